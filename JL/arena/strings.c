@@ -79,6 +79,7 @@ char *RESULT_VAL;
 char *ROOT;
 char *SAVED_BLOCKS;
 char *SELF;
+char *SHARED_CHARS_KEY;
 char *STACK;
 char *STACK_SIZE_NAME;
 char *STRING_NAME;
@@ -86,6 +87,7 @@ char *THREADS_KEY;
 char *TMP_VAL;
 char *TRUE_KEYWORD;
 char *TUPLE_NAME;
+char *TYPED_ARRAY_KEY;
 
 struct Chunk_ {
   char *block;
@@ -170,6 +172,7 @@ void strings_insert_constants() {
   ROOT = strings_intern("$root");
   SAVED_BLOCKS = strings_intern("$saved_blocks");
   SELF = strings_intern("self");
+  SHARED_CHARS_KEY = strings_intern("$shared_chars");
   STACK = strings_intern("$stack");
   STACK_SIZE_NAME = strings_intern("$stack_size");
   STRING_NAME = strings_intern("String");
@@ -177,6 +180,7 @@ void strings_insert_constants() {
   TMP_VAL = strings_intern("$tmp");
   TRUE_KEYWORD = strings_intern("True");
   TUPLE_NAME = strings_intern("Tuple");
+  TYPED_ARRAY_KEY = strings_intern("$typed_array");
 }
 
 void strings_init() {
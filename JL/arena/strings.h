@@ -69,6 +69,7 @@ extern char *RESULT_VAL;
 extern char *ROOT;
 extern char *SAVED_BLOCKS;
 extern char *SELF;
+extern char *SHARED_CHARS_KEY;
 extern char *STACK;
 extern char *STACK_SIZE_NAME;
 extern char *STRING_NAME;
@@ -76,6 +77,7 @@ extern char *THREADS_KEY;
 extern char *TMP_VAL;
 extern char *TRUE_KEYWORD;
 extern char *TUPLE_NAME;
+extern char *TYPED_ARRAY_KEY;
 
 typedef struct Chunk_ Chunk;
 
@@ -0,0 +1,130 @@
+/*
+ * find_str_bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+// Times find_str() on a browser-sized HTTP request against the plain double
+// loop it replaced, and checks both agree. Link it with the tree's objects in
+// place of main.c, built with the same flags (-O2, -msse2 or -mavx2).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../external/time/impl/time.h"
+#include "../shared.h"
+
+#define NUM_ROUNDS 200000
+#define NUM_RANDOM_CHECKS 200000
+
+static const char REQUEST[] =
+    "GET /static/js/app.bundle.js?v=3f9c2a HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: https://www.example.com/dashboard\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cookie: session=8c1d0f6b2e; theme=dark; _ga=GA1.2.1234567890.1700000000"
+    "\r\n\r\n";
+
+// The search find_str() used before.
+char *naive_find_str(char *haystack, size_t haystack_len, const char *needle,
+                     size_t needle_len) {
+  size_t i, j;
+  if (needle_len > haystack_len) {
+    return NULL;
+  }
+  for (i = 0; i + needle_len <= haystack_len; i++) {
+    for (j = 0; j < needle_len && haystack[i + j] == needle[j]; j++) {
+    }
+    if (j == needle_len) {
+      return haystack + i;
+    }
+  }
+  return NULL;
+}
+
+typedef char *(*Finder)(char *, size_t, const char *, size_t);
+
+// Finds every needle in the request the way String.find_all() does.
+size_t find_all(Finder finder, char *haystack, size_t len, const char *needle,
+                size_t needle_len) {
+  size_t count = 0, pos = 0;
+  char *found;
+  while (pos < len &&
+         NULL != (found = finder(haystack + pos, len - pos, needle,
+                                 needle_len))) {
+    count++;
+    pos = found - haystack + needle_len;
+  }
+  return count;
+}
+
+double time_ns(Finder finder, bool all, char *haystack, size_t len,
+               const char *needle) {
+  size_t needle_len = strlen(needle);
+  volatile size_t sink = 0;
+  int64_t start = current_usec_since_epoch();
+  int i;
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    sink += all ? find_all(finder, haystack, len, needle, needle_len)
+                : (size_t)finder(haystack, len, needle, needle_len);
+  }
+  return (current_usec_since_epoch() - start) * 1000.0 / NUM_ROUNDS;
+}
+
+// Compares against the naive search on short random strings over a small
+// alphabet, which makes partial matches common.
+int check_random() {
+  char haystack[256], needle[96];
+  int i, mismatches = 0;
+  srand(1);
+  for (i = 0; i < NUM_RANDOM_CHECKS; i++) {
+    size_t j, haystack_len = rand() % sizeof(haystack);
+    size_t needle_len = 1 + rand() % (i % 2 ? 8 : sizeof(needle));
+    for (j = 0; j < haystack_len; j++) {
+      haystack[j] = 'a' + rand() % 3;
+    }
+    for (j = 0; j < needle_len; j++) {
+      needle[j] = 'a' + rand() % 3;
+    }
+    if (find_str(haystack, haystack_len, needle, needle_len) !=
+        naive_find_str(haystack, haystack_len, needle, needle_len)) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+int main(int argc, const char *argv[]) {
+  const char *needles[] = {"\r\n", "\r\n\r\n", "Cookie", "keep-alive",
+                           "X-Not-There"};
+  const char *labels[] = {"\\r\\n", "\\r\\n\\r\\n", "Cookie",
+                          "keep-alive", "X-Not-There"};
+  size_t len = sizeof(REQUEST) - 1;
+  char *haystack = malloc(len);
+  memcpy(haystack, REQUEST, len);
+  printf("%zu byte request, ns per call (naive -> find_str)\n", len);
+  int i;
+  for (i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+    printf("  find %-14s %8.1f -> %8.1f\n", labels[i],
+           time_ns(naive_find_str, false, haystack, len, needles[i]),
+           time_ns(find_str, false, haystack, len, needles[i]));
+  }
+  printf("  find_all \\r\\n        %8.1f -> %8.1f\n",
+         time_ns(naive_find_str, true, haystack, len, "\r\n"),
+         time_ns(find_str, true, haystack, len, "\r\n"));
+  int mismatches = check_random();
+  printf("%d mismatches in %d random searches.\n", mismatches,
+         NUM_RANDOM_CHECKS);
+  free(haystack);
+  return mismatches > 0;
+}
@@ -0,0 +1,11 @@
+; Startup cost of a script which imports only io. Compare the line printed by
+; -startup_stats before and after a change to how builtin modules load:
+;
+;   jlc -startup_stats bench/startup_io.jl
+;
+; Loading every builtin module up front reports no modules left to load and
+; many more objects.
+
+import io
+
+io.println('Hello, world!')
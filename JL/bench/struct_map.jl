@@ -0,0 +1,72 @@
+; Map and LruCache workload from lib/struct.jl, for comparing interpreter
+; changes before and after. Run it with -profile_ops to also see the op pairs
+; and triples it executes most.
+;
+;   jlc bench/struct_map.jl
+
+import io
+import struct
+import time
+
+N = 200000
+
+def bench(name, fn) {
+  start = time.now_usec()
+  result = fn()
+  elapsed_ms = (time.now_usec() - start) / 1000
+  io.println(concat(name, ': ', elapsed_ms, ' ms (', result, ')'))
+}
+
+m = struct.Map()
+bench('Map insert', () -> {
+  for i=0, i<N, i=i+1 {
+    m[i] = i
+  }
+  return N
+})
+bench('Map lookup', () -> {
+  sum = 0
+  for i=0, i<N, i=i+1 {
+    sum = sum + m[i]
+  }
+  return sum
+})
+bench('Map in', () -> {
+  found = 0
+  for i=0, i<2*N, i=i+1 {
+    if i in m {
+      found = found + 1
+    }
+  }
+  return found
+})
+bench('Map string keys', () -> {
+  sm = struct.Map()
+  for i=0, i<N, i=i+1 {
+    sm[str(i)] = i
+  }
+  sum = 0
+  for i=0, i<N, i=i+1 {
+    sum = sum + sm[str(i)]
+  }
+  return sum
+})
+bench('Map remove', () -> {
+  for i=0, i<N, i=i+1 {
+    m.remove(i)
+  }
+  return N
+})
+bench('LruCache', () -> {
+  lru = struct.LruCache(1024)
+  hits = 0
+  for i=0, i<N, i=i+1 {
+    k = (i * 7) % 2048
+    if lru[k] {
+      hits = hits + 1
+    } else {
+      lru[k] = k + 1
+    }
+  }
+  return hits
+})
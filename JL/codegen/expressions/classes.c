@@ -253,13 +253,9 @@ int produce_constructor(Class *class, Tape *tape) {
     num_ins += tape->ins_no_arg(tape, RES, class->def.name.token);
   }
 
-  if (class->has_constructor && class->constructor.has_args) {
-    num_ins += produce_arguments(&class->constructor.args, tape);
-  }
-
   if (class->has_constructor) {
     Function *func = &class->constructor;
-    num_ins += produce_instructions(func->body, tape);
+    num_ins += produce_arguments_and_body(func, tape);
     num_ins += tape->ins_text(tape, RES, SELF, func->fn_name);
     if (func->is_const) {
       num_ins += tape->ins_no_arg(tape, CNST, func->const_token);
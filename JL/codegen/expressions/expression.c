@@ -884,10 +884,7 @@ ImplDelete(anon_function_definition) {
 int produce_anon_function(Function *func, Tape *tape) {
   int num_ins = 0, func_ins = 0;
   Tape *tmp = tape_create();
-  if (func->has_args) {
-    func_ins += produce_arguments(&func->args, tmp);
-  }
-  func_ins += produce_instructions(func->body, tmp);
+  func_ins += produce_arguments_and_body(func, tmp);
   if (func->is_const) {
     func_ins += tmp->ins_no_arg(tmp, CNST, func->const_token);
   }
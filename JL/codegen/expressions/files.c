@@ -13,6 +13,7 @@
 #include "../syntax.h"
 #include "expression.h"
 #include "expression_macros.h"
+#include "slots.h"
 
 Argument populate_argument(const SyntaxTree *stree) {
   Argument arg = { .is_const = false, .const_token = NULL, .is_field = false,
@@ -235,13 +236,31 @@ int produce_arguments(Arguments *args, Tape *tape) {
   return num_ins;
 }
 
+int produce_arguments_and_body(Function *func, Tape *tape) {
+  int num_ins = 0, num_slots = 0;
+  Tape *args_tape = tape_create();
+  Tape *body_tape = tape_create();
+  if (func->has_args) {
+    num_ins += produce_arguments(&func->args, args_tape);
+  }
+  num_ins += produce_instructions(func->body, body_tape);
+  if (func->has_args) {
+    num_slots = resolve_arg_slots(&func->args, args_tape, body_tape);
+  }
+  if (num_slots > 0) {
+    num_ins += tape->ins_int(tape, SLTS, num_slots, func->def_token);
+  }
+  tape_append(tape, args_tape);
+  tape_append(tape, body_tape);
+  tape_delete(args_tape);
+  tape_delete(body_tape);
+  return num_ins;
+}
+
 int produce_function(Function *func, Tape *tape) {
   int num_ins = 0;
   num_ins += tape->label(tape, func->fn_name);
-  if (func->has_args) {
-    num_ins += produce_arguments(&func->args, tape);
-  }
-  num_ins += produce_instructions(func->body, tape);
+  num_ins += produce_arguments_and_body(func, tape);
   if (func->is_const) {
     num_ins += tape->ins_no_arg(tape, CNST, func->const_token);
   }
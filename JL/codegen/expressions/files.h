@@ -58,6 +58,9 @@ Function populate_function_variant(const SyntaxTree *stree, ParseExpression def,
 Function populate_function(const SyntaxTree *stree);
 
 int produce_arguments(Arguments *args, Tape *tape);
+// Produces the arguments and then the body of func, resolving the arguments to
+// slots where possible.
+int produce_arguments_and_body(Function *func, Tape *tape);
 
 typedef struct {
   bool is_named;
@@ -0,0 +1,153 @@
+/*
+ * slots.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "slots.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../datastructure/expando.h"
+#include "../../datastructure/map.h"
+#include "../../memory/memory.h"
+#include "../../program/instruction.h"
+
+#define MAX_SLOT_REF 0xFFFF
+
+// These look the id up on an object, not as a variable.
+bool is_member_access(Op op) {
+  switch (op) {
+    case GET:
+    case GTSH:
+    case FLD:
+    case FLDC:
+    case CALL:
+    case CLLN:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns the slot for name, or -1 if it does not have one.
+int slot_of(const Map *slots, const char name[]) {
+  return ((int)(intptr_t)map_lookup(slots, name)) - 1;
+}
+
+// Marks where each anonymous function defined on tape starts and ends in
+// boundaries, which has one entry per instruction plus one. An anonymous
+// function runs in a block whose $parent is the block it was made in, so its
+// body is one block further from the function block. Returns false if the
+// tape does not have the expected JMP over the anonymous function body.
+bool mark_anon_functions(Tape *tape, int *boundaries) {
+  bool ok = true;
+  int len = tape_len(tape);
+  void mark_anon_function(Pair *kv) {
+    int start = (int)(intptr_t)kv->value;
+    const InsContainer *jmp = start > 0 ? tape_get(tape, start - 1) : NULL;
+    if (NULL == jmp || JMP != jmp->ins.op || VAL_PARAM != jmp->ins.param ||
+        INT != jmp->ins.val.type || start + jmp->ins.val.int_val > len) {
+      ok = false;
+      return;
+    }
+    boundaries[start]++;
+    boundaries[start + jmp->ins.val.int_val]--;
+  }
+  map_iterate(tape_refs(tape), mark_anon_function);
+  return ok;
+}
+
+// Returns false if some use of an argument on tape cannot be turned into a
+// slot access. Only modifies tape when rewrite is set.
+bool resolve_tape(const Map *slots, Tape *tape, bool is_args, bool rewrite) {
+  int i, depth = 0, len = tape_len(tape);
+  int *boundaries = ALLOC_ARRAY(int, len + 1);
+  bool ok = mark_anon_functions(tape, boundaries);
+  for (i = 0; ok && i < len; i++) {
+    depth += boundaries[i];
+    InsContainer *c = tape_get_mutable(tape, i);
+    if (NBLK == c->ins.op) {
+      if (++depth > MAX_SLOT_REF) {
+        ok = false;
+      }
+      continue;
+    }
+    if (BBLK == c->ins.op) {
+      if (--depth < 0) {
+        ok = false;
+      }
+      continue;
+    }
+    if (ID_PARAM != c->ins.param || is_member_access(c->ins.op)) {
+      continue;
+    }
+    int slot = slot_of(slots, c->ins.id);
+    if (slot < 0) {
+      continue;
+    }
+    Op op;
+    switch (c->ins.op) {
+      case LET:
+      case SET:
+        op = SETL;
+        break;
+      case RES:
+        op = RESL;
+        break;
+      case PUSH:
+        op = PSHL;
+        break;
+      default:
+        // E.g. SETC or CNST, which need the name.
+        ok = false;
+        continue;
+    }
+    // Arguments are only LET while binding them. Anything else there is a
+    // default value reading an argument which may not be bound yet. In the
+    // body it is an anonymous function binding an argument of its own which
+    // shadows this one.
+    if ((LET == c->ins.op) != is_args) {
+      ok = false;
+      continue;
+    }
+    if (rewrite) {
+      Value ref = {.type = INT, .int_val = SLOT_REF(depth, slot)};
+      c->ins = instruction_val(op, ref);
+    }
+  }
+  DEALLOC(boundaries);
+  return ok;
+}
+
+int resolve_arg_slots(const Arguments *args, Tape *args_tape, Tape *body) {
+  // An anonymous function in a default value would be bound while the
+  // arguments are, so LET can no longer tell them apart.
+  if (map_size(tape_refs(args_tape)) > 0) {
+    return 0;
+  }
+  Map slots;
+  map_init_default(&slots);
+  int i, num_slots = 0, num_args = expando_len(args->args);
+  for (i = 0; i < num_args && num_slots < MAX_SLOT_REF; i++) {
+    const Argument *arg = (const Argument *)expando_get(args->args, i);
+    // Fields live on self and consts are checked by name, so both are left
+    // alone.
+    if (arg->is_field || arg->is_const ||
+        NULL != map_lookup(&slots, arg->arg_name->text)) {
+      continue;
+    }
+    map_insert(&slots, arg->arg_name->text, (void *)(intptr_t)(++num_slots));
+  }
+  if (num_slots > 0 && resolve_tape(&slots, args_tape, true, false) &&
+      resolve_tape(&slots, body, false, false)) {
+    resolve_tape(&slots, args_tape, true, true);
+    resolve_tape(&slots, body, false, true);
+  } else {
+    num_slots = 0;
+  }
+  map_finalize(&slots);
+  return num_slots;
+}
@@ -0,0 +1,30 @@
+/*
+ * slots.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef CODEGEN_EXPRESSIONS_SLOTS_H_
+#define CODEGEN_EXPRESSIONS_SLOTS_H_
+
+#include "../../program/tape.h"
+#include "files.h"
+
+// Rewrites the instructions on args_tape and body which refer to the
+// arguments of a function so they access slots in the function's block by
+// index instead of looking them up by name.
+//
+// Only arguments are resolved. They are the only names a function binds
+// itself, with LET. Any other name is assigned with SET, which walks $parent
+// at runtime and may land on a module global, so it keeps its name lookup.
+// An anonymous function defined in the body reaches the arguments it captures
+// through the block it was made in, so uses inside it count that function's
+// block as one more level of depth.
+//
+// Returns the number of slots the function block needs or 0 if nothing was
+// rewritten, e.g. because an anonymous function in the body binds an argument
+// of the same name which it could not resolve itself.
+int resolve_arg_slots(const Arguments *args, Tape *args_tape, Tape *body);
+
+#endif /* CODEGEN_EXPRESSIONS_SLOTS_H_ */
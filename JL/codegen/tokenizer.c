@@ -24,24 +24,37 @@ char *keyword_to_type[] = {
 struct FileInfo_ {
   char *name;
   FILE *fp;
-  LineInfo **lines;
+  // The whole file if it was read up front, otherwise NULL and lines are read
+  // from fp as they are needed.
+  char *source, *source_pos;
+  LineInfo *lines;
   int num_lines;
   int array_len;
 };
 
-LineInfo *line_info(FileInfo *fi, char line_text[], int line_num) {
-  LineInfo *li = ALLOC(LineInfo);
-  li->line_text = strings_intern(line_text);
-  li->line_num = line_num;
-  return li;
+// Reads all of fi->fp into memory so lines can be tokenized in place instead
+// of being copied out one at a time.
+void file_info_read_source(FileInfo *fi) {
+  if (0 != fseek(fi->fp, 0, SEEK_END)) {
+    return;
+  }
+  long size = ftell(fi->fp);
+  if (size < 0 || 0 != fseek(fi->fp, 0, SEEK_SET)) {
+    return;
+  }
+  fi->source = ALLOC_ARRAY2(char, size + 1);
+  // May read less than size when newlines are translated.
+  size_t len = fread(fi->source, sizeof(char), size, fi->fp);
+  fi->source[len] = '\0';
+  fi->source_pos = fi->source;
+  file_info_close_file(fi);
 }
 
-void line_info_delete(LineInfo *li) { DEALLOC(li); }
-
 FileInfo *file_info(const char fn[]) {
   FILE *file = FILE_FN(fn, "r");
   FileInfo *fi = file_info_file(file);
   file_info_set_name(fi, fn);
+  file_info_read_source(fi);
   return fi;
 }
 
@@ -55,9 +68,10 @@ FileInfo *file_info_file(FILE *tmp_file) {
   fi->name = NULL;
   fi->fp = tmp_file;
   ASSERT_NOT_NULL(fi->fp);
+  fi->source = fi->source_pos = NULL;
   fi->num_lines = 0;
   fi->array_len = DEFAULT_NUM_LINES;
-  fi->lines = ALLOC_ARRAY(LineInfo *, fi->array_len);
+  fi->lines = ALLOC_ARRAY(LineInfo, fi->array_len);
   return fi;
 }
 
@@ -72,31 +86,54 @@ void file_info_close_file(FileInfo *fi) {
 void file_info_delete(FileInfo *fi) {
   ASSERT_NOT_NULL(fi);
   ASSERT_NOT_NULL(fi->lines);
-  int i;
-  for (i = 0; i < fi->num_lines; i++) {
-    line_info_delete(fi->lines[i]);
-  }
   DEALLOC(fi->lines);
+  if (NULL != fi->source) {
+    DEALLOC(fi->source);
+  }
   file_info_close_file(fi);
   DEALLOC(fi);
 }
 
 LineInfo *file_info_append(FileInfo *fi, char line_text[]) {
-  int num_lines = fi->num_lines;
-  LineInfo *li = fi->lines[fi->num_lines++] =
-      line_info(fi, line_text, num_lines);
   if (fi->num_lines >= fi->array_len) {
-    fi->array_len += DEFAULT_NUM_LINES;
-    fi->lines = REALLOC(fi->lines, LineInfo *, fi->array_len);
+    fi->array_len *= 2;
+    fi->lines = REALLOC(fi->lines, LineInfo, fi->array_len);
   }
+  LineInfo *li = fi->lines + fi->num_lines;
+  // Lines in fi->source already live as long as fi does.
+  li->line_text =
+      (NULL == fi->source) ? strings_intern(line_text) : line_text;
+  li->tokens = NULL;
+  li->line_num = fi->num_lines++;
   return li;
 }
 
+// Returns the next line, which may be modified in place, or NULL if there are
+// no more lines.
+char *file_info_next_line(FileInfo *fi, char buffer[]) {
+  if (NULL == fi->source) {
+    return fgets(buffer, MAX_LINE_LEN, fi->fp);
+  }
+  if ('\0' == *fi->source_pos) {
+    return NULL;
+  }
+  char *line = fi->source_pos;
+  char *end = strchr(line, '\n');
+  if (NULL == end) {
+    fi->source_pos = line + strlen(line);
+  } else {
+    // The newline only ever ended the line, so just terminate it instead.
+    *end = '\0';
+    fi->source_pos = end + 1;
+  }
+  return line;
+}
+
 const LineInfo *file_info_lookup(const FileInfo *fi, int line_num) {
   if (line_num < 1 || line_num > fi->num_lines) {
     return NULL;
   }
-  return fi->lines[line_num - 1];
+  return fi->lines + line_num - 1;
 }
 
 int file_info_len(const FileInfo *fi) { return fi->num_lines; }
@@ -118,6 +155,17 @@ Token *token_create(TokenType type, int line, int col, const char text[]) {
   return tok;
 }
 
+// Creates a token for the first len chars of text without copying them out
+// first. text is only modified temporarily.
+Token *token_create_len(TokenType type, int line, int col, char text[],
+                        int len) {
+  char end = text[len];
+  text[len] = '\0';
+  Token *tok = token_create(type, line, col, text);
+  text[len] = end;
+  return tok;
+}
+
 void token_delete(Token *token) {
   ASSERT_NOT_NULL(token);
   ARENA_DEALLOC(Token, token);
@@ -250,6 +298,8 @@ TokenType word_type(const char word[], int word_len) {
 
 TokenType resolve_type(const char word[], int word_len, int *in_comment) {
   TokenType type;
+  // word is not terminated, so do not look past its end.
+  const char second = word_len > 1 ? word[1] : '\0';
   if (0 == word_len) {
     type = ENDLINE;
     *in_comment = false;
@@ -274,10 +324,10 @@ TokenType resolve_type(const char word[], int word_len, int *in_comment) {
         type = RBRAC;
         break;
       case '+':
-        type = word[1] == '+' ? INCREMENT : PLUS;
+        type = second == '+' ? INCREMENT : PLUS;
         break;
       case '-':
-        type = word[1] == '>' ? RARROW : (word[1] == '-' ? DECREMENT : MINUS);
+        type = second == '>' ? RARROW : (second == '-' ? DECREMENT : MINUS);
         break;
       case '*':
         type = STAR;
@@ -304,7 +354,7 @@ TokenType resolve_type(const char word[], int word_len, int *in_comment) {
         type = TILDE;
         break;
       case '!':
-        type = word[1] == '=' ? NEQUIV : EXCLAIM;
+        type = second == '=' ? NEQUIV : EXCLAIM;
         break;
       case '?':
         type = QUESTION;
@@ -316,13 +366,13 @@ TokenType resolve_type(const char word[], int word_len, int *in_comment) {
         type = POUND;
         break;
       case '<':
-        type = word[1] == '-' ? LARROW : (word[1] == '=' ? LTHANEQ : LTHAN);
+        type = second == '-' ? LARROW : (second == '=' ? LTHANEQ : LTHAN);
         break;
       case '>':
-        type = word[1] == '=' ? GTHANEQ : GTHAN;
+        type = second == '=' ? GTHANEQ : GTHAN;
         break;
       case '=':
-        type = word[1] == '=' ? EQUIV : EQUALS;
+        type = second == '=' ? EQUIV : EQUALS;
         break;
       case ',':
         type = COMMA;
@@ -342,7 +392,8 @@ TokenType resolve_type(const char word[], int word_len, int *in_comment) {
         break;
       default:
         if (is_number(word[0])) {
-          if (ends_with(word, "f") || contains_char(word, '.')) {
+          if ('f' == word[word_len - 1] ||
+              NULL != memchr(word, '.', word_len)) {
             type = FLOATING;
           } else {
             type = INTEGER;
@@ -381,87 +432,88 @@ bool is_complex(const char seq[]) {
   }
 }
 
-int read_word(char **ptr, char word[], int *word_len) {
-  char *index = *ptr, *tmp;
-  int wrd_ln = 0;
+// Finds the next word in the line at *ptr without copying it. Returns the
+// number of chars consumed.
+int read_word(char **ptr, char **word, int *word_len) {
+  char *index = *ptr;
 
   if (0 == index[0]) {
-    word[0] = '\0';
+    *word = index;
     *word_len = 0;
-    tmp = *ptr;
     return 0;
   }
 
   while (is_whitespace(index[0])) {
     index++;
   }
+  *word = index;
 
   if ((is_special_char(index[0]) || CODE_COMMENT_CH == index[0])) {
-    if (is_complex(index)) {
-      word[wrd_ln++] = index[0];
+    index += is_complex(index) ? 2 : 1;
+  } else if ('\n' != index[0] && '\0' != index[0]) {
+    if (is_number(index[0])) {
       index++;
-    }
-    word[wrd_ln++] = index[0];
-    index++;
-  } else {
-    if ('\n' != index[0]) {
-      word[wrd_ln++] = index[0];
+      while (is_number(index[0]) || 'f' == index[0]) {
+        index++;
+      }
+    } else if (is_alphanumeric(index[0])) {
       index++;
-
-      if (is_alphanumeric(word[0])) {
-        if (is_number(word[0])) {
-          while (is_number(index[0]) || 'f' == index[0]) {
-            word[wrd_ln++] = index[0];
-            index++;
-          }
-        } else {
-          while (is_alphanumeric(index[0])) {
-            word[wrd_ln++] = index[0];
-            index++;
-          }
-        }
+      while (is_alphanumeric(index[0])) {
+        index++;
       }
+    } else {
+      index++;
     }
   }
 
-  word[wrd_ln] = '\0';
-  *word_len = wrd_ln;
-  tmp = *ptr;
+  *word_len = index - *word;
+  int consumed = index - *ptr;
   *ptr = index;
-
-  // printf("\t'%s' %d %d\n", word, wrd_ln, *ptr - tmp);
-
-  return *ptr - tmp;
+  return consumed;
 }
 
-int read_string(const char line[], char **index, char *word,
-                bool escape_characters) {
-  int word_i = 1;
-  word[0] = '\'';
-  while ('\'' != **index) {
-    if ('\\' == **index && escape_characters) {
-      word[word_i++] = char_unesc(*++*index);
-    } else {
-      word[word_i++] = **index;
+// Creates a token for the string starting just after the opening quote at
+// *index and moves *index past the closing quote.
+Token *read_string(char **index, int line_num, int col_num,
+                   bool escape_characters) {
+  char *start = *index - 1, *end = *index;
+  bool has_escapes = false;
+  while ('\'' != *end && '\0' != *end) {
+    if ('\\' == *end && escape_characters && '\0' != end[1]) {
+      has_escapes = true;
+      end++;
     }
-    (*index)++;
+    end++;
+  }
+  if ('\'' == *end) {
+    end++;
+  }
+  *index = end;
+  if (!has_escapes) {
+    return token_create_len(STR, line_num, col_num - (end - start), start,
+                            end - start);
+  }
+  char *word = ALLOC_ARRAY2(char, end - start + 1);
+  int word_i = 0;
+  char *c;
+  for (c = start; c < end; c++) {
+    word[word_i++] = ('\\' == *c && c + 1 < end) ? char_unesc(*++c) : *c;
   }
-  word[word_i++] = **index;
-  (*index)++;
   word[word_i] = '\0';
-  return word_i;
+  Token *tok = token_create(STR, line_num, col_num - word_i, word);
+  DEALLOC(word);
+  return tok;
 }
 
 bool tokenize_line(int *line_num, FileInfo *fi, Queue *queue,
                    bool escape_characters) {
-  char line[MAX_LINE_LEN];
-  char word[MAX_LINE_LEN];
-  char *index;
+  char buffer[MAX_LINE_LEN];
+  char *line, *index, *word;
   int in_comment = false;
   TokenType type;
   int col_num = 0, word_len = 0, chars_consumed;
 
-  if (NULL == fgets(line, MAX_LINE_LEN, fi->fp)) {
+  if (NULL == (line = file_info_next_line(fi, buffer))) {
     return false;
   }
 
@@ -471,31 +523,34 @@ bool tokenize_line(int *line_num, FileInfo *fi, Queue *queue,
   file_info_append(fi, line);
 
   while (true) {
-    chars_consumed = read_word(&index, word, &word_len);
+    chars_consumed = read_word(&index, &word, &word_len);
 
     type = resolve_type(word, word_len, &in_comment);
 
     col_num += chars_consumed;
 
     if (in_comment) {
+      // Nothing else on the line matters.
+      int rest = strlen(index);
+      index += rest;
+      col_num += rest;
       continue;
     }
 
-    if (STR == type) {
-      read_string(line, &index, word, escape_characters);
-    }
-
     if (ENDLINE == type && queue->size > 0 && queue_last(queue) != NULL &&
         ((Token *)queue_last(queue))->type == BSLASH) {
       Token *bslash = queue_last(queue);
       queue_remove_elt(queue, bslash);
       token_delete(bslash);
       tokenize_line(line_num, fi, queue, escape_characters);
+    } else if (STR == type) {
+      queue_add(queue,
+                read_string(&index, *line_num, col_num, escape_characters));
     } else if (ENDLINE != type ||
                (queue->size != 0 &&
                 ENDLINE != ((Token *)queue_last(queue))->type)) {
-      queue_add(queue,
-                token_create(type, *line_num, col_num - strlen(word), word));
+      queue_add(queue, token_create_len(type, *line_num, col_num - word_len,
+                                        word, word_len));
     }
 
     if (0 == chars_consumed) {
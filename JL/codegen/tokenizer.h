@@ -142,6 +142,7 @@ Token *token_copy(Token *tok);
 void token_delete(Token *tok);
 
 bool is_whitespace(const char c);
+bool is_alphanumeric(const char c);
 bool is_any_space(const char c);
 char char_unesc(char u);
 
@@ -22,8 +22,13 @@ typedef enum {
   ArgKey__OUT_MACHINE,
   ArgKey__OUT_UNOPTIMIZED,
   ArgKey__OPTIMIZE,
+  ArgKey__OPTIMIZATION_LEVEL,
+  ArgKey__OPTIMIZE_SKIP,
   ArgKey__EXECUTE,
   ArgKey__INTERPRETER,
+  ArgKey__PROFILE_OPS,
+  ArgKey__STARTUP_STATS,
+  ArgKey__EAGER_BUILTINS,
   ArgKey__BUILTIN_DIR,
   ArgKey__BUILTIN_FILES,
   ArgKey__BIN_OUT_DIR,
@@ -18,6 +18,8 @@ void argconfig_compile(ArgConfig* const config) {
   argconfig_add(config, ArgKey__OUT_MACHINE, "m", arg_bool(false));
   argconfig_add(config, ArgKey__OUT_BINARY, "b", arg_bool(false));
   argconfig_add(config, ArgKey__OPTIMIZE, "opt", arg_bool(true));
+  argconfig_add(config, ArgKey__OPTIMIZATION_LEVEL, "optlevel", arg_int(1));
+  argconfig_add(config, ArgKey__OPTIMIZE_SKIP, "opt_skip", arg_string(""));
   argconfig_add(config, ArgKey__OUT_UNOPTIMIZED, "ou", arg_bool(false));
   argconfig_add(config, ArgKey__BIN_OUT_DIR, "bout", arg_string("./"));
   argconfig_add(config, ArgKey__MACHINE_OUT_DIR, "mout", arg_string("./"));
@@ -28,6 +30,11 @@ void argconfig_run(ArgConfig* const config) {
   ASSERT(NOT_NULL(config));
   argconfig_add(config, ArgKey__EXECUTE, "ex", arg_bool(true));
   argconfig_add(config, ArgKey__INTERPRETER, "i", arg_bool(false));
+  argconfig_add(config, ArgKey__PROFILE_OPS, "profile_ops", arg_bool(false));
+  argconfig_add(config, ArgKey__STARTUP_STATS, "startup_stats",
+                arg_bool(false));
+  argconfig_add(config, ArgKey__EAGER_BUILTINS, "eager_builtins",
+                arg_bool(false));
   argconfig_add(config, ArgKey__BUILTIN_DIR, "builtin_dir",
                 arg_string(path_to_libs()));
   argconfig_add(config, ArgKey__BUILTIN_FILES, "builtin_files",
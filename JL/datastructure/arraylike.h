@@ -96,6 +96,8 @@
     if (size <= 0 || size <= array->table_size) {                              \
       return;                                                                  \
     }                                                                          \
+    /* Grow geometrically so repeated appends are amortized O(1). */           \
+    size = max(size, array->table_size * 2);                                   \
     array->table = REALLOC(array->table, type, size);                          \
     array->table_size = size;                                                  \
     memset(array->table + array->num_elts, 0x0,                                \
@@ -0,0 +1,381 @@
+/*
+ * sort.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "sort.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../error.h"
+#include "../memory/memory.h"
+
+#define INSERTION_SORT_THRESHOLD 24
+#define NINTHER_THRESHOLD 128
+#define PARTIAL_INSERTION_SORT_LIMIT 8
+#define MERGE_SORT_RUN 16
+#define RADIX_SORT_THRESHOLD 64
+
+typedef struct {
+  char *base;
+  size_t size;
+  SortComparator cmp;
+  void *ctx;
+  // Scratch space for one element each.
+  char *tmp, *pivot;
+} Sorter;
+
+#define AT(s, i) ((s)->base + (i) * (s)->size)
+
+bool sorter_less(const Sorter *s, const char *x, const char *y) {
+  return s->cmp(x, y, s->ctx) < 0;
+}
+
+void sorter_swap(const Sorter *s, size_t x, size_t y) {
+  memcpy(s->tmp, AT(s, x), s->size);
+  memcpy(AT(s, x), AT(s, y), s->size);
+  memcpy(AT(s, y), s->tmp, s->size);
+}
+
+void sorter_sort2(const Sorter *s, size_t x, size_t y) {
+  if (sorter_less(s, AT(s, y), AT(s, x))) {
+    sorter_swap(s, x, y);
+  }
+}
+
+void sorter_sort3(const Sorter *s, size_t x, size_t y, size_t z) {
+  sorter_sort2(s, x, y);
+  sorter_sort2(s, y, z);
+  sorter_sort2(s, x, y);
+}
+
+void sorter_insertion_sort(const Sorter *s, size_t begin, size_t end) {
+  size_t cur;
+  for (cur = begin + 1; cur < end; cur++) {
+    if (!sorter_less(s, AT(s, cur), AT(s, cur - 1))) {
+      continue;
+    }
+    size_t sift = cur;
+    memcpy(s->tmp, AT(s, cur), s->size);
+    do {
+      memcpy(AT(s, sift), AT(s, sift - 1), s->size);
+      sift--;
+    } while (sift > begin && sorter_less(s, s->tmp, AT(s, sift - 1)));
+    memcpy(AT(s, sift), s->tmp, s->size);
+  }
+}
+
+// Like sorter_insertion_sort() but gives up after moving a handful of
+// elements. Returns true if [begin, end) ended up sorted.
+bool sorter_partial_insertion_sort(const Sorter *s, size_t begin,
+                                   size_t end) {
+  size_t cur, moved = 0;
+  for (cur = begin + 1; cur < end; cur++) {
+    if (moved > PARTIAL_INSERTION_SORT_LIMIT) {
+      return false;
+    }
+    if (!sorter_less(s, AT(s, cur), AT(s, cur - 1))) {
+      continue;
+    }
+    size_t sift = cur;
+    memcpy(s->tmp, AT(s, cur), s->size);
+    do {
+      memcpy(AT(s, sift), AT(s, sift - 1), s->size);
+      sift--;
+    } while (sift > begin && sorter_less(s, s->tmp, AT(s, sift - 1)));
+    memcpy(AT(s, sift), s->tmp, s->size);
+    moved += cur - sift;
+  }
+  return true;
+}
+
+void sorter_sift_down(const Sorter *s, size_t begin, size_t root, size_t num) {
+  while (true) {
+    size_t child = 2 * root + 1;
+    if (child >= num) {
+      return;
+    }
+    if (child + 1 < num &&
+        sorter_less(s, AT(s, begin + child), AT(s, begin + child + 1))) {
+      child++;
+    }
+    if (!sorter_less(s, AT(s, begin + root), AT(s, begin + child))) {
+      return;
+    }
+    sorter_swap(s, begin + root, begin + child);
+    root = child;
+  }
+}
+
+void sorter_heap_sort(const Sorter *s, size_t begin, size_t end) {
+  size_t num = end - begin, i;
+  for (i = num / 2; i > 0; i--) {
+    sorter_sift_down(s, begin, i - 1, num);
+  }
+  for (i = num - 1; i > 0; i--) {
+    sorter_swap(s, begin, begin + i);
+    sorter_sift_down(s, begin, 0, i);
+  }
+}
+
+// Partitions [begin, end) around the element at begin, putting elements equal
+// to it on the right. Returns the final position of the pivot.
+size_t sorter_partition_right(const Sorter *s, size_t begin, size_t end,
+                              bool *already_partitioned) {
+  memcpy(s->pivot, AT(s, begin), s->size);
+  size_t first = begin, last = end;
+  do {
+    first++;
+  } while (first < end && sorter_less(s, AT(s, first), s->pivot));
+  if (first - 1 == begin) {
+    do {
+      last--;
+    } while (first < last && !sorter_less(s, AT(s, last), s->pivot));
+  } else {
+    do {
+      last--;
+    } while (last > begin && !sorter_less(s, AT(s, last), s->pivot));
+  }
+  *already_partitioned = first >= last;
+  while (first < last) {
+    sorter_swap(s, first, last);
+    do {
+      first++;
+    } while (first < end && sorter_less(s, AT(s, first), s->pivot));
+    do {
+      last--;
+    } while (last > begin && !sorter_less(s, AT(s, last), s->pivot));
+  }
+  size_t pivot_pos = first - 1;
+  memcpy(AT(s, begin), AT(s, pivot_pos), s->size);
+  memcpy(AT(s, pivot_pos), s->pivot, s->size);
+  return pivot_pos;
+}
+
+// Partitions [begin, end) around the element at begin, putting elements equal
+// to it on the left. Used when the pivot is known to equal an element before
+// begin, so the equal ones are done and never need to be looked at again.
+size_t sorter_partition_left(const Sorter *s, size_t begin, size_t end) {
+  memcpy(s->pivot, AT(s, begin), s->size);
+  size_t first = begin, last = end;
+  do {
+    last--;
+  } while (last > begin && sorter_less(s, s->pivot, AT(s, last)));
+  do {
+    first++;
+  } while (first < last && !sorter_less(s, s->pivot, AT(s, first)));
+  while (first < last) {
+    sorter_swap(s, first, last);
+    do {
+      last--;
+    } while (last > begin && sorter_less(s, s->pivot, AT(s, last)));
+    do {
+      first++;
+    } while (first < last && !sorter_less(s, s->pivot, AT(s, first)));
+  }
+  memcpy(AT(s, begin), AT(s, last), s->size);
+  memcpy(AT(s, last), s->pivot, s->size);
+  return last;
+}
+
+void sorter_pdq_loop(const Sorter *s, size_t begin, size_t end, int bad_allowed,
+                     bool leftmost) {
+  while (true) {
+    size_t num = end - begin;
+    if (num < INSERTION_SORT_THRESHOLD) {
+      sorter_insertion_sort(s, begin, end);
+      return;
+    }
+    // Move the median of 3 (or of 9 for big ranges) to begin.
+    size_t half = num / 2;
+    if (num > NINTHER_THRESHOLD) {
+      sorter_sort3(s, begin, begin + half, end - 1);
+      sorter_sort3(s, begin + 1, begin + half - 1, end - 2);
+      sorter_sort3(s, begin + 2, begin + half + 1, end - 3);
+      sorter_sort3(s, begin + half - 1, begin + half, begin + half + 1);
+      sorter_swap(s, begin, begin + half);
+    } else {
+      sorter_sort3(s, begin + half, begin, end - 1);
+    }
+    if (!leftmost && !sorter_less(s, AT(s, begin - 1), AT(s, begin))) {
+      begin = sorter_partition_left(s, begin, end) + 1;
+      continue;
+    }
+    bool already_partitioned;
+    size_t pivot_pos =
+        sorter_partition_right(s, begin, end, &already_partitioned);
+    size_t l_size = pivot_pos - begin;
+    size_t r_size = end - (pivot_pos + 1);
+    if (l_size < num / 8 || r_size < num / 8) {
+      // Too many bad pivots means the input is adversarial.
+      if (--bad_allowed == 0) {
+        sorter_heap_sort(s, begin, end);
+        return;
+      }
+      // Shuffle some elements around to break up the pattern.
+      if (l_size >= INSERTION_SORT_THRESHOLD) {
+        sorter_swap(s, begin, begin + l_size / 4);
+        sorter_swap(s, pivot_pos - 1, pivot_pos - l_size / 4);
+        if (l_size > NINTHER_THRESHOLD) {
+          sorter_swap(s, begin + 1, begin + (l_size / 4 + 1));
+          sorter_swap(s, begin + 2, begin + (l_size / 4 + 2));
+          sorter_swap(s, pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+          sorter_swap(s, pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+        }
+      }
+      if (r_size >= INSERTION_SORT_THRESHOLD) {
+        sorter_swap(s, pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+        sorter_swap(s, end - 1, end - r_size / 4);
+        if (r_size > NINTHER_THRESHOLD) {
+          sorter_swap(s, pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+          sorter_swap(s, pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+          sorter_swap(s, end - 2, end - (1 + r_size / 4));
+          sorter_swap(s, end - 3, end - (2 + r_size / 4));
+        }
+      }
+    } else if (already_partitioned &&
+               sorter_partial_insertion_sort(s, begin, pivot_pos) &&
+               sorter_partial_insertion_sort(s, pivot_pos + 1, end)) {
+      // Probably was already sorted.
+      return;
+    }
+    // Recurse into the left side and loop on the right.
+    sorter_pdq_loop(s, begin, pivot_pos, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+void pdq_sort(void *base, size_t num, size_t size, SortComparator cmp,
+              void *ctx) {
+  ASSERT(NOT_NULL(cmp));
+  if (num < 2) {
+    return;
+  }
+  char *scratch = ALLOC_ARRAY2(char, 2 * size);
+  Sorter s = {.base = (char *)base,
+              .size = size,
+              .cmp = cmp,
+              .ctx = ctx,
+              .tmp = scratch,
+              .pivot = scratch + size};
+  int bad_allowed = 0;
+  size_t n;
+  for (n = num; n > 1; n >>= 1) {
+    bad_allowed++;
+  }
+  sorter_pdq_loop(&s, 0, num, bad_allowed, true);
+  DEALLOC(scratch);
+}
+
+// Merges the sorted runs src[lo, mid) and src[mid, hi) into dst[lo, hi).
+void sorter_merge(const Sorter *s, const char *src, char *dst, size_t lo,
+                  size_t mid, size_t hi) {
+  size_t i = lo, j = mid, k = lo;
+  while (i < mid && j < hi) {
+    // Take from the left on ties to keep it stable.
+    if (s->cmp(src + j * s->size, src + i * s->size, s->ctx) < 0) {
+      memcpy(dst + k++ * s->size, src + j++ * s->size, s->size);
+    } else {
+      memcpy(dst + k++ * s->size, src + i++ * s->size, s->size);
+    }
+  }
+  memcpy(dst + k * s->size, src + i * s->size, (mid - i) * s->size);
+  k += mid - i;
+  memcpy(dst + k * s->size, src + j * s->size, (hi - j) * s->size);
+}
+
+void merge_sort(void *base, size_t num, size_t size, SortComparator cmp,
+                void *ctx) {
+  ASSERT(NOT_NULL(cmp));
+  if (num < 2) {
+    return;
+  }
+  char *tmp = ALLOC_ARRAY2(char, size);
+  Sorter s = {
+      .base = (char *)base, .size = size, .cmp = cmp, .ctx = ctx, .tmp = tmp};
+  size_t lo;
+  for (lo = 0; lo < num; lo += MERGE_SORT_RUN) {
+    sorter_insertion_sort(&s, lo, min(lo + MERGE_SORT_RUN, num));
+  }
+  if (num <= MERGE_SORT_RUN) {
+    DEALLOC(tmp);
+    return;
+  }
+  char *buffer = ALLOC_ARRAY2(char, num * size);
+  char *src = (char *)base, *dst = buffer, *swap;
+  size_t width;
+  for (width = MERGE_SORT_RUN; width < num; width *= 2) {
+    for (lo = 0; lo < num; lo += 2 * width) {
+      size_t mid = min(lo + width, num);
+      size_t hi = min(lo + 2 * width, num);
+      sorter_merge(&s, src, dst, lo, mid, hi);
+    }
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != (char *)base) {
+    memcpy(base, src, num * size);
+  }
+  DEALLOC(buffer);
+  DEALLOC(tmp);
+}
+
+void radix_sort_int64(int64_t vals[], size_t num) {
+  ASSERT(NOT_NULL(vals));
+  size_t i;
+  if (num < RADIX_SORT_THRESHOLD) {
+    for (i = 1; i < num; i++) {
+      int64_t val = vals[i];
+      size_t j = i;
+      for (; j > 0 && vals[j - 1] > val; j--) {
+        vals[j] = vals[j - 1];
+      }
+      vals[j] = val;
+    }
+    return;
+  }
+  // Flip the sign bit so negatives order before positives as unsigned.
+#define RADIX_KEY(val) (((uint64_t)(val)) ^ 0x8000000000000000ULL)
+  size_t *counts = ALLOC_ARRAY(size_t, 8 * 256);
+  for (i = 0; i < num; i++) {
+    uint64_t key = RADIX_KEY(vals[i]);
+    int byte;
+    for (byte = 0; byte < 8; byte++) {
+      counts[byte * 256 + ((key >> (8 * byte)) & 0xFF)]++;
+    }
+  }
+  int64_t *buffer = ALLOC_ARRAY2(int64_t, num);
+  int64_t *src = vals, *dst = buffer, *swap;
+  int byte;
+  for (byte = 0; byte < 8; byte++) {
+    size_t *count = counts + byte * 256;
+    // Every value has the same byte here, so there is nothing to do.
+    if (count[(RADIX_KEY(src[0]) >> (8 * byte)) & 0xFF] == num) {
+      continue;
+    }
+    size_t offset = 0;
+    int bucket;
+    for (bucket = 0; bucket < 256; bucket++) {
+      size_t bucket_count = count[bucket];
+      count[bucket] = offset;
+      offset += bucket_count;
+    }
+    for (i = 0; i < num; i++) {
+      dst[count[(RADIX_KEY(src[i]) >> (8 * byte)) & 0xFF]++] = src[i];
+    }
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+#undef RADIX_KEY
+  if (src != vals) {
+    memcpy(vals, src, num * sizeof(int64_t));
+  }
+  DEALLOC(buffer);
+  DEALLOC(counts);
+}
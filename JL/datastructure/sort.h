@@ -0,0 +1,31 @@
+/*
+ * sort.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef DATASTRUCTURE_SORT_H_
+#define DATASTRUCTURE_SORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns < 0 if x comes before y, > 0 if after and 0 if they are equal.
+typedef int (*SortComparator)(const void *x, const void *y, void *ctx);
+
+// Pattern-defeating quicksort. Not stable. O(n log n) worst case and O(n) on
+// sorted, reversed and all-equal input. Stays within bounds even if cmp is not
+// consistent, so it is safe to use with user-provided comparators.
+void pdq_sort(void *base, size_t num, size_t size, SortComparator cmp,
+              void *ctx);
+
+// Stable bottom-up merge sort. Needs num * size bytes of scratch space.
+void merge_sort(void *base, size_t num, size_t size, SortComparator cmp,
+                void *ctx);
+
+// LSD radix sort. Skips byte positions where every value is the same, so
+// small ranges of values only take a pass or two.
+void radix_sort_int64(int64_t vals[], size_t num);
+
+#endif /* DATASTRUCTURE_SORT_H_ */
@@ -405,6 +405,10 @@ void obj_delete_ptr(Object *obj, bool free_mem) {
   ASSERT(NOT_NULL(obj->parent_objs));
   expando_delete(obj->parent_objs);
 
+  if (NULL != obj->slots) {
+    DEALLOC(obj->slots);
+  }
+
   if (ARRAY == obj->type) {
     Array_delete(obj->array);
   } else if (TUPLE == obj->type) {
@@ -628,9 +632,9 @@ void obj_to_str(Object *obj, FILE *file) {
         fprintf(file, "?");
       } else {
         if (class.obj == class_string.obj) {
-          fprintf(file,
-                  "'%*s'==", String_size(String_extract(element_from_obj(obj))),
-                  String_cstr(String_extract(element_from_obj(obj))));
+          String *string = String_extract(element_from_obj(obj));
+          fprintf(file, "'%.*s'==", (int)String_size(string),
+                  String_cstr(string));
           fflush(file);
         }
         fprintf(file, "%s@%p",
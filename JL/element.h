@@ -69,6 +69,9 @@ typedef struct Object_ {
   Map fields;
   bool is_external, is_const;
   Expando *parent_objs;
+  // Arguments resolved to slots by the compiler. Only used by blocks.
+  Element *slots;
+  int num_slots;
 
   union {
     Array *array;
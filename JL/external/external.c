@@ -13,6 +13,7 @@
 #include "../arena/strings.h"
 #include "../class.h"
 #include "../datastructure/array.h"
+#include "../datastructure/sort.h"
 #include "../datastructure/tuple.h"
 #include "../error.h"
 #include "../memory/memory.h"
@@ -22,7 +23,9 @@
 #include "file.h"
 #include "math.h"
 #include "modules.h"
+#include "string_builder.h"
 #include "strings.h"
+#include "typed_array.h"
 
 Element Int__(VM *vm, Thread *t, ExternalData *data, Element *arg);
 Element Float__(VM *vm, Thread *t, ExternalData *data, Element *arg);
@@ -63,6 +66,13 @@ void add_builtin_external(VM *vm, Element builtin) {
   add_external_function(vm, builtin, "load_module__", load_module__);
   add_external_function(vm, builtin, "log__", log__);
   add_external_function(vm, builtin, "pow__", pow__);
+  add_external_function(vm, builtin, "sum__", sum__);
+  add_external_function(vm, builtin, "min__", min__);
+  add_external_function(vm, builtin, "max__", max__);
+  add_external_function(vm, builtin, "dot__", dot__);
+  add_external_function(vm, builtin, "scale__", scale__);
+  add_external_function(vm, builtin, "add__", add__);
+  add_external_function(vm, builtin, "compare__", compare__);
 }
 
 void add_global_builtin_external(VM *vm, Element builtin) {
@@ -71,8 +81,13 @@ void add_global_builtin_external(VM *vm, Element builtin) {
   add_global_external_function(vm, builtin, "Char", Char__);
   add_global_external_function(vm, builtin, "srand", srand__);
   add_global_external_function(vm, builtin, "rand", rand__);
+  add_global_external_function(vm, builtin, "concat", concat__);
   add_global_external_function(vm, builtin, "collect_garbage",
                                collect_garbage__);
+  merge_typed_array_classes(vm, builtin);
+  Element builder_class = create_string_builder_class(vm, builtin);
+  memory_graph_set_field(vm->graph, vm->root, strings_intern("StringBuilder"),
+                         builder_class);
 }
 
 Element add_external_function(VM *vm, Element parent, const char fn_name[],
@@ -248,12 +263,238 @@ Element array_shift(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   return create_none();
 }
 
+typedef struct {
+  Element key, elt;
+  // Set if key is a String so it does not need to be extracted every time.
+  const String *str;
+} SortEntry;
+
+typedef enum {
+  SortKind_INT,
+  SortKind_NUMBER,
+  SortKind_STRING,
+  SortKind_OTHER
+} SortKind;
+
+typedef struct {
+  VM *vm;
+  Thread *t;
+  Element fn;
+  bool has_error;
+  // What the external method should return if has_error.
+  Element error;
+} SortCallback;
+
+SortKind sort_kind(const SortEntry entries[], uint32_t num) {
+  bool all_int = true, all_number = true, all_string = true;
+  uint32_t i;
+  for (i = 0; i < num && (all_number || all_string); ++i) {
+    const Element *key = &entries[i].key;
+    all_int &= is_value_type(key, INT);
+    all_number &= VALUE == key->type;
+    all_string &= ISTYPE(*key, class_string);
+  }
+  return all_int ? SortKind_INT
+                 : all_number ? SortKind_NUMBER
+                              : all_string ? SortKind_STRING : SortKind_OTHER;
+}
+
+int sort_number_cmp(const void *x, const void *y, void *ctx) {
+  Value v1 = ((const SortEntry *)x)->key.val;
+  Value v2 = ((const SortEntry *)y)->key.val;
+  if (INT == v1.type && INT == v2.type) {
+    return (v1.int_val > v2.int_val) - (v1.int_val < v2.int_val);
+  }
+  double d1 = VALUE_OF(v1), d2 = VALUE_OF(v2);
+  return (d1 > d2) - (d1 < d2);
+}
+
+int sort_string_cmp(const void *x, const void *y, void *ctx) {
+  return String_compare(((const SortEntry *)x)->str,
+                        ((const SortEntry *)y)->str);
+}
+
+// Calls the JL comparator. Once it fails, every comparison is a tie so the
+// sort finishes quickly without calling back into the VM.
+int sort_callback_cmp(const void *x, const void *y, void *ctx) {
+  SortCallback *callback = (SortCallback *)ctx;
+  if (callback->has_error) {
+    return 0;
+  }
+  VM *vm = callback->vm;
+  Thread *t = callback->t;
+  Element args = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, args, ((const SortEntry *)x)->key);
+  memory_graph_tuple_add(vm->graph, args, ((const SortEntry *)y)->key);
+  Element module = *obj_deep_lookup_ckey(callback->fn.obj, CKey_module);
+  Element result;
+  if (!vm_call_fn_sync(vm, t, module, callback->fn, args, &result)) {
+    callback->has_error = true;
+    callback->error = t_get_resval(t);
+    return 0;
+  }
+  if (VALUE != result.type) {
+    callback->has_error = true;
+    callback->error =
+        throw_error(vm, t, "Sort comparator must return an Int or Float.");
+    return 0;
+  }
+  double cmp = VALUE_OF(result.val);
+  return (cmp > 0) - (cmp < 0);
+}
+
+bool is_callable(Element fn) {
+  return ISOBJECT(fn) &&
+         (inherits_from(obj_lookup(fn.obj, CKey_class).obj,
+                        class_function.obj) ||
+          ISTYPE(fn, class_methodinstance) ||
+          ISTYPE(fn, class_external_methodinstance) ||
+          ISTYPE(fn, class_anon_function));
+}
+
+// Sorts entries by key. Uses a C comparator when every key is an Int, Float,
+// Char or String and fn is None, otherwise calls fn, or builtin.cmp if fn is
+// None.
+void sort_entries(VM *vm, Thread *t, SortEntry entries[], uint32_t num,
+                  Element fn, bool stable, SortCallback *callback) {
+  callback->vm = vm;
+  callback->t = t;
+  callback->has_error = false;
+  uint32_t i;
+  if (NONE == fn.type) {
+    switch (sort_kind(entries, num)) {
+      case SortKind_INT:
+      case SortKind_NUMBER:
+        (stable ? merge_sort : pdq_sort)(entries, num, sizeof(SortEntry),
+                                         sort_number_cmp, NULL);
+        return;
+      case SortKind_STRING:
+        for (i = 0; i < num; ++i) {
+          entries[i].str = String_extract(entries[i].key);
+        }
+        (stable ? merge_sort : pdq_sort)(entries, num, sizeof(SortEntry),
+                                         sort_string_cmp, NULL);
+        return;
+      default:
+        fn = obj_get_field(vm_lookup_module(vm, BUILTIN_MODULE_NAME),
+                           strings_intern("cmp"));
+    }
+  }
+  callback->fn = fn;
+  (stable ? merge_sort : pdq_sort)(entries, num, sizeof(SortEntry),
+                                   sort_callback_cmp, callback);
+}
+
+// Writes the sorted entries back. JL code may have run while sorting, so this
+// goes through the memory graph.
+Element sort_write_back(VM *vm, Thread *t, Element array,
+                        const SortEntry entries[], uint32_t num) {
+  if (Array_size(array.obj->array) != num) {
+    return throw_error(vm, t, "Array was modified while being sorted.");
+  }
+  uint32_t i;
+  for (i = 0; i < num; ++i) {
+    memory_graph_array_set(vm->graph, array.obj, i, &entries[i].elt);
+  }
+  return array;
+}
+
+Element array_sort(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Element fn = create_none();
+  if (NONE != arg->type &&
+      !(OBJECT == arg->type && arg->obj == vm->empty_tuple.obj)) {
+    if (!is_callable(*arg)) {
+      return throw_error(vm, t, "Argument to sort must be a Function.");
+    }
+    fn = *arg;
+  }
+  Array *arr = data->object.obj->array;
+  uint32_t i, num = Array_size(arr);
+  if (num < 2) {
+    return data->object;
+  }
+  SortEntry *entries = ALLOC_ARRAY(SortEntry, num);
+  for (i = 0; i < num; ++i) {
+    entries[i].key = entries[i].elt = Array_get(arr, i);
+  }
+  if (NONE == fn.type && SortKind_INT == sort_kind(entries, num)) {
+    // Nothing but Ints, so no order among equal elements to preserve and no
+    // need to go through the memory graph.
+    int64_t *vals = ALLOC_ARRAY2(int64_t, num);
+    for (i = 0; i < num; ++i) {
+      vals[i] = entries[i].key.val.int_val;
+    }
+    radix_sort_int64(vals, num);
+    for (i = 0; i < num; ++i) {
+      Array_set(arr, i, create_int(vals[i]));
+    }
+    DEALLOC(vals);
+    DEALLOC(entries);
+    return data->object;
+  }
+  SortCallback callback;
+  sort_entries(vm, t, entries, num, fn, /*stable=*/false, &callback);
+  Element result = callback.has_error
+                       ? callback.error
+                       : sort_write_back(vm, t, data->object, entries, num);
+  DEALLOC(entries);
+  return result;
+}
+
+Element array_sort_by(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_callable(*arg)) {
+    return throw_error(vm, t, "Argument to sort_by must be a Function.");
+  }
+  Element fn = *arg;
+  Array *arr = data->object.obj->array;
+  uint32_t i, num = Array_size(arr);
+  if (num < 2) {
+    return data->object;
+  }
+  SortEntry *entries = ALLOC_ARRAY(SortEntry, num);
+  for (i = 0; i < num; ++i) {
+    entries[i].elt = Array_get(arr, i);
+  }
+  // Keep the keys reachable while JL code runs.
+  Element keys = create_array(vm->graph);
+  t_pushstack(t, keys);
+  Element module = *obj_deep_lookup_ckey(fn.obj, CKey_module);
+  Element result;
+  bool failed = false;
+  for (i = 0; i < num; ++i) {
+    if (!vm_call_fn_sync(vm, t, module, fn, entries[i].elt, &entries[i].key)) {
+      result = t_get_resval(t);
+      failed = true;
+      break;
+    }
+    memory_graph_array_enqueue(vm->graph, keys, entries[i].key);
+  }
+  if (!failed) {
+    SortCallback callback;
+    sort_entries(vm, t, entries, num, create_none(), /*stable=*/true,
+                 &callback);
+    if (callback.has_error) {
+      result = callback.error;
+      failed = true;
+    }
+  }
+  bool has_error = false;
+  t_popstack(t, &has_error);
+  if (!failed) {
+    result = sort_write_back(vm, t, data->object, entries, num);
+  }
+  DEALLOC(entries);
+  return result;
+}
+
 void merge_array_class(VM *vm) {
   add_external_method(vm, class_array, "pop", array_pop);
   add_external_method(vm, class_array, "remove", array_remove);
   add_external_method(vm, class_array, "remove_at", array_remove_at);
   add_external_method(vm, class_array, "swap", array_swap);
   add_external_method(vm, class_array, "shift", array_shift);
+  add_external_method(vm, class_array, "sort", array_sort);
+  add_external_method(vm, class_array, "sort_by", array_sort_by);
 }
 
 bool is_value_type(const Element *e, int type) {
@@ -47,6 +47,8 @@ void merge_array_class(VM *vm);
 
 bool is_value_type(const Element *e, int type);
 bool is_object_type(const Element *e, int type);
+// Whether fn can be called like a function.
+bool is_callable(Element fn);
 
 Element throw_error(VM *vm, Thread *t, const char msg[]);
 
@@ -5,10 +5,19 @@
  *      Author: Jeff
  */
 
+// For fileno(), which strict C modes hide. Not 2008, whose getline() would
+// clash with the one in shared.h.
+#define _POSIX_C_SOURCE 200112L
+
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
 
 #include "../arena/strings.h"
 #include "../class.h"
@@ -19,10 +28,79 @@
 #include "../memory/memory.h"
 #include "../memory/memory_graph.h"
 #include "../shared.h"
+#include "../threads/thread.h"
 #include "../threads/thread_interface.h"
 #include "external.h"
+#include "file_io.h"
+#include "net/impl/event_loop.h"
 #include "strings.h"
 
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+// stdio buffer for opened files, so reading line by line takes fewer reads.
+#define FILE_BUFFER_SIZE (64 * 1024)
+// Files at least this large are read whole with chunks in flight at once.
+#define FILE_PARALLEL_READ_SIZE (2 * FILE_IO_CHUNK_SIZE)
+
+Element class_file_future;
+
+// The buffer getline() reuses from one call to the next.
+typedef struct {
+  char *line;
+  size_t cap;
+} LineBuffer;
+
+// Async ops started on a File, each with a reference of its own so close__()
+// can wait for them before the fd goes away under them.
+typedef struct {
+  FileOp **ops;
+  uint32_t num_ops, cap;
+} LiveOps;
+
+void file_track_op(ExternalData *data, FileOp *op) {
+  LiveOps *live = map_lookup(&data->state, strings_intern("ops"));
+  if (NULL == live) {
+    live = ALLOC2(LiveOps);
+    live->cap = 4;
+    live->ops = ALLOC_ARRAY2(FileOp *, live->cap);
+    live->num_ops = 0;
+    map_insert(&data->state, strings_intern("ops"), live);
+  }
+  // Forget the ones already done so the list stays short.
+  uint32_t i, kept = 0;
+  for (i = 0; i < live->num_ops; ++i) {
+    if (file_op_is_done(live->ops[i])) {
+      file_op_delete(live->ops[i]);
+    } else {
+      live->ops[kept++] = live->ops[i];
+    }
+  }
+  live->num_ops = kept;
+  if (live->num_ops == live->cap) {
+    live->cap *= 2;
+    live->ops = REALLOC(live->ops, FileOp *, live->cap);
+  }
+  file_op_retain(op);
+  live->ops[live->num_ops++] = op;
+}
+
+void file_await_ops(ExternalData *data) {
+  LiveOps *live = map_lookup(&data->state, strings_intern("ops"));
+  if (NULL == live) {
+    return;
+  }
+  uint32_t i;
+  for (i = 0; i < live->num_ops; ++i) {
+    file_op_wait(live->ops[i]);
+    file_op_delete(live->ops[i]);
+  }
+  DEALLOC(live->ops);
+  DEALLOC(live);
+  map_remove(&data->state, strings_intern("ops"));
+}
+
 Element file_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   ASSERT(arg->type == OBJECT);
   char *fn, *mode;
@@ -58,6 +136,9 @@ Element file_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
     file = stderr;
   } else {
     file = fopen(fn, mode);
+    if (NULL != file) {
+      setvbuf(file, NULL, _IOFBF, FILE_BUFFER_SIZE);
+    }
   }
 
   ASSERT(NOT_NULL(data));
@@ -69,6 +150,9 @@ Element file_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
     ThreadHandle write_mutex = mutex_create(NULL);
     map_insert(&data->state, strings_intern("file"), file);
     map_insert(&data->state, strings_intern("mutex"), write_mutex);
+    if (NULL != strchr(mode, 'a')) {
+      map_insert(&data->state, strings_intern("append"), file);
+    }
   }
   return data->object;
 }
@@ -76,9 +160,20 @@ Element file_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
 Element file_deconstructor(VM *vm, Thread *t, ExternalData *data,
                            Element *arg) {
   FILE *file = map_lookup(&data->state, strings_intern("file"));
+  file_await_ops(data);
   if (NULL != file && stdin != file && stdout != file && stderr != file) {
     fclose(file);
   }
+  // This is also close__(), so it may run again once the File is collected.
+  map_remove(&data->state, strings_intern("file"));
+  LineBuffer *buffer = map_lookup(&data->state, strings_intern("line"));
+  if (NULL != buffer) {
+    if (NULL != buffer->line) {
+      DEALLOC(buffer->line);
+    }
+    DEALLOC(buffer);
+    map_remove(&data->state, strings_intern("line"));
+  }
   return create_none();
 }
 
@@ -103,7 +198,7 @@ Element file_puts(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   //  char *cstr = string_to_cstr(arg);
   String *string = String_extract(*arg);
   mutex_await(mutex, INFINITE);
-  fprintf(file, "%*s", String_size(string), String_cstr(string));
+  fwrite(String_cstr(string), 1, String_size(string), file);
   //  fputs(cstr, file);
   fflush(file);
   mutex_release(mutex);
@@ -113,19 +208,28 @@ Element file_puts(VM *vm, Thread *t, ExternalData *data, Element *arg) {
 Element file_getline(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   FILE *file = map_lookup(&data->state, strings_intern("file"));
   ASSERT(NOT_NULL(file));
-  char *line = NULL;
-  size_t len = 0;
-  int nread = getline(&line, &len, file);
-  Element string;
-  if (-1 == nread) {
-    string = create_none();
-  } else {
-    string = string_create_len(vm, line, nread);
+  LineBuffer *buffer = map_lookup(&data->state, strings_intern("line"));
+  if (NULL == buffer) {
+    buffer = ALLOC2(LineBuffer);
+    buffer->line = NULL;
+    buffer->cap = 0;
+    map_insert(&data->state, strings_intern("line"), buffer);
   }
-  if (line != NULL) {
-    DEALLOC(line);
+  int nread = getline(&buffer->line, &buffer->cap, file);
+  if (-1 == nread) {
+    return create_none();
   }
-  return string;
+  return string_create_len(vm, buffer->line, nread);
+}
+
+// Reads len bytes from the start of file into buf, with the chunks in flight
+// at once. Returns how many were read, or -1 if it failed.
+int64_t file_read_parallel(FILE *file, char *buf, int64_t len) {
+  FileOp *op = file_op_read(fileno(file), 0, buf, len);
+  file_io_submit();
+  int64_t read = file_op_wait(op);
+  file_op_delete(op);
+  return read;
 }
 
 // This is vulnerable to files with \0 inside them.
@@ -140,8 +244,20 @@ Element file_getall(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   Element elt = string_create_len(vm, NULL, fsize);
   String *string = String_extract(elt);
   String_set(string, fsize - 1, '\0');
-  // Can be less than read on Windows because \r gets dropped.
-  int actually_read = fread(string->table, sizeof(char), fsize, file);
+  int64_t actually_read = -1;
+#ifndef _WIN32
+  if (fsize >= FILE_PARALLEL_READ_SIZE && fsize <= UINT32_MAX) {
+    actually_read = file_read_parallel(file, string->table, fsize);
+    if (actually_read >= 0) {
+      // Where the fread() would have left it.
+      fseek(file, 0, SEEK_END);
+    }
+  }
+#endif
+  if (actually_read < 0) {
+    // Can be less than read on Windows because \r gets dropped.
+    actually_read = fread(string->table, sizeof(char), fsize, file);
+  }
 
   // If this happens then something is really wrong.
   ASSERT(actually_read <= fsize);
@@ -159,6 +275,162 @@ Element file_rewind(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   return create_none();
 }
 
+Element file_future_create(VM *vm, Element file, FileOp *op, bool write) {
+  Element future = create_external_obj(vm, class_file_future);
+  ExternalData *data = future.obj->external_data;
+  map_insert(&data->state, strings_intern("op"), op);
+  if (write) {
+    map_insert(&data->state, strings_intern("write"), op);
+  }
+  // Keeps the file open until the op is done with it, and close__() waits.
+  memory_graph_set_field(vm->graph, future, strings_intern("$file"), file);
+  file_track_op(file.obj->external_data, op);
+  return future;
+}
+
+// read_async__(offset, len): Starts reading len bytes from offset. Returns a
+// FileFuture of them.
+Element file_read_async(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  FILE *file = map_lookup(&data->state, strings_intern("file"));
+  ASSERT(NOT_NULL(file));
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "read_async() expects (offset, len).");
+  }
+  Element offset = tuple_get(arg->obj->tuple, 0);
+  Element len = tuple_get(arg->obj->tuple, 1);
+  if (!is_value_type(&offset, INT) || !is_value_type(&len, INT) ||
+      offset.val.int_val < 0 || len.val.int_val < 0 ||
+      len.val.int_val > UINT32_MAX) {
+    return throw_error(vm, t, "read_async() expects (offset, len).");
+  }
+  FileOp *op = file_op_read(fileno(file), offset.val.int_val, NULL,
+                            len.val.int_val);
+  file_io_submit();
+  return file_future_create(vm, data->object, op, false);
+}
+
+// getall_async__(): Starts reading the whole file. Returns a FileFuture of it.
+Element file_getall_async(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  FILE *file = map_lookup(&data->state, strings_intern("file"));
+  ASSERT(NOT_NULL(file));
+  struct stat st;
+  if (0 != fstat(fileno(file), &st) || st.st_size > UINT32_MAX) {
+    return throw_error(vm, t, "Cannot read file asynchronously.");
+  }
+  FileOp *op = file_op_read(fileno(file), 0, NULL, st.st_size);
+  file_io_submit();
+  return file_future_create(vm, data->object, op, false);
+}
+
+// Whether every write to file lands at its end whatever offset it asks for,
+// as with mode "a" or a shell's >>. Positional writes would then land in the
+// order they finish instead of the order they were made.
+bool file_appends(ExternalData *data, FILE *file) {
+#ifdef _WIN32
+  return NULL != map_lookup(&data->state, strings_intern("append"));
+#else
+  int flags = fcntl(fileno(file), F_GETFL);
+  return flags < 0 || 0 != (flags & O_APPEND);
+#endif
+}
+
+// A FileFuture of a write which was already done.
+Element file_future_written(VM *vm, int64_t len) {
+  Element future = create_external_obj(vm, class_file_future);
+  memory_graph_set_field(vm->graph, future, strings_intern("$written"),
+                         create_int(len));
+  return future;
+}
+
+// puts_async__(s): Starts writing s where puts__() would have. Later writes go
+// after it even before it is done. Returns a FileFuture of how many bytes
+// were written. Files which append, or cannot seek like pipes, are written
+// right away instead.
+Element file_puts_async(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  FILE *file = map_lookup(&data->state, strings_intern("file"));
+  ThreadHandle mutex = map_lookup(&data->state, strings_intern("mutex"));
+  ASSERT(NOT_NULL(file), NOT_NULL(mutex));
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "puts_async() expects a String.");
+  }
+  String *string = String_extract(*arg);
+  mutex_await(mutex, INFINITE);
+  fflush(file);
+  long offset;
+  if (file_appends(data, file) || (offset = ftell(file)) < 0) {
+    size_t written =
+        fwrite(String_cstr(string), 1, String_size(string), file);
+    fflush(file);
+    mutex_release(mutex);
+    if (written < String_size(string)) {
+      return throw_error(vm, t, "Cannot write to file asynchronously.");
+    }
+    return file_future_written(vm, written);
+  }
+  // Leaves room for the write, which does not go through stdio.
+  if (0 != fseek(file, offset + String_size(string), SEEK_SET)) {
+    mutex_release(mutex);
+    return throw_error(vm, t, "Cannot write to file asynchronously.");
+  }
+  FileOp *op = file_op_write(fileno(file), offset, String_cstr(string),
+                             String_size(string));
+  mutex_release(mutex);
+  file_io_submit();
+  return file_future_create(vm, data->object, op, true);
+}
+
+Element file_future_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                  Element *arg) {
+  FileOp *op = map_lookup(&data->state, strings_intern("op"));
+  if (NULL != op) {
+    file_op_delete(op);
+  }
+  return create_none();
+}
+
+// get() or wait(): Waits for the op, then gives what was read as a String or
+// how many bytes were written. A green Thread parks instead of blocking.
+Element file_future_get(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  FileOp *op = map_lookup(&data->state, strings_intern("op"));
+  if (NULL == op) {
+    return obj_get_field(data->object, strings_intern("$written"));
+  }
+  if (!file_op_is_done(op) &&
+      t_park(t, file_op_event_fd(op), EVENT_READABLE, file_future_get, data,
+             arg)) {
+    return create_none();
+  }
+  int64_t len = file_op_wait(op);
+  if (len < 0) {
+    return throw_error(vm, t, "Asynchronous file operation failed.");
+  }
+  if (NULL != map_lookup(&data->state, strings_intern("write"))) {
+    return create_int(len);
+  }
+  return string_create_len(vm, file_op_data(op), len);
+}
+
+Element file_future_is_complete(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  FileOp *op = map_lookup(&data->state, strings_intern("op"));
+  return (NULL == op || file_op_is_done(op)) ? element_true(vm)
+                                             : element_false(vm);
+}
+
+Element create_file_future_class(VM *vm, Element module) {
+  class_file_future = create_external_class(vm, module,
+                                            strings_intern("FileFuture"), NULL,
+                                            file_future_deconstructor);
+  add_external_method(vm, class_file_future, strings_intern("get"),
+                      file_future_get);
+  add_external_method(vm, class_file_future, strings_intern("wait"),
+                      file_future_get);
+  add_external_method(vm, class_file_future, strings_intern("is_complete"),
+                      file_future_is_complete);
+  return class_file_future;
+}
+
 Element create_file_class(VM *vm, Element module) {
   Element file_class =
       create_external_class(vm, module, strings_intern("File__"),
@@ -171,5 +443,12 @@ Element create_file_class(VM *vm, Element module) {
   add_external_method(vm, file_class, strings_intern("rewind__"), file_rewind);
   add_external_method(vm, file_class, strings_intern("close__"),
                       file_deconstructor);
+  add_external_method(vm, file_class, strings_intern("read_async__"),
+                      file_read_async);
+  add_external_method(vm, file_class, strings_intern("getall_async__"),
+                      file_getall_async);
+  add_external_method(vm, file_class, strings_intern("puts_async__"),
+                      file_puts_async);
+  create_file_future_class(vm, module);
   return file_class;
 }
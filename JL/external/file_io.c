@@ -0,0 +1,503 @@
+/*
+ * file_io.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+// For pread(), pwrite() and syscall(), which strict C modes hide.
+#define _GNU_SOURCE
+
+#include "file_io.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../memory/memory.h"
+#include "../threads/thread_interface.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define FILE_IO_URING
+#endif
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#endif
+
+// Workers in the thread pool backend.
+#define FILE_IO_THREADS 4
+// Submission queue entries asked for when making the ring.
+#define FILE_IO_RING_SIZE 256
+
+struct FileOp_ {
+  bool write;
+  int fd;
+  char *buf;
+  bool owns_buf;
+  // Chunks not yet done.
+  int32_t parts_left;
+  // One for the owner and one for the backend until every chunk is done.
+  int32_t refs;
+  int64_t done_len;
+  bool failed;
+  volatile bool done;
+  Semaphore done_sem;
+  int event_fd;
+};
+
+// One chunk of an op. It may take several reads or writes if the kernel does
+// less than asked.
+typedef struct FilePart_ {
+  struct FilePart_ *next;
+  FileOp *op;
+  int64_t offset;
+  char *data;
+  uint32_t len;
+#ifdef FILE_IO_URING
+  struct iovec iov;
+#endif
+} FilePart;
+
+#ifdef FILE_IO_URING
+typedef struct {
+  int fd;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned sq_entries, cq_entries;
+  // Kept below cq_entries, so the completion queue cannot overflow.
+  unsigned in_flight;
+  // Entries in the submission queue the kernel has not been told about.
+  unsigned to_submit;
+} Ring;
+#endif
+
+typedef struct {
+  Mutex mutex;
+  bool uring;
+  // Parts not yet taken by a worker or put in the ring, oldest first.
+  FilePart *head, *tail;
+  // Parts queued since the last file_io_submit().
+  uint32_t num_unsubmitted;
+  // Counts parts for the thread pool to take.
+  Semaphore work;
+#ifdef FILE_IO_URING
+  Ring ring;
+#endif
+} FileIO;
+
+static FileIO FILE_IO;
+// 0 before the backend starts, 1 while it starts and 2 once it has.
+static volatile int FILE_IO_STATE = 0;
+
+// Must hold the lock.
+void file_io_enqueue(FilePart *part) {
+  part->next = NULL;
+  if (NULL == FILE_IO.tail) {
+    FILE_IO.head = part;
+  } else {
+    FILE_IO.tail->next = part;
+  }
+  FILE_IO.tail = part;
+}
+
+// Must hold the lock.
+FilePart *file_io_dequeue() {
+  FilePart *part = FILE_IO.head;
+  if (NULL != part) {
+    FILE_IO.head = part->next;
+    if (NULL == FILE_IO.head) {
+      FILE_IO.tail = NULL;
+    }
+  }
+  return part;
+}
+
+void file_op_release(FileOp *op) {
+  if (0 != __sync_sub_and_fetch(&op->refs, 1)) {
+    return;
+  }
+  if (op->owns_buf) {
+    DEALLOC(op->buf);
+  }
+  semaphore_close(op->done_sem);
+  if (op->event_fd >= 0) {
+    close(op->event_fd);
+  }
+  DEALLOC(op);
+}
+
+// Counts result, what one read or write of part returned. Returns whether
+// part still has more to do.
+bool file_part_advance(FilePart *part, int64_t result) {
+  if (result < 0) {
+    part->op->failed = true;
+    return false;
+  }
+  __sync_fetch_and_add(&part->op->done_len, result);
+  // 0 is the end of the file.
+  if (0 == result || result == part->len) {
+    return false;
+  }
+  part->offset += result;
+  part->data += result;
+  part->len -= result;
+  return true;
+}
+
+void file_part_finish(FilePart *part) {
+  FileOp *op = part->op;
+  DEALLOC(part);
+  if (0 != __sync_sub_and_fetch(&op->parts_left, 1)) {
+    return;
+  }
+  __sync_synchronize();
+  op->done = true;
+  semaphore_unlock(op->done_sem);
+#ifdef __linux__
+  uint64_t one = 1;
+  if (write(op->event_fd, &one, sizeof(one)) < 0) {
+    // Already readable.
+  }
+#endif
+  file_op_release(op);
+}
+
+#ifdef _WIN32
+// Windows has no pread() or pwrite(), but a read or write at an offset does
+// not move the file position either when given an OVERLAPPED.
+int64_t file_rw_at(bool write, int fd, char *data, uint32_t len,
+                   int64_t offset) {
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  overlapped.Offset = (DWORD)offset;
+  overlapped.OffsetHigh = (DWORD)(offset >> 32);
+  HANDLE handle = (HANDLE)_get_osfhandle(fd);
+  DWORD done = 0;
+  BOOL ok = write ? WriteFile(handle, data, len, &done, &overlapped)
+                  : ReadFile(handle, data, len, &done, &overlapped);
+  if (!ok) {
+    // The end of the file is not an error.
+    return ERROR_HANDLE_EOF == GetLastError() ? 0 : -1;
+  }
+  return done;
+}
+#else
+int64_t file_rw_at(bool write, int fd, char *data, uint32_t len,
+                   int64_t offset) {
+  return write ? pwrite(fd, data, len, offset) : pread(fd, data, len, offset);
+}
+#endif
+
+unsigned __stdcall file_io_work(void *arg) {
+  while (true) {
+    semaphore_lock(FILE_IO.work, INFINITE);
+    mutex_await(FILE_IO.mutex, INFINITE);
+    FilePart *part = file_io_dequeue();
+    mutex_release(FILE_IO.mutex);
+    if (NULL == part) {
+      // Another worker took it before it was submitted.
+      continue;
+    }
+    FileOp *op = part->op;
+    int64_t result;
+    do {
+      result =
+          file_rw_at(op->write, op->fd, part->data, part->len, part->offset);
+    } while ((result < 0 && EINTR == errno) ||
+             file_part_advance(part, result));
+    file_part_finish(part);
+  }
+  return 0;
+}
+
+#ifdef FILE_IO_URING
+bool ring_init(Ring *ring) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, FILE_IO_RING_SIZE, &params);
+  if (fd < 0) {
+    // Too old a kernel, or turned off by seccomp or sysctl.
+    return false;
+  }
+  size_t sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_len =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_len = cq_len = max(sq_len, cq_len);
+  }
+  char *sq = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  char *cq = single_mmap ? sq
+                         : mmap(NULL, cq_len, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, fd,
+                                IORING_OFF_CQ_RING);
+  struct io_uring_sqe *sqes =
+      mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+           IORING_OFF_SQES);
+  if (MAP_FAILED == sq || MAP_FAILED == cq || MAP_FAILED == sqes) {
+    // Closing the ring unmaps whatever was mapped.
+    close(fd);
+    return false;
+  }
+  ring->fd = fd;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->sqes = sqes;
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  ring->sq_entries = params.sq_entries;
+  ring->cq_entries = params.cq_entries;
+  ring->in_flight = ring->to_submit = 0;
+  return true;
+}
+
+// Must hold the lock. Moves queued parts into free submission entries.
+void ring_fill(Ring *ring) {
+  while (NULL != FILE_IO.head && ring->in_flight < ring->cq_entries) {
+    unsigned tail = *ring->sq_tail;
+    __sync_synchronize();
+    if (tail - *ring->sq_head == ring->sq_entries) {
+      break;
+    }
+    FilePart *part = file_io_dequeue();
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    // The vectored ops are in every kernel with io_uring.
+    sqe->opcode = part->op->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = part->op->fd;
+    sqe->off = part->offset;
+    part->iov.iov_base = part->data;
+    part->iov.iov_len = part->len;
+    sqe->addr = (uintptr_t)&part->iov;
+    sqe->len = 1;
+    sqe->user_data = (uintptr_t)part;
+    ring->sq_array[index] = index;
+    __sync_synchronize();
+    *ring->sq_tail = tail + 1;
+    ring->in_flight++;
+    ring->to_submit++;
+  }
+}
+
+// Must hold the lock. Takes back the entries the kernel was never told about
+// and fails their parts, since nothing would ever complete them.
+void ring_fail_unsubmitted(Ring *ring) {
+  unsigned tail = *ring->sq_tail;
+  while (ring->to_submit > 0) {
+    --tail;
+    struct io_uring_sqe *sqe =
+        &ring->sqes[ring->sq_array[tail & *ring->sq_mask]];
+    FilePart *part = (FilePart *)(uintptr_t)sqe->user_data;
+    part->op->failed = true;
+    file_part_finish(part);
+    ring->to_submit--;
+    ring->in_flight--;
+  }
+  __sync_synchronize();
+  *ring->sq_tail = tail;
+}
+
+// Must hold the lock. Submits everything that fits with one system call.
+void ring_submit(Ring *ring) {
+  ring_fill(ring);
+  while (ring->to_submit > 0) {
+    int submitted =
+        syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 0, 0, NULL, 0);
+    if (submitted < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      ring_fail_unsubmitted(ring);
+      break;
+    }
+    ring->to_submit -= submitted;
+  }
+}
+
+// Waits for completions and finishes their parts, resubmitting any the kernel
+// did only some of.
+unsigned __stdcall ring_reap(void *arg) {
+  Ring *ring = &FILE_IO.ring;
+  while (true) {
+    syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL,
+            0);
+    unsigned head = *ring->cq_head, reaped = 0;
+    __sync_synchronize();
+    unsigned tail = *ring->cq_tail;
+    FilePart *retry = NULL;
+    for (; head != tail; ++head, ++reaped) {
+      struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+      FilePart *part = (FilePart *)(uintptr_t)cqe->user_data;
+      int64_t result = cqe->res;
+      if ((-EINTR == result || -EAGAIN == result) ||
+          file_part_advance(part, result)) {
+        part->next = retry;
+        retry = part;
+      } else {
+        file_part_finish(part);
+      }
+    }
+    __sync_synchronize();
+    *ring->cq_head = head;
+    if (0 == reaped) {
+      continue;
+    }
+    mutex_await(FILE_IO.mutex, INFINITE);
+    ring->in_flight -= reaped;
+    while (NULL != retry) {
+      FilePart *next = retry->next;
+      file_io_enqueue(retry);
+      retry = next;
+    }
+    // Also fills the room just made for parts waiting on it.
+    ring_submit(ring);
+    mutex_release(FILE_IO.mutex);
+  }
+  return 0;
+}
+#endif
+
+void file_io_start() {
+  if (2 == FILE_IO_STATE) {
+    return;
+  }
+  if (!__sync_bool_compare_and_swap(&FILE_IO_STATE, 0, 1)) {
+    while (2 != FILE_IO_STATE) {
+      sleep_thread(1);
+    }
+    return;
+  }
+  FILE_IO.mutex = mutex_create(NULL);
+  FILE_IO.head = FILE_IO.tail = NULL;
+  FILE_IO.num_unsubmitted = 0;
+  FILE_IO.uring = false;
+  ThreadId id;
+#ifdef FILE_IO_URING
+  FILE_IO.uring = ring_init(&FILE_IO.ring) &&
+                  NULL != create_thread(ring_reap, NULL, &id);
+#endif
+  if (!FILE_IO.uring) {
+    FILE_IO.work = semaphore_create(0, INT_MAX);
+    int i;
+    for (i = 0; i < FILE_IO_THREADS; ++i) {
+      create_thread(file_io_work, NULL, &id);
+    }
+  }
+  __sync_synchronize();
+  FILE_IO_STATE = 2;
+}
+
+const char *file_io_backend() {
+  file_io_start();
+  return FILE_IO.uring ? "io_uring" : "threads";
+}
+
+FileOp *file_op_create(bool write, int fd, int64_t offset, char *buf,
+                       bool owns_buf, uint32_t len) {
+  file_io_start();
+  FileOp *op = ALLOC2(FileOp);
+  int32_t i, num_parts = max(1, (len + FILE_IO_CHUNK_SIZE - 1) /
+                                    (uint32_t)FILE_IO_CHUNK_SIZE);
+  op->write = write;
+  op->fd = fd;
+  op->buf = buf;
+  op->owns_buf = owns_buf;
+  op->parts_left = num_parts;
+  op->refs = 2;
+  op->done_len = 0;
+  op->failed = false;
+  op->done = false;
+  op->done_sem = semaphore_create(0, 1);
+#ifdef __linux__
+  op->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+  op->event_fd = -1;
+#endif
+  uint32_t start = 0;
+  mutex_await(FILE_IO.mutex, INFINITE);
+  for (i = 0; i < num_parts; ++i) {
+    FilePart *part = ALLOC2(FilePart);
+    part->op = op;
+    part->offset = offset + start;
+    part->data = buf + start;
+    part->len = min(len - start, FILE_IO_CHUNK_SIZE);
+    start += part->len;
+    file_io_enqueue(part);
+  }
+  FILE_IO.num_unsubmitted += num_parts;
+  mutex_release(FILE_IO.mutex);
+  return op;
+}
+
+FileOp *file_op_read(int fd, int64_t offset, char *buf, uint32_t len) {
+  bool owns_buf = NULL == buf;
+  if (owns_buf) {
+    buf = ALLOC_ARRAY2(char, max(len, 1));
+  }
+  return file_op_create(false, fd, offset, buf, owns_buf, len);
+}
+
+FileOp *file_op_write(int fd, int64_t offset, const char *data,
+                      uint32_t len) {
+  char *buf = ALLOC_ARRAY2(char, max(len, 1));
+  memmove(buf, data, len);
+  return file_op_create(true, fd, offset, buf, true, len);
+}
+
+void file_io_submit() {
+  file_io_start();
+  mutex_await(FILE_IO.mutex, INFINITE);
+  uint32_t num_unsubmitted = FILE_IO.num_unsubmitted;
+  FILE_IO.num_unsubmitted = 0;
+#ifdef FILE_IO_URING
+  if (FILE_IO.uring) {
+    ring_submit(&FILE_IO.ring);
+    mutex_release(FILE_IO.mutex);
+    return;
+  }
+#endif
+  mutex_release(FILE_IO.mutex);
+  while (num_unsubmitted-- > 0) {
+    semaphore_unlock(FILE_IO.work);
+  }
+}
+
+bool file_op_is_done(const FileOp *op) { return op->done; }
+
+int64_t file_op_wait(FileOp *op) {
+  if (!op->done) {
+    semaphore_lock(op->done_sem, INFINITE);
+    // Left unlocked for any other waiter.
+    semaphore_unlock(op->done_sem);
+  }
+  __sync_synchronize();
+  return op->failed ? -1 : op->done_len;
+}
+
+int file_op_event_fd(const FileOp *op) { return op->event_fd; }
+
+const char *file_op_data(const FileOp *op) { return op->buf; }
+
+void file_op_retain(FileOp *op) { __sync_add_and_fetch(&op->refs, 1); }
+
+void file_op_delete(FileOp *op) { file_op_release(op); }
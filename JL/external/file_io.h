@@ -0,0 +1,51 @@
+/*
+ * file_io.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_FILE_IO_H_
+#define EXTERNAL_FILE_IO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Reads and writes which complete in the background, backed by io_uring where
+// the kernel has it and otherwise by a pool of threads doing pread() and
+// pwrite(). Ops larger than FILE_IO_CHUNK_SIZE are split into chunks which are
+// in flight at the same time. The backend starts on first use.
+
+#define FILE_IO_CHUNK_SIZE (1024 * 1024)
+
+typedef struct FileOp_ FileOp;
+
+// "io_uring" or "threads".
+const char *file_io_backend();
+
+// Reads len bytes of fd from offset into buf, which must outlive the op. With
+// a NULL buf the op allocates its own.
+FileOp *file_op_read(int fd, int64_t offset, char *buf, uint32_t len);
+// Writes a copy of len bytes of data to fd at offset.
+FileOp *file_op_write(int fd, int64_t offset, const char *data,
+                      uint32_t len);
+
+// Ops are only queued until this hands everything queued to the backend at
+// once, with a single io_uring_enter().
+void file_io_submit();
+
+bool file_op_is_done(const FileOp *op);
+// Blocks until op is done. Returns how many bytes were read or written, which
+// is less than asked for a read past the end, or -1 if it failed.
+int64_t file_op_wait(FileOp *op);
+// An fd which becomes readable once op is done, to wait for it along with
+// others. -1 where the platform has none.
+int file_op_event_fd(const FileOp *op);
+const char *file_op_data(const FileOp *op);
+
+// Takes another reference to op, which needs its own file_op_delete().
+void file_op_retain(FileOp *op);
+// Frees op once the backend is also done with it.
+void file_op_delete(FileOp *op);
+
+#endif /* EXTERNAL_FILE_IO_H_ */
@@ -1,64 +1,385 @@
-/*
- * math.c
- *
- *  Created on: Aug 3, 2018
- *      Author: Jeff
- */
-
-#include <math.h>
-
-#include "../codegen/tokenizer.h"
-#include "../datastructure/tuple.h"
-#include "../element.h"
-#include "external.h"
-
-double log_special(double base, double num) { return log10(num) / log10(base); }
-
-Element log_tuple(VM *vm, Thread *th, Element *tuple) {
-  Tuple *t = tuple->obj->tuple;
-  if (tuple_size(t) != 2) {
-    return throw_error(vm, th, "Invalid tuple arg to log__.");
-  }
-  Element base = tuple_get(t, 0);
-  Element num = tuple_get(t, 1);
-
-  if (base.type != VALUE) {
-    return throw_error(vm, th, "Cannot perform log__ with non-numeric base.");
-  }
-  if (num.type != VALUE) {
-    return throw_error(vm, th, "Cannot perform log__ with non-numeric input.");
-  }
-  return create_float(
-      log_special((double)VALUE_OF(base.val), (double)VALUE_OF(num.val)));
-}
-
-Element log__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
-  if (is_object_type(argument, TUPLE)) {
-    return log_tuple(vm, t, argument);
-  }
-  if (argument->type != VALUE) {
-    return throw_error(vm, t, "Cannot perform log__ on a non-value.");
-  }
-  return create_float(log((double)VALUE_OF(argument->val)));
-}
-
-Element pow__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
-  if (!is_object_type(argument, TUPLE)) {
-    return throw_error(vm, th, "pow_ expects multiple arguments.");
-  }
-  Tuple *t = argument->obj->tuple;
-  if (tuple_size(t) != 2) {
-    return throw_error(vm, th, "pow__ expects exactly 2 arguments.");
-  }
-  Element num = tuple_get(t, 0);
-  Element power = tuple_get(t, 1);
-
-  if (num.type != VALUE) {
-    return throw_error(vm, th, "Cannot perform pow__ with non-numeric input.");
-  }
-  if (power.type != VALUE) {
-    return throw_error(vm, th, "Cannot perform pow__ with non-numeric power.");
-  }
-  return create_float(
-      pow((double)VALUE_OF(num.val), (double)VALUE_OF(power.val)));
-}
+/*
+ * math.c
+ *
+ *  Created on: Aug 3, 2018
+ *      Author: Jeff
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../class.h"
+#include "../codegen/tokenizer.h"
+#include "../datastructure/tuple.h"
+#include "../element.h"
+#include "../memory/memory.h"
+#include "../shared.h"
+#include "external.h"
+#include "math_kernels.h"
+#include "strings.h"
+#include "typed_array.h"
+
+double log_special(double base, double num) { return log10(num) / log10(base); }
+
+Element log_tuple(VM *vm, Thread *th, Element *tuple) {
+  Tuple *t = tuple->obj->tuple;
+  if (tuple_size(t) != 2) {
+    return throw_error(vm, th, "Invalid tuple arg to log__.");
+  }
+  Element base = tuple_get(t, 0);
+  Element num = tuple_get(t, 1);
+
+  if (base.type != VALUE) {
+    return throw_error(vm, th, "Cannot perform log__ with non-numeric base.");
+  }
+  if (num.type != VALUE) {
+    return throw_error(vm, th, "Cannot perform log__ with non-numeric input.");
+  }
+  return create_float(
+      log_special((double)VALUE_OF(base.val), (double)VALUE_OF(num.val)));
+}
+
+Element log__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
+  if (is_object_type(argument, TUPLE)) {
+    return log_tuple(vm, t, argument);
+  }
+  if (argument->type != VALUE) {
+    return throw_error(vm, t, "Cannot perform log__ on a non-value.");
+  }
+  return create_float(log((double)VALUE_OF(argument->val)));
+}
+
+Element pow__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
+  if (!is_object_type(argument, TUPLE)) {
+    return throw_error(vm, th, "pow_ expects multiple arguments.");
+  }
+  Tuple *t = argument->obj->tuple;
+  if (tuple_size(t) != 2) {
+    return throw_error(vm, th, "pow__ expects exactly 2 arguments.");
+  }
+  Element num = tuple_get(t, 0);
+  Element power = tuple_get(t, 1);
+
+  if (num.type != VALUE) {
+    return throw_error(vm, th, "Cannot perform pow__ with non-numeric input.");
+  }
+  if (power.type != VALUE) {
+    return throw_error(vm, th, "Cannot perform pow__ with non-numeric power.");
+  }
+  return create_float(
+      pow((double)VALUE_OF(num.val), (double)VALUE_OF(power.val)));
+}
+
+// A run of numbers to hand to the kernels: either the buffer of an IntArray or
+// FloatArray, or the values of an Array or Tuple copied into a new one.
+typedef struct {
+  // INT or FLOAT.
+  ValType type;
+  uint32_t len;
+  // True if ints and floats were mixed and so everything became a float.
+  bool mixed;
+  // True if the buffer was allocated here.
+  bool owned;
+  union {
+    int64_t *ints;
+    double *floats;
+  };
+} NumView;
+
+// Returns false if arg is not a sequence of numbers.
+bool num_view_init(const Element *arg, NumView *view) {
+  view->mixed = false;
+  view->owned = false;
+  if (OBJECT != arg->type) {
+    return false;
+  }
+  TypedArray *array = typed_array_of(arg->obj);
+  if (NULL != array && CHAR != array->type) {
+    view->type = array->type;
+    view->len = array->len;
+    view->ints = array->ints;
+    return true;
+  }
+  uint32_t i;
+  if (NULL != array) {
+    view->type = INT;
+    view->len = array->len;
+    view->owned = true;
+    view->ints = ALLOC_ARRAY2(int64_t, max(view->len, 1));
+    for (i = 0; i < view->len; ++i) {
+      view->ints[i] = array->bytes[i];
+    }
+    return true;
+  }
+  int32_t len = sequence_size(arg);
+  if (len < 0) {
+    return false;
+  }
+  view->len = len;
+  view->type = INT;
+  bool has_int = false;
+  for (i = 0; i < view->len; ++i) {
+    Element elt = sequence_get(arg, i);
+    if (VALUE != elt.type || CHAR == elt.val.type) {
+      return false;
+    }
+    if (FLOAT == elt.val.type) {
+      view->type = FLOAT;
+    } else {
+      has_int = true;
+    }
+  }
+  view->mixed = has_int && FLOAT == view->type;
+  view->owned = true;
+  view->ints = ALLOC_ARRAY2(int64_t, max(view->len, 1));
+  for (i = 0; i < view->len; ++i) {
+    Element elt = sequence_get(arg, i);
+    if (FLOAT == view->type) {
+      view->floats[i] = VALUE_OF(elt.val);
+    } else {
+      view->ints[i] = elt.val.int_val;
+    }
+  }
+  return true;
+}
+
+void num_view_finalize(NumView *view) {
+  if (view->owned) {
+    DEALLOC(view->ints);
+  }
+}
+
+void num_view_to_float(NumView *view) {
+  if (FLOAT == view->type) {
+    return;
+  }
+  double *floats = ALLOC_ARRAY2(double, max(view->len, 1));
+  uint32_t i;
+  for (i = 0; i < view->len; ++i) {
+    floats[i] = view->ints[i];
+  }
+  num_view_finalize(view);
+  view->type = FLOAT;
+  view->owned = true;
+  view->floats = floats;
+}
+
+bool num_view_pair(Element *arg, NumView *first, Element *second_elt) {
+  if (!is_object_type(arg, TUPLE) || 2 != tuple_size(arg->obj->tuple)) {
+    return false;
+  }
+  *second_elt = tuple_get(arg->obj->tuple, 1);
+  Element first_elt = tuple_get(arg->obj->tuple, 0);
+  return num_view_init(&first_elt, first);
+}
+
+// The bulk functions below return None when given something other than
+// numbers so that lib/math.jl can fall back to its element-wise versions.
+
+Element sum__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
+  NumView view;
+  if (!num_view_init(argument, &view)) {
+    return create_none();
+  }
+  int64_t sum;
+  Element result;
+  if (INT == view.type && kernel_sum_int(view.ints, view.len, &sum)) {
+    result = create_int(sum);
+  } else {
+    // Past what an int holds, the sum is a float like QUICK_INT_ARITH makes.
+    num_view_to_float(&view);
+    result = create_float(kernel_sum_float(view.floats, view.len));
+  }
+  num_view_finalize(&view);
+  return result;
+}
+
+// Mixed ints and floats go the slow way so the original element, and not a
+// float copy of it, is returned.
+Element min_max(const Element *argument, bool want_max) {
+  NumView view;
+  if (!num_view_init(argument, &view)) {
+    return create_none();
+  }
+  Element result = create_none();
+  if (view.len > 0 && !view.mixed) {
+    if (FLOAT == view.type) {
+      result = create_float(want_max ? kernel_max_float(view.floats, view.len)
+                                     : kernel_min_float(view.floats, view.len));
+    } else {
+      result = create_int(want_max ? kernel_max_int(view.ints, view.len)
+                                   : kernel_min_int(view.ints, view.len));
+    }
+  }
+  num_view_finalize(&view);
+  return result;
+}
+
+Element min__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
+  return min_max(argument, /*want_max=*/false);
+}
+
+Element max__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
+  return min_max(argument, /*want_max=*/true);
+}
+
+Element dot__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
+  NumView a, b;
+  Element b_elt;
+  if (!num_view_pair(argument, &a, &b_elt)) {
+    return create_none();
+  }
+  if (!num_view_init(&b_elt, &b)) {
+    num_view_finalize(&a);
+    return create_none();
+  }
+  Element result;
+  int64_t dot;
+  if (a.len != b.len) {
+    result = throw_error(vm, th, "dot__ expects sequences of the same length.");
+  } else if (INT == a.type && INT == b.type &&
+             kernel_dot_int(a.ints, b.ints, a.len, &dot)) {
+    result = create_int(dot);
+  } else {
+    num_view_to_float(&a);
+    num_view_to_float(&b);
+    result = create_float(kernel_dot_float(a.floats, b.floats, a.len));
+  }
+  num_view_finalize(&a);
+  num_view_finalize(&b);
+  return result;
+}
+
+Element scale__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
+  NumView a;
+  Element k;
+  if (!num_view_pair(argument, &a, &k)) {
+    return create_none();
+  }
+  if (VALUE != k.type || CHAR == k.val.type) {
+    num_view_finalize(&a);
+    return create_none();
+  }
+  TypedArray *out;
+  Element result = create_none();
+  if (INT == a.type && INT == k.val.type) {
+    result = typed_array_new(vm, INT, a.len, &out);
+    if (!kernel_scale_int(a.ints, k.val.int_val, out->ints, a.len)) {
+      // Overflowed, so make floats instead.
+      result = create_none();
+    }
+  }
+  if (NONE == result.type) {
+    num_view_to_float(&a);
+    result = typed_array_new(vm, FLOAT, a.len, &out);
+    kernel_scale_float(a.floats, VALUE_OF(k.val), out->floats, a.len);
+  }
+  num_view_finalize(&a);
+  return result;
+}
+
+Element add__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
+  NumView a, b;
+  Element b_elt;
+  if (!num_view_pair(argument, &a, &b_elt)) {
+    return create_none();
+  }
+  if (!num_view_init(&b_elt, &b)) {
+    num_view_finalize(&a);
+    return create_none();
+  }
+  TypedArray *out;
+  Element result = create_none();
+  if (a.len != b.len) {
+    result = throw_error(vm, th, "add__ expects sequences of the same length.");
+  } else if (INT == a.type && INT == b.type) {
+    result = typed_array_new(vm, INT, a.len, &out);
+    if (!kernel_add_int(a.ints, b.ints, out->ints, a.len)) {
+      // Overflowed, so make floats instead.
+      result = create_none();
+    }
+  }
+  if (a.len == b.len && NONE == result.type) {
+    num_view_to_float(&a);
+    num_view_to_float(&b);
+    result = typed_array_new(vm, FLOAT, a.len, &out);
+    kernel_add_float(a.floats, b.floats, out->floats, a.len);
+  }
+  num_view_finalize(&a);
+  num_view_finalize(&b);
+  return result;
+}
+
+bool cmp_op_of(const Element *elt, CmpOp *op) {
+  if (!ISTYPE(*elt, class_string)) {
+    return false;
+  }
+  const char *ops[] = {"<", "<=", ">", ">=", "==", "!="};
+  const CmpOp values[] = {CMP_LT, CMP_LTE, CMP_GT, CMP_GTE, CMP_EQ, CMP_NEQ};
+  String *string = String_extract(*elt);
+  size_t i;
+  for (i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    if (String_size(string) == strlen(ops[i]) &&
+        0 == strncmp(String_cstr(string), ops[i], String_size(string))) {
+      *op = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+// compare__(a, op, b) where b is a number or a sequence as long as a. Returns a
+// ByteArray holding 1 where a[i] op b[i] holds and 0 elsewhere.
+Element compare__(VM *vm, Thread *th, ExternalData *ed, Element *argument) {
+  if (!is_object_type(argument, TUPLE) ||
+      3 != tuple_size(argument->obj->tuple)) {
+    return throw_error(vm, th, "compare__ expects exactly 3 arguments.");
+  }
+  Element a_elt = tuple_get(argument->obj->tuple, 0);
+  Element op_elt = tuple_get(argument->obj->tuple, 1);
+  Element b_elt = tuple_get(argument->obj->tuple, 2);
+  CmpOp op;
+  if (!cmp_op_of(&op_elt, &op)) {
+    return throw_error(vm, th, "compare__ expects one of <, <=, >, >=, ==, !=.");
+  }
+  NumView a, b;
+  if (!num_view_init(&a_elt, &a)) {
+    return create_none();
+  }
+  int64_t b_int;
+  double b_float;
+  if (VALUE == b_elt.type && CHAR != b_elt.val.type) {
+    b.len = 1;
+    b.owned = false;
+    b.type = b_elt.val.type;
+    if (INT == b.type) {
+      b_int = b_elt.val.int_val;
+      b.ints = &b_int;
+    } else {
+      b_float = b_elt.val.float_val;
+      b.floats = &b_float;
+    }
+  } else if (!num_view_init(&b_elt, &b)) {
+    num_view_finalize(&a);
+    return create_none();
+  } else if (a.len != b.len) {
+    num_view_finalize(&a);
+    num_view_finalize(&b);
+    return throw_error(vm, th,
+                       "compare__ expects sequences of the same length.");
+  }
+  TypedArray *out;
+  Element result = typed_array_new(vm, CHAR, a.len, &out);
+  if (INT == a.type && INT == b.type) {
+    kernel_compare_int(a.ints, b.ints, b.len, op, out->bytes, a.len);
+  } else {
+    num_view_to_float(&a);
+    num_view_to_float(&b);
+    kernel_compare_float(a.floats, b.floats, b.len, op, out->bytes, a.len);
+  }
+  num_view_finalize(&a);
+  num_view_finalize(&b);
+  return result;
+}
@@ -13,4 +13,13 @@
 Element log__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
 Element pow__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
 
+// Native bulk operations over Arrays, Tuples and typed arrays of numbers.
+Element sum__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element min__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element max__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element dot__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element scale__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element add__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element compare__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+
 #endif /* EXTERNAL_MATH_H_ */
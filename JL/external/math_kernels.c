@@ -0,0 +1,413 @@
+/*
+ * math_kernels.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "math_kernels.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Each loop handles what the vector registers can and leaves the tail to the
+// scalar loop after it. Sums use two accumulators to hide add latency.
+
+// Vector adds wrap, so the int kernels below note where a lane overflowed
+// instead: that is where both addends differ in sign from their sum.
+
+bool kernel_sum_int(const int64_t a[], size_t n, int64_t *sum) {
+  size_t i = 0;
+  int64_t total = 0;
+#if defined(__AVX2__)
+  __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+  __m256i overflow = _mm256_setzero_si256();
+  for (; i + 8 <= n; i += 8) {
+    __m256i vals0 = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vals1 = _mm256_loadu_si256((const __m256i *)(a + i + 4));
+    __m256i sum0 = _mm256_add_epi64(acc0, vals0);
+    __m256i sum1 = _mm256_add_epi64(acc1, vals1);
+    overflow = _mm256_or_si256(
+        overflow, _mm256_and_si256(_mm256_xor_si256(acc0, sum0),
+                                   _mm256_xor_si256(vals0, sum0)));
+    overflow = _mm256_or_si256(
+        overflow, _mm256_and_si256(_mm256_xor_si256(acc1, sum1),
+                                   _mm256_xor_si256(vals1, sum1)));
+    acc0 = sum0;
+    acc1 = sum1;
+  }
+  if (0 != _mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+    return false;
+  }
+  int64_t lanes[8];
+  _mm256_storeu_si256((__m256i *)lanes, acc0);
+  _mm256_storeu_si256((__m256i *)(lanes + 4), acc1);
+  int j;
+  for (j = 0; j < 8; ++j) {
+    if (__builtin_add_overflow(total, lanes[j], &total)) {
+      return false;
+    }
+  }
+#elif defined(__SSE2__)
+  __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+  __m128i overflow = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    __m128i vals0 = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vals1 = _mm_loadu_si128((const __m128i *)(a + i + 2));
+    __m128i sum0 = _mm_add_epi64(acc0, vals0);
+    __m128i sum1 = _mm_add_epi64(acc1, vals1);
+    overflow = _mm_or_si128(overflow,
+                            _mm_and_si128(_mm_xor_si128(acc0, sum0),
+                                          _mm_xor_si128(vals0, sum0)));
+    overflow = _mm_or_si128(overflow,
+                            _mm_and_si128(_mm_xor_si128(acc1, sum1),
+                                          _mm_xor_si128(vals1, sum1)));
+    acc0 = sum0;
+    acc1 = sum1;
+  }
+  if (0 != _mm_movemask_pd(_mm_castsi128_pd(overflow))) {
+    return false;
+  }
+  int64_t lanes[4];
+  _mm_storeu_si128((__m128i *)lanes, acc0);
+  _mm_storeu_si128((__m128i *)(lanes + 2), acc1);
+  int j;
+  for (j = 0; j < 4; ++j) {
+    if (__builtin_add_overflow(total, lanes[j], &total)) {
+      return false;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (__builtin_add_overflow(total, a[i], &total)) {
+      return false;
+    }
+  }
+  *sum = total;
+  return true;
+}
+
+double kernel_sum_float(const double a[], size_t n) {
+  size_t i = 0;
+  double sum = 0;
+#if defined(__AVX2__)
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+  for (; i < n; ++i) {
+    sum += a[i];
+  }
+  return sum;
+}
+
+// There is no packed 64-bit multiply below AVX-512, so leave this one to the
+// compiler.
+bool kernel_dot_int(const int64_t a[], const int64_t b[], size_t n,
+                    int64_t *dot) {
+  size_t i;
+  int64_t sum = 0, product;
+  for (i = 0; i < n; ++i) {
+    if (__builtin_mul_overflow(a[i], b[i], &product) ||
+        __builtin_add_overflow(sum, product, &sum)) {
+      return false;
+    }
+  }
+  *dot = sum;
+  return true;
+}
+
+double kernel_dot_float(const double a[], const double b[], size_t n) {
+  size_t i = 0;
+  double sum = 0;
+#if defined(__AVX2__)
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(
+        acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+                                             _mm256_loadu_pd(b + i + 4)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    acc0 =
+        _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    acc1 = _mm_add_pd(
+        acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+int64_t kernel_extreme_int(const int64_t a[], size_t n, int want_max) {
+  size_t i = 1;
+  int64_t best = a[0];
+#if defined(__AVX2__)
+  if (n >= 4) {
+    __m256i acc = _mm256_loadu_si256((const __m256i *)a);
+    for (i = 4; i + 4 <= n; i += 4) {
+      __m256i vals = _mm256_loadu_si256((const __m256i *)(a + i));
+      __m256i take = want_max ? _mm256_cmpgt_epi64(vals, acc)
+                              : _mm256_cmpgt_epi64(acc, vals);
+      acc = _mm256_blendv_epi8(acc, vals, take);
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    int j;
+    for (j = 0; j < 4; ++j) {
+      if (want_max ? lanes[j] > best : lanes[j] < best) {
+        best = lanes[j];
+      }
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (want_max ? a[i] > best : a[i] < best) {
+      best = a[i];
+    }
+  }
+  return best;
+}
+
+int64_t kernel_min_int(const int64_t a[], size_t n) {
+  return kernel_extreme_int(a, n, /*want_max=*/0);
+}
+
+int64_t kernel_max_int(const int64_t a[], size_t n) {
+  return kernel_extreme_int(a, n, /*want_max=*/1);
+}
+
+double kernel_extreme_float(const double a[], size_t n, int want_max) {
+  size_t i = 1;
+  double best = a[0];
+#if defined(__AVX2__)
+  if (n >= 4) {
+    // Every lane starts from a[0] and max/min return their second operand
+    // when either is NaN. So, like the loop below, a NaN is skipped unless it
+    // is a[0], in which case it sticks.
+    __m256d acc = _mm256_set1_pd(best);
+    for (i = 0; i + 4 <= n; i += 4) {
+      __m256d vals = _mm256_loadu_pd(a + i);
+      acc = want_max ? _mm256_max_pd(vals, acc) : _mm256_min_pd(vals, acc);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    int j;
+    for (j = 0; j < 4; ++j) {
+      if (want_max ? lanes[j] > best : lanes[j] < best) {
+        best = lanes[j];
+      }
+    }
+  }
+#elif defined(__SSE2__)
+  if (n >= 2) {
+    __m128d acc = _mm_set1_pd(best);
+    for (i = 0; i + 2 <= n; i += 2) {
+      __m128d vals = _mm_loadu_pd(a + i);
+      acc = want_max ? _mm_max_pd(vals, acc) : _mm_min_pd(vals, acc);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    int j;
+    for (j = 0; j < 2; ++j) {
+      if (want_max ? lanes[j] > best : lanes[j] < best) {
+        best = lanes[j];
+      }
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (want_max ? a[i] > best : a[i] < best) {
+      best = a[i];
+    }
+  }
+  return best;
+}
+
+double kernel_min_float(const double a[], size_t n) {
+  return kernel_extreme_float(a, n, /*want_max=*/0);
+}
+
+double kernel_max_float(const double a[], size_t n) {
+  return kernel_extreme_float(a, n, /*want_max=*/1);
+}
+
+bool kernel_scale_int(const int64_t a[], int64_t k, int64_t out[], size_t n) {
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    if (__builtin_mul_overflow(a[i], k, out + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void kernel_scale_float(const double a[], double k, double out[], size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  __m256d factor = _mm256_set1_pd(k);
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+  }
+#elif defined(__SSE2__)
+  __m128d factor = _mm_set1_pd(k);
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), factor));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = a[i] * k;
+  }
+}
+
+bool kernel_add_int(const int64_t a[], const int64_t b[], int64_t out[],
+                    size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  __m256i overflow = _mm256_setzero_si256();
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i sum = _mm256_add_epi64(x, y);
+    overflow = _mm256_or_si256(overflow,
+                               _mm256_and_si256(_mm256_xor_si256(x, sum),
+                                                _mm256_xor_si256(y, sum)));
+    _mm256_storeu_si256((__m256i *)(out + i), sum);
+  }
+  if (0 != _mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+    return false;
+  }
+#elif defined(__SSE2__)
+  __m128i overflow = _mm_setzero_si128();
+  for (; i + 2 <= n; i += 2) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i sum = _mm_add_epi64(x, y);
+    overflow = _mm_or_si128(
+        overflow, _mm_and_si128(_mm_xor_si128(x, sum), _mm_xor_si128(y, sum)));
+    _mm_storeu_si128((__m128i *)(out + i), sum);
+  }
+  if (0 != _mm_movemask_pd(_mm_castsi128_pd(overflow))) {
+    return false;
+  }
+#endif
+  for (; i < n; ++i) {
+    if (__builtin_add_overflow(a[i], b[i], out + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void kernel_add_float(const double a[], const double b[], double out[],
+                      size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(
+        out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i,
+                  _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+#define COMPARE(x, y, op)                       \
+  ((CMP_LT == (op))    ? (x) < (y)              \
+   : (CMP_LTE == (op)) ? (x) <= (y)             \
+   : (CMP_GT == (op))  ? (x) > (y)              \
+   : (CMP_GTE == (op)) ? (x) >= (y)             \
+   : (CMP_EQ == (op))  ? (x) == (y)             \
+                       : (x) != (y))
+
+// Branching on op inside the loop keeps these short. The compiler hoists it
+// out, since op never changes.
+void kernel_compare_int(const int64_t a[], const int64_t b[], size_t b_len,
+                        CmpOp op, uint8_t mask[], size_t n) {
+  size_t i;
+  if (1 == b_len) {
+    int64_t y = b[0];
+    for (i = 0; i < n; ++i) {
+      mask[i] = COMPARE(a[i], y, op);
+    }
+    return;
+  }
+  for (i = 0; i < n; ++i) {
+    mask[i] = COMPARE(a[i], b[i], op);
+  }
+}
+
+#if defined(__AVX2__)
+__m256d compare_pd(__m256d x, __m256d y, CmpOp op) {
+  switch (op) {
+    case CMP_LT:
+      return _mm256_cmp_pd(x, y, _CMP_LT_OQ);
+    case CMP_LTE:
+      return _mm256_cmp_pd(x, y, _CMP_LE_OQ);
+    case CMP_GT:
+      return _mm256_cmp_pd(x, y, _CMP_GT_OQ);
+    case CMP_GTE:
+      return _mm256_cmp_pd(x, y, _CMP_GE_OQ);
+    case CMP_EQ:
+      return _mm256_cmp_pd(x, y, _CMP_EQ_OQ);
+    default /*CMP_NEQ*/:
+      return _mm256_cmp_pd(x, y, _CMP_NEQ_UQ);
+  }
+}
+#endif
+
+void kernel_compare_float(const double a[], const double b[], size_t b_len,
+                          CmpOp op, uint8_t mask[], size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  __m256d scalar = _mm256_set1_pd(b[0]);
+  for (; i + 4 <= n; i += 4) {
+    __m256d y = (1 == b_len) ? scalar : _mm256_loadu_pd(b + i);
+    int bits = _mm256_movemask_pd(compare_pd(_mm256_loadu_pd(a + i), y, op));
+    mask[i] = bits & 1;
+    mask[i + 1] = (bits >> 1) & 1;
+    mask[i + 2] = (bits >> 2) & 1;
+    mask[i + 3] = (bits >> 3) & 1;
+  }
+#endif
+  for (; i < n; ++i) {
+    mask[i] = COMPARE(a[i], (1 == b_len) ? b[0] : b[i], op);
+  }
+}
@@ -0,0 +1,49 @@
+/*
+ * math_kernels.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_MATH_KERNELS_H_
+#define EXTERNAL_MATH_KERNELS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bulk numeric operations over contiguous buffers. They use AVX2 or SSE2 when
+// compiled with them. The int kernels which can overflow return false when
+// they do, so the caller can redo the work with doubles.
+
+typedef enum { CMP_LT, CMP_LTE, CMP_GT, CMP_GTE, CMP_EQ, CMP_NEQ } CmpOp;
+
+bool kernel_sum_int(const int64_t a[], size_t n, int64_t *sum);
+double kernel_sum_float(const double a[], size_t n);
+
+bool kernel_dot_int(const int64_t a[], const int64_t b[], size_t n,
+                    int64_t *dot);
+double kernel_dot_float(const double a[], const double b[], size_t n);
+
+// n must be > 0.
+int64_t kernel_min_int(const int64_t a[], size_t n);
+int64_t kernel_max_int(const int64_t a[], size_t n);
+double kernel_min_float(const double a[], size_t n);
+double kernel_max_float(const double a[], size_t n);
+
+bool kernel_scale_int(const int64_t a[], int64_t k, int64_t out[], size_t n);
+void kernel_scale_float(const double a[], double k, double out[], size_t n);
+
+bool kernel_add_int(const int64_t a[], const int64_t b[], int64_t out[],
+                    size_t n);
+void kernel_add_float(const double a[], const double b[], double out[],
+                      size_t n);
+
+// Sets mask[i] to 1 if a[i] op b[i], otherwise 0. If b_len is 1, every a[i] is
+// compared to b[0].
+void kernel_compare_int(const int64_t a[], const int64_t b[], size_t b_len,
+                        CmpOp op, uint8_t mask[], size_t n);
+void kernel_compare_float(const double a[], const double b[], size_t b_len,
+                          CmpOp op, uint8_t mask[], size_t n);
+
+#endif /* EXTERNAL_MATH_KERNELS_H_ */
@@ -0,0 +1,710 @@
+/*
+ * event_loop.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "event_loop.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../arena/strings.h"
+#include "../../class.h"
+#include "../../datastructure/array.h"
+#include "../../datastructure/map.h"
+#include "../../datastructure/tuple.h"
+#include "../../element.h"
+#include "../../error.h"
+#include "../../ltable/ltable.h"
+#include "../../memory/memory.h"
+#include "../../memory/memory_graph.h"
+#include "../../threads/thread.h"
+#include "../../threads/thread_interface.h"
+#include "../../vm/vm.h"
+#include "../external.h"
+#include "../strings.h"
+#include "impl/event_loop.h"
+#include "impl/socket.h"
+#include "socket.h"
+
+#define DEFAULT_WATCH_CAPACITY 64
+// How often idle handles are looked for. Idle timeouts are only this precise.
+#define TIMEOUT_SWEEP_MSEC 500
+// Queued segments written per writev when draining.
+#define FLUSH_BATCH_SIZE 64
+
+// Output which could not be written without blocking. Either a copy of bytes
+// or the unsent remainder of a file, which is sent straight from file_fd.
+typedef struct OutSegment_ {
+  struct OutSegment_ *next;
+  // -1 for bytes.
+  int file_fd;
+  int64_t offset, remaining;
+  uint32_t len, sent;
+  char bytes[];
+} OutSegment;
+
+// What the reactor knows about one watched fd. The matching (object, callback)
+// tuple lives in the $watched array so the VM can see them.
+typedef struct {
+  bool in_use;
+  bool close_when_flushed;
+  // Exactly one is set.
+  Socket *listener;
+  SocketHandle *sh;
+  // Pending output, oldest first.
+  OutSegment *out_head, *out_tail;
+  // Handles idle for timeout_msec are closed. 0 for none.
+  int32_t timeout_msec;
+  int64_t deadline;
+} Watch;
+
+typedef struct {
+  EventLoop *loop;
+  Mutex mutex;
+  // Set by stop() only, so run() can be called again after a callback raised.
+  bool stopped;
+  Watch *watches;
+  uint32_t num_watches;
+  // Watches with an idle timeout.
+  uint32_t num_timed;
+  int64_t next_sweep;
+} Reactor;
+
+Reactor *reactor_state(ExternalData *data) {
+  return (Reactor *)map_lookup(&data->state, strings_intern("reactor"));
+}
+
+Watch *reactor_watch(Reactor *reactor, int fd) {
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fd >= reactor->num_watches) {
+    uint32_t num_watches = max(reactor->num_watches * 2, fd + 1);
+    reactor->watches = REALLOC(reactor->watches, Watch, num_watches);
+    memset(reactor->watches + reactor->num_watches, 0,
+           sizeof(Watch) * (num_watches - reactor->num_watches));
+    reactor->num_watches = num_watches;
+  }
+  return &reactor->watches[fd];
+}
+
+// Returns the watch only if fd is currently watched.
+Watch *reactor_find(Reactor *reactor, int fd) {
+  if (fd < 0 || fd >= reactor->num_watches || !reactor->watches[fd].in_use) {
+    return NULL;
+  }
+  return &reactor->watches[fd];
+}
+
+void watched_set(VM *vm, ExternalData *data, int fd, Element entry) {
+  Element watched = obj_get_field(data->object, strings_intern("$watched"));
+  Array *arr = extract_array(watched);
+  // Array_set() leaves any gap uninitialized.
+  while (Array_size(arr) < fd) {
+    memory_graph_array_enqueue(vm->graph, watched, create_none());
+  }
+  memory_graph_array_set(vm->graph, watched.obj, fd, &entry);
+}
+
+Element watched_get(ExternalData *data, int fd) {
+  Element watched = obj_get_field(data->object, strings_intern("$watched"));
+  Array *arr = extract_array(watched);
+  if (fd >= Array_size(arr)) {
+    return create_none();
+  }
+  return Array_get(arr, fd);
+}
+
+// Must hold the reactor lock.
+bool reactor_add(VM *vm, ExternalData *data, Reactor *reactor, int fd,
+                 int events, Socket *listener, SocketHandle *sh,
+                 Element object, Element callback) {
+  Watch *watch = reactor_watch(reactor, fd);
+  if (watch->in_use || !event_loop_add(reactor->loop, fd, events)) {
+    return false;
+  }
+  memset(watch, 0, sizeof(Watch));
+  watch->in_use = true;
+  watch->listener = listener;
+  watch->sh = sh;
+  Element entry = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, entry, object);
+  memory_graph_tuple_add(vm->graph, entry, callback);
+  watched_set(vm, data, fd, entry);
+  return true;
+}
+
+void out_segment_delete(OutSegment *segment) {
+  if (segment->file_fd >= 0) {
+    socket_file_close(segment->file_fd);
+  }
+  DEALLOC(segment);
+}
+
+void watch_clear_output(Watch *watch) {
+  while (NULL != watch->out_head) {
+    OutSegment *next = watch->out_head->next;
+    out_segment_delete(watch->out_head);
+    watch->out_head = next;
+  }
+  watch->out_tail = NULL;
+}
+
+void watch_queue_output(Watch *watch, OutSegment *segment) {
+  segment->next = NULL;
+  if (NULL == watch->out_tail) {
+    watch->out_head = segment;
+  } else {
+    watch->out_tail->next = segment;
+  }
+  watch->out_tail = segment;
+}
+
+// Must hold the reactor lock. Closes handles but not listening sockets, which
+// belong to whoever created them.
+void reactor_drop(VM *vm, ExternalData *data, Reactor *reactor, int fd) {
+  Watch *watch = reactor_find(reactor, fd);
+  if (NULL == watch) {
+    return;
+  }
+  event_loop_remove(reactor->loop, fd);
+  if (watch->timeout_msec > 0) {
+    reactor->num_timed--;
+  }
+  if (NULL != watch->sh) {
+    sockethandle_close(watch->sh);
+  }
+  watch_clear_output(watch);
+  memset(watch, 0, sizeof(Watch));
+  watched_set(vm, data, fd, create_none());
+}
+
+// Must hold the reactor lock.
+void reactor_touch(Watch *watch) {
+  if (watch->timeout_msec > 0) {
+    watch->deadline = event_loop_now_msec() + watch->timeout_msec;
+  }
+}
+
+// Must hold the reactor lock. Closes handles which have been idle too long.
+void reactor_sweep(VM *vm, ExternalData *data, Reactor *reactor) {
+  int64_t now = event_loop_now_msec();
+  if (0 == reactor->num_timed || now < reactor->next_sweep) {
+    return;
+  }
+  reactor->next_sweep = now + TIMEOUT_SWEEP_MSEC;
+  int fd;
+  for (fd = 0; fd < reactor->num_watches; ++fd) {
+    Watch *watch = &reactor->watches[fd];
+    if (!watch->in_use || watch->timeout_msec <= 0 || watch->deadline > now) {
+      continue;
+    }
+    if (NULL != watch->out_head) {
+      watch->close_when_flushed = true;
+    } else {
+      reactor_drop(vm, data, reactor, fd);
+    }
+  }
+}
+
+// Removes the fully written oldest segment.
+void watch_pop_output(Watch *watch) {
+  OutSegment *next = watch->out_head->next;
+  out_segment_delete(watch->out_head);
+  watch->out_head = next;
+  if (NULL == next) {
+    watch->out_tail = NULL;
+  }
+}
+
+// Must hold the reactor lock. Writes as much pending output as the socket
+// takes, coalescing queued bytes into one write. False if the peer is gone.
+bool reactor_flush(Watch *watch) {
+  while (NULL != watch->out_head) {
+    OutSegment *segment = watch->out_head;
+    if (segment->file_fd >= 0) {
+      int64_t sent = sockethandle_send_file(watch->sh, segment->file_fd,
+                                            &segment->offset,
+                                            segment->remaining);
+      if (sent < 0) {
+        return false;
+      }
+      segment->remaining -= sent;
+      if (segment->remaining > 0) {
+        return true;
+      }
+      watch_pop_output(watch);
+      continue;
+    }
+    SocketBuffer bufs[FLUSH_BATCH_SIZE];
+    int num_bufs = 0;
+    int64_t pending = 0;
+    for (; NULL != segment && segment->file_fd < 0 &&
+           num_bufs < FLUSH_BATCH_SIZE;
+         segment = segment->next) {
+      bufs[num_bufs].data = segment->bytes + segment->sent;
+      bufs[num_bufs].len = segment->len - segment->sent;
+      pending += bufs[num_bufs++].len;
+    }
+    int64_t written = sockethandle_sendv(watch->sh, bufs, num_bufs);
+    if (written < 0) {
+      return false;
+    }
+    int64_t sent = written;
+    while (sent > 0 && sent >= watch->out_head->len - watch->out_head->sent) {
+      sent -= watch->out_head->len - watch->out_head->sent;
+      watch_pop_output(watch);
+    }
+    if (sent > 0) {
+      watch->out_head->sent += sent;
+    }
+    if (written < pending) {
+      // Would block.
+      return true;
+    }
+  }
+  return true;
+}
+
+// Must hold the reactor lock. Writes bufs now if nothing is queued ahead of
+// them, and copies whatever the socket did not take.
+bool reactor_send(Reactor *reactor, Watch *watch, int fd,
+                  const SocketBuffer *bufs, int num_bufs) {
+  int64_t sent = 0;
+  if (NULL == watch->out_head) {
+    sent = sockethandle_sendv(watch->sh, bufs, num_bufs);
+    if (sent < 0) {
+      return false;
+    }
+  }
+  while (num_bufs > 0 && sent >= bufs[0].len) {
+    sent -= bufs[0].len;
+    bufs++;
+    num_bufs--;
+  }
+  if (0 == num_bufs) {
+    return true;
+  }
+  if (NULL == watch->out_head) {
+    event_loop_modify(reactor->loop, fd, EVENT_READABLE | EVENT_WRITABLE);
+  }
+  uint32_t len = 0;
+  int i;
+  for (i = 0; i < num_bufs; ++i) {
+    len += bufs[i].len;
+  }
+  len -= sent;
+  OutSegment *segment =
+      (OutSegment *)ALLOC_ARRAY2(char, sizeof(OutSegment) + len);
+  segment->file_fd = -1;
+  segment->offset = segment->remaining = 0;
+  segment->len = len;
+  segment->sent = 0;
+  char *out = segment->bytes;
+  for (i = 0; i < num_bufs; ++i) {
+    uint32_t skip = (0 == i) ? sent : 0;
+    memmove(out, bufs[i].data + skip, bufs[i].len - skip);
+    out += bufs[i].len - skip;
+  }
+  watch_queue_output(watch, segment);
+  return true;
+}
+
+// Must hold the reactor lock. Like reactor_send(), for size bytes of
+// file_fd. Takes ownership of file_fd.
+bool reactor_send_file(Reactor *reactor, Watch *watch, int fd, int file_fd,
+                       int64_t size) {
+  int64_t offset = 0;
+  if (NULL == watch->out_head &&
+      sockethandle_send_file(watch->sh, file_fd, &offset, size) < 0) {
+    socket_file_close(file_fd);
+    return false;
+  }
+  if (offset == size) {
+    socket_file_close(file_fd);
+    return true;
+  }
+  if (NULL == watch->out_head) {
+    event_loop_modify(reactor->loop, fd, EVENT_READABLE | EVENT_WRITABLE);
+  }
+  OutSegment *segment = ALLOC2(OutSegment);
+  segment->file_fd = file_fd;
+  segment->offset = offset;
+  segment->remaining = size - offset;
+  segment->len = segment->sent = 0;
+  watch_queue_output(watch, segment);
+  return true;
+}
+
+SocketHandle *handle_of(Element handle) {
+  if (!ISTYPE(handle, class_sockethandle)) {
+    return NULL;
+  }
+  return (SocketHandle *)map_lookup(&handle.obj->external_data->state,
+                                    strings_intern("handle"));
+}
+
+Element EventLoop_constructor(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  EventLoop *loop = event_loop_create();
+  if (NULL == loop) {
+    return throw_error(vm, t, "EventLoop is not supported on this platform.");
+  }
+  Reactor *reactor = ALLOC2(Reactor);
+  reactor->loop = loop;
+  reactor->mutex = mutex_create(NULL);
+  reactor->stopped = false;
+  reactor->num_timed = 0;
+  reactor->next_sweep = 0;
+  reactor->num_watches = DEFAULT_WATCH_CAPACITY;
+  reactor->watches = ALLOC_ARRAY(Watch, DEFAULT_WATCH_CAPACITY);
+  memset(reactor->watches, 0, sizeof(Watch) * DEFAULT_WATCH_CAPACITY);
+  map_insert(&data->state, strings_intern("reactor"), reactor);
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$watched"),
+                         create_array(vm->graph));
+  return data->object;
+}
+
+Element EventLoop_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  Reactor *reactor = reactor_state(data);
+  if (NULL == reactor) {
+    return create_none();
+  }
+  int fd;
+  for (fd = 0; fd < reactor->num_watches; ++fd) {
+    watch_clear_output(&reactor->watches[fd]);
+  }
+  DEALLOC(reactor->watches);
+  event_loop_delete(reactor->loop);
+  mutex_close(reactor->mutex);
+  DEALLOC(reactor);
+  return create_none();
+}
+
+// serve(socket, on_accept): Accepts connections on a listening Socket and
+// calls on_accept(handle) for each. Several loops may serve the same socket.
+Element EventLoop_serve(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "serve() expects (Socket, on_accept).");
+  }
+  Element sock = tuple_get(arg->obj->tuple, 0);
+  Element on_accept = tuple_get(arg->obj->tuple, 1);
+  if (!ISTYPE(sock, class_socket) || !is_callable(on_accept)) {
+    return throw_error(vm, t, "serve() expects (Socket, on_accept).");
+  }
+  Socket *socket = (Socket *)map_lookup(&sock.obj->external_data->state,
+                                        strings_intern("socket"));
+  if (NULL == socket || !socket_set_nonblocking(socket)) {
+    return throw_error(vm, t, "Could not make Socket non-blocking.");
+  }
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  bool added = reactor_add(vm, data, reactor, socket_get_fd(socket),
+                           EVENT_READABLE | EVENT_EXCLUSIVE, socket, NULL,
+                           sock, on_accept);
+  mutex_release(reactor->mutex);
+  if (!added) {
+    return throw_error(vm, t, "Could not watch Socket.");
+  }
+  return data->object;
+}
+
+// watch(handle, on_readable): Calls on_readable(handle) whenever handle has
+// input or the peer hung up. receive() then returns None if nothing is
+// available yet and '' once the peer is gone, at which point the callback
+// should close() the handle.
+Element EventLoop_watch(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "watch() expects (SocketHandle, on_readable).");
+  }
+  Element handle = tuple_get(arg->obj->tuple, 0);
+  Element on_readable = tuple_get(arg->obj->tuple, 1);
+  SocketHandle *sh = handle_of(handle);
+  if (NULL == sh || !is_callable(on_readable)) {
+    return throw_error(vm, t, "watch() expects (SocketHandle, on_readable).");
+  }
+  if (!sockethandle_is_valid(sh) || !sockethandle_set_nonblocking(sh)) {
+    return throw_error(vm, t, "Could not make SocketHandle non-blocking.");
+  }
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  bool added = reactor_add(vm, data, reactor, sockethandle_get_socket(sh),
+                           EVENT_READABLE, NULL, sh, handle, on_readable);
+  mutex_release(reactor->mutex);
+  if (!added) {
+    return throw_error(vm, t, "Could not watch SocketHandle.");
+  }
+  return data->object;
+}
+
+// Must hold the reactor lock. The watch for sh if it can still be written to.
+Watch *reactor_writable(Reactor *reactor, SocketHandle *sh) {
+  int fd = sockethandle_get_socket(sh);
+  Watch *watch = sockethandle_is_valid(sh) ? reactor_find(reactor, fd) : NULL;
+  if (NULL == watch || NULL == watch->sh) {
+    return NULL;
+  }
+  reactor_touch(watch);
+  return watch;
+}
+
+// send(handle, msg): Writes a String or Array of Strings without blocking, the
+// latter with a single writev. Whatever the socket does not take now is
+// written as it drains. Safe to call from any thread. False if the handle is
+// closed or no longer watched.
+Element EventLoop_send(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "send() expects (SocketHandle, msg).");
+  }
+  Element handle = tuple_get(arg->obj->tuple, 0);
+  Element msg = tuple_get(arg->obj->tuple, 1);
+  SocketHandle *sh = handle_of(handle);
+  if (NULL == sh) {
+    return throw_error(vm, t, "send() expects (SocketHandle, msg).");
+  }
+  SocketBuffer single, *bufs = NULL;
+  int num_bufs = 1;
+  if (ISTYPE(msg, class_array)) {
+    bufs = socket_buffers_of(msg, &num_bufs);
+    if (NULL == bufs) {
+      return throw_error(vm, t, "Cannot send non-string.");
+    }
+  } else if (ISTYPE(msg, class_string)) {
+    String *str = String_extract(msg);
+    single.data = String_cstr(str);
+    single.len = String_size(str);
+  } else {
+    return throw_error(vm, t, "Cannot send non-string.");
+  }
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  int fd = sockethandle_get_socket(sh);
+  Watch *watch = reactor_writable(reactor, sh);
+  bool ok = NULL != watch &&
+            reactor_send(reactor, watch, fd, NULL == bufs ? &single : bufs,
+                         num_bufs);
+  if (NULL != watch && !ok) {
+    reactor_drop(vm, data, reactor, fd);
+  }
+  mutex_release(reactor->mutex);
+  if (NULL != bufs) {
+    DEALLOC(bufs);
+  }
+  return ok ? element_true(vm) : element_false(vm);
+}
+
+// send_file(handle, path): Like send() for the contents of a file, which the
+// kernel copies to the socket where it can. The file is opened now, so it may
+// be replaced before the rest is sent.
+Element EventLoop_send_file(VM *vm, Thread *t, ExternalData *data,
+                            Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "send_file() expects (SocketHandle, path).");
+  }
+  Element handle = tuple_get(arg->obj->tuple, 0);
+  Element path = tuple_get(arg->obj->tuple, 1);
+  SocketHandle *sh = handle_of(handle);
+  if (NULL == sh || !ISTYPE(path, class_string)) {
+    return throw_error(vm, t, "send_file() expects (SocketHandle, path).");
+  }
+  int64_t size;
+  String *path_string = String_extract(path);
+  int file_fd = socket_file_open(String_cstr(path_string),
+                                 String_size(path_string), &size);
+  if (file_fd < 0) {
+    return throw_error(vm, t, "Could not open file.");
+  }
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  int fd = sockethandle_get_socket(sh);
+  Watch *watch = reactor_writable(reactor, sh);
+  bool ok = false;
+  if (NULL == watch) {
+    socket_file_close(file_fd);
+  } else {
+    ok = reactor_send_file(reactor, watch, fd, file_fd, size);
+  }
+  if (NULL != watch && !ok) {
+    reactor_drop(vm, data, reactor, fd);
+  }
+  mutex_release(reactor->mutex);
+  return ok ? element_true(vm) : element_false(vm);
+}
+
+// set_timeout(handle, msec): Closes handle once it has been idle, with no
+// input or sends, for msec. None or 0 turns the timeout off, e.g. while a
+// request is being worked on.
+Element EventLoop_set_timeout(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "set_timeout() expects (SocketHandle, msec).");
+  }
+  Element handle = tuple_get(arg->obj->tuple, 0);
+  Element msec = tuple_get(arg->obj->tuple, 1);
+  SocketHandle *sh = handle_of(handle);
+  if (NULL == sh || (NONE != msec.type && !is_value_type(&msec, INT))) {
+    return throw_error(vm, t, "set_timeout() expects (SocketHandle, msec).");
+  }
+  int32_t timeout_msec = NONE == msec.type ? 0 : max(msec.val.int_val, 0);
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  int fd = sockethandle_get_socket(sh);
+  Watch *watch = sockethandle_is_valid(sh) ? reactor_find(reactor, fd) : NULL;
+  if (NULL != watch) {
+    if (watch->timeout_msec > 0) {
+      reactor->num_timed--;
+    }
+    if (timeout_msec > 0) {
+      reactor->num_timed++;
+    }
+    watch->timeout_msec = timeout_msec;
+    reactor_touch(watch);
+  }
+  mutex_release(reactor->mutex);
+  if (NULL != watch && timeout_msec > 0) {
+    // run() may be waiting without a timeout.
+    event_loop_wakeup(reactor->loop);
+  }
+  return data->object;
+}
+
+// close(handle): Stops watching handle and closes it once pending output is
+// written.
+Element EventLoop_close(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  SocketHandle *sh = handle_of(*arg);
+  if (NULL == sh) {
+    return throw_error(vm, t, "close() expects a SocketHandle.");
+  }
+  Reactor *reactor = reactor_state(data);
+  mutex_await(reactor->mutex, INFINITE);
+  int fd = sockethandle_get_socket(sh);
+  Watch *watch = sockethandle_is_valid(sh) ? reactor_find(reactor, fd) : NULL;
+  if (NULL == watch) {
+    sockethandle_close(sh);
+  } else if (NULL != watch->out_head) {
+    watch->close_when_flushed = true;
+  } else {
+    reactor_drop(vm, data, reactor, fd);
+  }
+  mutex_release(reactor->mutex);
+  return create_none();
+}
+
+bool reactor_callback(VM *vm, Thread *t, Element callback, Element arg) {
+  Element module = *obj_deep_lookup_ckey(callback.obj, CKey_module);
+  Element result;
+  return vm_call_fn_sync(vm, t, module, callback, arg, &result);
+}
+
+// Accepts until the backlog is empty. False if a callback raised.
+bool reactor_accept(VM *vm, Thread *t, ExternalData *data, Reactor *reactor,
+                    Socket *listener, Element on_accept) {
+  while (true) {
+    SocketHandle *sh = socket_accept(listener);
+    if (!sockethandle_is_valid(sh)) {
+      // Would block, or another loop took it.
+      sockethandle_delete(sh);
+      return true;
+    }
+    if (!reactor_callback(vm, t, on_accept, sockethandle_wrap(vm, sh))) {
+      return false;
+    }
+  }
+}
+
+// run(): Dispatches events until stop() is called. Callbacks run on the
+// calling thread. An error a callback does not catch is raised from run(),
+// which can then be called again to carry on where it left off.
+Element EventLoop_run(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Reactor *reactor = reactor_state(data);
+  Event events[EVENT_LOOP_MAX_EVENTS];
+  while (!reactor->stopped) {
+    int i, num_events = event_loop_wait(
+        reactor->loop, events, reactor->num_timed > 0 ? TIMEOUT_SWEEP_MSEC : -1);
+    if (num_events < 0) {
+      return throw_error(vm, t, "EventLoop wait failed.");
+    }
+    for (i = 0; i < num_events && !reactor->stopped; ++i) {
+      int fd = events[i].fd;
+      mutex_await(reactor->mutex, INFINITE);
+      Watch *watch = reactor_find(reactor, fd);
+      if (NULL == watch) {
+        mutex_release(reactor->mutex);
+        continue;
+      }
+      Socket *listener = watch->listener;
+      bool notify = NULL != listener;
+      if (NULL != watch->sh) {
+        if (events[i].events & EVENT_READABLE) {
+          reactor_touch(watch);
+        }
+        if (events[i].events & EVENT_WRITABLE) {
+          if (!reactor_flush(watch)) {
+            watch->close_when_flushed = true;
+            watch_clear_output(watch);
+          } else if (NULL == watch->out_head) {
+            event_loop_modify(reactor->loop, fd, EVENT_READABLE);
+          }
+        }
+        if (watch->close_when_flushed && NULL == watch->out_head) {
+          reactor_drop(vm, data, reactor, fd);
+        } else {
+          notify = events[i].events & (EVENT_READABLE | EVENT_CLOSED);
+        }
+      }
+      // Copied so the callback can close or rewatch fd.
+      Element entry = watched_get(data, fd);
+      mutex_release(reactor->mutex);
+      if (!notify || !is_object_type(&entry, TUPLE)) {
+        continue;
+      }
+      Element object = tuple_get(entry.obj->tuple, 0);
+      Element callback = tuple_get(entry.obj->tuple, 1);
+      bool ok = (NULL != listener)
+                    ? reactor_accept(vm, t, data, reactor, listener, callback)
+                    : reactor_callback(vm, t, callback, object);
+      if (!ok) {
+        // Readiness is level-triggered, so the events after this one come up
+        // again in the next run().
+        return t_get_resval(t);
+      }
+    }
+    mutex_await(reactor->mutex, INFINITE);
+    reactor_sweep(vm, data, reactor);
+    mutex_release(reactor->mutex);
+  }
+  return data->object;
+}
+
+// stop(): Makes run() return after the callback in progress. Safe to call
+// from any thread.
+Element EventLoop_stop(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Reactor *reactor = reactor_state(data);
+  reactor->stopped = true;
+  event_loop_wakeup(reactor->loop);
+  return data->object;
+}
+
+Element add_event_loop_class(VM *vm, Element module) {
+  Element event_loop =
+      create_external_class(vm, module, strings_intern("EventLoop"),
+                            EventLoop_constructor, EventLoop_deconstructor);
+  add_external_method(vm, event_loop, strings_intern("serve"),
+                      EventLoop_serve);
+  add_external_method(vm, event_loop, strings_intern("watch"),
+                      EventLoop_watch);
+  add_external_method(vm, event_loop, strings_intern("send"), EventLoop_send);
+  add_external_method(vm, event_loop, strings_intern("send_file"),
+                      EventLoop_send_file);
+  add_external_method(vm, event_loop, strings_intern("set_timeout"),
+                      EventLoop_set_timeout);
+  add_external_method(vm, event_loop, strings_intern("close"),
+                      EventLoop_close);
+  add_external_method(vm, event_loop, strings_intern("run"), EventLoop_run);
+  add_external_method(vm, event_loop, strings_intern("stop"), EventLoop_stop);
+  return event_loop;
+}
@@ -0,0 +1,15 @@
+/*
+ * event_loop.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_EVENT_LOOP_H_
+#define EXTERNAL_NET_EVENT_LOOP_H_
+
+#include "../../element.h"
+
+Element add_event_loop_class(VM *vm, Element module);
+
+#endif /* EXTERNAL_NET_EVENT_LOOP_H_ */
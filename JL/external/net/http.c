@@ -0,0 +1,481 @@
+/*
+ * http.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "http.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../arena/strings.h"
+#include "../../class.h"
+#include "../../datastructure/map.h"
+#include "../../datastructure/tuple.h"
+#include "../../element.h"
+#include "../../error.h"
+#include "../../memory/memory.h"
+#include "../../memory/memory_graph.h"
+#include "../external.h"
+#include "../strings.h"
+#include "impl/http_parser.h"
+#include "impl/socket.h"
+
+// Header or query fields of one request. Spans index into the $raw String and
+// Strings are only made for the fields which are looked at.
+typedef struct {
+  HttpField *fields;
+  uint32_t num_fields;
+  bool case_insensitive;
+} HttpFields;
+
+typedef struct {
+  uint32_t next;
+} HttpFieldsCursor;
+
+Element class_httpfields;
+Element class_httpfields_iterator;
+
+HttpFields *http_fields_state(ExternalData *data) {
+  HttpFields *fields = map_lookup(&data->state, strings_intern("fields"));
+  ASSERT(NOT_NULL(fields));
+  return fields;
+}
+
+ExternalData *http_fields_raw(ExternalData *data) {
+  return obj_get_field(data->object, strings_intern("$raw")).obj->external_data;
+}
+
+Element http_fields_string(VM *vm, ExternalData *data, HttpSpan span) {
+  return string_slice(vm, http_fields_raw(data), span.start, span.len);
+}
+
+// Index of the first field named name, or -1.
+int32_t http_fields_find(ExternalData *data, Element name) {
+  if (!ISTYPE(name, class_string)) {
+    return -1;
+  }
+  HttpFields *fields = http_fields_state(data);
+  String *key = String_extract(name);
+  const char *raw = String_cstr(String_extract(
+      obj_get_field(data->object, strings_intern("$raw"))));
+  uint32_t key_len = String_size(key);
+  int i;
+  for (i = 0; i < fields->num_fields; ++i) {
+    HttpSpan span = fields->fields[i].name;
+    if (span.len != key_len) {
+      continue;
+    }
+    if (fields->case_insensitive
+            ? 0 == strncasecmp(raw + span.start, String_cstr(key), key_len)
+            : 0 == strncmp(raw + span.start, String_cstr(key), key_len)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+Element http_fields_create(VM *vm, Element raw, uint32_t raw_start,
+                           const HttpFieldList *list, bool case_insensitive) {
+  Element obj = create_external_obj(vm, class_httpfields);
+  HttpFields *fields = ALLOC2(HttpFields);
+  fields->num_fields = list->num_fields;
+  fields->case_insensitive = case_insensitive;
+  fields->fields = ALLOC_ARRAY2(HttpField, max(list->num_fields, 1));
+  int i;
+  for (i = 0; i < list->num_fields; ++i) {
+    fields->fields[i] = list->fields[i];
+    fields->fields[i].name.start -= raw_start;
+    fields->fields[i].value.start -= raw_start;
+  }
+  map_insert(&obj.obj->external_data->state, strings_intern("fields"), fields);
+  memory_graph_set_field(vm->graph, obj, strings_intern("$raw"), raw);
+  Element len = create_int(list->num_fields);
+  memory_graph_set_field_ptr(vm->graph, obj.obj, LENGTH_KEY, &len);
+  return obj;
+}
+
+Element HttpFields_constructor(VM *vm, Thread *t, ExternalData *data,
+                               Element *arg) {
+  return throw_error(vm, t, "HttpFields are made by HttpParser.");
+}
+
+Element HttpFields_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                 Element *arg) {
+  HttpFields *fields = map_lookup(&data->state, strings_intern("fields"));
+  if (NULL != fields) {
+    DEALLOC(fields->fields);
+    DEALLOC(fields);
+  }
+  return create_none();
+}
+
+// The value of the first field named arg, or None.
+Element HttpFields_index(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  int32_t i = http_fields_find(data, *arg);
+  return i < 0 ? create_none()
+               : http_fields_string(vm, data,
+                                    http_fields_state(data)->fields[i].value);
+}
+
+Element HttpFields_in(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return http_fields_find(data, *arg) < 0 ? element_false(vm)
+                                          : element_true(vm);
+}
+
+Element HttpFields_keys(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  HttpFields *fields = http_fields_state(data);
+  Element keys = create_array(vm->graph);
+  int i;
+  for (i = 0; i < fields->num_fields; ++i) {
+    memory_graph_array_enqueue(
+        vm->graph, keys, http_fields_string(vm, data, fields->fields[i].name));
+  }
+  return keys;
+}
+
+Element HttpFields_iter(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Element iter = create_external_obj(vm, class_httpfields_iterator);
+  HttpFieldsCursor *cursor = ALLOC2(HttpFieldsCursor);
+  cursor->next = 0;
+  map_insert(&iter.obj->external_data->state, strings_intern("cursor"),
+             cursor);
+  memory_graph_set_field(vm->graph, iter, strings_intern("$fields"),
+                         data->object);
+  return iter;
+}
+
+Element HttpFieldsIterator_constructor(VM *vm, Thread *t, ExternalData *data,
+                                       Element *arg) {
+  return throw_error(vm, t, "Use iter() to iterate over HttpFields.");
+}
+
+Element HttpFieldsIterator_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                         Element *arg) {
+  HttpFieldsCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  if (NULL != cursor) {
+    DEALLOC(cursor);
+  }
+  return create_none();
+}
+
+ExternalData *http_fields_of_iterator(ExternalData *data) {
+  return obj_get_field(data->object, strings_intern("$fields"))
+      .obj->external_data;
+}
+
+Element HttpFieldsIterator_has_next(VM *vm, Thread *t, ExternalData *data,
+                                    Element *arg) {
+  HttpFieldsCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  ASSERT(NOT_NULL(cursor));
+  HttpFields *fields = http_fields_state(http_fields_of_iterator(data));
+  return cursor->next < fields->num_fields ? element_true(vm)
+                                           : element_false(vm);
+}
+
+// Gives (name, value).
+Element HttpFieldsIterator_next(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  HttpFieldsCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  ASSERT(NOT_NULL(cursor));
+  ExternalData *fields_data = http_fields_of_iterator(data);
+  HttpFields *fields = http_fields_state(fields_data);
+  if (cursor->next >= fields->num_fields) {
+    return throw_error(vm, t, "Iterated past the end.");
+  }
+  HttpField *field = &fields->fields[cursor->next++];
+  Element pair = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, pair,
+                         http_fields_string(vm, fields_data, field->name));
+  memory_graph_tuple_add(vm->graph, pair,
+                         http_fields_string(vm, fields_data, field->value));
+  return pair;
+}
+
+HttpParser *http_parser_state(ExternalData *data) {
+  HttpParser *parser = map_lookup(&data->state, strings_intern("parser"));
+  ASSERT(NOT_NULL(parser));
+  return parser;
+}
+
+Element HttpParser_constructor(VM *vm, Thread *t, ExternalData *data,
+                               Element *arg) {
+  HttpParser *parser = ALLOC2(HttpParser);
+  http_parser_init(parser);
+  map_insert(&data->state, strings_intern("parser"), parser);
+  return data->object;
+}
+
+Element HttpParser_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                 Element *arg) {
+  HttpParser *parser = map_lookup(&data->state, strings_intern("parser"));
+  if (NULL != parser) {
+    http_parser_finalize(parser);
+    DEALLOC(parser);
+  }
+  return create_none();
+}
+
+// (method, path, params, protocol, version, headers, body, keep_alive) for the
+// request the parser just finished. Only the head is copied; everything but the body
+// shares its chars.
+Element http_request_parts(VM *vm, HttpParser *parser) {
+  uint32_t start = parser->head_start;
+  Element raw = string_create_len(vm, parser->buf + start,
+                                  parser->head_end - start);
+  ExternalData *raw_data = raw.obj->external_data;
+  Element parts = create_tuple(vm->graph);
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      string_slice(vm, raw_data, parser->method.start - start,
+                   parser->method.len));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      string_slice(vm, raw_data, parser->path.start - start,
+                   parser->path.len));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      http_fields_create(vm, raw, start, &parser->params,
+                         /*case_insensitive=*/false));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      string_slice(vm, raw_data, parser->protocol.start - start,
+                   parser->protocol.len));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      string_slice(vm, raw_data, parser->version.start - start,
+                   parser->version.len));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      http_fields_create(vm, raw, start, &parser->headers,
+                         /*case_insensitive=*/true));
+  memory_graph_tuple_add(
+      vm->graph, parts,
+      string_create_len(vm, parser->buf + parser->head_end,
+                        parser->body_end - parser->head_end));
+  memory_graph_tuple_add(vm->graph, parts,
+                         http_parser_keep_alive(parser) ? element_true(vm)
+                                                        : element_false(vm));
+  return parts;
+}
+
+// feed(text): Consumes the next bytes of a connection. Returns the parts of
+// the next complete request, or None if more bytes are needed. Bytes past the
+// request are kept, so feed('') gives the next pipelined request.
+Element HttpParser_feed(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "HttpParser.feed() expects a String.");
+  }
+  HttpParser *parser = http_parser_state(data);
+  String *text = String_extract(*arg);
+  HttpParseStatus status =
+      http_parser_feed(parser, String_cstr(text), String_size(text));
+  if (HTTP_PARSE_ERROR == status) {
+    return throw_error(vm, t, parser->error);
+  }
+  if (HTTP_PARSE_INCOMPLETE == status) {
+    return create_none();
+  }
+  Element parts = http_request_parts(vm, parser);
+  // Any error in what follows is reported by the next feed().
+  http_parser_next(parser);
+  return parts;
+}
+
+// Whether the header line [start, end) of text is named name.
+bool is_header(const char *text, uint32_t start, uint32_t end,
+               const char name[]) {
+  uint32_t len = strlen(name);
+  return end - start > len && ':' == text[start + len] &&
+         0 == strncasecmp(text + start, name, len);
+}
+
+bool header_value_is(const char *text, uint32_t start, uint32_t end,
+                     const char value[]) {
+  while (start < end && (':' == text[start] || ' ' == text[start])) {
+    start++;
+  }
+  while (end > start && ' ' == text[end - 1]) {
+    end--;
+  }
+  return strlen(value) == end - start &&
+         0 == strncasecmp(text + start, value, end - start);
+}
+
+// The size of a FileBody part, or -1 if part is not one.
+int64_t file_body_size(Element part) {
+  if (OBJECT != part.type ||
+      !ISTYPE(obj_get_field(part, strings_intern("path")), class_string)) {
+    return -1;
+  }
+  Element size = obj_get_field(part, strings_intern("size"));
+  if (!is_value_type(&size, INT)) {
+    return -1;
+  }
+  return size.val.int_val;
+}
+
+// file_size__(path): Bytes in the regular file at path, or None if it cannot
+// be read.
+Element http_file_size(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "file_size__ expects a path.");
+  }
+  int64_t size;
+  String *path_str = String_extract(*arg);
+  int file_fd = socket_file_open(String_cstr(path_str), String_size(path_str),
+                                 &size);
+  if (file_fd < 0) {
+    return create_none();
+  }
+  socket_file_close(file_fd);
+  return create_int(size);
+}
+
+// frame_response__(parts, keep_alive): Adds the Content-Length and Connection
+// headers a persistent connection needs, unless the response already has
+// them. Parts are Strings or FileBodys. Only the parts up to the end of the
+// head are copied; the rest are passed through so they can be written with
+// one writev or sendfile. Gives (parts, keep_alive), where keep_alive is False
+// if the response cannot be delimited or asks for the connection to be closed.
+Element http_frame_response(VM *vm, Thread *t, ExternalData *data,
+                            Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "frame_response__ expects (parts, keep_alive).");
+  }
+  Element parts = tuple_get(arg->obj->tuple, 0);
+  bool keep_alive = NONE != tuple_get(arg->obj->tuple, 1).type;
+  bool single = ISTYPE(parts, class_string);
+  int32_t i, num_parts = single ? 1 : sequence_size(&parts);
+  // Joins parts until the head is complete.
+  String *joined = String_create();
+  uint32_t head_end = 0, scanned = 0;
+  int64_t body_len = 0;
+  Element framed = create_array(vm->graph);
+  for (i = 0; i < num_parts; ++i) {
+    Element part = single ? parts : sequence_get(&parts, i);
+    if (ISTYPE(part, class_string)) {
+      String *str = String_extract(part);
+      if (head_end > 0) {
+        body_len += String_size(str);
+        memory_graph_array_enqueue(vm->graph, framed, part);
+        continue;
+      }
+      String_append_cstr(joined, String_cstr(str), String_size(str));
+      const char *text = String_cstr(joined);
+      uint32_t len = String_size(joined);
+      // Picks up where the last part left off, as the terminator may
+      // straddle parts.
+      for (; scanned + 3 < len; ++scanned) {
+        if (0 == memcmp(text + scanned, "\r\n\r\n", 4)) {
+          head_end = scanned + 4;
+          break;
+        }
+      }
+      continue;
+    }
+    int64_t file_len = file_body_size(part);
+    if (file_len < 0) {
+      String_delete(joined);
+      return throw_error(vm, t, "Cannot send non-string.");
+    }
+    if (0 == head_end) {
+      // A file before the end of the head cannot be framed.
+      break;
+    }
+    body_len += file_len;
+    memory_graph_array_enqueue(vm->graph, framed, part);
+  }
+  Element result = create_tuple(vm->graph);
+  if (0 == head_end) {
+    // Not a response this can frame, so sent as it came.
+    String_delete(joined);
+    memory_graph_tuple_add(vm->graph, result, parts);
+    memory_graph_tuple_add(vm->graph, result, element_false(vm));
+    return result;
+  }
+  const char *text = String_cstr(joined);
+  uint32_t len = String_size(joined);
+  body_len += len - head_end;
+  // 1xx, 204 and 304 responses never have a body.
+  const char *space = memchr(text, ' ', head_end);
+  bool no_body = NULL != space && space + 3 < text + head_end &&
+                 ('1' == space[1] || 0 == strncmp(space + 1, "204", 3) ||
+                  0 == strncmp(space + 1, "304", 3));
+  bool has_length = false, has_connection = false;
+  uint32_t start = (const char *)memchr(text, '\n', head_end) - text + 1;
+  while (start + 2 < head_end) {
+    uint32_t end = (const char *)memchr(text + start, '\n', head_end - start) -
+                   text - 1;
+    if (is_header(text, start, end, "Content-Length") ||
+        is_header(text, start, end, "Transfer-Encoding")) {
+      has_length = true;
+    } else if (is_header(text, start, end, "Connection")) {
+      has_connection = true;
+      if (header_value_is(text, start + strlen("Connection"), end, "close")) {
+        keep_alive = false;
+      }
+    }
+    start = end + 2;
+  }
+  String *head = String_create();
+  // Everything but the blank line ending the head.
+  String_append_cstr(head, text, head_end - 2);
+  char header[64];
+  if (!has_length && !no_body) {
+    int header_len = snprintf(header, sizeof(header),
+                              "Content-Length: %lld\r\n", (long long)body_len);
+    String_append_cstr(head, header, header_len);
+  }
+  if (!has_connection) {
+    const char *connection = keep_alive ? "Connection: keep-alive\r\n"
+                                        : "Connection: close\r\n";
+    String_append_cstr(head, connection, strlen(connection));
+  }
+  String_append_cstr(head, "\r\n", 2);
+  // The rest of the part which ended the head.
+  String_append_cstr(head, text + head_end, len - head_end);
+  String_delete(joined);
+  Element head_elt = string_adopt(vm, head);
+  // Pushed to the front.
+  memory_graph_array_push(vm->graph, framed.obj, &head_elt);
+  memory_graph_tuple_add(vm->graph, result, framed);
+  memory_graph_tuple_add(vm->graph, result,
+                         keep_alive ? element_true(vm) : element_false(vm));
+  return result;
+}
+
+Element add_http_classes(VM *vm, Element module) {
+  add_external_function(vm, module, strings_intern("frame_response__"),
+                        http_frame_response);
+  add_external_function(vm, module, strings_intern("file_size__"),
+                        http_file_size);
+
+  class_httpfields =
+      create_external_class(vm, module, strings_intern("HttpFields"),
+                            HttpFields_constructor, HttpFields_deconstructor);
+  add_external_method(vm, class_httpfields, ARRAYLIKE_INDEX_KEY,
+                      HttpFields_index);
+  add_external_method(vm, class_httpfields, IN_FN_NAME, HttpFields_in);
+  add_external_method(vm, class_httpfields, strings_intern("keys"),
+                      HttpFields_keys);
+  add_external_method(vm, class_httpfields, ITER_FN_NAME, HttpFields_iter);
+
+  class_httpfields_iterator = create_external_class(
+      vm, module, strings_intern("HttpFieldsIterator__"),
+      HttpFieldsIterator_constructor, HttpFieldsIterator_deconstructor);
+  add_external_method(vm, class_httpfields_iterator, HAS_NEXT_FN_NAME,
+                      HttpFieldsIterator_has_next);
+  add_external_method(vm, class_httpfields_iterator, NEXT_FN_NAME,
+                      HttpFieldsIterator_next);
+
+  Element parser =
+      create_external_class(vm, module, strings_intern("HttpParser"),
+                            HttpParser_constructor, HttpParser_deconstructor);
+  add_external_method(vm, parser, strings_intern("feed"), HttpParser_feed);
+  return parser;
+}
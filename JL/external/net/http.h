@@ -0,0 +1,24 @@
+/*
+ * http.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_HTTP_H_
+#define EXTERNAL_NET_HTTP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../element.h"
+#include "impl/http_parser.h"
+
+// Wraps list, whose spans are offsets into raw's chars from raw_start, in an
+// HttpFields.
+Element http_fields_create(VM *vm, Element raw, uint32_t raw_start,
+                           const HttpFieldList *list, bool case_insensitive);
+
+Element add_http_classes(VM *vm, Element module);
+
+#endif /* EXTERNAL_NET_HTTP_H_ */
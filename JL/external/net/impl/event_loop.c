@@ -0,0 +1,155 @@
+/*
+ * event_loop.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "event_loop.h"
+
+#include <stddef.h>
+
+#include "../../../memory/memory.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+struct EventLoop_ {
+  int epoll_fd;
+  // Written to by event_loop_wakeup().
+  int wake_fd;
+};
+
+uint32_t to_epoll_events(int events) {
+  uint32_t epoll_events = EPOLLRDHUP;
+  if (events & EVENT_READABLE) {
+    epoll_events |= EPOLLIN;
+  }
+  if (events & EVENT_WRITABLE) {
+    epoll_events |= EPOLLOUT;
+  }
+#ifdef EPOLLEXCLUSIVE
+  if (events & EVENT_EXCLUSIVE) {
+    epoll_events |= EPOLLEXCLUSIVE;
+  }
+#endif
+  return epoll_events;
+}
+
+int from_epoll_events(uint32_t epoll_events) {
+  int events = 0;
+  if (epoll_events & EPOLLIN) {
+    events |= EVENT_READABLE;
+  }
+  if (epoll_events & EPOLLOUT) {
+    events |= EVENT_WRITABLE;
+  }
+  if (epoll_events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+    events |= EVENT_CLOSED;
+  }
+  return events;
+}
+
+bool event_loop_ctl(EventLoop *loop, int op, int fd, int events) {
+  struct epoll_event event = {0};
+  event.events = to_epoll_events(events);
+  event.data.fd = fd;
+  return 0 == epoll_ctl(loop->epoll_fd, op, fd, &event);
+}
+
+EventLoop *event_loop_create() {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    return NULL;
+  }
+  int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    close(epoll_fd);
+    return NULL;
+  }
+  EventLoop *loop = ALLOC2(EventLoop);
+  loop->epoll_fd = epoll_fd;
+  loop->wake_fd = wake_fd;
+  if (!event_loop_ctl(loop, EPOLL_CTL_ADD, wake_fd, EVENT_READABLE)) {
+    event_loop_delete(loop);
+    return NULL;
+  }
+  return loop;
+}
+
+void event_loop_delete(EventLoop *loop) {
+  close(loop->wake_fd);
+  close(loop->epoll_fd);
+  DEALLOC(loop);
+}
+
+bool event_loop_add(EventLoop *loop, int fd, int events) {
+  return event_loop_ctl(loop, EPOLL_CTL_ADD, fd, events);
+}
+
+bool event_loop_modify(EventLoop *loop, int fd, int events) {
+  // EPOLLEXCLUSIVE may not be given to EPOLL_CTL_MOD.
+  return event_loop_ctl(loop, EPOLL_CTL_MOD, fd, events & ~EVENT_EXCLUSIVE);
+}
+
+bool event_loop_remove(EventLoop *loop, int fd) {
+  return 0 == epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int event_loop_wait(EventLoop *loop, Event *events, int timeout_ms) {
+  struct epoll_event epoll_events[EVENT_LOOP_MAX_EVENTS];
+  int num_ready;
+  do {
+    num_ready = epoll_wait(loop->epoll_fd, epoll_events, EVENT_LOOP_MAX_EVENTS,
+                           timeout_ms);
+  } while (num_ready < 0 && EINTR == errno);
+  if (num_ready < 0) {
+    return -1;
+  }
+  int i, num_events = 0;
+  for (i = 0; i < num_ready; ++i) {
+    if (epoll_events[i].data.fd == loop->wake_fd) {
+      uint64_t count;
+      while (read(loop->wake_fd, &count, sizeof(count)) > 0)
+        ;
+      continue;
+    }
+    events[num_events].fd = epoll_events[i].data.fd;
+    events[num_events].events = from_epoll_events(epoll_events[i].events);
+    num_events++;
+  }
+  return num_events;
+}
+
+void event_loop_wakeup(EventLoop *loop) {
+  uint64_t one = 1;
+  if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+    // Already pending; the loop will wake anyway.
+  }
+}
+
+int64_t event_loop_now_msec() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+#else
+
+EventLoop *event_loop_create() { return NULL; }
+void event_loop_delete(EventLoop *loop) {}
+bool event_loop_add(EventLoop *loop, int fd, int events) { return false; }
+bool event_loop_modify(EventLoop *loop, int fd, int events) { return false; }
+bool event_loop_remove(EventLoop *loop, int fd) { return false; }
+int event_loop_wait(EventLoop *loop, Event *events, int timeout_ms) {
+  return -1;
+}
+void event_loop_wakeup(EventLoop *loop) {}
+int64_t event_loop_now_msec() { return 0; }
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * event_loop.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_IMPL_EVENT_LOOP_H_
+#define EXTERNAL_NET_IMPL_EVENT_LOOP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Readiness notification for non-blocking sockets. Backed by epoll; on other
+// platforms event_loop_create() returns NULL.
+
+#define EVENT_READABLE 1
+#define EVENT_WRITABLE 2
+// The peer hung up or the socket errored.
+#define EVENT_CLOSED 4
+// Only wake one of the loops watching this fd. For listening sockets shared by
+// several loops.
+#define EVENT_EXCLUSIVE 8
+
+#define EVENT_LOOP_MAX_EVENTS 256
+
+typedef struct EventLoop_ EventLoop;
+
+typedef struct {
+  int fd;
+  int events;
+} Event;
+
+EventLoop *event_loop_create();
+void event_loop_delete(EventLoop *loop);
+
+bool event_loop_add(EventLoop *loop, int fd, int events);
+bool event_loop_modify(EventLoop *loop, int fd, int events);
+bool event_loop_remove(EventLoop *loop, int fd);
+
+// Blocks until at least one fd is ready, timeout_ms passes (-1 to wait
+// forever) or event_loop_wakeup() is called. Fills at most
+// EVENT_LOOP_MAX_EVENTS events and returns how many, or -1 on error.
+int event_loop_wait(EventLoop *loop, Event *events, int timeout_ms);
+
+// Interrupts event_loop_wait() from another thread.
+void event_loop_wakeup(EventLoop *loop);
+
+// Milliseconds on a clock which never goes backwards.
+int64_t event_loop_now_msec();
+
+#endif /* EXTERNAL_NET_IMPL_EVENT_LOOP_H_ */
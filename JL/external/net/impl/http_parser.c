@@ -0,0 +1,436 @@
+/*
+ * http_parser.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "http_parser.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../../memory/memory.h"
+
+#define HTTP_DEFAULT_BUFFER_SIZE 4096
+#define HTTP_DEFAULT_FIELDS 16
+#define HTTP_MAX_CHUNK_LINE 1024
+
+HttpSpan span_of(uint32_t start, uint32_t end) {
+  HttpSpan span = {start, end - start};
+  return span;
+}
+
+void field_list_init(HttpFieldList *list) {
+  list->fields = ALLOC_ARRAY2(HttpField, HTTP_DEFAULT_FIELDS);
+  list->num_fields = 0;
+  list->cap = HTTP_DEFAULT_FIELDS;
+}
+
+void field_list_add(HttpFieldList *list, HttpSpan name, HttpSpan value) {
+  if (list->num_fields == list->cap) {
+    list->cap *= 2;
+    list->fields = REALLOC(list->fields, HttpField, list->cap);
+  }
+  list->fields[list->num_fields].name = name;
+  list->fields[list->num_fields].value = value;
+  list->num_fields++;
+}
+
+void http_parser_reset(HttpParser *parser) {
+  parser->state = HTTP_HEAD;
+  parser->scan = parser->pos;
+  parser->remaining = 0;
+  parser->error = NULL;
+  parser->headers.num_fields = 0;
+  parser->params.num_fields = 0;
+  parser->head_start = parser->head_end = parser->body_end = parser->pos;
+}
+
+void http_parser_init(HttpParser *parser) {
+  parser->buf = ALLOC_ARRAY2(char, HTTP_DEFAULT_BUFFER_SIZE);
+  parser->len = parser->pos = 0;
+  parser->cap = HTTP_DEFAULT_BUFFER_SIZE;
+  field_list_init(&parser->headers);
+  field_list_init(&parser->params);
+  http_parser_reset(parser);
+}
+
+void http_parser_finalize(HttpParser *parser) {
+  DEALLOC(parser->buf);
+  DEALLOC(parser->headers.fields);
+  DEALLOC(parser->params.fields);
+}
+
+HttpParseStatus http_error(HttpParser *parser, const char *error) {
+  parser->error = error;
+  return HTTP_PARSE_ERROR;
+}
+
+bool span_equals_ci(const HttpParser *parser, HttpSpan span,
+                    const char str[]) {
+  return strlen(str) == span.len &&
+         0 == strncasecmp(parser->buf + span.start, str, span.len);
+}
+
+const HttpField *http_parser_header(const HttpParser *parser,
+                                    const char name[]) {
+  int i;
+  for (i = 0; i < parser->headers.num_fields; ++i) {
+    if (span_equals_ci(parser, parser->headers.fields[i].name, name)) {
+      return &parser->headers.fields[i];
+    }
+  }
+  return NULL;
+}
+
+HttpSpan trim(const HttpParser *parser, uint32_t start, uint32_t end) {
+  while (start < end &&
+         (' ' == parser->buf[start] || '\t' == parser->buf[start])) {
+    start++;
+  }
+  while (end > start &&
+         (' ' == parser->buf[end - 1] || '\t' == parser->buf[end - 1])) {
+    end--;
+  }
+  return span_of(start, end);
+}
+
+// Whether the comma-separated list in span contains token.
+bool span_has_token(const HttpParser *parser, HttpSpan span,
+                    const char token[]) {
+  uint32_t i = span.start, end = span.start + span.len;
+  while (i < end) {
+    uint32_t comma = i;
+    while (comma < end && ',' != parser->buf[comma]) {
+      comma++;
+    }
+    if (span_equals_ci(parser, trim(parser, i, comma), token)) {
+      return true;
+    }
+    i = comma + 1;
+  }
+  return false;
+}
+
+bool http_parser_keep_alive(const HttpParser *parser) {
+  const HttpField *connection = http_parser_header(parser, "Connection");
+  if (NULL != connection && span_has_token(parser, connection->value, "close")) {
+    return false;
+  }
+  if (span_equals_ci(parser, parser->version, "1.0")) {
+    return NULL != connection &&
+           span_has_token(parser, connection->value, "keep-alive");
+  }
+  return true;
+}
+
+// Index of the next '\n' in [from, to), or to if there is none.
+uint32_t find_newline(const HttpParser *parser, uint32_t from, uint32_t to) {
+  const char *nl = memchr(parser->buf + from, '\n', to - from);
+  return NULL == nl ? to : nl - parser->buf;
+}
+
+// End of a line ending at the '\n' at nl, without the '\r' if there is one.
+uint32_t line_end(const HttpParser *parser, uint32_t start, uint32_t nl) {
+  return (nl > start && '\r' == parser->buf[nl - 1]) ? nl - 1 : nl;
+}
+
+void parse_params(HttpParser *parser) {
+  uint32_t i = parser->query.start,
+           end = parser->query.start + parser->query.len;
+  while (i < end) {
+    uint32_t param_end = i;
+    while (param_end < end && '&' != parser->buf[param_end]) {
+      param_end++;
+    }
+    uint32_t eq = i;
+    while (eq < param_end && '=' != parser->buf[eq]) {
+      eq++;
+    }
+    if (param_end > i) {
+      field_list_add(&parser->params, span_of(i, eq),
+                     span_of(eq < param_end ? eq + 1 : param_end, param_end));
+    }
+    i = param_end + 1;
+  }
+}
+
+// Parses "METHOD target PROTOCOL/VERSION".
+bool parse_request_line(HttpParser *parser, uint32_t start, uint32_t end) {
+  uint32_t sp1 = start;
+  while (sp1 < end && ' ' != parser->buf[sp1]) {
+    sp1++;
+  }
+  uint32_t sp2 = sp1 + 1;
+  while (sp2 < end && ' ' != parser->buf[sp2]) {
+    sp2++;
+  }
+  if (sp1 == start || sp2 >= end || sp2 == sp1 + 1) {
+    return false;
+  }
+  parser->method = span_of(start, sp1);
+  uint32_t q = sp1 + 1;
+  while (q < sp2 && '?' != parser->buf[q]) {
+    q++;
+  }
+  parser->path = span_of(sp1 + 1, q);
+  parser->query = span_of(q < sp2 ? q + 1 : sp2, sp2);
+  uint32_t slash = sp2 + 1;
+  while (slash < end && '/' != parser->buf[slash]) {
+    slash++;
+  }
+  if (slash >= end) {
+    return false;
+  }
+  parser->protocol = span_of(sp2 + 1, slash);
+  parser->version = span_of(slash + 1, end);
+  parse_params(parser);
+  return true;
+}
+
+// Sets up body parsing from the headers.
+HttpParseStatus start_body(HttpParser *parser) {
+  const HttpField *encoding = http_parser_header(parser, "Transfer-Encoding");
+  if (NULL != encoding) {
+    if (!span_equals_ci(parser, encoding->value, "chunked")) {
+      return http_error(parser, "Unsupported Transfer-Encoding.");
+    }
+    parser->state = HTTP_CHUNK_SIZE;
+    return HTTP_PARSE_INCOMPLETE;
+  }
+  const HttpField *length = http_parser_header(parser, "Content-Length");
+  if (NULL == length) {
+    parser->state = HTTP_DONE;
+    return HTTP_PARSE_DONE;
+  }
+  uint64_t content_length = 0;
+  int i;
+  for (i = 0; i < length->value.len; ++i) {
+    char c = parser->buf[length->value.start + i];
+    if (c < '0' || c > '9') {
+      return http_error(parser, "Invalid Content-Length.");
+    }
+    content_length = content_length * 10 + (c - '0');
+    if (content_length > HTTP_MAX_BODY_SIZE) {
+      return http_error(parser, "Request body too large.");
+    }
+  }
+  if (0 == length->value.len) {
+    return http_error(parser, "Invalid Content-Length.");
+  }
+  parser->remaining = content_length;
+  parser->state = content_length > 0 ? HTTP_BODY : HTTP_DONE;
+  return content_length > 0 ? HTTP_PARSE_INCOMPLETE : HTTP_PARSE_DONE;
+}
+
+HttpParseStatus parse_head(HttpParser *parser) {
+  // Blank lines may precede a request, e.g. after a pipelined body.
+  while (parser->pos < parser->len && ('\r' == parser->buf[parser->pos] ||
+                                       '\n' == parser->buf[parser->pos])) {
+    parser->pos++;
+  }
+  parser->scan = max(parser->scan, parser->pos);
+  uint32_t end = 0;
+  while (0 == end) {
+    uint32_t nl = find_newline(parser, parser->scan, parser->len);
+    if (nl == parser->len) {
+      parser->scan = parser->len;
+      break;
+    }
+    uint32_t next = nl + 1;
+    if (next < parser->len && '\r' == parser->buf[next]) {
+      next++;
+    }
+    if (next >= parser->len) {
+      // Cannot yet tell whether the next line is the blank one.
+      parser->scan = nl;
+      break;
+    }
+    if ('\n' == parser->buf[next]) {
+      end = next + 1;
+    } else {
+      parser->scan = nl + 1;
+    }
+  }
+  if (0 == end) {
+    if (parser->len - parser->pos > HTTP_MAX_HEAD_SIZE) {
+      return http_error(parser, "Request head too large.");
+    }
+    return HTTP_PARSE_INCOMPLETE;
+  }
+  parser->head_start = parser->pos;
+  parser->head_end = parser->body_end = end;
+  uint32_t start = parser->pos;
+  uint32_t nl = find_newline(parser, start, end);
+  if (!parse_request_line(parser, start, line_end(parser, start, nl))) {
+    return http_error(parser, "Invalid request line.");
+  }
+  for (start = nl + 1; start < end; start = nl + 1) {
+    nl = find_newline(parser, start, end);
+    uint32_t stop = line_end(parser, start, nl);
+    if (stop == start) {
+      break;
+    }
+    if (' ' == parser->buf[start] || '\t' == parser->buf[start]) {
+      return http_error(parser, "Folded headers are not supported.");
+    }
+    uint32_t colon = start;
+    while (colon < stop && ':' != parser->buf[colon]) {
+      colon++;
+    }
+    if (colon == start || colon == stop) {
+      return http_error(parser, "Invalid header.");
+    }
+    field_list_add(&parser->headers, trim(parser, start, colon),
+                   trim(parser, colon + 1, stop));
+  }
+  parser->pos = end;
+  return start_body(parser);
+}
+
+HttpParseStatus parse_chunk_size(HttpParser *parser) {
+  uint32_t nl = find_newline(parser, parser->pos, parser->len);
+  if (nl == parser->len) {
+    return (parser->len - parser->pos > HTTP_MAX_CHUNK_LINE)
+               ? http_error(parser, "Invalid chunk size.")
+               : HTTP_PARSE_INCOMPLETE;
+  }
+  uint64_t size = 0;
+  uint32_t i;
+  for (i = parser->pos; i < nl; ++i) {
+    char c = parser->buf[i];
+    int digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      // Chunk extensions are ignored.
+      break;
+    }
+    size = size * 16 + digit;
+    if (size > HTTP_MAX_BODY_SIZE) {
+      return http_error(parser, "Request body too large.");
+    }
+  }
+  if (i == parser->pos) {
+    return http_error(parser, "Invalid chunk size.");
+  }
+  parser->pos = nl + 1;
+  parser->remaining = size;
+  parser->state = size > 0 ? HTTP_CHUNK_DATA : HTTP_TRAILER;
+  return HTTP_PARSE_INCOMPLETE;
+}
+
+HttpParseStatus http_parser_advance(HttpParser *parser) {
+  while (true) {
+    HttpParseStatus status = HTTP_PARSE_INCOMPLETE;
+    HttpState state = parser->state;
+    uint32_t pos = parser->pos;
+    uint32_t available = parser->len - parser->pos;
+    switch (parser->state) {
+      case HTTP_HEAD:
+        status = parse_head(parser);
+        break;
+      case HTTP_BODY:
+        if (available < parser->remaining) {
+          return HTTP_PARSE_INCOMPLETE;
+        }
+        parser->pos += parser->remaining;
+        parser->body_end = parser->pos;
+        parser->state = HTTP_DONE;
+        status = HTTP_PARSE_DONE;
+        break;
+      case HTTP_CHUNK_SIZE:
+        if (parser->pos == parser->len) {
+          return HTTP_PARSE_INCOMPLETE;
+        }
+        status = parse_chunk_size(parser);
+        break;
+      case HTTP_CHUNK_DATA:
+        if (available < parser->remaining) {
+          return HTTP_PARSE_INCOMPLETE;
+        }
+        if (parser->body_end - parser->head_end + parser->remaining >
+            HTTP_MAX_BODY_SIZE) {
+          return http_error(parser, "Request body too large.");
+        }
+        // Decoded bytes never outrun the encoded ones, so the body is packed
+        // in place after the head.
+        memmove(parser->buf + parser->body_end, parser->buf + parser->pos,
+                parser->remaining);
+        parser->body_end += parser->remaining;
+        parser->pos += parser->remaining;
+        parser->state = HTTP_CHUNK_END;
+        break;
+      case HTTP_CHUNK_END:
+        if (available < 1 ||
+            ('\r' == parser->buf[parser->pos] && available < 2)) {
+          return HTTP_PARSE_INCOMPLETE;
+        }
+        if ('\r' == parser->buf[parser->pos]) {
+          parser->pos++;
+        }
+        if ('\n' != parser->buf[parser->pos]) {
+          return http_error(parser, "Invalid chunk.");
+        }
+        parser->pos++;
+        parser->state = HTTP_CHUNK_SIZE;
+        break;
+      case HTTP_TRAILER: {
+        uint32_t nl = find_newline(parser, parser->pos, parser->len);
+        if (nl == parser->len) {
+          return (available > HTTP_MAX_HEAD_SIZE)
+                     ? http_error(parser, "Request trailer too large.")
+                     : HTTP_PARSE_INCOMPLETE;
+        }
+        bool blank = line_end(parser, parser->pos, nl) == parser->pos;
+        parser->pos = nl + 1;
+        if (blank) {
+          parser->state = HTTP_DONE;
+          status = HTTP_PARSE_DONE;
+        }
+        break;
+      }
+      case HTTP_DONE:
+        return HTTP_PARSE_DONE;
+    }
+    if (HTTP_PARSE_INCOMPLETE != status) {
+      return status;
+    }
+    if (state == parser->state && pos == parser->pos) {
+      return HTTP_PARSE_INCOMPLETE;
+    }
+  }
+}
+
+HttpParseStatus http_parser_feed(HttpParser *parser, const char *bytes,
+                                 uint32_t len) {
+  if (NULL != parser->error) {
+    return HTTP_PARSE_ERROR;
+  }
+  if (parser->len + len > parser->cap) {
+    parser->cap = max(parser->cap * 2, parser->len + len);
+    parser->buf = REALLOC(parser->buf, char, parser->cap);
+  }
+  memmove(parser->buf + parser->len, bytes, len);
+  parser->len += len;
+  return http_parser_advance(parser);
+}
+
+HttpParseStatus http_parser_next(HttpParser *parser) {
+  if (NULL != parser->error) {
+    return HTTP_PARSE_ERROR;
+  }
+  if (HTTP_DONE == parser->state) {
+    memmove(parser->buf, parser->buf + parser->pos, parser->len - parser->pos);
+    parser->len -= parser->pos;
+    parser->pos = 0;
+    http_parser_reset(parser);
+  }
+  return http_parser_advance(parser);
+}
@@ -0,0 +1,93 @@
+/*
+ * http_parser.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_IMPL_HTTP_PARSER_H_
+#define EXTERNAL_NET_IMPL_HTTP_PARSER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Incremental HTTP/1.x request parser. Bytes are fed as they arrive and may
+// split a request anywhere. Bodies framed by Content-Length or chunked
+// Transfer-Encoding are supported; chunked bodies are decoded in place.
+
+#define HTTP_MAX_HEAD_SIZE (64 * 1024)
+#define HTTP_MAX_BODY_SIZE (16 * 1024 * 1024)
+
+typedef enum {
+  HTTP_PARSE_INCOMPLETE,
+  HTTP_PARSE_DONE,
+  HTTP_PARSE_ERROR,
+} HttpParseStatus;
+
+typedef enum {
+  HTTP_HEAD,
+  HTTP_BODY,
+  HTTP_CHUNK_SIZE,
+  HTTP_CHUNK_DATA,
+  HTTP_CHUNK_END,
+  HTTP_TRAILER,
+  HTTP_DONE,
+} HttpState;
+
+// Offsets into HttpParser.buf.
+typedef struct {
+  uint32_t start, len;
+} HttpSpan;
+
+typedef struct {
+  HttpSpan name, value;
+} HttpField;
+
+typedef struct {
+  HttpField *fields;
+  uint32_t num_fields, cap;
+} HttpFieldList;
+
+// Once http_parser_feed() returns HTTP_PARSE_DONE, the spans describe the
+// request until http_parser_next() is called.
+typedef struct {
+  char *buf;
+  uint32_t len, cap;
+  // Where parsing resumes.
+  uint32_t pos;
+  // Where to resume looking for the end of the head.
+  uint32_t scan;
+  HttpState state;
+  uint64_t remaining;
+  const char *error;
+
+  uint32_t head_start, head_end;
+  HttpSpan method, path, query, protocol, version;
+  HttpFieldList headers;
+  HttpFieldList params;
+  // Starts at head_end.
+  uint32_t body_end;
+} HttpParser;
+
+void http_parser_init(HttpParser *parser);
+void http_parser_finalize(HttpParser *parser);
+
+// Appends bytes and parses as far as they allow. On HTTP_PARSE_ERROR,
+// parser->error says why and the parser should be discarded.
+HttpParseStatus http_parser_feed(HttpParser *parser, const char *bytes,
+                                 uint32_t len);
+
+// Discards the parsed request and parses any bytes after it, e.g. a pipelined
+// request.
+HttpParseStatus http_parser_next(HttpParser *parser);
+
+// Case-insensitive lookup of a header. NULL if absent.
+const HttpField *http_parser_header(const HttpParser *parser,
+                                    const char name[]);
+
+// Whether the client wants the connection kept open after this request.
+// HTTP/1.1 defaults to yes and HTTP/1.0 to no, unless Connection says
+// otherwise.
+bool http_parser_keep_alive(const HttpParser *parser);
+
+#endif /* EXTERNAL_NET_IMPL_HTTP_PARSER_H_ */
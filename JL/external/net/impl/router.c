@@ -0,0 +1,223 @@
+/*
+ * router.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "router.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../../memory/memory.h"
+
+struct RouteNode_ {
+  // The static chars leading here from the parent, or a parameter's name.
+  char *text;
+  uint32_t text_len;
+  // Static children, each starting with a different char.
+  RouteNode **children;
+  uint32_t num_children;
+  RouteNode *param, *catch_all;
+  // -1 for none.
+  int32_t route, prefix_route;
+};
+
+RouteNode *route_node_create(const char *text, uint32_t text_len) {
+  RouteNode *node = ALLOC2(RouteNode);
+  node->text = ALLOC_ARRAY2(char, max(text_len, 1));
+  memmove(node->text, text, text_len);
+  node->text_len = text_len;
+  node->children = NULL;
+  node->num_children = 0;
+  node->param = node->catch_all = NULL;
+  node->route = node->prefix_route = -1;
+  return node;
+}
+
+void route_node_delete(RouteNode *node) {
+  if (NULL == node) {
+    return;
+  }
+  int i;
+  for (i = 0; i < node->num_children; ++i) {
+    route_node_delete(node->children[i]);
+  }
+  if (NULL != node->children) {
+    DEALLOC(node->children);
+  }
+  route_node_delete(node->param);
+  route_node_delete(node->catch_all);
+  DEALLOC(node->text);
+  DEALLOC(node);
+}
+
+// The static child starting with c, or NULL.
+RouteNode *route_node_child(const RouteNode *node, char c) {
+  int i;
+  for (i = 0; i < node->num_children; ++i) {
+    if (c == node->children[i]->text[0]) {
+      return node->children[i];
+    }
+  }
+  return NULL;
+}
+
+void route_node_add_child(RouteNode *node, RouteNode *child) {
+  node->children =
+      REALLOC(node->children, RouteNode *, node->num_children + 1);
+  node->children[node->num_children++] = child;
+}
+
+// Follows or adds the static chars text from node. Returns the node they end
+// at, splitting an edge if they end partway along it.
+RouteNode *route_node_insert(RouteNode *node, const char *text,
+                             uint32_t text_len) {
+  while (text_len > 0) {
+    RouteNode *child = route_node_child(node, text[0]);
+    if (NULL == child) {
+      child = route_node_create(text, text_len);
+      route_node_add_child(node, child);
+      return child;
+    }
+    uint32_t common = 0;
+    while (common < text_len && common < child->text_len &&
+           text[common] == child->text[common]) {
+      common++;
+    }
+    if (common < child->text_len) {
+      RouteNode *split = route_node_create(child->text, common);
+      memmove(child->text, child->text + common, child->text_len - common);
+      child->text_len -= common;
+      route_node_add_child(split, child);
+      int i;
+      for (i = 0; node->children[i] != child; ++i) {
+      }
+      node->children[i] = split;
+      child = split;
+    }
+    node = child;
+    text += common;
+    text_len -= common;
+  }
+  return node;
+}
+
+void router_init(Router *router) { router->root = route_node_create("", 0); }
+
+void router_finalize(Router *router) { route_node_delete(router->root); }
+
+RouterStatus router_add(Router *router, const char *pattern, uint32_t len,
+                        bool prefix, int32_t *route) {
+  RouteNode *node = router->root;
+  uint32_t i = 0, num_params = 0;
+  while (i < len) {
+    uint32_t start = i;
+    while (i < len && ':' != pattern[i] && '*' != pattern[i]) {
+      i++;
+    }
+    node = route_node_insert(node, pattern + start, i - start);
+    if (i == len) {
+      break;
+    }
+    if (++num_params > ROUTER_MAX_CAPTURES) {
+      return ROUTER_BAD_PATTERN;
+    }
+    bool catch_all = '*' == pattern[i++];
+    const char *name = pattern + i;
+    while (i < len && '/' != pattern[i]) {
+      i++;
+    }
+    uint32_t name_len = pattern + i - name;
+    if (catch_all && i < len) {
+      return ROUTER_BAD_PATTERN;
+    }
+    RouteNode **child = catch_all ? &node->catch_all : &node->param;
+    if (NULL == *child) {
+      *child = route_node_create(name, name_len);
+    } else if ((*child)->text_len != name_len ||
+               0 != memcmp((*child)->text, name, name_len)) {
+      return ROUTER_CONFLICT;
+    }
+    node = *child;
+  }
+  int32_t *existing = prefix ? &node->prefix_route : &node->route;
+  if (*existing >= 0) {
+    *route = *existing;
+  } else {
+    *existing = *route;
+  }
+  return ROUTER_OK;
+}
+
+bool route_capture(RouteMatch *match, const RouteNode *node, uint32_t start,
+                   uint32_t len) {
+  if (match->num_captures == ROUTER_MAX_CAPTURES) {
+    return false;
+  }
+  RouteCapture *capture = &match->captures[match->num_captures++];
+  capture->name = node->text;
+  capture->name_len = node->text_len;
+  capture->start = start;
+  capture->len = len;
+  return true;
+}
+
+// Matches the rest of path from pos, which node has been reached at. Backs
+// out of a branch which does not lead to a route. Prefix routes passed on the
+// way are remembered in best.
+bool route_node_match(const RouteNode *node, const char *path, uint32_t len,
+                      uint32_t pos, RouteMatch *match, RouteMatch *best) {
+  if (node->prefix_route >= 0 && (best->route < 0 || pos >= best->rest)) {
+    *best = *match;
+    best->route = node->prefix_route;
+    best->rest = pos;
+  }
+  if (pos == len && node->route >= 0) {
+    match->route = node->route;
+    match->rest = len;
+    return true;
+  }
+  RouteNode *child = pos < len ? route_node_child(node, path[pos]) : NULL;
+  if (NULL != child && child->text_len <= len - pos &&
+      0 == memcmp(path + pos, child->text, child->text_len) &&
+      route_node_match(child, path, len, pos + child->text_len, match, best)) {
+    return true;
+  }
+  uint32_t num_captures = match->num_captures;
+  if (NULL != node->param && pos < len && '/' != path[pos]) {
+    const char *slash = memchr(path + pos, '/', len - pos);
+    uint32_t end = NULL == slash ? len : slash - path;
+    if (route_capture(match, node->param, pos, end - pos) &&
+        route_node_match(node->param, path, len, end, match, best)) {
+      return true;
+    }
+    match->num_captures = num_captures;
+  }
+  if (NULL != node->catch_all) {
+    int32_t route = node->catch_all->route >= 0 ? node->catch_all->route
+                                                : node->catch_all->prefix_route;
+    if (route_capture(match, node->catch_all, pos, len - pos)) {
+      match->route = route;
+      match->rest = len;
+      return true;
+    }
+    match->num_captures = num_captures;
+  }
+  return false;
+}
+
+void router_match(const Router *router, const char *path, uint32_t len,
+                  RouteMatch *match) {
+  RouteMatch best;
+  best.route = -1;
+  best.rest = 0;
+  best.num_captures = 0;
+  match->route = -1;
+  match->rest = 0;
+  match->num_captures = 0;
+  if (!route_node_match(router->root, path, len, 0, match, &best)) {
+    *match = best;
+  }
+}
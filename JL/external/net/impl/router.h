@@ -0,0 +1,64 @@
+/*
+ * router.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_IMPL_ROUTER_H_
+#define EXTERNAL_NET_IMPL_ROUTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Most parameters one route may capture.
+#define ROUTER_MAX_CAPTURES 16
+
+typedef enum {
+  ROUTER_OK,
+  // A '*' which is not last, or too many parameters.
+  ROUTER_BAD_PATTERN,
+  // A parameter named differently from another at the same position.
+  ROUTER_CONFLICT,
+} RouterStatus;
+
+typedef struct RouteNode_ RouteNode;
+
+// Paths in a radix tree. Static runs share nodes by common prefix, and ':name'
+// segments and a trailing '*name' capture parts of the path.
+typedef struct {
+  RouteNode *root;
+} Router;
+
+typedef struct {
+  const char *name;
+  uint32_t name_len;
+  // Span of the matched path.
+  uint32_t start, len;
+} RouteCapture;
+
+typedef struct {
+  // -1 if nothing matched.
+  int32_t route;
+  // Where the part of the path after a prefix route starts.
+  uint32_t rest;
+  uint32_t num_captures;
+  RouteCapture captures[ROUTER_MAX_CAPTURES];
+} RouteMatch;
+
+void router_init(Router *router);
+void router_finalize(Router *router);
+
+// Adds pattern as *route. A prefix route matches any path which starts with
+// pattern. If pattern was already added the same way, *route is set to the
+// id it has instead.
+RouterStatus router_add(Router *router, const char *pattern, uint32_t len,
+                        bool prefix, int32_t *route);
+
+// Finds the route for path. Static segments win over parameters, which win
+// over '*'. If no route matches all of path, the longest prefix route which
+// matches the start of it is used.
+void router_match(const Router *router, const char *path, uint32_t len,
+                  RouteMatch *match);
+
+#endif /* EXTERNAL_NET_IMPL_ROUTER_H_ */
@@ -7,30 +7,125 @@
 
 #include "socket.h"
 
+#include <stddef.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
 #include <windows.h>
 #include <winsock2.h>
 
 #undef max
 #undef min
 
+typedef SOCKET SocketFd;
+typedef int SockLen;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+typedef int SocketFd;
+typedef socklen_t SockLen;
+
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+// Makes call again if a signal interrupted it before it did anything.
+#ifdef _WIN32
+#define RETRY_EINTR(result, call) result = (call)
+#else
+#define RETRY_EINTR(result, call) \
+  do {                            \
+    result = (call);              \
+  } while (result < 0 && EINTR == errno)
+#endif
+
+// Buffers per writev call.
+#ifdef IOV_MAX
+#define MAX_SEND_BUFFERS IOV_MAX
+#else
+#define MAX_SEND_BUFFERS 64
+#endif
+#define FILE_CHUNK_SIZE (64 * 1024)
+
 #include "../../../memory/memory.h"
 
 struct Socket_ {
   struct sockaddr_in in;
-  SOCKET sock;
+  SocketFd sock;
 };
 
 struct SocketHandle_ {
   struct sockaddr_in client;
-  SOCKET client_sock;
+  SocketFd client_sock;
 };
 
+bool set_nonblocking(SocketFd sock) {
+#ifdef _WIN32
+  u_long mode = 1;
+  return 0 == ioctlsocket(sock, FIONBIO, &mode);
+#else
+  int flags = fcntl(sock, F_GETFL, 0);
+  return flags >= 0 && 0 == fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+// Blocks until sock is readable or writable. False on error.
+bool await_socket(SocketFd sock, bool writable) {
+  int ready;
+#ifdef _WIN32
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sock, &fds);
+  ready = writable ? select(0, NULL, &fds, NULL, NULL)
+                   : select(0, &fds, NULL, NULL, NULL);
+#else
+  struct pollfd poll_fd = {.fd = sock, .events = writable ? POLLOUT : POLLIN};
+  RETRY_EINTR(ready, poll(&poll_fd, 1, -1));
+#endif
+  return ready > 0;
+}
+
 void sockets_init() {
+#ifdef _WIN32
   WSADATA wsaData;
   WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+  // Writing to a peer which hung up should fail the send instead of killing
+  // the process.
+  signal(SIGPIPE, SIG_IGN);
+#endif
 }
 
-void sockets_cleanup() { WSACleanup(); }
+void sockets_cleanup() {
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+bool socket_would_block() {
+#ifdef _WIN32
+  return WSAEWOULDBLOCK == WSAGetLastError();
+#else
+  return EAGAIN == errno || EWOULDBLOCK == errno;
+#endif
+}
 
 Socket *socket_create(short namespace, ulong style, uint16_t port,
                       int protocol) {
@@ -39,6 +134,13 @@ Socket *socket_create(short namespace, ulong style, uint16_t port,
   sock->in.sin_addr.s_addr = htonl(INADDR_ANY);
   sock->in.sin_port = htons(port);
   sock->sock = socket(namespace, style, protocol);
+#ifndef _WIN32
+  // So a restarted server can bind while old connections sit in TIME_WAIT.
+  int reuse = 1;
+  if (INVALID_SOCKET != sock->sock) {
+    setsockopt(sock->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  }
+#endif
   return sock;
 }
 
@@ -54,15 +156,31 @@ SocketStatus socket_listen(Socket *socket, int num_connections) {
   return listen(socket->sock, num_connections);
 }
 
+bool socket_set_nonblocking(Socket *socket) {
+  return set_nonblocking(socket->sock);
+}
+
+int socket_get_fd(const Socket *socket) { return (int)socket->sock; }
+
+bool socket_await_connection(Socket *socket) {
+  return await_socket(socket->sock, /*writable=*/false);
+}
+
 SocketHandle *socket_accept(Socket *socket) {
   SocketHandle *sh = ALLOC2(SocketHandle);
-  int addr_len = sizeof(sh->client);
-  sh->client_sock =
-      accept(socket->sock, (struct sockaddr *)&sh->client, &addr_len);
+  SockLen addr_len = sizeof(sh->client);
+  RETRY_EINTR(sh->client_sock, accept(socket->sock,
+                                      (struct sockaddr *)&sh->client,
+                                      &addr_len));
   return sh;
 }
 
-void socket_close(Socket *socket) { closesocket(socket->sock); }
+void socket_close(Socket *socket) {
+  if (INVALID_SOCKET != socket->sock) {
+    closesocket(socket->sock);
+    socket->sock = INVALID_SOCKET;
+  }
+}
 
 void socket_delete(Socket *socket) { DEALLOC(socket); }
 
@@ -70,17 +188,207 @@ bool sockethandle_is_valid(const SocketHandle *sh) {
   return sh->client_sock != INVALID_SOCKET && sh->client_sock != -1;
 }
 
+bool sockethandle_set_nonblocking(SocketHandle *sh) {
+  return set_nonblocking(sh->client_sock);
+}
+
+bool sockethandle_set_receive_timeout(SocketHandle *sh, int timeout_msec) {
+#ifdef _WIN32
+  DWORD timeout = timeout_msec;
+#else
+  struct timeval timeout;
+  timeout.tv_sec = timeout_msec / 1000;
+  timeout.tv_usec = (timeout_msec % 1000) * 1000;
+#endif
+  return 0 == setsockopt(sh->client_sock, SOL_SOCKET, SO_RCVTIMEO,
+                         (const char *)&timeout, sizeof(timeout));
+}
+
 int32_t sockethandle_send(SocketHandle *sh, const char *const msg,
                           int msg_len) {
-  return send(sh->client_sock, msg, msg_len, 0);
+  int32_t sent;
+#ifdef MSG_NOSIGNAL
+  RETRY_EINTR(sent, send(sh->client_sock, msg, msg_len, MSG_NOSIGNAL));
+#else
+  RETRY_EINTR(sent, send(sh->client_sock, msg, msg_len, 0));
+#endif
+  return sent;
 }
 
 int32_t sockethandle_receive(SocketHandle *sh, char *buf, int buf_len) {
-  return recv(sh->client_sock, buf, buf_len, 0);
+  int32_t received;
+  RETRY_EINTR(received, recv(sh->client_sock, buf, buf_len, 0));
+  return received;
+}
+
+bool sockethandle_await_writable(SocketHandle *sh) {
+  return await_socket(sh->client_sock, /*writable=*/true);
 }
 
-SOCKET sockethandle_get_socket(SocketHandle *sh) { return sh->client_sock; }
+// Sends up to MAX_SEND_BUFFERS of bufs with one call.
+int64_t send_buffers(SocketHandle *sh, const SocketBuffer *bufs,
+                     int num_bufs) {
+#ifdef _WIN32
+  WSABUF wsa_bufs[MAX_SEND_BUFFERS];
+  int i;
+  for (i = 0; i < num_bufs; ++i) {
+    wsa_bufs[i].buf = (char *)bufs[i].data;
+    wsa_bufs[i].len = bufs[i].len;
+  }
+  DWORD sent;
+  if (0 != WSASend(sh->client_sock, wsa_bufs, num_bufs, &sent, 0, NULL, NULL)) {
+    return -1;
+  }
+  return sent;
+#else
+  struct iovec iov[MAX_SEND_BUFFERS];
+  int i;
+  for (i = 0; i < num_bufs; ++i) {
+    iov[i].iov_base = (void *)bufs[i].data;
+    iov[i].iov_len = bufs[i].len;
+  }
+  struct msghdr msg = {0};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = num_bufs;
+  ssize_t sent;
+#ifdef MSG_NOSIGNAL
+  RETRY_EINTR(sent, sendmsg(sh->client_sock, &msg, MSG_NOSIGNAL));
+#else
+  RETRY_EINTR(sent, sendmsg(sh->client_sock, &msg, 0));
+#endif
+  return sent;
+#endif
+}
+
+int64_t sockethandle_sendv(SocketHandle *sh, const SocketBuffer *bufs,
+                           int num_bufs) {
+  int64_t total = 0;
+  // How much of bufs[0] has gone.
+  uint32_t skip = 0;
+  while (num_bufs > 0) {
+    SocketBuffer batch[MAX_SEND_BUFFERS];
+    int i, batch_size = min(num_bufs, MAX_SEND_BUFFERS);
+    for (i = 0; i < batch_size; ++i) {
+      batch[i] = bufs[i];
+    }
+    batch[0].data += skip;
+    batch[0].len -= skip;
+    int64_t sent = send_buffers(sh, batch, batch_size);
+    if (sent < 0) {
+      return socket_would_block() ? total : -1;
+    }
+    total += sent;
+    // Partial writes leave off anywhere, even mid-buffer.
+    sent += skip;
+    while (num_bufs > 0 && sent >= bufs[0].len) {
+      sent -= bufs[0].len;
+      bufs++;
+      num_bufs--;
+    }
+    skip = sent;
+  }
+  return total;
+}
+
+int socket_file_open(const char path_chars[], size_t path_len,
+                     int64_t *size) {
+  // A NUL inside would open some other file.
+  if (NULL != memchr(path_chars, '\0', path_len)) {
+    return -1;
+  }
+  char *path = ALLOC_ARRAY2(char, path_len + 1);
+  memcpy(path, path_chars, path_len);
+  path[path_len] = '\0';
+#ifdef _WIN32
+  int file_fd = _open(path, _O_RDONLY | _O_BINARY);
+#else
+  int file_fd = open(path, O_RDONLY);
+#endif
+  DEALLOC(path);
+#ifdef _WIN32
+  struct _stat64 stat_buf;
+  if (file_fd >= 0 && 0 != _fstat64(file_fd, &stat_buf)) {
+#else
+  struct stat stat_buf;
+  if (file_fd >= 0 &&
+      (0 != fstat(file_fd, &stat_buf) || !S_ISREG(stat_buf.st_mode))) {
+#endif
+    socket_file_close(file_fd);
+    return -1;
+  }
+  if (file_fd >= 0) {
+    *size = stat_buf.st_size;
+  }
+  return file_fd;
+}
 
-void sockethandle_close(SocketHandle *sh) { closesocket(sh->client_sock); }
+void socket_file_close(int file_fd) {
+#ifdef _WIN32
+  _close(file_fd);
+#else
+  close(file_fd);
+#endif
+}
+
+int32_t socket_file_read(int file_fd, char *buf, int32_t len) {
+#ifdef _WIN32
+  return _read(file_fd, buf, len);
+#else
+  int32_t bytes_read;
+  RETRY_EINTR(bytes_read, read(file_fd, buf, len));
+  return bytes_read;
+#endif
+}
+
+int64_t sockethandle_send_file(SocketHandle *sh, int file_fd, int64_t *offset,
+                               int64_t len) {
+  int64_t total = 0;
+  while (total < len) {
+#ifdef __linux__
+    off_t file_offset = *offset;
+    ssize_t sent;
+    RETRY_EINTR(sent,
+                sendfile(sh->client_sock, file_fd, &file_offset, len - total));
+    if (0 == sent) {
+      // The file shrank.
+      return -1;
+    }
+#else
+    char chunk[FILE_CHUNK_SIZE];
+    int64_t chunk_len = min(len - total, FILE_CHUNK_SIZE);
+#ifdef _WIN32
+    _lseeki64(file_fd, *offset, SEEK_SET);
+    int chunk_read = _read(file_fd, chunk, (unsigned int)chunk_len);
+#else
+    lseek(file_fd, *offset, SEEK_SET);
+    ssize_t chunk_read;
+    RETRY_EINTR(chunk_read, read(file_fd, chunk, chunk_len));
+#endif
+    if (chunk_read <= 0) {
+      return -1;
+    }
+    int32_t sent = sockethandle_send(sh, chunk, chunk_read);
+#endif
+    if (sent < 0) {
+      return socket_would_block() ? total : -1;
+    }
+    *offset += sent;
+    total += sent;
+  }
+  return total;
+}
+
+unsigned int sockethandle_get_socket(SocketHandle *sh) {
+  return (unsigned int)sh->client_sock;
+}
+
+// Closing twice could close an unrelated socket which reused the number, so
+// the handle forgets it.
+void sockethandle_close(SocketHandle *sh) {
+  if (INVALID_SOCKET != sh->client_sock) {
+    closesocket(sh->client_sock);
+    sh->client_sock = INVALID_SOCKET;
+  }
+}
 
 void sockethandle_delete(SocketHandle *sh) { DEALLOC(sh); }
@@ -9,6 +9,7 @@
 #define EXTERNAL_NET_IMPL_SOCKET_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef unsigned long ulong;
@@ -20,10 +21,19 @@ typedef int SocketStatus;
 
 typedef struct SocketHandle_ SocketHandle;
 
+typedef struct {
+  const char *data;
+  uint32_t len;
+} SocketBuffer;
+
 void sockets_init();
 
 void sockets_cleanup();
 
+// Whether the last failed call on a non-blocking socket only failed because
+// it would have had to wait.
+bool socket_would_block();
+
 Socket *socket_create(short namespace, ulong style, uint16_t port,
                       int protocol);
 
@@ -33,7 +43,14 @@ SocketStatus socket_bind(Socket *socket);
 
 SocketStatus socket_listen(Socket *socket, int num_connections);
 
+bool socket_set_nonblocking(Socket *socket);
+
+int socket_get_fd(const Socket *socket);
+
+// The handle is invalid if nothing could be accepted.
 SocketHandle *socket_accept(Socket *socket);
+// Blocks until a connection is waiting to be accepted. False on error.
+bool socket_await_connection(Socket *socket);
 
 void socket_close(Socket *socket);
 
@@ -41,10 +58,39 @@ void socket_delete(Socket *socket);
 
 bool sockethandle_is_valid(const SocketHandle *sh);
 
+bool sockethandle_set_nonblocking(SocketHandle *sh);
+
+// Makes blocking receives fail after timeout_msec. 0 waits forever.
+bool sockethandle_set_receive_timeout(SocketHandle *sh, int timeout_msec);
+
 SocketStatus sockethandle_send(SocketHandle *sh, const char *const msg,
                                int msg_len);
 int32_t sockethandle_receive(SocketHandle *sh, char *buf, int buf_len);
 
+// Blocks until sh can take more, for sending all of something on a
+// non-blocking handle. False on error.
+bool sockethandle_await_writable(SocketHandle *sh);
+
+// Sends bufs in as few system calls as possible (one writev when they fit).
+// Returns how many bytes were sent, which is less than the total only if a
+// non-blocking socket would block, or -1 on error.
+int64_t sockethandle_sendv(SocketHandle *sh, const SocketBuffer *bufs,
+                           int num_bufs);
+
+// Opens the file at the path_len chars of path, which need not end in a NUL,
+// for socket_send_file(). Returns -1 if it cannot be read.
+int socket_file_open(const char path[], size_t path_len, int64_t *size);
+void socket_file_close(int file_fd);
+// Reads the next bytes of a file, for sockets the kernel cannot send a file
+// to directly. Returns the number read, 0 at the end, or -1 on error.
+int32_t socket_file_read(int file_fd, char *buf, int32_t len);
+
+// Sends up to len bytes of file_fd from *offset, which it advances, without
+// copying them through user space where the platform allows (sendfile).
+// Returns like sockethandle_sendv().
+int64_t sockethandle_send_file(SocketHandle *sh, int file_fd, int64_t *offset,
+                               int64_t len);
+
 unsigned int sockethandle_get_socket(SocketHandle *sh);
 
 void sockethandle_close(SocketHandle *sh);
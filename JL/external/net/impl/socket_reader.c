@@ -0,0 +1,137 @@
+/*
+ * socket_reader.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "socket_reader.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../../memory/memory.h"
+
+// A reader this much larger than the default is shrunk again once emptied, so
+// one large upload does not pin memory for the rest of the connection.
+#define SOCKET_READER_KEEP_SIZE (64 * 1024)
+
+SocketReader *socket_reader_create() {
+  SocketReader *reader = ALLOC2(SocketReader);
+  reader->cap = SOCKET_READER_DEFAULT_SIZE;
+  reader->buf = ALLOC_ARRAY2(char, reader->cap);
+  reader->start = reader->len = 0;
+  return reader;
+}
+
+void socket_reader_delete(SocketReader *reader) {
+  DEALLOC(reader->buf);
+  DEALLOC(reader);
+}
+
+uint32_t socket_reader_size(const SocketReader *reader) { return reader->len; }
+
+int socket_reader_peek(const SocketReader *reader, uint32_t len,
+                       SocketBuffer parts[2]) {
+  uint32_t first = min(len, reader->cap - reader->start);
+  parts[0].data = reader->buf + reader->start;
+  parts[0].len = first;
+  if (first == len) {
+    return 1;
+  }
+  parts[1].data = reader->buf;
+  parts[1].len = len - first;
+  return 2;
+}
+
+// Moves the contents to the front of a buffer of cap bytes.
+void socket_reader_resize(SocketReader *reader, uint32_t cap) {
+  char *buf = ALLOC_ARRAY2(char, cap);
+  SocketBuffer parts[2];
+  int i, num_parts = socket_reader_peek(reader, reader->len, parts);
+  uint32_t copied = 0;
+  for (i = 0; i < num_parts; ++i) {
+    memmove(buf + copied, parts[i].data, parts[i].len);
+    copied += parts[i].len;
+  }
+  DEALLOC(reader->buf);
+  reader->buf = buf;
+  reader->cap = cap;
+  reader->start = 0;
+}
+
+bool socket_reader_reserve(SocketReader *reader, uint32_t len) {
+  if (len <= reader->cap) {
+    return true;
+  }
+  if (len > SOCKET_READER_MAX_SIZE) {
+    return false;
+  }
+  uint32_t cap = reader->cap;
+  while (cap < len) {
+    cap *= 2;
+  }
+  socket_reader_resize(reader, cap);
+  return true;
+}
+
+int32_t socket_reader_fill(SocketReader *reader, SocketHandle *sh) {
+  if (reader->len == reader->cap &&
+      !socket_reader_reserve(reader, reader->cap * 2)) {
+    return -1;
+  }
+  // Only the free space up to the end of the buffer, so one receive can write
+  // it directly.
+  uint32_t end = (reader->start + reader->len) & (reader->cap - 1);
+  uint32_t free_len =
+      (end >= reader->start) ? reader->cap - end : reader->start - end;
+  int32_t received = sockethandle_receive(sh, reader->buf + end, free_len);
+  if (received > 0) {
+    reader->len += received;
+  }
+  return received;
+}
+
+int64_t socket_reader_find(const SocketReader *reader, const char *delim,
+                           uint32_t delim_len, uint32_t from) {
+  if (0 == delim_len) {
+    return from <= reader->len ? from : -1;
+  }
+  uint32_t mask = reader->cap - 1, i, j;
+  for (i = from; i + delim_len <= reader->len; ++i) {
+    // Skips to the next possible start in this stretch of the buffer.
+    uint32_t pos = (reader->start + i) & mask;
+    uint32_t stretch = min(reader->len - i, reader->cap - pos);
+    const char *hit = memchr(reader->buf + pos, delim[0], stretch);
+    if (NULL == hit) {
+      i += stretch - 1;
+      continue;
+    }
+    i += hit - (reader->buf + pos);
+    if (i + delim_len > reader->len) {
+      return -1;
+    }
+    for (j = 1; j < delim_len; ++j) {
+      if (reader->buf[(reader->start + i + j) & mask] != delim[j]) {
+        break;
+      }
+    }
+    if (j == delim_len) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void socket_reader_consume(SocketReader *reader, uint32_t len) {
+  reader->len -= len;
+  if (0 == reader->len) {
+    // Leaves the most room for the next receive.
+    reader->start = 0;
+    if (reader->cap > SOCKET_READER_KEEP_SIZE) {
+      socket_reader_resize(reader, SOCKET_READER_DEFAULT_SIZE);
+    }
+    return;
+  }
+  reader->start = (reader->start + len) & (reader->cap - 1);
+}
@@ -0,0 +1,54 @@
+/*
+ * socket_reader.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_IMPL_SOCKET_READER_H_
+#define EXTERNAL_NET_IMPL_SOCKET_READER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "socket.h"
+
+#define SOCKET_READER_DEFAULT_SIZE 4096
+// Largest amount a reader buffers, e.g. while looking for a delimiter.
+#define SOCKET_READER_MAX_SIZE (16 * 1024 * 1024)
+
+// Bytes received on a connection but not yet read, in a ring buffer which is
+// reused for the life of the connection and grows to fit large reads.
+typedef struct {
+  char *buf;
+  // Always a power of two.
+  uint32_t cap;
+  uint32_t start, len;
+} SocketReader;
+
+SocketReader *socket_reader_create();
+void socket_reader_delete(SocketReader *reader);
+
+uint32_t socket_reader_size(const SocketReader *reader);
+
+// Makes room for at least len buffered bytes. False if len is too large.
+bool socket_reader_reserve(SocketReader *reader, uint32_t len);
+
+// Receives once into the free space, growing the buffer if it is full. Returns
+// like sockethandle_receive(): the number of bytes, 0 once the peer is gone,
+// or -1 on error or if a non-blocking handle has nothing yet.
+int32_t socket_reader_fill(SocketReader *reader, SocketHandle *sh);
+
+// The index of the first delim at or after from, or -1.
+int64_t socket_reader_find(const SocketReader *reader, const char *delim,
+                           uint32_t delim_len, uint32_t from);
+
+// Points parts at the first len buffered bytes, which may wrap around the end
+// of the buffer. Returns how many parts are used.
+int socket_reader_peek(const SocketReader *reader, uint32_t len,
+                       SocketBuffer parts[2]);
+
+// Drops the first len buffered bytes.
+void socket_reader_consume(SocketReader *reader, uint32_t len);
+
+#endif /* EXTERNAL_NET_IMPL_SOCKET_READER_H_ */
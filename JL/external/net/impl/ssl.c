@@ -14,16 +14,29 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "../../../error.h"
 #include "../../../memory/memory.h"
+#include "../../../threads/thread_interface.h"
 #include "socket.h"
 
 #define SUCCESS 1
+// Sessions remembered per listener for clients which resume without a ticket.
+#define SSL_SESSION_CACHE_SIZE 10240
+#define SSL_SESSION_TIMEOUT_SEC 300
+// Idle buffers kept for reuse. More are allocated when all are in use.
+#define SSL_MAX_POOLED_BUFFERS 64
+
+// Identifies sessions as this server's, which the session cache requires.
+static const unsigned char SESSION_ID_CONTEXT[] = "jl-net";
 
 struct SSLSocket_ {
   Socket *raw_socket;
+  // Shared by every connection accepted on the listener, along with its
+  // session cache and ticket keys.
   SSL_CTX *ssl_ctx;
+  uint64_t full_handshakes, resumed_handshakes;
 };
 
 struct SSLSocketHandle_ {
@@ -31,26 +44,67 @@ struct SSLSocketHandle_ {
   SSL *ssl;
 };
 
+static Mutex buffer_pool_mutex = NULL;
+static char *buffer_pool[SSL_MAX_POOLED_BUFFERS];
+static int num_pooled_buffers = 0;
+
 void ssl_init() {
   SSL_load_error_strings();
   SSL_library_init();
   OpenSSL_add_all_algorithms();
+  buffer_pool_mutex = mutex_create(NULL);
 }
 
 void ssl_cleanup() {
+  while (num_pooled_buffers > 0) {
+    DEALLOC(buffer_pool[--num_pooled_buffers]);
+  }
+  mutex_close(buffer_pool_mutex);
   ERR_free_strings();
   EVP_cleanup();
 }
 
+char *ssl_buffer_acquire() {
+  char *buf = NULL;
+  mutex_await(buffer_pool_mutex, INFINITE);
+  if (num_pooled_buffers > 0) {
+    buf = buffer_pool[--num_pooled_buffers];
+  }
+  mutex_release(buffer_pool_mutex);
+  return NULL != buf ? buf : ALLOC_ARRAY2(char, SSL_BUFFER_SIZE);
+}
+
+void ssl_buffer_release(char *buf) {
+  mutex_await(buffer_pool_mutex, INFINITE);
+  if (num_pooled_buffers < SSL_MAX_POOLED_BUFFERS) {
+    buffer_pool[num_pooled_buffers++] = buf;
+    buf = NULL;
+  }
+  mutex_release(buffer_pool_mutex);
+  if (NULL != buf) {
+    DEALLOC(buf);
+  }
+}
+
 SSLSocket *sslsocket_create(Socket *socket, const char certificate_fn[],
                             const char private_key_fn[], int *status) {
   ASSERT(NOT_NULL(socket));
   // Assume socket is valid, bound, and listening.
   SSLSocket *ssl_sock = ALLOC2(SSLSocket);
   ssl_sock->raw_socket = socket;
+  ssl_sock->full_handshakes = ssl_sock->resumed_handshakes = 0;
   // Wrap socket in SSL
   ssl_sock->ssl_ctx = SSL_CTX_new(SSLv23_server_method());
   SSL_CTX_set_options(ssl_sock->ssl_ctx, SSL_OP_SINGLE_DH_USE);
+  // Returning clients skip the full handshake, either with a session ticket
+  // or, for those without, from the server-side cache.
+  SSL_CTX_set_session_cache_mode(ssl_sock->ssl_ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context(ssl_sock->ssl_ctx, SESSION_ID_CONTEXT,
+                                 sizeof(SESSION_ID_CONTEXT) - 1);
+  SSL_CTX_sess_set_cache_size(ssl_sock->ssl_ctx, SSL_SESSION_CACHE_SIZE);
+  SSL_CTX_set_timeout(ssl_sock->ssl_ctx, SSL_SESSION_TIMEOUT_SEC);
+  // Idle keep-alive connections give their record buffers back.
+  SSL_CTX_set_mode(ssl_sock->ssl_ctx, SSL_MODE_RELEASE_BUFFERS);
   // Apply cert and private key encryption.
   if (SSL_CTX_use_certificate_file(ssl_sock->ssl_ctx, certificate_fn,
                                    SSL_FILETYPE_PEM) != SUCCESS) {
@@ -77,6 +131,12 @@ SSLSocketHandle *sslsocket_accept(SSLSocket *ssl_socket) {
   }
   int accept_status = SSL_accept(ssl_handle->ssl);
   if (accept_status > 0) {
+    // Several threads may be accepting at once.
+    if (SSL_session_reused(ssl_handle->ssl)) {
+      __sync_fetch_and_add(&ssl_socket->resumed_handshakes, 1);
+    } else {
+      __sync_fetch_and_add(&ssl_socket->full_handshakes, 1);
+    }
     return ssl_handle;
   }
   //  int err = SSL_get_error(ssl_handle->ssl, accept_status);
@@ -99,6 +159,60 @@ int32_t sslsockethandle_send(SSLSocketHandle *ssl_sh, const char *const msg,
   return bytes_written;
 }
 
+int64_t sslsockethandle_sendv(SSLSocketHandle *ssl_sh,
+                              const SocketBuffer *bufs, int num_bufs) {
+  char *staged = ssl_buffer_acquire();
+  uint32_t staged_len = 0;
+  int64_t total = 0;
+  bool ok = true;
+  int i;
+  for (i = 0; ok && i < num_bufs; ++i) {
+    const char *data = bufs[i].data;
+    uint32_t len = bufs[i].len;
+    while (ok && len > 0) {
+      if (0 == staged_len && len >= SSL_BUFFER_SIZE) {
+        // Already big enough to fill records by itself.
+        ok = sslsockethandle_send(ssl_sh, data, len) == len;
+        total += ok ? len : 0;
+        break;
+      }
+      uint32_t copied = min(len, SSL_BUFFER_SIZE - staged_len);
+      memmove(staged + staged_len, data, copied);
+      staged_len += copied;
+      data += copied;
+      len -= copied;
+      if (SSL_BUFFER_SIZE == staged_len) {
+        ok = sslsockethandle_send(ssl_sh, staged, staged_len) == staged_len;
+        total += ok ? staged_len : 0;
+        staged_len = 0;
+      }
+    }
+  }
+  if (ok && staged_len > 0 &&
+      sslsockethandle_send(ssl_sh, staged, staged_len) == staged_len) {
+    total += staged_len;
+  }
+  ssl_buffer_release(staged);
+  return total;
+}
+
+int64_t sslsockethandle_send_file(SSLSocketHandle *ssl_sh, int file_fd,
+                                  int64_t len) {
+  char *chunk = ssl_buffer_acquire();
+  int64_t total = 0;
+  while (total < len) {
+    int32_t chunk_read =
+        socket_file_read(file_fd, chunk, min(len - total, SSL_BUFFER_SIZE));
+    if (chunk_read <= 0 ||
+        sslsockethandle_send(ssl_sh, chunk, chunk_read) != chunk_read) {
+      break;
+    }
+    total += chunk_read;
+  }
+  ssl_buffer_release(chunk);
+  return total;
+}
+
 int32_t sslsockethandle_receive(SSLSocketHandle *ssl_sh, char *buf,
                                 int buf_len) {
   int total_bytes_read = 0;
@@ -114,6 +228,10 @@ int32_t sslsockethandle_receive(SSLSocketHandle *ssl_sh, char *buf,
         return total_bytes_read;
       case SSL_ERROR_WANT_READ:
       case SSL_ERROR_WANT_WRITE:
+        // The receive timeout passed.
+        if (socket_would_block()) {
+          return total_bytes_read > 0 ? total_bytes_read : -1;
+        }
         // Error in read/write, but it was not fatal, we can try again.
         continue;
       default:
@@ -126,12 +244,27 @@ int32_t sslsockethandle_receive(SSLSocketHandle *ssl_sh, char *buf,
   return total_bytes_read;
 }
 
+bool sslsockethandle_set_receive_timeout(SSLSocketHandle *ssl_sh,
+                                         int timeout_msec) {
+  return sockethandle_set_receive_timeout(ssl_sh->sh, timeout_msec);
+}
+
+void sslsocket_handshake_counts(const SSLSocket *ssl_socket,
+                                uint64_t *full_handshakes,
+                                uint64_t *resumed_handshakes) {
+  *full_handshakes = ssl_socket->full_handshakes;
+  *resumed_handshakes = ssl_socket->resumed_handshakes;
+}
+
 void sslsocket_close(SSLSocket *ssl_socket) {
   socket_close(ssl_socket->raw_socket);
-  SSL_CTX_SRP_CTX_free(ssl_socket->ssl_ctx);
 }
 
-void sslsocket_delete(SSLSocket *ssl_socket) { DEALLOC(ssl_socket); }
+// Handles still open keep their own reference to the context.
+void sslsocket_delete(SSLSocket *ssl_socket) {
+  SSL_CTX_free(ssl_socket->ssl_ctx);
+  DEALLOC(ssl_socket);
+}
 
 void sslsockethandle_close(SSLSocketHandle *ssl_sh) {
   SSL_shutdown(ssl_sh->ssl);
@@ -8,6 +8,7 @@
 #ifndef EXTERNAL_NET_IMPL_SSL_H_
 #define EXTERNAL_NET_IMPL_SSL_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "socket.h"
@@ -18,6 +19,9 @@
 #define ERR_BAD_CERTIFICATE 1001
 #define ERR_BAD_PRIVATE_KEY 1002
 
+// Size of pooled buffers, which is the most plaintext one TLS record holds.
+#define SSL_BUFFER_SIZE (16 * 1024)
+
 typedef struct SSLSocket_ SSLSocket;
 typedef struct SSLSocketHandle_ SSLSocketHandle;
 
@@ -25,6 +29,10 @@ void ssl_init();
 
 void ssl_cleanup();
 
+// Borrows an SSL_BUFFER_SIZE buffer from a pool shared by all connections.
+char *ssl_buffer_acquire();
+void ssl_buffer_release(char *buf);
+
 SSLSocket *sslsocket_create(Socket *socket, const char certificate_fn[],
                             const char private_key_fn[], int *status);
 
@@ -34,14 +42,33 @@ void sslsocket_delete(SSLSocket *socket);
 
 SSLSocketHandle *sslsocket_accept(SSLSocket *ssl_socket);
 
+// How many accepted connections needed a full handshake and how many resumed
+// an earlier session.
+void sslsocket_handshake_counts(const SSLSocket *ssl_socket,
+                                uint64_t *full_handshakes,
+                                uint64_t *resumed_handshakes);
+
 int32_t sslsockethandle_send(SSLSocketHandle *ssl_sh, const char *const msg,
                              int msg_len);
 
+// Sends bufs staged through a pooled buffer, so small parts share TLS records
+// instead of taking one each. Returns how many bytes were sent.
+int64_t sslsockethandle_sendv(SSLSocketHandle *ssl_sh,
+                              const SocketBuffer *bufs, int num_bufs);
+
+// Sends len bytes read from file_fd. TLS has to encrypt them in user space,
+// so they are read in chunks rather than sent by the kernel.
+int64_t sslsockethandle_send_file(SSLSocketHandle *ssl_sh, int file_fd,
+                                  int64_t len);
+
 int32_t sslsockethandle_receive(SSLSocketHandle *ssl_sh, char *buf,
                                 int buf_len);
 
 void sslsocket_delete(SSLSocket *ssl_socket);
 
+bool sslsockethandle_set_receive_timeout(SSLSocketHandle *ssl_sh,
+                                         int timeout_msec);
+
 void sslsockethandle_close(SSLSocketHandle *sh);
 
 void sslsockethandle_delete(SSLSocketHandle *sh);
@@ -0,0 +1,135 @@
+/*
+ * template.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "template.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../../../memory/memory.h"
+
+#define ESCAPED_LT "&lt;"
+#define ESCAPED_GT "&gt;"
+// Both entities are the same length.
+#define ESCAPE_GROWTH (sizeof(ESCAPED_LT) - 1 - 1)
+
+#define BYTES_ONES 0x0101010101010101ULL
+#define BYTES_HIGHS 0x8080808080808080ULL
+
+// Non-zero if any byte of word is c.
+uint64_t word_has_byte(uint64_t word, unsigned char c) {
+  uint64_t diff = word ^ (BYTES_ONES * c);
+  return (diff - BYTES_ONES) & ~diff & BYTES_HIGHS;
+}
+
+bool needs_escape(char c) { return '<' == c || '>' == c; }
+
+void template_add_piece(TemplateProgram *program, uint32_t *capacity,
+                        int32_t slot, uint32_t start, uint32_t len) {
+  if (slot < 0 && 0 == len) {
+    return;
+  }
+  if (program->num_pieces == *capacity) {
+    *capacity *= 2;
+    program->pieces = REALLOC(program->pieces, TemplatePiece, *capacity);
+  }
+  TemplatePiece *piece = &program->pieces[program->num_pieces++];
+  piece->slot = slot;
+  piece->start = start;
+  piece->len = len;
+  if (slot < 0) {
+    program->literal_len += len;
+  } else {
+    program->num_slots++;
+  }
+}
+
+void template_compile(TemplateProgram *program, const char *src,
+                      uint32_t src_len, const TemplateKey *keys,
+                      uint32_t num_keys) {
+  uint32_t capacity = 8;
+  program->pieces = ALLOC_ARRAY2(TemplatePiece, capacity);
+  program->num_pieces = program->num_slots = program->literal_len = 0;
+  // Chars which start some key, so most positions are rejected at once.
+  bool starts_key[256] = {false};
+  uint32_t i, k;
+  for (k = 0; k < num_keys; ++k) {
+    if (keys[k].len > 0) {
+      starts_key[(unsigned char)keys[k].text[0]] = true;
+    }
+  }
+  uint32_t literal_start = 0;
+  for (i = 0; i < src_len;) {
+    int32_t match = -1;
+    if (starts_key[(unsigned char)src[i]]) {
+      for (k = 0; k < num_keys; ++k) {
+        if (keys[k].len > 0 && keys[k].len <= src_len - i &&
+            0 == memcmp(src + i, keys[k].text, keys[k].len) &&
+            (match < 0 || keys[k].len > keys[match].len)) {
+          match = k;
+        }
+      }
+    }
+    if (match < 0) {
+      ++i;
+      continue;
+    }
+    template_add_piece(program, &capacity, -1, literal_start,
+                       i - literal_start);
+    template_add_piece(program, &capacity, match, i, keys[match].len);
+    i += keys[match].len;
+    literal_start = i;
+  }
+  template_add_piece(program, &capacity, -1, literal_start,
+                     src_len - literal_start);
+}
+
+void template_finalize(TemplateProgram *program) {
+  DEALLOC(program->pieces);
+}
+
+size_t html_escape_next(const char *text, size_t from, size_t len) {
+  size_t i = from;
+  // A word at a time until one might hold a char to replace.
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, text + i, sizeof(word));
+    if (word_has_byte(word, '<') | word_has_byte(word, '>')) {
+      break;
+    }
+  }
+  for (; i < len; ++i) {
+    if (needs_escape(text[i])) {
+      return i;
+    }
+  }
+  return len;
+}
+
+size_t html_escaped_len(const char *text, size_t len) {
+  size_t escaped_len = len, i = html_escape_next(text, 0, len);
+  while (i < len) {
+    escaped_len += ESCAPE_GROWTH;
+    i = html_escape_next(text, i + 1, len);
+  }
+  return escaped_len;
+}
+
+char *html_escape_into(char *dst, const char *text, size_t len) {
+  size_t start = 0, i = html_escape_next(text, 0, len);
+  while (i < len) {
+    memmove(dst, text + start, i - start);
+    dst += i - start;
+    const char *entity = ('<' == text[i]) ? ESCAPED_LT : ESCAPED_GT;
+    memmove(dst, entity, sizeof(ESCAPED_LT) - 1);
+    dst += sizeof(ESCAPED_LT) - 1;
+    start = i + 1;
+    i = html_escape_next(text, start, len);
+  }
+  memmove(dst, text + start, len - start);
+  return dst + len - start;
+}
@@ -0,0 +1,53 @@
+/*
+ * template.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_IMPL_TEMPLATE_H_
+#define EXTERNAL_NET_IMPL_TEMPLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  const char *text;
+  uint32_t len;
+} TemplateKey;
+
+// A literal run of the source when slot is -1, otherwise the value of
+// keys[slot].
+typedef struct {
+  int32_t slot;
+  uint32_t start, len;
+} TemplatePiece;
+
+typedef struct {
+  TemplatePiece *pieces;
+  uint32_t num_pieces;
+  uint32_t num_slots;
+  // Total length of the literal pieces.
+  uint32_t literal_len;
+} TemplateProgram;
+
+// Splits src into literals and the keys found in it. Where keys overlap, the
+// longest one starting at a position wins.
+void template_compile(TemplateProgram *program, const char *src,
+                      uint32_t src_len, const TemplateKey *keys,
+                      uint32_t num_keys);
+
+void template_finalize(TemplateProgram *program);
+
+// The index of the first char at or after from which html_escape_into()
+// replaces, or len if there is none.
+size_t html_escape_next(const char *text, size_t from, size_t len);
+
+// The length of text once escaped.
+size_t html_escaped_len(const char *text, size_t len);
+
+// Writes text to dst with '<' and '>' replaced by entities. dst must have
+// room for html_escaped_len() chars. Returns the end of what was written.
+char *html_escape_into(char *dst, const char *text, size_t len);
+
+#endif /* EXTERNAL_NET_IMPL_TEMPLATE_H_ */
@@ -9,10 +9,15 @@
 
 #include "../../arena/strings.h"
 #include "../external.h"
+#include "event_loop.h"
+#include "http.h"
 #include "impl/socket.h"
 #include "impl/ssl.h"
+#include "router.h"
+#include "scheduler.h"
 #include "socket.h"
 #include "ssl.h"
+#include "template.h"
 
 Element net_init(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   sockets_init();
@@ -34,4 +39,9 @@ void add_net_external(VM *vm, Element module_element) {
   add_socket_class(vm, module_element);
   add_sslsockethandle_class(vm, &module_element);
   add_sslsocket_class(vm, &module_element);
+  add_event_loop_class(vm, module_element);
+  add_http_classes(vm, module_element);
+  add_template_class(vm, module_element);
+  add_router_class(vm, module_element);
+  add_scheduler_class(vm, module_element);
 }
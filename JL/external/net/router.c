@@ -0,0 +1,148 @@
+/*
+ * router.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "router.h"
+
+#include <stddef.h>
+
+#include "../../arena/strings.h"
+#include "../../class.h"
+#include "../../datastructure/array.h"
+#include "../../datastructure/map.h"
+#include "../../datastructure/tuple.h"
+#include "../../element.h"
+#include "../../error.h"
+#include "../../memory/memory.h"
+#include "../../memory/memory_graph.h"
+#include "../external.h"
+#include "../strings.h"
+#include "http.h"
+#include "impl/router.h"
+
+Router *router_state(ExternalData *data) {
+  return (Router *)map_lookup(&data->state, strings_intern("router"));
+}
+
+Element Router_constructor(VM *vm, Thread *t, ExternalData *data,
+                           Element *arg) {
+  Router *router = ALLOC2(Router);
+  router_init(router);
+  map_insert(&data->state, strings_intern("router"), router);
+  // Values by route id, where the VM can see them.
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$routes"),
+                         create_array(vm->graph));
+  return data->object;
+}
+
+Element Router_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                             Element *arg) {
+  Router *router = router_state(data);
+  if (NULL != router) {
+    router_finalize(router);
+    DEALLOC(router);
+  }
+  return create_none();
+}
+
+Element router_add_route(VM *vm, Thread *t, ExternalData *data, Element *arg,
+                         bool prefix) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2 ||
+      !ISTYPE(tuple_get(arg->obj->tuple, 0), class_string)) {
+    return throw_error(vm, t, "Expected (pattern, value).");
+  }
+  String *pattern = String_extract(tuple_get(arg->obj->tuple, 0));
+  Element value = tuple_get(arg->obj->tuple, 1);
+  Element routes = obj_get_field(data->object, strings_intern("$routes"));
+  int32_t route = Array_size(extract_array(routes));
+  switch (router_add(router_state(data), String_cstr(pattern),
+                     String_size(pattern), prefix, &route)) {
+    case ROUTER_BAD_PATTERN:
+      return throw_error(vm, t, "Invalid route pattern.");
+    case ROUTER_CONFLICT:
+      return throw_error(vm, t,
+                         "Route parameter is named differently elsewhere.");
+    default:
+      break;
+  }
+  if (route == Array_size(extract_array(routes))) {
+    memory_graph_array_enqueue(vm->graph, routes, value);
+  } else {
+    // Added again, so the new value replaces the old.
+    memory_graph_array_set(vm->graph, routes.obj, route, &value);
+  }
+  return data->object;
+}
+
+// add(pattern, value): Routes paths matching pattern to value. ':name' matches
+// one segment and '*name', which must be last, matches the rest of the path.
+Element Router_add(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return router_add_route(vm, t, data, arg, false);
+}
+
+// add_prefix(prefix, value): Routes paths starting with prefix to value when
+// no route matches all of the path. The longest such prefix wins.
+Element Router_add_prefix(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  return router_add_route(vm, t, data, arg, true);
+}
+
+// The captures of match as HttpFields. Their values are slices of path and
+// their names follow it in the same String.
+Element router_captures(VM *vm, const String *path, const RouteMatch *match) {
+  String *raw = String_create();
+  String_append_cstr(raw, String_cstr(path), String_size(path));
+  HttpField fields[ROUTER_MAX_CAPTURES];
+  HttpFieldList list = {fields, match->num_captures, ROUTER_MAX_CAPTURES};
+  int i;
+  for (i = 0; i < match->num_captures; ++i) {
+    const RouteCapture *capture = &match->captures[i];
+    fields[i].value.start = capture->start;
+    fields[i].value.len = capture->len;
+    fields[i].name.start = String_size(raw);
+    fields[i].name.len = capture->name_len;
+    String_append_cstr(raw, capture->name, capture->name_len);
+  }
+  return http_fields_create(vm, string_adopt(vm, raw), 0, &list, false);
+}
+
+// match(path): (value, params, rest) for the route path takes, or None. params
+// holds what ':name' and '*name' captured and rest is the part of path after
+// a prefix route, or ''.
+Element Router_match(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "match() expects a path.");
+  }
+  String *path = String_extract(*arg);
+  RouteMatch match;
+  router_match(router_state(data), String_cstr(path), String_size(path),
+               &match);
+  if (match.route < 0) {
+    return create_none();
+  }
+  Element routes = obj_get_field(data->object, strings_intern("$routes"));
+  Element result = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, result,
+                         Array_get(extract_array(routes), match.route));
+  memory_graph_tuple_add(vm->graph, result,
+                         router_captures(vm, path, &match));
+  memory_graph_tuple_add(
+      vm->graph, result,
+      string_slice(vm, arg->obj->external_data, match.rest,
+                   String_size(path) - match.rest));
+  return result;
+}
+
+Element add_router_class(VM *vm, Element module) {
+  Element router =
+      create_external_class(vm, module, strings_intern("Router"),
+                            Router_constructor, Router_deconstructor);
+  add_external_method(vm, router, strings_intern("add"), Router_add);
+  add_external_method(vm, router, strings_intern("add_prefix"),
+                      Router_add_prefix);
+  add_external_method(vm, router, strings_intern("match"), Router_match);
+  return router;
+}
@@ -0,0 +1,15 @@
+/*
+ * router.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_ROUTER_H_
+#define EXTERNAL_NET_ROUTER_H_
+
+#include "../../element.h"
+
+Element add_router_class(VM *vm, Element module);
+
+#endif /* EXTERNAL_NET_ROUTER_H_ */
@@ -0,0 +1,274 @@
+/*
+ * scheduler.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "scheduler.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../arena/strings.h"
+#include "../../class.h"
+#include "../../datastructure/array.h"
+#include "../../datastructure/map.h"
+#include "../../datastructure/tuple.h"
+#include "../../element.h"
+#include "../../error.h"
+#include "../../memory/memory.h"
+#include "../../memory/memory_graph.h"
+#include "../../threads/thread.h"
+#include "../../threads/thread_interface.h"
+#include "../../vm/vm.h"
+#include "../external.h"
+#include "impl/event_loop.h"
+
+#define DEFAULT_FD_CAPACITY 64
+
+// Green Threads multiplexed over whichever OS threads call run(). A Thread
+// runs until it finishes or an external call parks it on an fd, and is ready
+// again once the fd is. Ready Threads are in the $ready Array and parked ones
+// in the $parked Array, which holds an Array of Threads per fd.
+typedef struct {
+  EventLoop *loop;
+  Mutex mutex;
+  // Spawned Threads which have not finished.
+  uint32_t num_live;
+  // What the Threads parked on each fd are waiting for. 0 if none are.
+  int *fd_events;
+  uint32_t num_fds;
+} Scheduler;
+
+Scheduler *scheduler_state(ExternalData *data) {
+  return (Scheduler *)map_lookup(&data->state, strings_intern("scheduler"));
+}
+
+int *scheduler_fd_events(Scheduler *scheduler, int fd) {
+  if (fd >= scheduler->num_fds) {
+    uint32_t num_fds = max(scheduler->num_fds * 2, fd + 1);
+    scheduler->fd_events = REALLOC(scheduler->fd_events, int, num_fds);
+    memset(scheduler->fd_events + scheduler->num_fds, 0,
+           sizeof(int) * (num_fds - scheduler->num_fds));
+    scheduler->num_fds = num_fds;
+  }
+  return &scheduler->fd_events[fd];
+}
+
+Element scheduler_ready(ExternalData *data) {
+  return obj_get_field(data->object, strings_intern("$ready"));
+}
+
+Element parked_get(ExternalData *data, int fd) {
+  Element parked = obj_get_field(data->object, strings_intern("$parked"));
+  Array *arr = extract_array(parked);
+  if (fd >= Array_size(arr)) {
+    return create_none();
+  }
+  return Array_get(arr, fd);
+}
+
+void parked_set(VM *vm, ExternalData *data, int fd, Element waiting) {
+  Element parked = obj_get_field(data->object, strings_intern("$parked"));
+  Array *arr = extract_array(parked);
+  // Array_set() leaves any gap uninitialized.
+  while (Array_size(arr) < fd) {
+    memory_graph_array_enqueue(vm->graph, parked, create_none());
+  }
+  memory_graph_array_set(vm->graph, parked.obj, fd, &waiting);
+}
+
+// Must hold the scheduler lock. Makes every Thread parked on fd ready.
+void scheduler_wake(VM *vm, ExternalData *data, Scheduler *scheduler,
+                    int fd) {
+  int *events = scheduler_fd_events(scheduler, fd);
+  if (0 == *events) {
+    // Another run() already took them.
+    return;
+  }
+  // Watching only while something is parked keeps a level-triggered fd from
+  // waking every run() call over and over.
+  event_loop_remove(scheduler->loop, fd);
+  *events = 0;
+  Element waiting = parked_get(data, fd);
+  parked_set(vm, data, fd, create_none());
+  if (NONE == waiting.type) {
+    return;
+  }
+  Element ready = scheduler_ready(data);
+  Array *arr = extract_array(waiting);
+  int i;
+  for (i = 0; i < Array_size(arr); ++i) {
+    memory_graph_array_enqueue(vm->graph, ready, Array_get(arr, i));
+  }
+}
+
+// Must hold the scheduler lock. Waits for the events thread parked for.
+void scheduler_park(VM *vm, ExternalData *data, Scheduler *scheduler,
+                    Element task, Thread *thread) {
+  int fd = thread->park.fd;
+  int *events = scheduler_fd_events(scheduler, fd);
+  Element waiting = parked_get(data, fd);
+  if (NONE == waiting.type) {
+    waiting = create_array(vm->graph);
+    parked_set(vm, data, fd, waiting);
+  }
+  memory_graph_array_enqueue(vm->graph, waiting, task);
+  int new_events = *events | thread->park.events;
+  bool watched = (0 == *events)
+                     ? event_loop_add(scheduler->loop, fd, new_events)
+                     : (new_events == *events ||
+                        event_loop_modify(scheduler->loop, fd, new_events));
+  *events = new_events;
+  if (!watched) {
+    // Not something epoll can wait on. The retried call fails instead of
+    // waiting forever.
+    scheduler_wake(vm, data, scheduler, fd);
+  }
+}
+
+// Runs task until it finishes or parks.
+void scheduler_step(VM *vm, ExternalData *data, Scheduler *scheduler,
+                    Element task) {
+  Thread *thread = Thread_extract(task);
+  if (thread->park.fd >= 0) {
+    vm_resume_parked(vm, thread);
+  }
+  bool finished = thread->park.fd < 0 && thread_continue(thread, vm);
+  mutex_await(scheduler->mutex, INFINITE);
+  if (finished) {
+    scheduler->num_live--;
+  } else {
+    scheduler_park(vm, data, scheduler, task, thread);
+  }
+  mutex_release(scheduler->mutex);
+}
+
+Element Scheduler_constructor(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  EventLoop *loop = event_loop_create();
+  if (NULL == loop) {
+    return throw_error(vm, t, "Scheduler is not supported on this platform.");
+  }
+  Scheduler *scheduler = ALLOC2(Scheduler);
+  scheduler->loop = loop;
+  scheduler->mutex = mutex_create(NULL);
+  scheduler->num_live = 0;
+  scheduler->num_fds = DEFAULT_FD_CAPACITY;
+  scheduler->fd_events = ALLOC_ARRAY(int, DEFAULT_FD_CAPACITY);
+  memset(scheduler->fd_events, 0, sizeof(int) * DEFAULT_FD_CAPACITY);
+  map_insert(&data->state, strings_intern("scheduler"), scheduler);
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$ready"),
+                         create_array(vm->graph));
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$parked"),
+                         create_array(vm->graph));
+  return data->object;
+}
+
+Element Scheduler_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  Scheduler *scheduler = scheduler_state(data);
+  if (NULL == scheduler) {
+    return create_none();
+  }
+  DEALLOC(scheduler->fd_events);
+  event_loop_delete(scheduler->loop);
+  mutex_close(scheduler->mutex);
+  DEALLOC(scheduler);
+  return create_none();
+}
+
+// spawn(fn[, arg]): Starts fn(arg) as a green Thread and returns it. Its
+// result is set on it once it finishes. Safe to call from any thread,
+// including a green one.
+Element Scheduler_spawn(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Element fn = *arg, fn_arg = create_none();
+  if (is_object_type(arg, TUPLE)) {
+    if (tuple_size(arg->obj->tuple) != 2) {
+      return throw_error(vm, t, "spawn() expects (fn, arg).");
+    }
+    fn = tuple_get(arg->obj->tuple, 0);
+    fn_arg = tuple_get(arg->obj->tuple, 1);
+  }
+  if (!ISOBJECT(fn) ||
+      (!inherits_from(obj_get_field_obj(fn.obj, CLASS_KEY).obj,
+                      class_function.obj) &&
+       !ISTYPE(fn, class_anon_function) &&
+       !ISTYPE(fn, class_methodinstance))) {
+    return throw_error(vm, t, "spawn() expects a function.");
+  }
+  Element task = create_thread_object(vm, fn, fn_arg);
+  Thread *thread = Thread_extract(task);
+  thread->green = true;
+  thread_begin(thread, vm);
+
+  Scheduler *scheduler = scheduler_state(data);
+  mutex_await(scheduler->mutex, INFINITE);
+  Element ready = scheduler_ready(data);
+  bool was_idle = 0 == Array_size(extract_array(ready));
+  scheduler->num_live++;
+  memory_graph_array_enqueue(vm->graph, ready, task);
+  mutex_release(scheduler->mutex);
+  if (was_idle) {
+    // run() may be waiting on fds.
+    event_loop_wakeup(scheduler->loop);
+  }
+  return task;
+}
+
+// run(): Runs green Threads until every one spawned has finished. Calling it
+// from several Threads spreads the green ones over them.
+Element Scheduler_run(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  Scheduler *scheduler = scheduler_state(data);
+  Event events[EVENT_LOOP_MAX_EVENTS];
+  while (true) {
+    mutex_await(scheduler->mutex, INFINITE);
+    Element ready = scheduler_ready(data);
+    if (Array_size(extract_array(ready)) > 0) {
+      // Oldest first.
+      Element task = memory_graph_array_pop(vm->graph, ready.obj);
+      mutex_release(scheduler->mutex);
+      scheduler_step(vm, data, scheduler, task);
+      continue;
+    }
+    bool done = 0 == scheduler->num_live;
+    mutex_release(scheduler->mutex);
+    if (done) {
+      // Passes it on to any other run() waiting.
+      event_loop_wakeup(scheduler->loop);
+      break;
+    }
+    int i, num_events = event_loop_wait(scheduler->loop, events, -1);
+    if (num_events < 0) {
+      return throw_error(vm, t, "Scheduler wait failed.");
+    }
+    mutex_await(scheduler->mutex, INFINITE);
+    for (i = 0; i < num_events; ++i) {
+      scheduler_wake(vm, data, scheduler, events[i].fd);
+    }
+    bool share = Array_size(extract_array(scheduler_ready(data))) > 1;
+    mutex_release(scheduler->mutex);
+    if (share) {
+      event_loop_wakeup(scheduler->loop);
+    }
+  }
+  return data->object;
+}
+
+// num_live(): How many spawned green Threads have not finished.
+Element Scheduler_num_live(VM *vm, Thread *t, ExternalData *data,
+                           Element *arg) {
+  return create_int(scheduler_state(data)->num_live);
+}
+
+Element add_scheduler_class(VM *vm, Element module) {
+  Element scheduler =
+      create_external_class(vm, module, strings_intern("Scheduler"),
+                            Scheduler_constructor, Scheduler_deconstructor);
+  add_external_method(vm, scheduler, strings_intern("spawn"), Scheduler_spawn);
+  add_external_method(vm, scheduler, strings_intern("run"), Scheduler_run);
+  add_external_method(vm, scheduler, strings_intern("num_live"),
+                      Scheduler_num_live);
+  return scheduler;
+}
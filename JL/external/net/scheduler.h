@@ -0,0 +1,15 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_SCHEDULER_H_
+#define EXTERNAL_NET_SCHEDULER_H_
+
+#include "../../element.h"
+
+Element add_scheduler_class(VM *vm, Element module);
+
+#endif /* EXTERNAL_NET_SCHEDULER_H_ */
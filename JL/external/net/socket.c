@@ -6,9 +6,12 @@
  */
 
 #include "impl/socket.h"
+#include "impl/event_loop.h"
+#include "impl/socket_reader.h"
 #include "socket.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "../../arena/strings.h"
 #include "../../class.h"
@@ -17,19 +20,38 @@
 #include "../../datastructure/tuple.h"
 #include "../../element.h"
 #include "../../error.h"
+#include "../../memory/memory.h"
 #include "../../memory/memory_graph.h"
+#include "../../threads/thread.h"
 #include "../external.h"
 #include "../strings.h"
 
-#define BUFFER_SIZE 4096
 #define SOCKET_ERROR (-1)
 
-static Element sh_class;
+Element class_sockethandle;
 Element class_socket;
 
 Element SocketHandle_constructor(VM *vm, Thread *t, ExternalData *data,
                                  Element *arg);
 
+SocketBuffer *socket_buffers_of(Element arr_elt, int *num_bufs) {
+  Array *arr = extract_array(arr_elt);
+  *num_bufs = Array_size(arr);
+  SocketBuffer *bufs = ALLOC_ARRAY2(SocketBuffer, max(*num_bufs, 1));
+  int i;
+  for (i = 0; i < *num_bufs; ++i) {
+    Element part = Array_get(arr, i);
+    if (!ISTYPE(part, class_string)) {
+      DEALLOC(bufs);
+      return NULL;
+    }
+    String *msg = String_extract(part);
+    bufs[i].data = String_cstr(msg);
+    bufs[i].len = String_size(msg);
+  }
+  return bufs;
+}
+
 Element Socket_constructor(VM *vm, Thread *t, ExternalData *data,
                            Element *arg) {
   ASSERT(is_object_type(arg, TUPLE));
@@ -77,16 +99,37 @@ Element Socket_close(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   return create_none();
 }
 
-// To ease finding sockethandle class.
+// To ease finding sockethandle class. In a green Thread, waits for a
+// connection by parking instead of blocking.
 Element Socket_accept(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   Socket *socket = (Socket *)map_lookup(&data->state, strings_intern("socket"));
   if (NULL == socket) {
     return throw_error(vm, t, "Weird Socket error.");
   }
-  Element socket_handle = create_external_obj(vm, sh_class);
-  SocketHandle_constructor(vm, t, socket_handle.obj->external_data,
-                           &data->object);
+  if (!t_can_park(t)) {
+    Element socket_handle = create_external_obj(vm, class_sockethandle);
+    SocketHandle_constructor(vm, t, socket_handle.obj->external_data,
+                             &data->object);
+    return socket_handle;
+  }
+  if (NULL == map_lookup(&data->state, strings_intern("nonblocking"))) {
+    socket_set_nonblocking(socket);
+    map_insert(&data->state, strings_intern("nonblocking"), socket);
+  }
+  SocketHandle *sh = socket_accept(socket);
+  if (!sockethandle_is_valid(sh) && socket_would_block() &&
+      t_park(t, socket_get_fd(socket), EVENT_READABLE, Socket_accept, data,
+             arg)) {
+    sockethandle_delete(sh);
+    return create_none();
+  }
+  return sockethandle_wrap(vm, sh);
+}
 
+Element sockethandle_wrap(VM *vm, SocketHandle *sh) {
+  Element socket_handle = create_external_obj(vm, class_sockethandle);
+  map_insert(&socket_handle.obj->external_data->state,
+             strings_intern("handle"), sh);
   return socket_handle;
 }
 
@@ -98,6 +141,13 @@ Element SocketHandle_constructor(VM *vm, Thread *t, ExternalData *data,
     return throw_error(vm, t, "Weird Socket error.");
   }
   SocketHandle *sh = socket_accept(socket);
+  // Green Threads or an EventLoop may have made the socket non-blocking, and
+  // others may take the connection first.
+  while (!sockethandle_is_valid(sh) && socket_would_block() &&
+         socket_await_connection(socket)) {
+    sockethandle_delete(sh);
+    sh = socket_accept(socket);
+  }
   map_insert(&data->state, strings_intern("handle"), sh);
 
   return data->object;
@@ -112,6 +162,11 @@ Element SocketHandle_deconstructor(VM *vm, Thread *t, ExternalData *data,
   }
   sockethandle_close(sh);
   sockethandle_delete(sh);
+  SocketReader *reader =
+      (SocketReader *)map_lookup(&data->state, strings_intern("reader"));
+  if (NULL != reader) {
+    socket_reader_delete(reader);
+  }
   return create_none();
 }
 
@@ -126,29 +181,178 @@ Element SocketHandle_close(VM *vm, Thread *t, ExternalData *data,
   return create_none();
 }
 
+// In a green Thread, makes sh non-blocking so calls which would block can park
+// instead.
+void sockethandle_prepare(Thread *t, ExternalData *data, SocketHandle *sh) {
+  if (t_can_park(t) &&
+      NULL == map_lookup(&data->state, strings_intern("nonblocking"))) {
+    sockethandle_set_nonblocking(sh);
+    map_insert(&data->state, strings_intern("nonblocking"), sh);
+  }
+}
+
+// Parks t until sh has events if the failed call before this only failed
+// because it would have blocked. fn is then called again with data and arg.
+bool sockethandle_park(Thread *t, ExternalData *data, SocketHandle *sh,
+                       int events, ExternalFunction fn, Element *arg) {
+  return socket_would_block() &&
+         t_park(t, sockethandle_get_socket(sh), events, fn, data, arg);
+}
+
+// send(msg): Sends a String or Array of Strings, the latter with a single
+// writev. A green Thread parks until the socket takes all of it; other threads
+// wait for it.
 Element SocketHandle_send(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   SocketHandle *sh =
       (SocketHandle *)map_lookup(&data->state, strings_intern("handle"));
   if (NULL == sh) {
     return throw_error(vm, t, "Weird Socket error.");
   }
+  SocketBuffer single, *bufs = &single;
+  int i, num_bufs = 1;
   if (ISTYPE(*arg, class_string)) {
     String *msg = String_extract(*arg);
-    sockethandle_send(sh, String_cstr(msg), String_size(msg));
-    return create_none();
+    single.data = String_cstr(msg);
+    single.len = String_size(msg);
   } else if (ISTYPE(*arg, class_array)) {
-    Array *arr = extract_array(*arg);
-    int i, arr_len = Array_size(arr);
-    for (i = 0; i < arr_len; ++i) {
-      String *msg = String_extract(Array_get(arr, i));
-      sockethandle_send(sh, String_cstr(msg), String_size(msg));
+    bufs = socket_buffers_of(*arg, &num_bufs);
+    if (NULL == bufs) {
+      return throw_error(vm, t, "Cannot send non-string.");
     }
-    return create_none();
   } else {
     return throw_error(vm, t, "Cannot send non-string.");
   }
+  sockethandle_prepare(t, data, sh);
+  // What got out before the last park.
+  int64_t sent = (intptr_t)map_lookup(&data->state, strings_intern("sent"));
+  // map_insert() keeps an existing value.
+  map_remove(&data->state, strings_intern("sent"));
+  SocketBuffer *rest = bufs;
+  int num_rest = num_bufs;
+  int64_t skip = sent;
+  bool failed = false;
+  while (true) {
+    for (; num_rest > 0 && skip >= rest[0].len; ++rest, --num_rest) {
+      skip -= rest[0].len;
+    }
+    if (0 == num_rest) {
+      break;
+    }
+    rest[0].data += skip;
+    rest[0].len -= skip;
+    int64_t pending = 0;
+    for (i = 0; i < num_rest; ++i) {
+      pending += rest[i].len;
+    }
+    int64_t written = sockethandle_sendv(sh, rest, num_rest);
+    if (written < 0) {
+      failed = true;
+      break;
+    }
+    sent += written;
+    skip = written;
+    if (written == pending) {
+      continue;
+    }
+    // Only a non-blocking handle stops short.
+    if (sockethandle_park(t, data, sh, EVENT_WRITABLE, SocketHandle_send,
+                          arg)) {
+      map_insert(&data->state, strings_intern("sent"),
+                 (void *)(intptr_t)sent);
+      break;
+    }
+    if (!sockethandle_await_writable(sh)) {
+      failed = true;
+      break;
+    }
+  }
+  if (bufs != &single) {
+    DEALLOC(bufs);
+  }
+  return failed ? throw_error(vm, t, "Could not send.") : create_none();
+}
+
+// send_file(path): Sends the contents of a file, letting the kernel copy them
+// where it can. Returns the number of bytes sent. A green Thread parks until
+// the socket takes all of it, like send().
+Element SocketHandle_send_file(VM *vm, Thread *t, ExternalData *data,
+                               Element *arg) {
+  SocketHandle *sh =
+      (SocketHandle *)map_lookup(&data->state, strings_intern("handle"));
+  if (NULL == sh) {
+    return throw_error(vm, t, "Weird Socket error.");
+  }
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "send_file() expects a path.");
+  }
+  sockethandle_prepare(t, data, sh);
+  // Where the last park left off.
+  int64_t size,
+      offset = (intptr_t)map_lookup(&data->state, strings_intern("file_sent"));
+  // map_insert() keeps an existing value.
+  map_remove(&data->state, strings_intern("file_sent"));
+  String *path_str = String_extract(*arg);
+  int file_fd = socket_file_open(String_cstr(path_str), String_size(path_str),
+                                 &size);
+  if (file_fd < 0) {
+    return throw_error(vm, t, "Could not open file.");
+  }
+  bool failed = false, parked = false;
+  // A non-blocking handle may only take part of it per call.
+  while (offset < size) {
+    if (sockethandle_send_file(sh, file_fd, &offset, size - offset) < 0) {
+      failed = true;
+      break;
+    }
+    if (offset == size) {
+      break;
+    }
+    if (sockethandle_park(t, data, sh, EVENT_WRITABLE, SocketHandle_send_file,
+                          arg)) {
+      map_insert(&data->state, strings_intern("file_sent"),
+                 (void *)(intptr_t)offset);
+      parked = true;
+      break;
+    }
+    if (!sockethandle_await_writable(sh)) {
+      failed = true;
+      break;
+    }
+  }
+  socket_file_close(file_fd);
+  if (failed) {
+    return throw_error(vm, t, "Could not send file.");
+  }
+  return parked ? create_none() : create_int(offset);
+}
+
+// The buffer for reads on a handle, made on first use.
+SocketReader *sockethandle_reader(ExternalData *data) {
+  SocketReader *reader =
+      (SocketReader *)map_lookup(&data->state, strings_intern("reader"));
+  if (NULL == reader) {
+    reader = socket_reader_create();
+    map_insert(&data->state, strings_intern("reader"), reader);
+  }
+  return reader;
 }
 
+// Takes the first len buffered bytes as a String.
+Element sockethandle_take(VM *vm, SocketReader *reader, uint32_t len) {
+  String *str = String_create_sz(max(len, 1));
+  SocketBuffer parts[2];
+  int i, num_parts = socket_reader_peek(reader, len, parts);
+  for (i = 0; i < num_parts; ++i) {
+    String_append_cstr(str, parts[i].data, parts[i].len);
+  }
+  socket_reader_consume(reader, len);
+  return string_adopt(vm, str);
+}
+
+// receive() or read_available(): Whatever is buffered, or else what one
+// receive gets. None if nothing is available yet on a non-blocking handle or
+// the receive failed, and '' once the peer is gone. A green Thread parks until
+// something arrives.
 Element SocketHandle_receive(VM *vm, Thread *t, ExternalData *data,
                              Element *arg) {
   SocketHandle *sh =
@@ -156,23 +360,130 @@ Element SocketHandle_receive(VM *vm, Thread *t, ExternalData *data,
   if (NULL == sh) {
     return throw_error(vm, t, "Weird Socket error.");
   }
+  SocketReader *reader = sockethandle_reader(data);
+  if (0 == socket_reader_size(reader)) {
+    sockethandle_prepare(t, data, sh);
+    int32_t received = socket_reader_fill(reader, sh);
+    if (received < 0) {
+      sockethandle_park(t, data, sh, EVENT_READABLE, SocketHandle_receive,
+                        arg);
+      return create_none();
+    }
+    if (0 == received) {
+      return string_create_len(vm, NULL, 0);
+    }
+  }
+  return sockethandle_take(vm, reader, socket_reader_size(reader));
+}
+
+// read_until(delim): Receives until delim arrives and gives everything up to
+// and including it. None if the peer is gone, a receive fails or times out, or
+// a non-blocking handle runs dry first. Whatever was received stays buffered
+// for the next read, and a green Thread parks until more arrives.
+Element SocketHandle_read_until(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  SocketHandle *sh =
+      (SocketHandle *)map_lookup(&data->state, strings_intern("handle"));
+  if (NULL == sh) {
+    return throw_error(vm, t, "Weird Socket error.");
+  }
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "read_until() expects a String.");
+  }
+  String *delim = String_extract(*arg);
+  uint32_t delim_len = String_size(delim), from = 0;
+  SocketReader *reader = sockethandle_reader(data);
+  sockethandle_prepare(t, data, sh);
+  while (true) {
+    int64_t index =
+        socket_reader_find(reader, String_cstr(delim), delim_len, from);
+    if (index >= 0) {
+      return sockethandle_take(vm, reader, index + delim_len);
+    }
+    uint32_t size = socket_reader_size(reader);
+    if (size >= SOCKET_READER_MAX_SIZE) {
+      return throw_error(vm, t, "read_until() did not find the delimiter.");
+    }
+    // Only bytes which could start a delimiter are looked at again.
+    from = size >= delim_len ? size - delim_len + 1 : 0;
+    int32_t received = socket_reader_fill(reader, sh);
+    if (received <= 0) {
+      if (received < 0) {
+        sockethandle_park(t, data, sh, EVENT_READABLE, SocketHandle_read_until,
+                          arg);
+      }
+      return create_none();
+    }
+  }
+}
 
-  char buf[BUFFER_SIZE];
-  int chars_received = sockethandle_receive(sh, buf, BUFFER_SIZE);
+// read_exact(n): Receives until n bytes have arrived and gives them. None like
+// read_until().
+Element SocketHandle_read_exact(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  SocketHandle *sh =
+      (SocketHandle *)map_lookup(&data->state, strings_intern("handle"));
+  if (NULL == sh) {
+    return throw_error(vm, t, "Weird Socket error.");
+  }
+  if (!is_value_type(arg, INT) || arg->val.int_val < 0) {
+    return throw_error(vm, t, "read_exact() expects a non-negative Int.");
+  }
+  SocketReader *reader = sockethandle_reader(data);
+  uint32_t len = arg->val.int_val;
+  if (arg->val.int_val > SOCKET_READER_MAX_SIZE ||
+      !socket_reader_reserve(reader, len)) {
+    return throw_error(vm, t, "read_exact() size is too large.");
+  }
+  sockethandle_prepare(t, data, sh);
+  while (socket_reader_size(reader) < len) {
+    int32_t received = socket_reader_fill(reader, sh);
+    if (received <= 0) {
+      if (received < 0) {
+        sockethandle_park(t, data, sh, EVENT_READABLE, SocketHandle_read_exact,
+                          arg);
+      }
+      return create_none();
+    }
+  }
+  return sockethandle_take(vm, reader, len);
+}
 
-  return string_create_len(vm, buf, chars_received);
+// set_timeout(msec): Makes receive() give None if nothing arrives in time.
+Element SocketHandle_set_timeout(VM *vm, Thread *t, ExternalData *data,
+                                 Element *arg) {
+  SocketHandle *sh =
+      (SocketHandle *)map_lookup(&data->state, strings_intern("handle"));
+  if (NULL == sh) {
+    return throw_error(vm, t, "Weird Socket error.");
+  }
+  if (!is_value_type(arg, INT) || arg->val.int_val < 0) {
+    return throw_error(vm, t, "Timeout must be a non-negative Int.");
+  }
+  sockethandle_set_receive_timeout(sh, arg->val.int_val);
+  return data->object;
 }
 
 Element add_sockethandle_class(VM *vm, Element module) {
-  sh_class = create_external_class(vm, module, strings_intern("SocketHandle"),
+  class_sockethandle = create_external_class(vm, module, strings_intern("SocketHandle"),
                                    SocketHandle_constructor,
                                    SocketHandle_deconstructor);
-  add_external_method(vm, sh_class, strings_intern("send"), SocketHandle_send);
-  add_external_method(vm, sh_class, strings_intern("receive"),
+  add_external_method(vm, class_sockethandle, strings_intern("send"), SocketHandle_send);
+  add_external_method(vm, class_sockethandle, strings_intern("receive"),
+                      SocketHandle_receive);
+  add_external_method(vm, class_sockethandle, strings_intern("read_available"),
                       SocketHandle_receive);
-  add_external_method(vm, sh_class, strings_intern("close"),
+  add_external_method(vm, class_sockethandle, strings_intern("read_until"),
+                      SocketHandle_read_until);
+  add_external_method(vm, class_sockethandle, strings_intern("read_exact"),
+                      SocketHandle_read_exact);
+  add_external_method(vm, class_sockethandle, strings_intern("close"),
                       SocketHandle_close);
-  return sh_class;
+  add_external_method(vm, class_sockethandle, strings_intern("send_file"),
+                      SocketHandle_send_file);
+  add_external_method(vm, class_sockethandle, strings_intern("set_timeout"),
+                      SocketHandle_set_timeout);
+  return class_sockethandle;
 }
 
 Element add_socket_class(VM *vm, Element module) {
@@ -10,7 +10,17 @@
 
 #include "../../element.h"
 
+#include "impl/socket.h"
+
 extern Element class_socket;
+extern Element class_sockethandle;
+
+// Points at the chars of an Array of Strings. NULL if it has a non-String.
+// The result must be DEALLOC'd.
+SocketBuffer *socket_buffers_of(Element arr_elt, int *num_bufs);
+
+// Wraps an accepted handle in a SocketHandle, which takes ownership of it.
+Element sockethandle_wrap(VM *vm, SocketHandle *sh);
 
 Element add_sockethandle_class(VM *vm, Element module);
 Element add_socket_class(VM *vm, Element module);
@@ -16,12 +16,12 @@
 #include "../../datastructure/tuple.h"
 #include "../../element.h"
 #include "../../error.h"
+#include "../../memory/memory.h"
 #include "../../memory/memory_graph.h"
 #include "../external.h"
 #include "../strings.h"
 #include "socket.h"
 
-#define BUFFER_SIZE 4096
 #define SOCKET_ERROR (-1)
 
 static Element ssl_sh_class;
@@ -90,6 +90,24 @@ Element SSLSocket_close(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   return create_none();
 }
 
+// handshake_counts(): (full, resumed) handshakes of the connections accepted
+// so far. Resumed ones reused a session from a ticket or the session cache.
+Element SSLSocket_handshake_counts(VM *vm, Thread *t, ExternalData *data,
+                                   Element *arg) {
+  SSLSocket *ssl_socket =
+      (SSLSocket *)map_lookup(&data->state, strings_intern("ssl_socket"));
+  if (NULL == ssl_socket) {
+    return throw_error(vm, t, "Weird SSLSocket error. (handshake_counts)");
+  }
+  uint64_t full_handshakes, resumed_handshakes;
+  sslsocket_handshake_counts(ssl_socket, &full_handshakes,
+                             &resumed_handshakes);
+  Element counts = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, counts, create_int(full_handshakes));
+  memory_graph_tuple_add(vm->graph, counts, create_int(resumed_handshakes));
+  return counts;
+}
+
 // To ease finding sockethandle class.
 Element SSLSocket_accept(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   SSLSocket *ssl_socket =
@@ -155,13 +173,13 @@ Element SSLSocketHandle_send(VM *vm, Thread *t, ExternalData *data,
     return create_int(
         sslsockethandle_send(ssl_sh, String_cstr(msg), String_size(msg)));
   } else if (ISTYPE(*arg, class_array)) {
-    Array *arr = extract_array(*arg);
-    int i, arr_len = Array_size(arr), bytes_sent = 0;
-    for (i = 0; i < arr_len; ++i) {
-      String *msg = String_extract(Array_get(arr, i));
-      bytes_sent +=
-          sslsockethandle_send(ssl_sh, String_cstr(msg), String_size(msg));
+    int num_bufs;
+    SocketBuffer *bufs = socket_buffers_of(*arg, &num_bufs);
+    if (NULL == bufs) {
+      return throw_error(vm, t, "Cannot send non-string.");
     }
+    int64_t bytes_sent = sslsockethandle_sendv(ssl_sh, bufs, num_bufs);
+    DEALLOC(bufs);
     return create_int(bytes_sent);
   } else {
     return throw_error(vm, t, "Cannot send non-string.");
@@ -175,9 +193,54 @@ Element SSLSocketHandle_receive(VM *vm, Thread *t, ExternalData *data,
   if (NULL == ssl_sh) {
     return throw_error(vm, t, "Weird SSLSocketHandle error. (receive)");
   }
-  char buf[BUFFER_SIZE];
-  int chars_received = sslsockethandle_receive(ssl_sh, buf, BUFFER_SIZE);
-  return string_create_len(vm, buf, chars_received);
+  // Room for a whole record, so one receive() does not split it.
+  char *buf = ssl_buffer_acquire();
+  int chars_received = sslsockethandle_receive(ssl_sh, buf, SSL_BUFFER_SIZE);
+  // The receive timeout passed.
+  Element received = chars_received < 0
+                         ? create_none()
+                         : string_create_len(vm, buf, chars_received);
+  ssl_buffer_release(buf);
+  return received;
+}
+
+// send_file(path): Sends the contents of a file. Returns the number of bytes
+// sent.
+Element SSLSocketHandle_send_file(VM *vm, Thread *t, ExternalData *data,
+                                  Element *arg) {
+  SSLSocketHandle *ssl_sh =
+      (SSLSocketHandle *)map_lookup(&data->state, strings_intern("ssl_handle"));
+  if (NULL == ssl_sh) {
+    return throw_error(vm, t, "Weird SSLSocketHandle error. (send_file)");
+  }
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "send_file() expects a path.");
+  }
+  int64_t size;
+  String *path_str = String_extract(*arg);
+  int file_fd = socket_file_open(String_cstr(path_str), String_size(path_str),
+                                 &size);
+  if (file_fd < 0) {
+    return throw_error(vm, t, "Could not open file.");
+  }
+  int64_t bytes_sent = sslsockethandle_send_file(ssl_sh, file_fd, size);
+  socket_file_close(file_fd);
+  return create_int(bytes_sent);
+}
+
+// set_timeout(msec): Makes receive() give None if nothing arrives in time.
+Element SSLSocketHandle_set_timeout(VM *vm, Thread *t, ExternalData *data,
+                                    Element *arg) {
+  SSLSocketHandle *ssl_sh =
+      (SSLSocketHandle *)map_lookup(&data->state, strings_intern("ssl_handle"));
+  if (NULL == ssl_sh) {
+    return throw_error(vm, t, "Weird SSLSocketHandle error. (set_timeout)");
+  }
+  if (!is_value_type(arg, INT) || arg->val.int_val < 0) {
+    return throw_error(vm, t, "Timeout must be a non-negative Int.");
+  }
+  sslsockethandle_set_receive_timeout(ssl_sh, arg->val.int_val);
+  return data->object;
 }
 
 Element add_sslsockethandle_class(VM *vm, Element *module) {
@@ -190,6 +253,10 @@ Element add_sslsockethandle_class(VM *vm, Element *module) {
                       SSLSocketHandle_receive);
   add_external_method(vm, ssl_sh_class, strings_intern("close"),
                       SSLSocketHandle_close);
+  add_external_method(vm, ssl_sh_class, strings_intern("send_file"),
+                      SSLSocketHandle_send_file);
+  add_external_method(vm, ssl_sh_class, strings_intern("set_timeout"),
+                      SSLSocketHandle_set_timeout);
   return ssl_sh_class;
 }
 
@@ -201,5 +268,7 @@ Element add_sslsocket_class(VM *vm, Element *module) {
                       SSLSocket_accept);
   add_external_method(vm, ssl_socket_class, strings_intern("close"),
                       SSLSocket_close);
+  add_external_method(vm, ssl_socket_class, strings_intern("handshake_counts"),
+                      SSLSocket_handshake_counts);
   return ssl_socket_class;
 }
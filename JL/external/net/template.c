@@ -0,0 +1,221 @@
+/*
+ * template.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "template.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../arena/strings.h"
+#include "../../class.h"
+#include "../../datastructure/map.h"
+#include "../../datastructure/tuple.h"
+#include "../../element.h"
+#include "../../error.h"
+#include "../../memory/memory.h"
+#include "../../memory/memory_graph.h"
+#include "../../threads/thread.h"
+#include "../../vm/vm.h"
+#include "../external.h"
+#include "../strings.h"
+#include "impl/template.h"
+
+// Template(src, keys): Compiles src once into literals and slots for whichever
+// of the String keys appear in it, so rendering is a single pass into one
+// buffer of the right size.
+Element Template_constructor(VM *vm, Thread *t, ExternalData *data,
+                             Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "Template() expects (src, keys).");
+  }
+  Element src = tuple_get(arg->obj->tuple, 0);
+  Element keys = tuple_get(arg->obj->tuple, 1);
+  int32_t i, num_keys = sequence_size(&keys);
+  if (!ISTYPE(src, class_string) || num_keys < 0) {
+    return throw_error(vm, t, "Template() expects (src, keys).");
+  }
+  TemplateKey *template_keys = ALLOC_ARRAY2(TemplateKey, max(num_keys, 1));
+  for (i = 0; i < num_keys; ++i) {
+    Element key = sequence_get(&keys, i);
+    if (!ISTYPE(key, class_string)) {
+      DEALLOC(template_keys);
+      return throw_error(vm, t, "Template keys must be Strings.");
+    }
+    template_keys[i].text = String_cstr(String_extract(key));
+    template_keys[i].len = String_size(String_extract(key));
+  }
+  String *src_str = String_extract(src);
+  TemplateProgram *program = ALLOC2(TemplateProgram);
+  template_compile(program, String_cstr(src_str), String_size(src_str),
+                   template_keys, num_keys);
+  DEALLOC(template_keys);
+  // Only keys which appear are kept, so each is looked up once per render.
+  int32_t *slots = ALLOC_ARRAY2(int32_t, max(num_keys, 1));
+  for (i = 0; i < num_keys; ++i) {
+    slots[i] = -1;
+  }
+  Element used_keys = create_tuple(vm->graph);
+  for (i = 0; i < program->num_pieces; ++i) {
+    TemplatePiece *piece = &program->pieces[i];
+    if (piece->slot < 0) {
+      continue;
+    }
+    if (slots[piece->slot] < 0) {
+      slots[piece->slot] = tuple_size(used_keys.obj->tuple);
+      memory_graph_tuple_add(vm->graph, used_keys,
+                             sequence_get(&keys, piece->slot));
+    }
+    piece->slot = slots[piece->slot];
+  }
+  DEALLOC(slots);
+  map_insert(&data->state, strings_intern("program"), program);
+  // Pieces point into $src.
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$src"), src);
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$keys"),
+                         used_keys);
+  return data->object;
+}
+
+Element Template_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                               Element *arg) {
+  TemplateProgram *program =
+      (TemplateProgram *)map_lookup(&data->state, strings_intern("program"));
+  if (NULL != program) {
+    template_finalize(program);
+    DEALLOC(program);
+  }
+  return create_none();
+}
+
+// Looks up each key in params as params[key] would. None renders as nothing
+// and other non-Strings as str() would.
+bool template_values(VM *vm, Thread *t, Element keys, Element params,
+                     Element values) {
+  Element *index_fn = (OBJECT == params.type)
+                          ? obj_deep_lookup(params.obj, ARRAYLIKE_INDEX_KEY)
+                          : NULL;
+  if (NULL == index_fn || NONE == index_fn->type) {
+    throw_error(vm, t, "render() expects params which can be indexed.");
+    return false;
+  }
+  int32_t i, num_keys = tuple_size(keys.obj->tuple);
+  for (i = 0; i < num_keys; ++i) {
+    Element value;
+    if (!vm_call_fn_sync(vm, t, params, *index_fn,
+                         tuple_get(keys.obj->tuple, i), &value)) {
+      return false;
+    }
+    if (!ISTYPE(value, class_string)) {
+      // to_s() can run anything, so keep value reachable until it is in
+      // values.
+      t_pushstack(t, value);
+      String *str = String_create();
+      bool converted =
+          NONE == value.type || String_append_element(vm, t, str, value);
+      bool has_error = false;
+      t_popstack(t, &has_error);
+      if (!converted) {
+        String_delete(str);
+        return false;
+      }
+      value = string_adopt(vm, str);
+    }
+    memory_graph_tuple_add(vm->graph, values, value);
+  }
+  return true;
+}
+
+Element template_render(VM *vm, Thread *t, ExternalData *data, Element params,
+                        bool escape) {
+  TemplateProgram *program =
+      (TemplateProgram *)map_lookup(&data->state, strings_intern("program"));
+  Element src = obj_get_field(data->object, strings_intern("$src"));
+  if (0 == program->num_slots) {
+    return src;
+  }
+  Element values = create_tuple(vm->graph);
+  Element keys = obj_get_field(data->object, strings_intern("$keys"));
+  // Looking up values can run anything, so keep them reachable.
+  t_pushstack(t, values);
+  bool has_error = false;
+  if (!template_values(vm, t, keys, params, values)) {
+    t_popstack(t, &has_error);
+    return t_get_resval(t);
+  }
+  const char *src_chars = String_cstr(String_extract(src));
+  size_t len = program->literal_len;
+  int32_t i;
+  for (i = 0; i < program->num_pieces; ++i) {
+    TemplatePiece *piece = &program->pieces[i];
+    if (piece->slot < 0) {
+      continue;
+    }
+    String *value = String_extract(tuple_get(values.obj->tuple, piece->slot));
+    len += escape ? html_escaped_len(String_cstr(value), String_size(value))
+                  : String_size(value);
+  }
+  // One more for the terminating NUL.
+  String *result = String_create_sz(max(len + 1, DEFAULT_TABLE_SIZE));
+  char *pos = result->table;
+  for (i = 0; i < program->num_pieces; ++i) {
+    TemplatePiece *piece = &program->pieces[i];
+    if (piece->slot < 0) {
+      memcpy(pos, src_chars + piece->start, piece->len);
+      pos += piece->len;
+      continue;
+    }
+    String *value = String_extract(tuple_get(values.obj->tuple, piece->slot));
+    if (escape) {
+      pos = html_escape_into(pos, String_cstr(value), String_size(value));
+    } else {
+      memcpy(pos, String_cstr(value), String_size(value));
+      pos += String_size(value);
+    }
+  }
+  result->num_elts = len;
+  Element rendered = string_adopt(vm, result);
+  t_popstack(t, &has_error);
+  return rendered;
+}
+
+// render(params): The template with each key replaced by params[key].
+Element Template_render(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return template_render(vm, t, data, *arg, false);
+}
+
+// render_escaped(params): Like render(), with the values HTML-escaped.
+Element Template_render_escaped(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  return template_render(vm, t, data, *arg, true);
+}
+
+// html_escape(text): text with '<' and '>' replaced by entities.
+Element template_html_escape(VM *vm, Thread *t, ExternalData *data,
+                             Element *arg) {
+  if (!ISTYPE(*arg, class_string)) {
+    return throw_error(vm, t, "html_escape() expects a String.");
+  }
+  String *text = String_extract(*arg);
+  size_t len = html_escaped_len(String_cstr(text), String_size(text));
+  String *result = String_create_sz(max(len + 1, DEFAULT_TABLE_SIZE));
+  html_escape_into(result->table, String_cstr(text), String_size(text));
+  result->num_elts = len;
+  return string_adopt(vm, result);
+}
+
+Element add_template_class(VM *vm, Element module) {
+  add_external_function(vm, module, strings_intern("html_escape"),
+                        template_html_escape);
+  Element template =
+      create_external_class(vm, module, strings_intern("Template"),
+                            Template_constructor, Template_deconstructor);
+  add_external_method(vm, template, strings_intern("render"),
+                      Template_render);
+  add_external_method(vm, template, strings_intern("render_escaped"),
+                      Template_render_escaped);
+  return template;
+}
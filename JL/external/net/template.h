@@ -0,0 +1,15 @@
+/*
+ * template.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_NET_TEMPLATE_H_
+#define EXTERNAL_NET_TEMPLATE_H_
+
+#include "../../element.h"
+
+Element add_template_class(VM *vm, Element module);
+
+#endif /* EXTERNAL_NET_TEMPLATE_H_ */
@@ -0,0 +1,92 @@
+/*
+ * string_builder.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "string_builder.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../arena/strings.h"
+#include "../class.h"
+#include "../datastructure/map.h"
+#include "../element.h"
+#include "../error.h"
+#include "../memory/memory_graph.h"
+#include "../shared.h"
+#include "../threads/thread.h"
+#include "../vm/vm.h"
+#include "external.h"
+#include "strings.h"
+
+// Pieces are copied into a single buffer which grows geometrically, so
+// building a String of n bytes is O(n) rather than O(n^2) with extend().
+
+void string_builder_set_len(VM *vm, ExternalData *data, String *buffer) {
+  Element len = create_int(String_size(buffer));
+  memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY, &len);
+}
+
+Element string_builder_constructor(VM *vm, Thread *t, ExternalData *data,
+                                   Element *arg) {
+  String *buffer = String_create();
+  map_insert(&data->state, strings_intern("builder"), buffer);
+  bool has_initial = NONE != arg->type && arg->obj != vm->empty_tuple.obj;
+  if (has_initial && !String_append_element(vm, t, buffer, *arg)) {
+    return t_get_resval(t);
+  }
+  string_builder_set_len(vm, data, buffer);
+  return data->object;
+}
+
+Element string_builder_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                     Element *arg) {
+  String *buffer = map_lookup(&data->state, strings_intern("builder"));
+  if (NULL != buffer) {
+    String_delete(buffer);
+  }
+  return create_none();
+}
+
+Element string_builder_append(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  String *buffer = map_lookup(&data->state, strings_intern("builder"));
+  ASSERT(NOT_NULL(buffer));
+  if (!String_append_element(vm, t, buffer, *arg)) {
+    return t_get_resval(t);
+  }
+  string_builder_set_len(vm, data, buffer);
+  return data->object;
+}
+
+Element string_builder_to_s(VM *vm, Thread *t, ExternalData *data,
+                            Element *arg) {
+  String *buffer = map_lookup(&data->state, strings_intern("builder"));
+  ASSERT(NOT_NULL(buffer));
+  return string_create_len(vm, String_cstr(buffer), String_size(buffer));
+}
+
+Element string_builder_clear(VM *vm, Thread *t, ExternalData *data,
+                             Element *arg) {
+  String *buffer = map_lookup(&data->state, strings_intern("builder"));
+  ASSERT(NOT_NULL(buffer));
+  String_clear(buffer);
+  string_builder_set_len(vm, data, buffer);
+  return data->object;
+}
+
+Element create_string_builder_class(VM *vm, Element module) {
+  Element builder_class = create_external_class(
+      vm, module, strings_intern("StringBuilder"), string_builder_constructor,
+      string_builder_deconstructor);
+  add_external_method(vm, builder_class, strings_intern("append"),
+                      string_builder_append);
+  add_external_method(vm, builder_class, strings_intern("to_s"),
+                      string_builder_to_s);
+  add_external_method(vm, builder_class, strings_intern("clear"),
+                      string_builder_clear);
+  return builder_class;
+}
@@ -0,0 +1,15 @@
+/*
+ * string_builder.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_STRING_BUILDER_H_
+#define EXTERNAL_STRING_BUILDER_H_
+
+#include "../element.h"
+
+Element create_string_builder_class(VM *vm, Element module);
+
+#endif /* EXTERNAL_STRING_BUILDER_H_ */
@@ -25,31 +25,52 @@
 #include "../ltable/ltable.h"
 #include "../memory/memory_graph.h"
 #include "../shared.h"
+#include "../threads/thread.h"
+#include "../vm/vm.h"
 #include "external.h"
 
-Element stringify__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
-  ASSERT(argument->type == VALUE);
-  Value val = argument->val;
-  static const int BUFFER_SIZE = 128;
-  char buffer[BUFFER_SIZE];
+#define VALUE_BUFFER_SIZE 128
+
+int value_to_cstr(Value val, char buffer[], int buffer_size) {
   int num_written = 0;
   switch (val.type) {
     case INT:
-      num_written = snprintf(buffer, BUFFER_SIZE, "%" PRId64, val.int_val);
+      num_written = snprintf(buffer, buffer_size, "%" PRId64, val.int_val);
       break;
     case FLOAT:
-      num_written = snprintf(buffer, BUFFER_SIZE, "%f", val.float_val);
+      num_written = snprintf(buffer, buffer_size, "%f", val.float_val);
       break;
     default /*CHAR*/:
-      num_written = snprintf(buffer, BUFFER_SIZE, "%c", val.char_val);
+      num_written = snprintf(buffer, buffer_size, "%c", val.char_val);
       break;
   }
   ASSERT(num_written > 0);
+  return num_written;
+}
+
+Element stringify__(VM *vm, Thread *t, ExternalData *ed, Element *argument) {
+  ASSERT(argument->type == VALUE);
+  char buffer[VALUE_BUFFER_SIZE];
+  int num_written = value_to_cstr(argument->val, buffer, VALUE_BUFFER_SIZE);
   return string_create_len_unescape(vm, buffer, num_written);
 }
 
 IMPL_ARRAYLIKE(String, char);
 
+// Chars shared by a String and the slices taken from it. Whichever of them
+// drops the last reference frees the chars.
+typedef struct {
+  char *chars;
+  int32_t refs;
+} SharedChars;
+
+void shared_chars_release(SharedChars *shared) {
+  if (0 == __sync_sub_and_fetch(&shared->refs, 1)) {
+    DEALLOC(shared->chars);
+    DEALLOC(shared);
+  }
+}
+
 const char *String_cstr(const String *const string) { return string->table; }
 
 void String_append_unescape(String *string, const char str[], size_t len) {
@@ -137,12 +158,215 @@ Element string_constructor(VM *vm, Thread *t, ExternalData *data,
 Element string_deconstructor(VM *vm, Thread *t, ExternalData *data,
                              Element *arg) {
   String *string = map_lookup(&data->state, STRING_NAME);
-  if (NULL != string) {
+  SharedChars *shared = map_lookup(&data->state, SHARED_CHARS_KEY);
+  if (NULL != shared) {
+    // The chars are not ours to free.
+    DEALLOC(string);
+    shared_chars_release(shared);
+  } else if (NULL != string) {
     String_delete(string);
   }
   return create_none();
 }
 
+Element string_adopt(VM *vm, String *string) {
+  Element elt = create_external_obj(vm, class_string);
+  ASSERT(NONE != elt.type);
+  String_fill(vm, elt.obj->external_data, string);
+  elt.obj->external_data->deconstructor = string_deconstructor;
+  return elt;
+}
+
+bool String_append_element(VM *vm, Thread *t, String *string, Element elt) {
+  if (NONE == elt.type) {
+    String_append_cstr(string, NIL_KEYWORD, strlen(NIL_KEYWORD));
+    return true;
+  }
+  if (VALUE == elt.type) {
+    char buffer[VALUE_BUFFER_SIZE];
+    String_append_cstr(string, buffer,
+                       value_to_cstr(elt.val, buffer, VALUE_BUFFER_SIZE));
+    return true;
+  }
+  if (!ISTYPE(elt, class_string)) {
+    Element to_s = *obj_deep_lookup(elt.obj, strings_intern("to_s"));
+    if (NONE == to_s.type) {
+      throw_error(vm, t, "Object has no to_s().");
+      return false;
+    }
+    if (!vm_call_fn_sync(vm, t, elt, to_s, vm->empty_tuple, &elt)) {
+      return false;
+    }
+    if (!ISTYPE(elt, class_string)) {
+      throw_error(vm, t, "to_s() must return a String.");
+      return false;
+    }
+  }
+  String_append(string, String_extract(elt));
+  return true;
+}
+
+// Returns the number of elements in arg if it is a Tuple or Array, otherwise
+// -1.
+int32_t sequence_size(const Element *arg) {
+  if (is_object_type(arg, TUPLE)) {
+    return tuple_size(arg->obj->tuple);
+  }
+  if (is_object_type(arg, ARRAY)) {
+    return Array_size(arg->obj->array);
+  }
+  return -1;
+}
+
+Element sequence_get(const Element *arg, uint32_t index) {
+  return is_object_type(arg, TUPLE) ? tuple_get(arg->obj->tuple, index)
+                                    : Array_get(arg->obj->array, index);
+}
+
+Element concat__(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  int32_t i, num_elts = sequence_size(arg);
+  if (num_elts < 0) {
+    String *result = String_create();
+    if (!String_append_element(vm, t, result, *arg)) {
+      String_delete(result);
+      return t_get_resval(t);
+    }
+    return string_adopt(vm, result);
+  }
+  // Reserve enough for everything but the Objects up front.
+  uint32_t len = 0;
+  for (i = 0; i < num_elts; ++i) {
+    Element elt = sequence_get(arg, i);
+    if (ISTYPE(elt, class_string)) {
+      len += String_size(String_extract(elt));
+    } else if (VALUE == elt.type) {
+      len += 24;
+    } else if (NONE == elt.type) {
+      len += strlen(NIL_KEYWORD);
+    }
+  }
+  // One more for the terminating NUL.
+  String *result = String_create_sz(max(len + 1, DEFAULT_TABLE_SIZE));
+  // to_s() can run anything, so keep args reachable and look up each element
+  // only when it is needed.
+  Element args = *arg;
+  t_pushstack(t, args);
+  bool failed = false;
+  for (i = 0; i < num_elts && i < sequence_size(&args); ++i) {
+    if (!String_append_element(vm, t, result, sequence_get(&args, i))) {
+      failed = true;
+      break;
+    }
+  }
+  bool has_error = false;
+  t_popstack(t, &has_error);
+  if (failed) {
+    String_delete(result);
+    return t_get_resval(t);
+  }
+  return string_adopt(vm, result);
+}
+
+Element string_join(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  int32_t i, num_elts = sequence_size(arg);
+  if (num_elts < 0) {
+    return throw_error(vm, t, "Can only join an Array or Tuple.");
+  }
+  String *delim = String_extract(data->object);
+  uint32_t len = 0;
+  for (i = 0; i < num_elts; ++i) {
+    Element elt = sequence_get(arg, i);
+    if (!ISTYPE(elt, class_string)) {
+      return throw_error(vm, t, "Can only join Strings.");
+    }
+    len += String_size(String_extract(elt));
+  }
+  if (num_elts > 0) {
+    len += (num_elts - 1) * String_size(delim);
+  }
+  // One more for the terminating NUL.
+  String *result = String_create_sz(max(len + 1, DEFAULT_TABLE_SIZE));
+  char *pos = result->table;
+  for (i = 0; i < num_elts; ++i) {
+    if (i > 0) {
+      memcpy(pos, String_cstr(delim), String_size(delim));
+      pos += String_size(delim);
+    }
+    String *piece = String_extract(sequence_get(arg, i));
+    memcpy(pos, String_cstr(piece), String_size(piece));
+    pos += String_size(piece);
+  }
+  result->num_elts = len;
+  return string_adopt(vm, result);
+}
+
+String *String_mutable(ExternalData *data) {
+  String *string = map_lookup(&data->state, STRING_NAME);
+  ASSERT(NOT_NULL(string));
+#ifdef ENABLE_MEMORY_LOCK
+  // Same lock as string_slice(), so a slice cannot share the chars as they
+  // stop being shared.
+  mutex_await(data->object.obj->node->access_mutex, INFINITE);
+#endif
+  SharedChars *shared = map_lookup(&data->state, SHARED_CHARS_KEY);
+  if (NULL != shared) {
+    map_remove(&data->state, SHARED_CHARS_KEY);
+  }
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_release(data->object.obj->node->access_mutex);
+#endif
+  if (NULL == shared) {
+    return string;
+  }
+  if (string->table == shared->chars && 1 == shared->refs) {
+    // Every slice is gone, so the chars can just be taken back.
+    DEALLOC(shared);
+    return string;
+  }
+  uint32_t len = String_size(string);
+  string->table_size = max(len, DEFAULT_TABLE_SIZE);
+  char *chars = ALLOC_ARRAY(char, string->table_size);
+  memcpy(chars, string->table, len);
+  string->table = chars;
+  shared_chars_release(shared);
+  return string;
+}
+
+Element string_slice(VM *vm, ExternalData *data, uint32_t start,
+                     uint32_t len) {
+  String *string = map_lookup(&data->state, STRING_NAME);
+  ASSERT(NOT_NULL(string), start + len <= String_size(string));
+  if (0 == len) {
+    return string_create_len(vm, NULL, 0);
+  }
+#ifdef ENABLE_MEMORY_LOCK
+  // Two threads slicing the same String must not both make its SharedChars.
+  mutex_await(data->object.obj->node->access_mutex, INFINITE);
+#endif
+  SharedChars *shared = map_lookup(&data->state, SHARED_CHARS_KEY);
+  if (NULL == shared) {
+    shared = ALLOC(SharedChars);
+    shared->chars = string->table;
+    shared->refs = 1;
+    map_insert(&data->state, SHARED_CHARS_KEY, shared);
+  }
+  __sync_add_and_fetch(&shared->refs, 1);
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_release(data->object.obj->node->access_mutex);
+#endif
+
+  Element elt = create_external_obj(vm, class_string);
+  ASSERT(NONE != elt.type);
+  ExternalData *slice_data = elt.obj->external_data;
+  String *slice = ALLOC2(String);
+  slice->table = string->table + start;
+  slice->num_elts = slice->table_size = len;
+  map_insert(&slice_data->state, SHARED_CHARS_KEY, shared);
+  String_fill(vm, slice_data, slice);
+  slice_data->deconstructor = string_deconstructor;
+  return elt;
+}
+
 Element string_index(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   if (!is_value_type(arg, INT)) {
     return throw_error(vm, t, "Indexing String with something not an Int.");
@@ -242,8 +466,7 @@ Element string_set(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   //  elt_to_str(val, stdout);
   //  printf("\n");fflush(stdout);
   ASSERT(index.type == VALUE, index.val.type == INT);
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
+  String *string = String_mutable(data);
   if (val.type == VALUE && val.val.type == CHAR) {
     String_set(string, index.val.int_val, val.val.char_val);
   } else if (OBJECT == val.type &&
@@ -262,8 +485,7 @@ Element string_extend(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   if (!ISTYPE(*arg, class_string)) {
     return throw_error(vm, t, "Cannot extend something not a String.");
   }
-  String *head = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(head));
+  String *head = String_mutable(data);
   String *tail = String_extract(*arg);
   ASSERT(NOT_NULL(tail));
   String_append(head, tail);
@@ -297,8 +519,7 @@ Element string_extend_range(VM *vm, Thread *t, ExternalData *data,
   if (end.val.int_val < start.val.int_val) {
     return throw_error(vm, t, "Expected end >= start.");
   }
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
+  String *string = String_mutable(data);
   String *substr = String_extract(string_arg);
   ASSERT(NOT_NULL(substr));
 
@@ -316,59 +537,44 @@ String *String_extract(Element elt) {
   return string;
 }
 
-Element string_ltrim(VM *vm, Thread *t, ExternalData *data, Element *arg) {
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
-  int i = 0;
-  while (is_any_space(string->table[i])) {
+uint32_t String_lspace(const String *string) {
+  uint32_t i = 0, len = String_size(string);
+  while (i < len && is_any_space(string->table[i])) {
     ++i;
   }
-  String_lshrink(string, i);
-  Element string_size = create_int(String_size(string));
-  memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY,
-                             &string_size);
-  return data->object;
+  return i;
 }
 
-Element string_rtrim(VM *vm, Thread *t, ExternalData *data, Element *arg) {
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
-  int i = 0;
-  while (is_any_space(string->table[String_size(string) - 1 - i])) {
-    ++i;
+uint32_t String_rspace(const String *string, uint32_t start) {
+  uint32_t end = String_size(string);
+  while (end > start && is_any_space(string->table[end - 1])) {
+    --end;
   }
-  String_rshrink(string, i);
-  Element string_size = create_int(String_size(string));
-  memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY,
-                             &string_size);
-  return data->object;
+  return end;
+}
+
+Element string_ltrim(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  String *string = String_extract(data->object);
+  uint32_t start = String_lspace(string);
+  return string_slice(vm, data, start, String_size(string) - start);
+}
+
+Element string_rtrim(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  String *string = String_extract(data->object);
+  return string_slice(vm, data, 0, String_rspace(string, 0));
 }
 
 Element string_trim(VM *vm, Thread *t, ExternalData *data, Element *arg) {
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
-  int i = 0;
-  while (is_any_space(string->table[i])) {
-    ++i;
-  }
-  String_lshrink(string, i);
-  i = 0;
-  while (is_any_space(string->table[String_size(string) - 1 - i])) {
-    ++i;
-  }
-  String_rshrink(string, i);
-  Element string_size = create_int(String_size(string));
-  memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY,
-                             &string_size);
-  return data->object;
+  String *string = String_extract(data->object);
+  uint32_t start = String_lspace(string);
+  return string_slice(vm, data, start, String_rspace(string, start) - start);
 }
 
 Element string_lshrink(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   if (!is_value_type(arg, INT)) {
     return throw_error(vm, t, "Trimming String with something not an Int.");
   }
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
+  String *string = String_mutable(data);
   if (arg->val.int_val > String_size(string)) {
     return throw_error(vm, t, "Cannot shrink more than the entire size.");
   }
@@ -383,8 +589,7 @@ Element string_rshrink(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   if (!is_value_type(arg, INT)) {
     return throw_error(vm, t, "Trimming String with something not an Int.");
   }
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
+  String *string = String_mutable(data);
   if (arg->val.int_val > String_size(string)) {
     return throw_error(vm, t, "Cannot shrink more than the entire size.");
   }
@@ -396,8 +601,7 @@ Element string_rshrink(VM *vm, Thread *t, ExternalData *data, Element *arg) {
 }
 
 Element string_clear(VM *vm, Thread *t, ExternalData *data, Element *arg) {
-  String *string = map_lookup(&data->state, STRING_NAME);
-  ASSERT(NOT_NULL(string));
+  String *string = String_mutable(data);
   String_clear(string);
   Element string_size = create_int(String_size(string));
   memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY,
@@ -416,22 +620,25 @@ Element string_split(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   int str_len = String_size(string);
   String *delim = String_extract(*arg);
   int delim_len = String_size(delim);
-  int i, last_delim_end = 0;
-  for (i = 0; i < str_len; ++i) {
-    if (0 == strncmp(string->table + i, delim->table, delim_len)) {
-      memory_graph_array_enqueue(
-          vm->graph, result,
-          string_create_len(vm, string->table + last_delim_end,
-                            i - last_delim_end));
-      i += delim_len;
-      last_delim_end = i;
-    }
+  if (0 == delim_len) {
+    return throw_error(vm, t, "Cannot split on an empty String.");
+  }
+  int i = 0, last_delim_end = 0;
+  char *found;
+  while (i < str_len &&
+         NULL != (found = find_str(string->table + i, str_len - i,
+                                   delim->table, delim_len))) {
+    int delim_start = found - string->table;
+    memory_graph_array_enqueue(
+        vm->graph, result,
+        string_slice(vm, data, last_delim_end, delim_start - last_delim_end));
+    // Adjacent delimiters produce an empty piece between them.
+    i = last_delim_end = delim_start + delim_len;
   }
-  if (last_delim_end < str_len - delim_len) {
+  if (last_delim_end < str_len) {
     memory_graph_array_enqueue(
         vm->graph, result,
-        string_create_len(vm, string->table + last_delim_end,
-                          str_len - last_delim_end));
+        string_slice(vm, data, last_delim_end, str_len - last_delim_end));
   }
   return result;
 }
@@ -469,7 +676,7 @@ Element string_substr(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   if (end < start) {
     return throw_error(vm, t, "start_index > end_index.");
   }
-  return string_create_len(vm, String_cstr(string) + start, end - start);
+  return string_slice(vm, data, start, end - start);
 }
 
 Element string_hash(VM *vm, Thread *t, ExternalData *data, Element *arg) {
@@ -560,20 +767,22 @@ Element string_ends_with(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   return cmp == 0 ? create_int(1) : create_none();
 }
 
+int String_compare(const String *s1, const String *s2) {
+  size_t len = min(String_size(s1), String_size(s2));
+  int cmp = strncmp(String_cstr(s1), String_cstr(s2), len);
+  return (cmp == 0) ? String_size(s1) > String_size(s2)
+                          ? 1
+                          : String_size(s1) < String_size(s2) ? -1 : 0
+                    : cmp;
+}
+
 Element string_cmp(VM *vm, Thread *t, ExternalData *data, Element *arg) {
   String *string = String_extract(data->object);
   if (!ISTYPE(*arg, class_string)) {
     return throw_error(vm, t,
                        "Cannot compare string to something not a string.");
   }
-  String *other_str = String_extract(*arg);
-  size_t len = min(String_size(string), String_size(other_str));
-  int cmp = strncmp(String_cstr(string), String_cstr(other_str), len);
-  return create_int(
-      (cmp == 0) ? String_size(string) > String_size(other_str)
-                       ? 1
-                       : String_size(string) < String_size(other_str) ? -1 : 0
-                 : cmp);
+  return create_int(String_compare(string, String_extract(*arg)));
 }
 
 void merge_string_class(VM *vm, Element string_class) {
@@ -600,6 +809,7 @@ void merge_string_class(VM *vm, Element string_class) {
                       string_rshrink);
   add_external_method(vm, string_class, strings_intern("clear"), string_clear);
   add_external_method(vm, string_class, strings_intern("split"), string_split);
+  add_external_method(vm, string_class, strings_intern("join"), string_join);
   add_external_method(vm, string_class, strings_intern("copy"), string_copy);
   add_external_method(vm, string_class, strings_intern("eq"), string_eq);
   add_external_method(vm, string_class, strings_intern("equals_range"),
@@ -12,6 +12,7 @@
 #include "../element.h"
 
 Element stringify__(VM *vm, Thread *t, ExternalData *ed, Element *argument);
+Element concat__(VM *vm, Thread *t, ExternalData *data, Element *arg);
 
 DEFINE_ARRAYLIKE(String, char);
 
@@ -24,8 +25,25 @@ String *String_of(VM *vm, ExternalData *data, const char *src, size_t len);
 void String_fill(VM *vm, ExternalData *data, String *string);
 
 const char *String_cstr(const String *const string);
+// Same order as String.cmp().
+int String_compare(const String *s1, const String *s2);
 
 String *String_extract(Element elt);
+// Wraps string in a new String Element, which takes ownership of it.
+Element string_adopt(VM *vm, String *string);
+// Appends elt as str() would. Returns false if calling to_s() raised an error.
+bool String_append_element(VM *vm, Thread *t, String *string, Element elt);
+// Returns the String in data, first giving it its own copy of its chars if
+// they are shared with a slice. Must be used before modifying a String.
+String *String_mutable(ExternalData *data);
+// Returns a String of len chars from start which shares chars with the one in
+// data instead of copying them.
+Element string_slice(VM *vm, ExternalData *data, uint32_t start,
+                     uint32_t len);
+
+// The size of an Array or Tuple, or -1 if arg is neither.
+int32_t sequence_size(const Element *arg);
+Element sequence_get(const Element *arg, uint32_t index);
 
 void merge_string_class(VM *vm, Element string_class);
 Element string_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg);
@@ -0,0 +1,991 @@
+/*
+ * struct.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "struct.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../arena/strings.h"
+#include "../class.h"
+#include "../datastructure/array.h"
+#include "../datastructure/map.h"
+#include "../datastructure/tuple.h"
+#include "../element.h"
+#include "../error.h"
+#include "../ltable/ltable.h"
+#include "../memory/memory.h"
+#include "../memory/memory_graph.h"
+#include "../program/ops.h"
+#include "../shared.h"
+#include "../threads/thread.h"
+#include "../threads/thread_interface.h"
+#include "../vm/vm.h"
+#include "external.h"
+#include "strings.h"
+
+#define MAP_EMPTY_SLOT -1
+#define MAP_NO_ENTRY -1
+#define MAP_MIN_SLOTS 8
+
+// Keys and values live in the $entries Array as [k0, v0, k1, v1, ...] so the
+// memory graph sees them. The index holds each entry's hash, an open-addressed
+// table of entry ids and a linked list of entries in iteration order, so
+// neither growing nor removing ever calls back into JL.
+typedef struct {
+  int32_t *slots;
+  uint32_t num_slots;
+  uint32_t *hashes;
+  int32_t *prev, *next;
+  // Live entries, ids handed out so far and ids allocated for.
+  uint32_t num_entries, entries_used, entries_size;
+  // Removed ids are reused through next before handing out new ones.
+  int32_t first, last, free;
+  // Bumped whenever entries come or go, so a search which let go of the lock
+  // can tell whether it has to start over.
+  uint32_t version;
+} HashIndex;
+
+typedef struct {
+  // An entry id, or a pair in $snapshot if from_snapshot.
+  int32_t next;
+  uint32_t count;
+  // The index's version when iteration started. An entry added or removed
+  // since may have moved next onto the free list.
+  uint32_t version;
+  bool keys_only, from_snapshot;
+} MapCursor;
+
+typedef struct {
+  uint32_t capacity;
+  uint64_t hits, misses, evictions;
+  // NULL unless the cache is synchronized.
+  Mutex mutex;
+} LruState;
+
+Element class_map_iterator;
+
+uint32_t hash_mix(uint64_t val) {
+  val ^= val >> 33;
+  val *= 0xff51afd7ed558ccdULL;
+  val ^= val >> 33;
+  val *= 0xc4ceb9fe1a85ec53ULL;
+  val ^= val >> 33;
+  return (uint32_t)val;
+}
+
+bool is_default_method(Element fn, const char name[]) {
+  return fn.obj == obj_get_field(class_object, name).obj;
+}
+
+// Hashes key the same way builtin.hash() does. Returns false if calling
+// hash() raised an error.
+bool map_key_hash(VM *vm, Thread *t, Element key, uint32_t *hash) {
+  if (NONE == key.type) {
+    *hash = 0;
+    return true;
+  }
+  if (VALUE == key.type) {
+    Value val = key.val;
+    int64_t int_val = (INT == val.type)
+                          ? val.int_val
+                          : (FLOAT == val.type) ? (int64_t)val.float_val
+                                                : val.char_val;
+    *hash = hash_mix(int_val);
+    return true;
+  }
+  if (ISTYPE(key, class_string)) {
+    String *string = String_extract(key);
+    *hash =
+        hash_mix(string_hasher_len(String_cstr(string), String_size(string)));
+    return true;
+  }
+  Element hash_fn = *obj_deep_lookup(key.obj, strings_intern("hash"));
+  Element result;
+  if (NONE == hash_fn.type || is_default_method(hash_fn, "hash")) {
+    result = obj_get_field(key, ADDRESS_KEY);
+  } else if (!vm_call_fn_sync(vm, t, key, hash_fn, vm->empty_tuple,
+                              &result)) {
+    return false;
+  }
+  if (!is_value_type(&result, INT)) {
+    throw_error(vm, t, "hash() must return an Int.");
+    return false;
+  }
+  *hash = hash_mix(result.val.int_val);
+  return true;
+}
+
+// Compares keys the same way builtin.eq() does, but without calling any JL.
+// Returns false if only key's eq() can tell.
+bool map_key_eq_builtin(Element key, Element other, bool *eq) {
+  if (NONE == key.type || NONE == other.type) {
+    *eq = key.type == other.type;
+    return true;
+  }
+  if (VALUE == key.type || VALUE == other.type) {
+    Value v1 = key.val, v2 = other.val;
+    *eq = key.type == other.type && VAL_OF(v1) == VAL_OF(v2);
+    return true;
+  }
+  if (key.obj == other.obj) {
+    *eq = true;
+    return true;
+  }
+  if (ISTYPE(key, class_string) || ISTYPE(other, class_string)) {
+    *eq = ISTYPE(key, class_string) && ISTYPE(other, class_string) &&
+          0 == String_compare(String_extract(key), String_extract(other));
+    return true;
+  }
+  Element eq_fn = *obj_deep_lookup(key.obj, strings_intern("eq"));
+  if (NONE == eq_fn.type || is_default_method(eq_fn, "eq")) {
+    *eq = false;
+    return true;
+  }
+  return false;
+}
+
+// Compares keys the same way builtin.eq() does. Returns false if calling eq()
+// raised an error.
+bool map_key_eq(VM *vm, Thread *t, Element key, Element other, bool *eq) {
+  if (map_key_eq_builtin(key, other, eq)) {
+    return true;
+  }
+  Element eq_fn = *obj_deep_lookup(key.obj, strings_intern("eq"));
+  Element result;
+  if (!vm_call_fn_sync(vm, t, key, eq_fn, other, &result)) {
+    return false;
+  }
+  *eq = NONE != result.type;
+  return true;
+}
+
+uint32_t slots_for(uint32_t num_entries) {
+  uint32_t num_slots = MAP_MIN_SLOTS;
+  while (num_slots * 3 < num_entries * 4) {
+    num_slots *= 2;
+  }
+  return num_slots;
+}
+
+void hash_index_clear(HashIndex *index) {
+  memset(index->slots, 0xff, sizeof(int32_t) * index->num_slots);
+  index->num_entries = index->entries_used = 0;
+  index->first = index->last = index->free = MAP_NO_ENTRY;
+  index->version++;
+}
+
+void hash_index_init(HashIndex *index, uint32_t size_hint) {
+  index->num_slots = slots_for(size_hint);
+  index->slots = ALLOC_ARRAY2(int32_t, index->num_slots);
+  index->version = 0;
+  index->entries_size = max(size_hint, MAP_MIN_SLOTS);
+  index->hashes = ALLOC_ARRAY2(uint32_t, index->entries_size);
+  index->prev = ALLOC_ARRAY2(int32_t, index->entries_size);
+  index->next = ALLOC_ARRAY2(int32_t, index->entries_size);
+  hash_index_clear(index);
+}
+
+void hash_index_finalize(HashIndex *index) {
+  DEALLOC(index->slots);
+  DEALLOC(index->hashes);
+  DEALLOC(index->prev);
+  DEALLOC(index->next);
+}
+
+uint32_t hash_index_free_slot(const HashIndex *index, uint32_t hash) {
+  uint32_t mask = index->num_slots - 1, slot = hash & mask;
+  while (MAP_EMPTY_SLOT != index->slots[slot]) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void hash_index_grow(HashIndex *index) {
+  DEALLOC(index->slots);
+  index->num_slots *= 2;
+  index->slots = ALLOC_ARRAY2(int32_t, index->num_slots);
+  memset(index->slots, 0xff, sizeof(int32_t) * index->num_slots);
+  int32_t entry;
+  for (entry = index->first; MAP_NO_ENTRY != entry;
+       entry = index->next[entry]) {
+    index->slots[hash_index_free_slot(index, index->hashes[entry])] = entry;
+  }
+}
+
+void hash_index_link_last(HashIndex *index, int32_t entry) {
+  index->prev[entry] = index->last;
+  index->next[entry] = MAP_NO_ENTRY;
+  if (MAP_NO_ENTRY == index->last) {
+    index->first = entry;
+  } else {
+    index->next[index->last] = entry;
+  }
+  index->last = entry;
+}
+
+void hash_index_unlink(HashIndex *index, int32_t entry) {
+  if (MAP_NO_ENTRY == index->prev[entry]) {
+    index->first = index->next[entry];
+  } else {
+    index->next[index->prev[entry]] = index->next[entry];
+  }
+  if (MAP_NO_ENTRY == index->next[entry]) {
+    index->last = index->prev[entry];
+  } else {
+    index->prev[index->next[entry]] = index->prev[entry];
+  }
+}
+
+void hash_index_move_to_last(HashIndex *index, int32_t entry) {
+  if (index->last != entry) {
+    hash_index_unlink(index, entry);
+    hash_index_link_last(index, entry);
+  }
+}
+
+// Returns the id of a new entry with hash, last in iteration order.
+int32_t hash_index_add(HashIndex *index, uint32_t hash) {
+  if ((index->num_entries + 1) * 4 > index->num_slots * 3) {
+    hash_index_grow(index);
+  }
+  int32_t entry = index->free;
+  if (MAP_NO_ENTRY != entry) {
+    index->free = index->next[entry];
+  } else {
+    if (index->entries_used == index->entries_size) {
+      index->entries_size *= 2;
+      index->hashes = REALLOC(index->hashes, uint32_t, index->entries_size);
+      index->prev = REALLOC(index->prev, int32_t, index->entries_size);
+      index->next = REALLOC(index->next, int32_t, index->entries_size);
+    }
+    entry = index->entries_used++;
+  }
+  index->hashes[entry] = hash;
+  index->slots[hash_index_free_slot(index, hash)] = entry;
+  hash_index_link_last(index, entry);
+  index->num_entries++;
+  index->version++;
+  return entry;
+}
+
+void hash_index_remove(HashIndex *index, int32_t entry) {
+  uint32_t mask = index->num_slots - 1;
+  uint32_t hole = index->hashes[entry] & mask, slot;
+  while (index->slots[hole] != entry) {
+    hole = (hole + 1) & mask;
+  }
+  // Shift back later entries of the probe run so lookups never stop early at
+  // the hole. An entry can fill the hole if the hole is between its home slot
+  // and where it is now.
+  for (slot = (hole + 1) & mask; MAP_EMPTY_SLOT != index->slots[slot];
+       slot = (slot + 1) & mask) {
+    uint32_t home = index->hashes[index->slots[slot]] & mask;
+    if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+      index->slots[hole] = index->slots[slot];
+      hole = slot;
+    }
+  }
+  index->slots[hole] = MAP_EMPTY_SLOT;
+  hash_index_unlink(index, entry);
+  index->next[entry] = index->free;
+  index->free = entry;
+  index->num_entries--;
+  index->version++;
+}
+
+HashIndex *map_index(ExternalData *data) {
+  HashIndex *index = map_lookup(&data->state, strings_intern("map"));
+  ASSERT(NOT_NULL(index));
+  return index;
+}
+
+Element map_entries(ExternalData *data) {
+  return obj_get_field(data->object, strings_intern("$entries"));
+}
+
+Element map_entry_key(ExternalData *data, int32_t entry) {
+  return Array_get(map_entries(data).obj->array, 2 * entry);
+}
+
+Element map_entry_value(ExternalData *data, int32_t entry) {
+  return Array_get(map_entries(data).obj->array, 2 * entry + 1);
+}
+
+// Sets *entry to the id of key's entry, or MAP_NO_ENTRY if it is not in the
+// map. Returns false if hashing or comparing raised an error.
+bool map_find(VM *vm, Thread *t, ExternalData *data, Element key,
+              uint32_t *hash, int32_t *entry) {
+  if (!map_key_hash(vm, t, key, hash)) {
+    return false;
+  }
+  HashIndex *index = map_index(data);
+  uint32_t mask = index->num_slots - 1, slot = *hash & mask;
+  for (; MAP_EMPTY_SLOT != index->slots[slot]; slot = (slot + 1) & mask) {
+    int32_t candidate = index->slots[slot];
+    if (index->hashes[candidate] != *hash) {
+      continue;
+    }
+    bool eq;
+    if (!map_key_eq(vm, t, key, map_entry_key(data, candidate), &eq)) {
+      return false;
+    }
+    if (eq) {
+      *entry = candidate;
+      return true;
+    }
+  }
+  *entry = MAP_NO_ENTRY;
+  return true;
+}
+
+void map_set_len(VM *vm, ExternalData *data) {
+  Element len = create_int(map_index(data)->num_entries);
+  memory_graph_set_field_ptr(vm->graph, data->object.obj, LENGTH_KEY, &len);
+}
+
+// Adds a new entry for key, which must not already be in the map.
+void map_add(VM *vm, ExternalData *data, Element key, Element value,
+             uint32_t hash) {
+  int32_t entry = hash_index_add(map_index(data), hash);
+  Element entries = map_entries(data);
+  if (2 * entry == Array_size(entries.obj->array)) {
+    memory_graph_array_enqueue(vm->graph, entries, key);
+    memory_graph_array_enqueue(vm->graph, entries, value);
+  } else {
+    memory_graph_array_set(vm->graph, entries.obj, 2 * entry, &key);
+    memory_graph_array_set(vm->graph, entries.obj, 2 * entry + 1, &value);
+  }
+  map_set_len(vm, data);
+}
+
+void map_remove_entry(VM *vm, ExternalData *data, int32_t entry) {
+  hash_index_remove(map_index(data), entry);
+  Element entries = map_entries(data), none = create_none();
+  memory_graph_array_set(vm->graph, entries.obj, 2 * entry, &none);
+  memory_graph_array_set(vm->graph, entries.obj, 2 * entry + 1, &none);
+  map_set_len(vm, data);
+}
+
+void map_object_init(VM *vm, ExternalData *data, uint32_t size_hint) {
+  HashIndex *index = ALLOC2(HashIndex);
+  hash_index_init(index, size_hint);
+  map_insert(&data->state, strings_intern("map"), index);
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$entries"),
+                         create_array(vm->graph));
+  map_set_len(vm, data);
+}
+
+uint32_t size_hint_of(const Element *arg) {
+  return (is_value_type(arg, INT) && arg->val.int_val > 0) ? arg->val.int_val
+                                                           : MAP_MIN_SLOTS;
+}
+
+Element map_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  map_object_init(vm, data, size_hint_of(arg));
+  return data->object;
+}
+
+Element map_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  HashIndex *index = map_lookup(&data->state, strings_intern("map"));
+  if (NULL != index) {
+    hash_index_finalize(index);
+    DEALLOC(index);
+  }
+  return create_none();
+}
+
+Element map_set(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "Map.__set__ expects a key and a value.");
+  }
+  Element key = tuple_get(arg->obj->tuple, 0);
+  Element value = tuple_get(arg->obj->tuple, 1);
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, key, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  if (MAP_NO_ENTRY == entry) {
+    map_add(vm, data, key, value, hash);
+    return create_none();
+  }
+  Element old_value = map_entry_value(data, entry);
+  memory_graph_array_set(vm->graph, map_entries(data).obj, 2 * entry + 1,
+                         &value);
+  return old_value;
+}
+
+Element map_index_fn(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  return MAP_NO_ENTRY == entry ? create_none() : map_entry_value(data, entry);
+}
+
+Element map_in(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  return MAP_NO_ENTRY == entry ? element_false(vm) : element_true(vm);
+}
+
+// Removes key and returns its value, or None if it was not there.
+Element map_remove_fn(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  if (MAP_NO_ENTRY == entry) {
+    return create_none();
+  }
+  Element value = map_entry_value(data, entry);
+  map_remove_entry(vm, data, entry);
+  return value;
+}
+
+Element map_clear(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  hash_index_clear(map_index(data));
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$entries"),
+                         create_array(vm->graph));
+  map_set_len(vm, data);
+  return data->object;
+}
+
+Element map_keys(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  HashIndex *index = map_index(data);
+  Element keys = create_array(vm->graph);
+  int32_t entry;
+  for (entry = index->first; MAP_NO_ENTRY != entry;
+       entry = index->next[entry]) {
+    memory_graph_array_enqueue(vm->graph, keys, map_entry_key(data, entry));
+  }
+  return keys;
+}
+
+// Calls fn with each key, or each (key, value) if keys_only is false. Entries
+// added by fn are visited too, but fn must not remove any.
+Element map_for_each(VM *vm, Thread *t, ExternalData *data, Element fn,
+                     bool keys_only) {
+  if (!is_callable(fn)) {
+    return throw_error(vm, t, "each() expects a function.");
+  }
+  Element module = *obj_deep_lookup_ckey(fn.obj, CKey_module);
+  int32_t entry;
+  for (entry = map_index(data)->first; MAP_NO_ENTRY != entry;
+       entry = map_index(data)->next[entry]) {
+    Element args = map_entry_key(data, entry);
+    if (!keys_only) {
+      args = create_tuple(vm->graph);
+      memory_graph_tuple_add(vm->graph, args, map_entry_key(data, entry));
+      memory_graph_tuple_add(vm->graph, args, map_entry_value(data, entry));
+    }
+    Element result;
+    if (!vm_call_fn_sync(vm, t, module, fn, args, &result)) {
+      return t_get_resval(t);
+    }
+  }
+  return data->object;
+}
+
+Element map_each(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_for_each(vm, t, data, *arg, /*keys_only=*/false);
+}
+
+Element map_to_string(VM *vm, Thread *t, ExternalData *data, bool keys_only) {
+  String *string = String_create();
+  String_append_cstr(string, "{", 1);
+  int32_t entry;
+  // to_s() may change the map, so look each entry up again every time.
+  for (entry = map_index(data)->first; MAP_NO_ENTRY != entry;
+       entry = map_index(data)->next[entry]) {
+    if (entry != map_index(data)->first) {
+      String_append_cstr(string, ", ", 2);
+    }
+    if (!String_append_element(vm, t, string, map_entry_key(data, entry))) {
+      String_delete(string);
+      return t_get_resval(t);
+    }
+    if (keys_only) {
+      continue;
+    }
+    String_append_cstr(string, ": ", 2);
+    if (!String_append_element(vm, t, string, map_entry_value(data, entry))) {
+      String_delete(string);
+      return t_get_resval(t);
+    }
+  }
+  String_append_cstr(string, "}", 1);
+  return string_adopt(vm, string);
+}
+
+Element map_to_s(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_to_string(vm, t, data, /*keys_only=*/false);
+}
+
+Element map_create_iterator(VM *vm, ExternalData *data, bool keys_only) {
+  Element iter = create_external_obj(vm, class_map_iterator);
+  MapCursor *cursor = ALLOC2(MapCursor);
+  cursor->next = map_index(data)->first;
+  cursor->count = 0;
+  cursor->version = map_index(data)->version;
+  cursor->keys_only = keys_only;
+  cursor->from_snapshot = false;
+  map_insert(&iter.obj->external_data->state, strings_intern("cursor"),
+             cursor);
+  memory_graph_set_field(vm->graph, iter, strings_intern("$map"),
+                         data->object);
+  return iter;
+}
+
+Element map_iter(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_create_iterator(vm, data, /*keys_only=*/false);
+}
+
+Element map_iterator_constructor(VM *vm, Thread *t, ExternalData *data,
+                                 Element *arg) {
+  return throw_error(vm, t, "Use iter() to iterate over a Map or Set.");
+}
+
+Element map_iterator_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                   Element *arg) {
+  MapCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  if (NULL != cursor) {
+    DEALLOC(cursor);
+  }
+  return create_none();
+}
+
+bool map_iterator_is_stale(ExternalData *data, MapCursor *cursor) {
+  if (cursor->from_snapshot) {
+    return false;
+  }
+  ExternalData *map_data =
+      obj_get_field(data->object, strings_intern("$map")).obj->external_data;
+  return cursor->version != map_index(map_data)->version;
+}
+
+Element map_iterator_has_next(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  MapCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  ASSERT(NOT_NULL(cursor));
+  if (map_iterator_is_stale(data, cursor)) {
+    // So that next() says why, rather than the loop quietly ending.
+    return element_true(vm);
+  }
+  return MAP_NO_ENTRY == cursor->next ? element_false(vm) : element_true(vm);
+}
+
+// Gives (key, value) for Maps and (index, key) for Sets, which is what
+// iterating over their keys Arrays used to give.
+Element map_iterator_next(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  MapCursor *cursor = map_lookup(&data->state, strings_intern("cursor"));
+  ASSERT(NOT_NULL(cursor));
+  if (map_iterator_is_stale(data, cursor)) {
+    return throw_error(vm, t, "Map or Set changed while iterating over it.");
+  }
+  if (MAP_NO_ENTRY == cursor->next) {
+    return throw_error(vm, t, "Iterated past the end.");
+  }
+  Element key, value;
+  if (cursor->from_snapshot) {
+    Array *pairs =
+        obj_get_field(data->object, strings_intern("$snapshot")).obj->array;
+    key = Array_get(pairs, 2 * cursor->next);
+    value = Array_get(pairs, 2 * cursor->next + 1);
+    cursor->next = (2 * (cursor->next + 1) < Array_size(pairs))
+                       ? cursor->next + 1
+                       : MAP_NO_ENTRY;
+  } else {
+    ExternalData *map_data =
+        obj_get_field(data->object, strings_intern("$map")).obj->external_data;
+    key = map_entry_key(map_data, cursor->next);
+    value = map_entry_value(map_data, cursor->next);
+    cursor->next = map_index(map_data)->next[cursor->next];
+  }
+  Element pair = create_tuple(vm->graph);
+  if (cursor->keys_only) {
+    memory_graph_tuple_add(vm->graph, pair, create_int(cursor->count));
+    memory_graph_tuple_add(vm->graph, pair, key);
+  } else {
+    memory_graph_tuple_add(vm->graph, pair, key);
+    memory_graph_tuple_add(vm->graph, pair, value);
+  }
+  cursor->count++;
+  return pair;
+}
+
+Element set_insert_fn(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  if (MAP_NO_ENTRY != entry) {
+    return element_false(vm);
+  }
+  map_add(vm, data, *arg, create_none(), hash);
+  return element_true(vm);
+}
+
+Element set_remove_fn(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  uint32_t hash;
+  int32_t entry;
+  if (!map_find(vm, t, data, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  if (MAP_NO_ENTRY == entry) {
+    return element_false(vm);
+  }
+  map_remove_entry(vm, data, entry);
+  return element_true(vm);
+}
+
+Element set_each(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_for_each(vm, t, data, *arg, /*keys_only=*/true);
+}
+
+Element set_to_s(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_to_string(vm, t, data, /*keys_only=*/true);
+}
+
+Element set_iter(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return map_create_iterator(vm, data, /*keys_only=*/true);
+}
+
+LruState *lru_state(ExternalData *data) {
+  LruState *lru = map_lookup(&data->state, strings_intern("lru"));
+  ASSERT(NOT_NULL(lru));
+  return lru;
+}
+
+void lru_lock(LruState *lru) {
+  if (NULL != lru->mutex) {
+    mutex_await(lru->mutex, INFINITE);
+  }
+}
+
+void lru_unlock(LruState *lru) {
+  if (NULL != lru->mutex) {
+    mutex_release(lru->mutex);
+  }
+}
+
+// Finds key like map_find(), but never holds the lock while hash() or eq()
+// run, since they may use the cache too. Returns with the lock held unless
+// hashing or comparing raised an error.
+bool lru_find(VM *vm, Thread *t, ExternalData *data, LruState *lru,
+              Element key, uint32_t *hash, int32_t *entry) {
+  if (!map_key_hash(vm, t, key, hash)) {
+    return false;
+  }
+  lru_lock(lru);
+  HashIndex *index = map_index(data);
+  uint32_t version = index->version;
+  uint32_t mask = index->num_slots - 1, slot = *hash & mask;
+  while (MAP_EMPTY_SLOT != index->slots[slot]) {
+    int32_t candidate = index->slots[slot];
+    slot = (slot + 1) & mask;
+    if (index->hashes[candidate] != *hash) {
+      continue;
+    }
+    Element other = map_entry_key(data, candidate);
+    bool eq;
+    if (!map_key_eq_builtin(key, other, &eq)) {
+      lru_unlock(lru);
+      // Another thread could evict other while eq() runs.
+      t_pushstack(t, other);
+      bool compared = map_key_eq(vm, t, key, other, &eq);
+      bool has_error = false;
+      t_popstack(t, &has_error);
+      if (!compared) {
+        return false;
+      }
+      lru_lock(lru);
+      if (version != index->version) {
+        // Entries came or went, so candidate may be stale.
+        version = index->version;
+        mask = index->num_slots - 1;
+        slot = *hash & mask;
+        continue;
+      }
+    }
+    if (eq) {
+      *entry = candidate;
+      return true;
+    }
+  }
+  *entry = MAP_NO_ENTRY;
+  return true;
+}
+
+// Takes capacity or (capacity, on_evict).
+Element lru_create(VM *vm, Thread *t, ExternalData *data, Element *arg,
+                   bool synchronized) {
+  Element capacity = *arg, on_evict = create_none();
+  if (is_object_type(arg, TUPLE) && tuple_size(arg->obj->tuple) == 2) {
+    capacity = tuple_get(arg->obj->tuple, 0);
+    on_evict = tuple_get(arg->obj->tuple, 1);
+  }
+  if (!is_value_type(&capacity, INT) || capacity.val.int_val <= 0) {
+    return throw_error(vm, t, "Cache capacity must be a positive Int.");
+  }
+  if (NONE != on_evict.type && !is_callable(on_evict)) {
+    return throw_error(vm, t, "Cache on_evict must be a function.");
+  }
+  map_object_init(vm, data, capacity.val.int_val + 1);
+  LruState *lru = ALLOC2(LruState);
+  lru->capacity = capacity.val.int_val;
+  lru->hits = lru->misses = lru->evictions = 0;
+  lru->mutex = synchronized ? mutex_create(NULL) : NULL;
+  map_insert(&data->state, strings_intern("lru"), lru);
+  memory_graph_set_field(vm->graph, data->object, strings_intern("$on_evict"),
+                         on_evict);
+  return data->object;
+}
+
+Element lru_constructor(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return lru_create(vm, t, data, arg, /*synchronized=*/false);
+}
+
+Element sync_lru_constructor(VM *vm, Thread *t, ExternalData *data,
+                             Element *arg) {
+  return lru_create(vm, t, data, arg, /*synchronized=*/true);
+}
+
+Element lru_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  LruState *lru = map_lookup(&data->state, strings_intern("lru"));
+  if (NULL != lru) {
+    if (NULL != lru->mutex) {
+      mutex_close(lru->mutex);
+    }
+    DEALLOC(lru);
+  }
+  return map_deconstructor(vm, t, data, arg);
+}
+
+// Gets the value for key and marks it most recently used. None on a miss.
+Element lru_get(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  uint32_t hash;
+  int32_t entry;
+  if (!lru_find(vm, t, data, lru, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  Element value = create_none();
+  if (MAP_NO_ENTRY == entry) {
+    lru->misses++;
+  } else {
+    lru->hits++;
+    hash_index_move_to_last(map_index(data), entry);
+    value = map_entry_value(data, entry);
+  }
+  lru_unlock(lru);
+  return value;
+}
+
+// Sets key to value, evicting the least recently used entry if the cache is
+// over capacity.
+Element lru_put(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "Cache.__set__ expects a key and a value.");
+  }
+  Element key = tuple_get(arg->obj->tuple, 0);
+  Element value = tuple_get(arg->obj->tuple, 1);
+  LruState *lru = lru_state(data);
+  uint32_t hash;
+  int32_t entry;
+  if (!lru_find(vm, t, data, lru, key, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  if (MAP_NO_ENTRY != entry) {
+    memory_graph_array_set(vm->graph, map_entries(data).obj, 2 * entry + 1,
+                           &value);
+    hash_index_move_to_last(map_index(data), entry);
+    lru_unlock(lru);
+    return create_none();
+  }
+  map_add(vm, data, key, value, hash);
+  Element evicted = create_none();
+  HashIndex *index = map_index(data);
+  if (index->num_entries > lru->capacity) {
+    evicted = create_tuple(vm->graph);
+    memory_graph_tuple_add(vm->graph, evicted,
+                           map_entry_key(data, index->first));
+    memory_graph_tuple_add(vm->graph, evicted,
+                           map_entry_value(data, index->first));
+    map_remove_entry(vm, data, index->first);
+    lru->evictions++;
+  }
+  lru_unlock(lru);
+  // Call back without holding the lock so on_evict can use the cache.
+  Element on_evict = obj_get_field(data->object, strings_intern("$on_evict"));
+  if (NONE == evicted.type || NONE == on_evict.type) {
+    return create_none();
+  }
+  Element module = *obj_deep_lookup_ckey(on_evict.obj, CKey_module);
+  Element result;
+  if (!vm_call_fn_sync(vm, t, module, on_evict, evicted, &result)) {
+    return t_get_resval(t);
+  }
+  return create_none();
+}
+
+// Whether key is cached, without counting a hit or miss or marking it used.
+Element lru_in(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  uint32_t hash;
+  int32_t entry;
+  if (!lru_find(vm, t, data, lru, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  lru_unlock(lru);
+  return MAP_NO_ENTRY == entry ? element_false(vm) : element_true(vm);
+}
+
+Element lru_remove(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  uint32_t hash;
+  int32_t entry;
+  if (!lru_find(vm, t, data, lru, *arg, &hash, &entry)) {
+    return t_get_resval(t);
+  }
+  Element value = create_none();
+  if (MAP_NO_ENTRY != entry) {
+    value = map_entry_value(data, entry);
+    map_remove_entry(vm, data, entry);
+  }
+  lru_unlock(lru);
+  return value;
+}
+
+Element lru_clear(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  lru_lock(lru);
+  map_clear(vm, t, data, arg);
+  lru_unlock(lru);
+  return data->object;
+}
+
+// Keys from least to most recently used.
+Element lru_keys(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  lru_lock(lru);
+  Element keys = map_keys(vm, t, data, arg);
+  lru_unlock(lru);
+  return keys;
+}
+
+// Iterates over a copy of the entries, since reading cache[k] in the loop
+// moves k to the end and it would come up again.
+Element lru_iter(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  LruState *lru = lru_state(data);
+  Element iter = map_create_iterator(vm, data, /*keys_only=*/false);
+  Element snapshot = create_array(vm->graph);
+  memory_graph_set_field(vm->graph, iter, strings_intern("$snapshot"),
+                         snapshot);
+  lru_lock(lru);
+  HashIndex *index = map_index(data);
+  int32_t entry;
+  for (entry = index->first; MAP_NO_ENTRY != entry;
+       entry = index->next[entry]) {
+    memory_graph_array_enqueue(vm->graph, snapshot, map_entry_key(data, entry));
+    memory_graph_array_enqueue(vm->graph, snapshot,
+                               map_entry_value(data, entry));
+  }
+  MapCursor *cursor =
+      map_lookup(&iter.obj->external_data->state, strings_intern("cursor"));
+  cursor->from_snapshot = true;
+  cursor->next = MAP_NO_ENTRY == index->first ? MAP_NO_ENTRY : 0;
+  lru_unlock(lru);
+  return iter;
+}
+
+Element lru_hits(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return create_int(lru_state(data)->hits);
+}
+
+Element lru_misses(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return create_int(lru_state(data)->misses);
+}
+
+Element lru_evictions(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return create_int(lru_state(data)->evictions);
+}
+
+Element create_map_class(VM *vm, Element module) {
+  Element map_class = create_external_class(
+      vm, module, strings_intern("Map"), map_constructor, map_deconstructor);
+  add_external_method(vm, map_class, ARRAYLIKE_SET_KEY, map_set);
+  add_external_method(vm, map_class, ARRAYLIKE_INDEX_KEY, map_index_fn);
+  add_external_method(vm, map_class, IN_FN_NAME, map_in);
+  add_external_method(vm, map_class, strings_intern("remove"), map_remove_fn);
+  add_external_method(vm, map_class, strings_intern("clear"), map_clear);
+  add_external_method(vm, map_class, strings_intern("keys"), map_keys);
+  add_external_method(vm, map_class, strings_intern("each"), map_each);
+  add_external_method(vm, map_class, strings_intern("to_s"), map_to_s);
+  add_external_method(vm, map_class, ITER_FN_NAME, map_iter);
+  return map_class;
+}
+
+Element create_set_class(VM *vm, Element module) {
+  Element set_class = create_external_class(
+      vm, module, strings_intern("Set"), map_constructor, map_deconstructor);
+  add_external_method(vm, set_class, strings_intern("insert"), set_insert_fn);
+  add_external_method(vm, set_class, strings_intern("remove"), set_remove_fn);
+  add_external_method(vm, set_class, IN_FN_NAME, map_in);
+  add_external_method(vm, set_class, strings_intern("clear"), map_clear);
+  add_external_method(vm, set_class, strings_intern("keys"), map_keys);
+  add_external_method(vm, set_class, strings_intern("each"), set_each);
+  add_external_method(vm, set_class, strings_intern("to_s"), set_to_s);
+  add_external_method(vm, set_class, ITER_FN_NAME, set_iter);
+  return set_class;
+}
+
+Element create_lru_class(VM *vm, Element module, const char class_name[],
+                         ExternalFunction constructor) {
+  Element lru_class = create_external_class(
+      vm, module, strings_intern(class_name), constructor, lru_deconstructor);
+  add_external_method(vm, lru_class, ARRAYLIKE_SET_KEY, lru_put);
+  add_external_method(vm, lru_class, ARRAYLIKE_INDEX_KEY, lru_get);
+  add_external_method(vm, lru_class, IN_FN_NAME, lru_in);
+  add_external_method(vm, lru_class, strings_intern("remove"), lru_remove);
+  add_external_method(vm, lru_class, strings_intern("clear"), lru_clear);
+  add_external_method(vm, lru_class, strings_intern("keys"), lru_keys);
+  add_external_method(vm, lru_class, strings_intern("hits"), lru_hits);
+  add_external_method(vm, lru_class, strings_intern("misses"), lru_misses);
+  add_external_method(vm, lru_class, strings_intern("evictions"),
+                      lru_evictions);
+  add_external_method(vm, lru_class, strings_intern("to_s"), map_to_s);
+  add_external_method(vm, lru_class, ITER_FN_NAME, lru_iter);
+  return lru_class;
+}
+
+void add_struct_external(VM *vm, Element module) {
+  create_map_class(vm, module);
+  create_set_class(vm, module);
+  create_lru_class(vm, module, "LruCache", lru_constructor);
+  create_lru_class(vm, module, "SyncLruCache", sync_lru_constructor);
+
+  class_map_iterator = create_external_class(
+      vm, module, strings_intern("MapIterator__"), map_iterator_constructor,
+      map_iterator_deconstructor);
+  add_external_method(vm, class_map_iterator, HAS_NEXT_FN_NAME,
+                      map_iterator_has_next);
+  add_external_method(vm, class_map_iterator, NEXT_FN_NAME,
+                      map_iterator_next);
+}
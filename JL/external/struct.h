@@ -0,0 +1,15 @@
+/*
+ * struct.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_STRUCT_H_
+#define EXTERNAL_STRUCT_H_
+
+#include "../element.h"
+
+void add_struct_external(VM *vm, Element module);
+
+#endif /* EXTERNAL_STRUCT_H_ */
@@ -0,0 +1,557 @@
+/*
+ * typed_array.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "typed_array.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../arena/strings.h"
+#include "../class.h"
+#include "../datastructure/array.h"
+#include "../datastructure/map.h"
+#include "../datastructure/tuple.h"
+#include "../element.h"
+#include "../error.h"
+#include "../memory/memory.h"
+#include "../memory/memory_graph.h"
+#include "../shared.h"
+#include "../vm/vm.h"
+#include "external.h"
+#include "math_kernels.h"
+#include "strings.h"
+
+// Lengths are uint32_t.
+#define TOO_LONG_ERROR "Typed arrays can hold at most 4294967295 values."
+
+size_t typed_array_elt_size(ValType type) {
+  switch (type) {
+    case INT:
+      return sizeof(int64_t);
+    case FLOAT:
+      return sizeof(double);
+    default /*CHAR*/:
+      return sizeof(uint8_t);
+  }
+}
+
+const char *typed_array_name(ValType type) {
+  switch (type) {
+    case INT:
+      return "IntArray";
+    case FLOAT:
+      return "FloatArray";
+    default /*CHAR*/:
+      return "ByteArray";
+  }
+}
+
+TypedArray *typed_array_of(const Object *obj) {
+  if (!obj->is_external) {
+    return NULL;
+  }
+  return map_lookup(&obj->external_data->state, TYPED_ARRAY_KEY);
+}
+
+TypedArray *typed_array_create(ValType type, uint32_t capacity) {
+  TypedArray *array = ALLOC2(TypedArray);
+  array->type = type;
+  array->len = 0;
+  array->capacity = max(capacity, DEFAULT_TABLE_SIZE);
+  array->bytes =
+      ALLOC_ARRAY2(uint8_t, array->capacity * typed_array_elt_size(type));
+  return array;
+}
+
+void typed_array_delete(TypedArray *array) {
+  DEALLOC(array->bytes);
+  DEALLOC(array);
+}
+
+// Grows to len, zeroing anything new.
+void typed_array_resize(TypedArray *array, uint32_t len) {
+  size_t elt_size = typed_array_elt_size(array->type);
+  if (len > array->capacity) {
+    array->capacity = max(len, array->capacity * 2);
+    array->bytes = REALLOC(array->bytes, uint8_t, array->capacity * elt_size);
+  }
+  if (len > array->len) {
+    memset(array->bytes + array->len * elt_size, 0x0,
+           (len - array->len) * elt_size);
+  }
+  array->len = len;
+}
+
+const char *typed_array_get(const TypedArray *array, int64_t index,
+                            Element *elt) {
+  if (index < 0 || index >= array->len) {
+    return "Index out of bounds.";
+  }
+  switch (array->type) {
+    case INT:
+      *elt = create_int(array->ints[index]);
+      break;
+    case FLOAT:
+      *elt = create_float(array->floats[index]);
+      break;
+    default /*CHAR*/:
+      *elt = create_int(array->bytes[index]);
+      break;
+  }
+  return NULL;
+}
+
+// Stores elt at index, which must be in bounds.
+const char *typed_array_store(TypedArray *array, uint32_t index, Element elt) {
+  if (VALUE != elt.type) {
+    return "Typed arrays can only hold Ints, Floats and Chars.";
+  }
+  Value val = elt.val;
+  switch (array->type) {
+    case INT:
+      if (FLOAT == val.type) {
+        return "Cannot put a Float in an IntArray.";
+      }
+      array->ints[index] = (INT == val.type) ? val.int_val : val.char_val;
+      break;
+    case FLOAT:
+      array->floats[index] = VALUE_OF(val);
+      break;
+    default /*CHAR*/:;
+      int64_t byte = (INT == val.type) ? val.int_val : val.char_val;
+      if (FLOAT == val.type || byte < 0 || byte > UINT8_MAX) {
+        return "ByteArray values must be between 0 and 255.";
+      }
+      array->bytes[index] = (uint8_t)byte;
+      break;
+  }
+  return NULL;
+}
+
+void typed_array_set_len(VM *vm, Element obj, const TypedArray *array) {
+  Element len = create_int(array->len);
+  memory_graph_set_field_ptr(vm->graph, obj.obj, LENGTH_KEY, &len);
+}
+
+void typed_array_lock(const Object *obj) {
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_await(obj->node->access_mutex, INFINITE);
+#endif
+}
+
+void typed_array_unlock(const Object *obj) {
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_release(obj->node->access_mutex);
+#endif
+}
+
+// Must hold the lock.
+const char *typed_array_put(VM *vm, Element obj, TypedArray *array,
+                            int64_t index, Element elt) {
+  // index + 1 has to fit in len.
+  if (index < 0 || index >= UINT32_MAX) {
+    return "Index out of bounds.";
+  }
+  if (index < array->len) {
+    return typed_array_store(array, index, elt);
+  }
+  // Like Arrays, setting past the end grows the array.
+  uint32_t old_len = array->len;
+  typed_array_resize(array, index + 1);
+  const char *error = typed_array_store(array, index, elt);
+  if (NULL != error) {
+    array->len = old_len;
+    return error;
+  }
+  typed_array_set_len(vm, obj, array);
+  return NULL;
+}
+
+const char *typed_array_set(VM *vm, Element obj, TypedArray *array,
+                            int64_t index, Element elt) {
+  typed_array_lock(obj.obj);
+  const char *error = typed_array_put(vm, obj, array, index, elt);
+  typed_array_unlock(obj.obj);
+  return error;
+}
+
+TypedArray *typed_array_extract(ExternalData *data) {
+  TypedArray *array = map_lookup(&data->state, TYPED_ARRAY_KEY);
+  ASSERT(NOT_NULL(array));
+  return array;
+}
+
+// Appends each value in the Array or Tuple arg, or returns the first error.
+const char *typed_array_append_all(TypedArray *array, const Element *arg) {
+  bool is_tuple = is_object_type(arg, TUPLE);
+  uint32_t i, num_elts = is_tuple ? tuple_size(arg->obj->tuple)
+                                  : Array_size(arg->obj->array);
+  uint32_t start = array->len;
+  if (num_elts > UINT32_MAX - start) {
+    return TOO_LONG_ERROR;
+  }
+  typed_array_resize(array, start + num_elts);
+  for (i = 0; i < num_elts; ++i) {
+    Element elt = is_tuple ? tuple_get(arg->obj->tuple, i)
+                           : Array_get(arg->obj->array, i);
+    const char *error = typed_array_store(array, start + i, elt);
+    if (NULL != error) {
+      array->len = start;
+      return error;
+    }
+  }
+  return NULL;
+}
+
+// Converts src into array's type.
+const char *typed_array_append_typed(TypedArray *array,
+                                     const TypedArray *src) {
+  uint32_t i, start = array->len;
+  if (src->len > UINT32_MAX - start) {
+    return TOO_LONG_ERROR;
+  }
+  if (array->type == src->type) {
+    size_t elt_size = typed_array_elt_size(array->type);
+    typed_array_resize(array, start + src->len);
+    memcpy(array->bytes + start * elt_size, src->bytes, src->len * elt_size);
+    return NULL;
+  }
+  typed_array_resize(array, start + src->len);
+  for (i = 0; i < src->len; ++i) {
+    Element elt;
+    typed_array_get(src, i, &elt);
+    const char *error = typed_array_store(array, start + i, elt);
+    if (NULL != error) {
+      array->len = start;
+      return error;
+    }
+  }
+  return NULL;
+}
+
+// Takes nothing, a length, an Array or Tuple of values, another typed array
+// or, for ByteArray, a String.
+Element typed_array_constructor(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg, ValType type) {
+  TypedArray *array = typed_array_create(type, DEFAULT_TABLE_SIZE);
+  map_insert(&data->state, TYPED_ARRAY_KEY, array);
+  const char *error = NULL;
+  if (is_value_type(arg, INT)) {
+    if (arg->val.int_val < 0) {
+      error = "Length cannot be negative.";
+    } else if (arg->val.int_val > UINT32_MAX) {
+      error = TOO_LONG_ERROR;
+    } else {
+      typed_array_resize(array, arg->val.int_val);
+    }
+  } else if (is_object_type(arg, TUPLE) || is_object_type(arg, ARRAY)) {
+    error = typed_array_append_all(array, arg);
+  } else if (CHAR == type && ISTYPE(*arg, class_string)) {
+    String *string = String_extract(*arg);
+    // String sizes are uint32_t, so these always fit.
+    typed_array_resize(array, String_size(string));
+    memcpy(array->bytes, String_cstr(string), String_size(string));
+  } else if (OBJECT == arg->type && NULL != typed_array_of(arg->obj)) {
+    error = typed_array_append_typed(array, typed_array_of(arg->obj));
+  } else if (NONE != arg->type) {
+    error = "Cannot create a typed array from that.";
+  }
+  if (NULL != error) {
+    return throw_error(vm, t, error);
+  }
+  typed_array_set_len(vm, data->object, array);
+  return data->object;
+}
+
+Element int_array_constructor(VM *vm, Thread *t, ExternalData *data,
+                              Element *arg) {
+  return typed_array_constructor(vm, t, data, arg, INT);
+}
+
+Element float_array_constructor(VM *vm, Thread *t, ExternalData *data,
+                                Element *arg) {
+  return typed_array_constructor(vm, t, data, arg, FLOAT);
+}
+
+Element byte_array_constructor(VM *vm, Thread *t, ExternalData *data,
+                               Element *arg) {
+  return typed_array_constructor(vm, t, data, arg, CHAR);
+}
+
+Element typed_array_deconstructor(VM *vm, Thread *t, ExternalData *data,
+                                  Element *arg) {
+  TypedArray *array = map_lookup(&data->state, TYPED_ARRAY_KEY);
+  if (NULL != array) {
+    typed_array_delete(array);
+  }
+  return create_none();
+}
+
+// Creates a typed array of the same class as data->object holding
+// src[start, end).
+Element typed_array_new_from(VM *vm, ExternalData *data, const TypedArray *src,
+                             uint32_t start, uint32_t end) {
+  Element class = obj_lookup(data->object.obj, CKey_class);
+  Element elt = create_external_obj(vm, class);
+  TypedArray *array = typed_array_create(src->type, end - start);
+  size_t elt_size = typed_array_elt_size(src->type);
+  typed_array_resize(array, end - start);
+  memcpy(array->bytes, src->bytes + start * elt_size,
+         (end - start) * elt_size);
+  map_insert(&elt.obj->external_data->state, TYPED_ARRAY_KEY, array);
+  typed_array_set_len(vm, elt, array);
+  return elt;
+}
+
+Element typed_array_new(VM *vm, ValType type, uint32_t len,
+                        TypedArray **array) {
+  Element class =
+      obj_get_field(vm->root, strings_intern(typed_array_name(type)));
+  ASSERT(NONE != class.type);
+  Element elt = create_external_obj(vm, class);
+  *array = typed_array_create(type, len);
+  typed_array_resize(*array, len);
+  map_insert(&elt.obj->external_data->state, TYPED_ARRAY_KEY, *array);
+  typed_array_set_len(vm, elt, *array);
+  return elt;
+}
+
+Element typed_array_index(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  if (!is_value_type(arg, INT)) {
+    return throw_error(vm, t, "Typed arrays can only be indexed by Ints.");
+  }
+  Element elt;
+  typed_array_lock(data->object.obj);
+  const char *error =
+      typed_array_get(typed_array_extract(data), arg->val.int_val, &elt);
+  typed_array_unlock(data->object.obj);
+  return NULL == error ? elt : throw_error(vm, t, error);
+}
+
+Element typed_array_set_fn(VM *vm, Thread *t, ExternalData *data,
+                           Element *arg) {
+  if (!is_object_type(arg, TUPLE) || tuple_size(arg->obj->tuple) != 2) {
+    return throw_error(vm, t, "__set__ expects an index and a value.");
+  }
+  Element index = tuple_get(arg->obj->tuple, 0);
+  if (!is_value_type(&index, INT)) {
+    return throw_error(vm, t, "Typed arrays can only be indexed by Ints.");
+  }
+  const char *error =
+      typed_array_set(vm, data->object, typed_array_extract(data),
+                      index.val.int_val, tuple_get(arg->obj->tuple, 1));
+  return NULL == error ? create_none() : throw_error(vm, t, error);
+}
+
+Element typed_array_append(VM *vm, Thread *t, ExternalData *data,
+                           Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  const char *error =
+      typed_array_set(vm, data->object, array, array->len, *arg);
+  return NULL == error ? data->object : throw_error(vm, t, error);
+}
+
+// Reads optional (start, end) arguments from arg, starting at tuple index
+// first. Both default to the whole array. Returns false if they are invalid.
+bool typed_array_range(const TypedArray *array, const Element *arg,
+                       uint32_t first, uint32_t *start, uint32_t *end) {
+  int64_t range[2] = {0, array->len};
+  if (is_object_type(arg, TUPLE)) {
+    Tuple *args = arg->obj->tuple;
+    uint32_t i;
+    for (i = 0; i < 2 && first + i < tuple_size(args); ++i) {
+      Element elt = tuple_get(args, first + i);
+      if (NONE == elt.type) {
+        continue;
+      }
+      if (!is_value_type(&elt, INT)) {
+        return false;
+      }
+      range[i] = elt.val.int_val;
+    }
+  }
+  if (range[0] < 0 || range[0] > range[1] || range[1] > array->len) {
+    return false;
+  }
+  *start = range[0];
+  *end = range[1];
+  return true;
+}
+
+// fill(value, start=0, end=len)
+Element typed_array_fill(VM *vm, Thread *t, ExternalData *data,
+                         Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  Element value = *arg;
+  if (is_object_type(arg, TUPLE) && tuple_size(arg->obj->tuple) > 0) {
+    value = tuple_get(arg->obj->tuple, 0);
+  }
+  uint32_t i, start, end;
+  if (!typed_array_range(array, arg, 1, &start, &end)) {
+    return throw_error(vm, t, "Invalid range to fill.");
+  }
+  if (start == end) {
+    return data->object;
+  }
+  const char *error = typed_array_store(array, start, value);
+  if (NULL != error) {
+    return throw_error(vm, t, error);
+  }
+  switch (array->type) {
+    case INT:
+      for (i = start + 1; i < end; ++i) {
+        array->ints[i] = array->ints[start];
+      }
+      break;
+    case FLOAT:
+      for (i = start + 1; i < end; ++i) {
+        array->floats[i] = array->floats[start];
+      }
+      break;
+    default /*CHAR*/:
+      memset(array->bytes + start, array->bytes[start], end - start);
+      break;
+  }
+  return data->object;
+}
+
+// slice(start=0, end=len) copies out [start, end).
+Element typed_array_slice(VM *vm, Thread *t, ExternalData *data,
+                          Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  uint32_t start, end;
+  if (is_value_type(arg, INT)) {
+    start = arg->val.int_val;
+    end = array->len;
+    if (arg->val.int_val < 0 || start > end) {
+      return throw_error(vm, t, "Invalid range to slice.");
+    }
+  } else if (!typed_array_range(array, arg, 0, &start, &end)) {
+    return throw_error(vm, t, "Invalid range to slice.");
+  }
+  return typed_array_new_from(vm, data, array, start, end);
+}
+
+Element typed_array_copy(VM *vm, Thread *t, ExternalData *data,
+                         Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  return typed_array_new_from(vm, data, array, 0, array->len);
+}
+
+Element typed_array_sum(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  uint32_t i;
+  if (FLOAT == array->type) {
+    return create_float(kernel_sum_float(array->floats, array->len));
+  }
+  int64_t sum = 0;
+  if (INT == array->type) {
+    if (kernel_sum_int(array->ints, array->len, &sum)) {
+      return create_int(sum);
+    }
+    // Past what an int holds, the sum is a float like QUICK_INT_ARITH makes.
+    double fsum = 0;
+    for (i = 0; i < array->len; ++i) {
+      fsum += array->ints[i];
+    }
+    return create_float(fsum);
+  }
+  for (i = 0; i < array->len; ++i) {
+    sum += array->bytes[i];
+  }
+  return create_int(sum);
+}
+
+Element typed_array_min_max(ExternalData *data, bool want_max) {
+  TypedArray *array = typed_array_extract(data);
+  if (0 == array->len) {
+    return create_none();
+  }
+  if (INT == array->type) {
+    return create_int(want_max ? kernel_max_int(array->ints, array->len)
+                               : kernel_min_int(array->ints, array->len));
+  }
+  if (FLOAT == array->type) {
+    return create_float(want_max
+                            ? kernel_max_float(array->floats, array->len)
+                            : kernel_min_float(array->floats, array->len));
+  }
+  uint8_t best = array->bytes[0];
+  uint32_t i;
+  for (i = 1; i < array->len; ++i) {
+    best = want_max ? max(best, array->bytes[i]) : min(best, array->bytes[i]);
+  }
+  return create_int(best);
+}
+
+Element typed_array_min(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return typed_array_min_max(data, /*want_max=*/false);
+}
+
+Element typed_array_max(VM *vm, Thread *t, ExternalData *data, Element *arg) {
+  return typed_array_min_max(data, /*want_max=*/true);
+}
+
+Element typed_array_to_a(VM *vm, Thread *t, ExternalData *data,
+                         Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  Element result = create_array(vm->graph);
+  uint32_t i;
+  for (i = 0; i < array->len; ++i) {
+    Element elt;
+    typed_array_get(array, i, &elt);
+    memory_graph_array_enqueue(vm->graph, result, elt);
+  }
+  return result;
+}
+
+Element typed_array_to_s(VM *vm, Thread *t, ExternalData *data,
+                         Element *arg) {
+  TypedArray *array = typed_array_extract(data);
+  String *string = String_create_sz(2 + array->len * 4);
+  String_append_cstr(string, "[", 1);
+  uint32_t i;
+  for (i = 0; i < array->len; ++i) {
+    if (i > 0) {
+      String_append_cstr(string, ",", 1);
+    }
+    Element elt;
+    typed_array_get(array, i, &elt);
+    String_append_element(vm, t, string, elt);
+  }
+  String_append_cstr(string, "]", 1);
+  return string_adopt(vm, string);
+}
+
+void merge_typed_array_class(VM *vm, Element builtin, ValType type,
+                             ExternalFunction constructor) {
+  const char *name = strings_intern(typed_array_name(type));
+  Element class = obj_get_field(builtin, name);
+  ASSERT(NONE != class.type);
+  merge_external_class(vm, class, constructor, typed_array_deconstructor);
+  add_external_method(vm, class, ARRAYLIKE_INDEX_KEY, typed_array_index);
+  add_external_method(vm, class, ARRAYLIKE_SET_KEY, typed_array_set_fn);
+  add_external_method(vm, class, strings_intern("append"), typed_array_append);
+  add_external_method(vm, class, strings_intern("fill"), typed_array_fill);
+  add_external_method(vm, class, strings_intern("slice"), typed_array_slice);
+  add_external_method(vm, class, strings_intern("copy"), typed_array_copy);
+  add_external_method(vm, class, strings_intern("sum"), typed_array_sum);
+  add_external_method(vm, class, strings_intern("min"), typed_array_min);
+  add_external_method(vm, class, strings_intern("max"), typed_array_max);
+  add_external_method(vm, class, strings_intern("to_a"), typed_array_to_a);
+  add_external_method(vm, class, strings_intern("to_s"), typed_array_to_s);
+  memory_graph_set_field(vm->graph, vm->root, name, class);
+}
+
+void merge_typed_array_classes(VM *vm, Element builtin) {
+  merge_typed_array_class(vm, builtin, INT, int_array_constructor);
+  merge_typed_array_class(vm, builtin, FLOAT, float_array_constructor);
+  merge_typed_array_class(vm, builtin, CHAR, byte_array_constructor);
+}
@@ -0,0 +1,52 @@
+/*
+ * typed_array.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef EXTERNAL_TYPED_ARRAY_H_
+#define EXTERNAL_TYPED_ARRAY_H_
+
+#include <stdint.h>
+
+#include "../element.h"
+
+// IntArray, FloatArray and ByteArray keep their values packed in one buffer
+// instead of as Elements, so the memory graph never sees them.
+typedef struct {
+  // INT, FLOAT or CHAR (which holds bytes).
+  ValType type;
+  uint32_t len, capacity;
+  union {
+    int64_t *ints;
+    double *floats;
+    uint8_t *bytes;
+  };
+} TypedArray;
+
+// The TypedArray behind obj, or NULL if obj is not one.
+TypedArray *typed_array_of(const Object *obj);
+
+// Under ENABLE_MEMORY_LOCK these hold obj's node mutex, like Array's, so a
+// value is never read or written while another thread grows the buffer.
+// Element reads and writes take it. Methods which go over the whole array
+// (fill, slice, sum, min, max, to_a and the math functions) do not, so a
+// typed array must not be grown on one thread while another runs those.
+void typed_array_lock(const Object *obj);
+void typed_array_unlock(const Object *obj);
+
+// Both return NULL on success, otherwise what went wrong. Callers of
+// typed_array_get() hold the lock; typed_array_set() takes it itself.
+const char *typed_array_get(const TypedArray *array, int64_t index,
+                            Element *elt);
+const char *typed_array_set(VM *vm, Element obj, TypedArray *array,
+                            int64_t index, Element elt);
+
+// Creates a zeroed typed array of the given length.
+Element typed_array_new(VM *vm, ValType type, uint32_t len,
+                        TypedArray **array);
+
+void merge_typed_array_classes(VM *vm, Element builtin);
+
+#endif /* EXTERNAL_TYPED_ARRAY_H_ */
@@ -87,6 +87,8 @@ Module* load_fn_jb(const char fn[], const ArgStore *store) {
 Module* load_fn_jm(const char fn[], const ArgStore *store) {
   bool out_binary = argstore_lookup_bool(store, ArgKey__OUT_BINARY);
   bool should_optimize = argstore_lookup_bool(store, ArgKey__OPTIMIZE);
+  int optimization_level = argstore_lookup_int(store,
+      ArgKey__OPTIMIZATION_LEVEL);
   bool out_unoptimized = argstore_lookup_bool(store, ArgKey__OUT_UNOPTIMIZED);
   const char *uoout_dir = argstore_lookup_string(store,
       ArgKey__UNOPTIMIZED_OUT_DIR);
@@ -117,7 +119,7 @@ Module* load_fn_jm(const char fn[], const ArgStore *store) {
       tape_write(tape, file);
       fclose(file);
     }
-    tape = optimize(tape);
+    tape = optimize(tape, optimization_level);
   }
 
   if (out_binary) {
@@ -133,6 +135,8 @@ Module* load_fn_jm(const char fn[], const ArgStore *store) {
 
 Module *load_fn_jl(const char fn[], const ArgStore *store) {
   bool should_optimize = argstore_lookup_bool(store, ArgKey__OPTIMIZE);
+  int optimization_level = argstore_lookup_int(store,
+      ArgKey__OPTIMIZATION_LEVEL);
   bool out_machine = argstore_lookup_bool(store, ArgKey__OUT_MACHINE);
   bool out_binary = argstore_lookup_bool(store, ArgKey__OUT_BINARY);
   bool out_unoptimized = argstore_lookup_bool(store, ArgKey__OUT_UNOPTIMIZED);
@@ -170,7 +174,7 @@ Module *load_fn_jl(const char fn[], const ArgStore *store) {
       tape_write(tape, file);
       fclose(file);
     }
-    tape = optimize(tape);
+    tape = optimize(tape, optimization_level);
   }
 
   if (out_machine) {
@@ -129,7 +129,7 @@ int interpret_from_file(FILE *f, const char filename[], VM *vm,
       ERROR("Expected str() to return a String.");
     }
     String *to_s = String_extract(str_rep);
-    printf("%*s\n", String_size(to_s), String_cstr(to_s));
+    printf("%.*s\n", (int)String_size(to_s), String_cstr(to_s));
     fflush(stdout);
   }
   parser_finalize(&p);
@@ -14,19 +14,6 @@ def str(input) {
   stringify__(input)  ; External C function
 }
 
-def concat(args) {
-  if ~args {
-    return 'None'
-  }
-  if ~(args.len) {
-    return str(args)
-  }
-  strc = ''
-  for i=0, i<args.len, i=i+1 {
-    strc.extend(str(args[i]))
-  }
-  strc
-}
 self.cat = self.concat
 
 def hash(v) {
@@ -298,34 +285,6 @@ class Array {
     if o.len != len return False
     equals_range(o, 0, len)
   }
-  method partition(c, l, h) {
-    x = self[h]
-    i = l - 1
-    for j=l, j<h, j=j+1 {
-      if c(self[j], x) < 0 {
-        i = i+1
-        ; TODO: Fix external methods since they cannot be
-        ; called witout self. for some reason.
-        self.swap(i,j)
-      }
-    }
-    i = i+1
-    self.swap(i,h)
-    i-1
-  }
-  method introsort(maxdepth, c, l, h) {
-    if l < h {
-      ; If recursed too many times, switch to insertion sort.
-      if maxdepth <= 0 {
-        inssort(c,l,h)
-      } else { ; Otherwise quicksort.
-        p = partition(c, l, h)
-        introsort(maxdepth-1, c, l, p)
-        introsort(maxdepth-1, c, p+1, h)
-      }
-    }
-    self
-  }
   method inssort(c, l=0, h=len) {
     i = l + 1
     while i < h {
@@ -343,9 +302,6 @@ class Array {
     }
     self
   }
-  method sort() {
-    self.introsort(math.log(len) * 2, cmp, 0, len)
-  }
   method iter() {
     IndexIterator(self)
   }
@@ -399,16 +355,6 @@ class String {
     }
     return equals_range(array, 0, array.len)
   }
-  method join(array) {
-    if array.len == 0 {
-      return ''
-    }
-    a = array[0].copy()
-    for i=1, i<array.len, i=i+1 {
-      a.extend(self).extend(array[i])
-    }
-    a
-  }
   method to_s() {
     self
   }
@@ -420,6 +366,27 @@ class String {
   }
 }
 
+; Packed Ints. Implemented natively.
+class IntArray {
+  method iter() {
+    IndexIterator(self, 0, len)
+  }
+}
+
+; Packed Floats. Implemented natively.
+class FloatArray {
+  method iter() {
+    IndexIterator(self, 0, len)
+  }
+}
+
+; Packed bytes. Implemented natively.
+class ByteArray {
+  method iter() {
+    IndexIterator(self, 0, len)
+  }
+}
+
 class Iterator {
   new(field has_next, field next) {}
 }
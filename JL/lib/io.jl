@@ -25,6 +25,9 @@ class FileInternal {
   method getline() file.getline__()
   method getlines() file.getall__()
   method puts(s) file.puts__(s)
+  method read_async(offset, len) file.read_async__(offset, len)
+  method getall_async() file.getall_async__()
+  method puts_async(s) file.puts_async__(s)
   method close() file.close__()
 }
 
@@ -38,6 +41,9 @@ class FileReader {
   method getline() fi.getline()
   method getlines() fi.getlines()
   method getall() fi.getall()
+  ; Futures of the bytes read, which read in the background.
+  method read_async(offset, len) fi.read_async(offset, len)
+  method getall_async() fi.getall_async()
   method close() fi.close()
 }
 
@@ -52,6 +58,8 @@ class FileWriter {
     fi.puts(s)
     fi.puts('\n')
   }
+  ; Writes in the background. The Future completes once s is written.
+  method write_async(s) fi.puts_async(s)
   method close() fi.close()
 }
 
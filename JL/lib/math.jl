@@ -6,7 +6,11 @@ self.epsilon = 0.000001
 self.pi = 3.14159265359
 self.e = 2.71828182845
 
+; The native versions of these only take numbers, and return None otherwise.
+
 def min(args) {
+  m = builtin.min__(args)
+  if m return m
 	m = args[0]
   for i in args {
     if (i < m) {
@@ -17,6 +21,8 @@ def min(args) {
 }
 
 def max(args) {
+  m = builtin.max__(args)
+  if m return m
 	m = args[0]
   for i in args {
     if (i > m) {
@@ -26,6 +32,56 @@ def max(args) {
   m
 }
 
+def sum(args) {
+  s = builtin.sum__(args)
+  if s return s
+  s = 0
+  for i in args {
+    s = s + i
+  }
+  s
+}
+
+; Sum of a[i] * b[i].
+def dot(a, b) {
+  s = builtin.dot__(a, b)
+  if s return s
+  s = 0
+  for i=0, i<a.len, i=i+1 {
+    s = s + (a[i] * b[i])
+  }
+  s
+}
+
+; Returns an IntArray or FloatArray of a[i] * k.
+def scale(a, k) {
+  result = builtin.scale__(a, k)
+  if result return result
+  result = []
+  for i in a {
+    result.append(i * k)
+  }
+  result
+}
+
+; Returns an IntArray or FloatArray of a[i] + b[i].
+def add(a, b) {
+  result = builtin.add__(a, b)
+  if result return result
+  result = []
+  for i=0, i<a.len, i=i+1 {
+    result.append(a[i] + b[i])
+  }
+  result
+}
+
+; Returns a ByteArray with 1 wherever a[i] op b (or b[i] if b is a sequence)
+; holds and 0 elsewhere, or None if a holds anything but numbers. op is one of
+; '<', '<=', '>', '>=', '==' or '!='.
+def compare(a, op, b) {
+  builtin.compare__(a, op, b)
+}
+
 def pow(num, power) {
   builtin.pow__(num, power)
 }
@@ -10,6 +10,11 @@ self.SOCKET_ERROR = -1
 self.AF_INET = 2
 self.INADDR_ANY = 0
 self.SOCK_STREAM = 1
+; Threads running EventLoops per plain (non-SSL) server socket.
+self.EVENT_LOOP_THREADS = 4
+; Persistent connections are closed after this long without a request.
+self.KEEP_ALIVE_TIMEOUT_MSEC = 5000
+self.MAX_KEEP_ALIVE_REQUESTS = 100
 
 self.HTTP = 'HTTP'
 self.OK = 'OK'
@@ -35,6 +40,7 @@ self.NOT_FOUND = 'Could not find file.'
 self.HEADER_GENERIC_200_HTML = 'HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=UTF-8\r\n\r\n'
 self.HEADER_GENERIC_200_CSS = 'HTTP/1.1 200 OK\r\nContent-Type: text/css; charset=UTF-8\r\n\r\n'
 self.HEADER_GENERIC_200_JS = 'HTTP/1.1 200 OK\r\nContent-Type: text/javascript; charset=UTF-8\r\n\r\n'
+self.HEADER_GENERIC_400 = 'HTTP/1.1 400 Bad Request\r\n\r\n'
 self.HEADER_GENERIC_500 = 'HTTP/1.1 500 Internal Server Error\r\n\r\n'
 self.HEADER_GENERIC_501 = 'HTTP/1.1 501 Not Implemented\r\n\r\n'
 
@@ -94,10 +100,13 @@ class HttpRequest {
         field params,
         field protocol,
         field version,
-        field map) {}
+        field map,
+        field body='',
+        field keep_alive=False,
+        field route_params=None) {}
     method to_s() {
       ret = concat(type, WHITE_SPACE, path)
-      if params and (params.keys.len > 0) {
+      if params and (params.len > 0) {
         ret.extend(QUESTION)
         param_arr = []
         for (k, v) in params {
@@ -126,7 +135,7 @@ def redirect(request, target) {
   } else {
     response.extend(target).extend('/').extend(request.path)
   }
-  if request.params and (request.params.keys.len > 0) {
+  if request.params and (request.params.len > 0) {
     response.extend(QUESTION)
     param_arr = []
     for (k, v) in request.params {
@@ -159,26 +168,25 @@ def parse_params(path) {
         {}))
 }
 
+; Builds the next complete HttpRequest from the bytes fed to parser so far,
+; or None if more are needed. Raises on a malformed request.
+def read_request(parser, text) {
+  parts = parser.feed(text)
+  if ~parts {
+    return None
+  }
+  (type, path, params, protocol, version, map, body, keep_alive) = parts
+  return HttpRequest(
+      type, path, params, protocol, version, map, body, keep_alive)
+}
+
 def parse_request(req) {
   try {
-    parts = req.split(RETURN_NEWLINE)
-    if parts.len == 0 {
-      raise Error(concat('Invalid request: ', req))
-    }
-    request = parts[0].trim()
-    req_head = request.split(WHITE_SPACE)
-    type = req_head[0]
-    path = req_head[1]
-    (path, params) = parse_params(path)
-    protocol = req_head[2].split(F_SLASH)
-    
-    map = {}
-    for i=1, i<parts.len, i=i+1 {
-      kv = parts[i].split(COLON)
-      key = kv[0].trim()
-      map[kv[0].trim()] = kv[1].trim()
-    }
-    return HttpRequest(type, path, params, protocol[0], protocol[1], map)
+    request = read_request(HttpParser(), req)
+    if ~request {
+      raise Error(concat('Incomplete request: ', req))
+    }
+    return request
   } catch e {
     io.fprintln(io.ERROR, e)
     return None
@@ -208,41 +216,31 @@ def parse_cookie(cookie) {
   return Cookies(res)
 }
 
-def html_escape(text) {
-  lts = text.find_all(LT)
-  gts = text.find_all(GT)  
-  if (lts.len == 0)  and (gts.len == 0){
-    return text.copy()
-  }
-  lts.extend(gts)
-  lts.sort(cmp)
-  result = ''
-  old_i = 0
-  for i=0, i<lts.len, i=i+1 {
-    c = text[lts[i]]
-    result.extend(text, old_i, lts[i])
-    old_i = lts[i]+1
-    if c == LT[0] then result.extend(LT_ESCAPED)
-    else if c == GT[0] then result.extend(GT_ESCAPED)
-  }
-  if lts[lts.len-1] < text.len - 1 {
-    result.extend(text, lts[lts.len-1] + 1)
-  }
-  return result
-}
-
 class RequestHandler {
-  field handlers, elseHandler
+  field handlers, elseHandler, router
   new() {
     handlers = []
+    router = Router()
   }
   method register(match_fn, handler) {
     handlers.append((match_fn, handler))
   }
+  ; Registers handler for paths matching pattern, e.g. '/users/:id' or
+  ; '/static/*path', with what they capture in request.route_params. Routes are
+  ; looked up natively, before any match_fn is tried.
+  method route(pattern, handler) {
+    router.add(pattern, handler)
+  }
   method register_else(handler) {
     elseHandler = handler
   }
   method handle(request) {
+    found = router.match(request.path)
+    if found {
+      (handler, route_params, _) = found
+      request.route_params = route_params
+      return handler(request)
+    }
     for i=0, i < handlers.len, i=i+1 {
       (match_fn, handler) = handlers[i]
       if match_fn(request) {
@@ -265,90 +263,315 @@ def read_entire_file(path) {
   return text
 }
 
+; A response body part which is sent straight from the file at path, without
+; reading it into memory.
+class FileBody {
+  field size
+  new(field path) {
+    size = file_size__(path)
+    if ~size {
+      raise Error(concat('Could not read file: ', path))
+    }
+  }
+}
+
+; Writes response parts, sending each run of Strings with a single send().
+def send_parts(parts, send, send_file) {
+  if parts is String {
+    send(parts)
+    return
+  }
+  batch = []
+  for (_, part) in parts {
+    if part is FileBody {
+      if batch.len > 0 {
+        send(batch)
+        batch = []
+      }
+      send_file(part.path)
+    } else {
+      batch.append(part)
+    }
+  }
+  if batch.len > 0 {
+    send(batch)
+  }
+}
+
+; Runs the green threads spawned on scheduler over num_threads OS threads and
+; waits until all of them have finished.
+def run_green_threads(scheduler, num_threads) {
+  threads = []
+  for i=0, i<num_threads, i=i+1 {
+    threads.append(sync.Thread(scheduler.run, None).start())
+  }
+  for (_, thread) in threads {
+    thread.wait()
+  }
+}
+
+; Renders templates in which the keys of params are replaced by their values.
+; Each src is compiled into a Template the first time its key is seen. With
+; escape, values are HTML-escaped.
 class CachedTextRenderer {
   field cache
-  new() {
+  new(field escape=False) {
     cache = struct.Cache()
   }
   method write(key, src, params, sink) {
-    parts_keys = cache.get(key, (_) {
-      indices = []
-      parts = []
-      keys = []
-      for i=0, i < params.keys.len, i=i+1 {
-        k_inds = src.find_all(params.keys[i])
-        k_inds_len = k_inds.len
-        for j=0, j < k_inds_len, j=j+1 {
-          indices.append((params.keys[i], k_inds[j]))
-        }
-      }
-      indices.sort((t1, t2) -> cmp(t1[1], t2[1]))
-      index = 0
-      for (_, (key, i)) in indices {
-        parts.append(src.substr(index, i))
-        keys.append(key)
-        index = i + key.len
-      }
-      parts.append(src.substr(index))
-      return (parts, keys)
-    })
-    if ~parts_keys or (parts_keys is error.Error) {
+    template = cache.get(key, (_) -> Template(src, params.keys()))
+    if ~template or (template is error.Error) {
       sink(NOT_FOUND)
+    } else if escape {
+      sink(template.render_escaped(params))
     } else {
-      (parts, keys) = parts_keys
-      len = keys.len + parts.len
-      if len == 1 {
-        sink(parts[0])
-        return
+      sink(template.render(params))
+    }
+  }
+}
+
+; A persistent connection served by an EventLoop. Pipelined requests are
+; answered one at a time in the order they arrived, and the idle timeout only
+; runs while no request is being worked on.
+class HttpConnection {
+  field parser, pending, busy, closed, served, mutex
+  new(field server, field loop, field handle, field app) {
+    parser = HttpParser()
+    pending = []
+    busy = False
+    closed = False
+    served = 0
+    mutex = sync.Mutex()
+    loop.watch(handle, on_readable)
+    loop.set_timeout(handle, server.keep_alive_timeout_msec)
+  }
+  method on_readable(handle) {
+    text = handle.receive()
+    if ~text {
+      return
+    }
+    if text.len == 0 {
+      close()
+      return
+    }
+    mutex.acquire()
+    try {
+      req = read_request(parser, text)
+      while req {
+        pending.append(req)
+        req = read_request(parser, '')
       }
-      for i=0, i<len, i=i+1 {
-        if i%2 == 0 {
-          sink(parts[i / 2])
-        } else {
-          sink(params[keys[i / 2]])
+    } catch e {
+      ; Answered with a 400 once the requests before it are.
+      pending.append(None)
+    }
+    start = ~busy and ~closed and (pending.len > 0)
+    if start {
+      busy = True
+      loop.set_timeout(handle, None)
+    }
+    mutex.release()
+    if start {
+      server.ex.execute(_serve_pending, None)
+    }
+  }
+  method _serve_pending() {
+    while True {
+      mutex.acquire()
+      if closed or (pending.len == 0) {
+        busy = False
+        if ~closed {
+          loop.set_timeout(handle, server.keep_alive_timeout_msec)
         }
+        mutex.release()
+        return
+      }
+      ; pop() takes the oldest, remove() the newest.
+      req = pending.pop()
+      mutex.release()
+      keep_alive = False
+      if req {
+        served = served + 1
+        keep_alive = server._respond(
+            req, app, served, True, (msg) -> loop.send(handle, msg),
+            (path) -> loop.send_file(handle, path))
+      } else {
+        loop.send(handle, [HEADER_GENERIC_400, 'Bad request.\n'])
+      }
+      if ~keep_alive {
+        close()
+        return
       }
     }
   }
+  method close() {
+    mutex.acquire()
+    closed = True
+    mutex.release()
+    loop.close(handle)
+  }
 }
 
 class Server {
-  field ex
-  new(field applications={}, field pool_size) {
+  field ex, blocking_kept_alive, blocking_mutex
+  new(field applications={},
+      field pool_size,
+      field keep_alive_timeout_msec=None,
+      field max_keep_alive_requests=None) {
     ex = sync.ThreadPool(pool_size)
+    blocking_kept_alive = 0
+    blocking_mutex = sync.Mutex()
+    if ~keep_alive_timeout_msec {
+      keep_alive_timeout_msec = KEEP_ALIVE_TIMEOUT_MSEC
+    }
+    if ~max_keep_alive_requests {
+      max_keep_alive_requests = MAX_KEEP_ALIVE_REQUESTS
+    }
   }
   
   method start() {
     for (port, app) in applications {
       try {
         sock = app.create_socket(port)
-        ex.execute(
-          (app) {
-            while True {
-              handle = None
-              handle = sock.accept()
-              ex.execute((handle) {
-                try {
-                  req = parse_request(handle.receive())
-                  app.process(req, handle.send)
-                } catch e {
-                  if handle {
-                    handle.send([HEADER_GENERIC_500, 'Sorry.\n'])
-                  }
-                  io.fprintln(io.ERROR, e)
-                }
-                if handle {
-                  handle.close()
-                }
-              }, handle)
-            }
-          }, app)
+        if sock is Socket {
+          _serve_evented(sock, app)
+        } else {
+          _serve_blocking(sock, app)
+        }
       } catch e {
         io.fprintln(io.ERROR, e)
       }
     }
     sync.sleep(sync.INFINITE)
   }
+  ; Answers req through send and send_file. Returns whether the connection may
+  ; stay open for another request, which is never when may_keep_alive is False.
+  ; The response is collected first so it can be given a Content-Length.
+  method _respond(req, app, served, may_keep_alive, send, send_file) {
+    response = []
+    sink = (msg) {
+      if msg is Array {
+        response.extend(msg)
+      } else {
+        response.append(msg)
+      }
+    }
+    try {
+      app.process(req, sink)
+    } catch e {
+      response = [HEADER_GENERIC_500, 'Sorry.\n']
+      io.fprintln(io.ERROR, e)
+    }
+    allowed = may_keep_alive and (served < max_keep_alive_requests)
+    (framed, keep_alive) = frame_response__(
+        response, allowed and req.keep_alive)
+    try {
+      send_parts(framed, send, send_file)
+    } catch e {
+      io.fprintln(io.ERROR, e)
+      return False
+    }
+    return keep_alive
+  }
+  ; A few event loops share the listening socket and read requests without
+  ; blocking, so only requests being processed occupy pool threads.
+  method _serve_evented(sock, app) {
+    loop = None
+    try {
+      loop = EventLoop()
+    } catch e {
+      ; Not every platform has one.
+      _serve_blocking(sock, app)
+      return
+    }
+    _start_event_loop(sock, app, loop)
+    for i=1, i<EVENT_LOOP_THREADS, i=i+1 {
+      _start_event_loop(sock, app, EventLoop())
+    }
+  }
+  method _start_event_loop(sock, app, loop) {
+    server = self
+    loop.serve(sock, (handle) -> HttpConnection(server, loop, handle, app))
+    sync.Thread(_run_event_loop, loop).start()
+  }
+  ; An error from one connection should not stop the others being served.
+  method _run_event_loop(loop) {
+    while True {
+      try {
+        loop.run()
+        return
+      } catch e {
+        io.fprintln(io.ERROR, e)
+      }
+    }
+  }
+  ; Used for SSLSocket, which cannot be read without blocking. Accepts on its
+  ; own thread so the pool's workers are all left for connections.
+  method _serve_blocking(sock, app) {
+    sync.Thread(
+      (sock) {
+        while True {
+          handle = None
+          handle = sock.accept()
+          ex.execute(
+              (handle) -> _serve_blocking_connection(handle, app), handle)
+        }
+      }, sock).start()
+  }
+  ; A blocking connection holds its worker while kept alive, so fewer than
+  ; pool_size may be, leaving a worker for new connections. Returns whether
+  ; this one may be.
+  method _reserve_keep_alive() {
+    blocking_mutex.acquire()
+    reserved = blocking_kept_alive < pool_size - 1
+    if reserved {
+      blocking_kept_alive = blocking_kept_alive + 1
+    }
+    blocking_mutex.release()
+    return reserved
+  }
+  method _release_keep_alive() {
+    blocking_mutex.acquire()
+    blocking_kept_alive = blocking_kept_alive - 1
+    blocking_mutex.release()
+  }
+  ; Answers requests on handle until the client closes it, stops asking for
+  ; keep-alive or sends nothing for keep_alive_timeout_msec.
+  method _serve_blocking_connection(handle, app) {
+    reserved = False
+    try {
+      handle.set_timeout(keep_alive_timeout_msec)
+      parser = HttpParser()
+      served = 0
+      keep_alive = True
+      while keep_alive {
+        req = read_request(parser, '')
+        while ~req {
+          text = handle.receive()
+          if ~text or (text.len == 0) {
+            break
+          }
+          req = read_request(parser, text)
+        }
+        if ~req {
+          break
+        }
+        served = served + 1
+        if ~reserved and req.keep_alive {
+          reserved = _reserve_keep_alive()
+        }
+        keep_alive = _respond(
+            req, app, served, reserved, handle.send, handle.send_file)
+      }
+    } catch e {
+      handle.send([HEADER_GENERIC_400, 'Bad request.\n'])
+      io.fprintln(io.ERROR, e)
+    }
+    if reserved {
+      _release_keep_alive()
+    }
+    handle.close()
+  }
 }
 
 class Application {
@@ -411,6 +634,7 @@ def wrap_in_ssl(application, cert_fn, private_key_fn) {
 }
 
 class ShardedHttpApplication : HttpApplication {
+  field router
   new(field shards) {
     directory = 
         $module.HttpApplication(
@@ -427,20 +651,20 @@ class ShardedHttpApplication : HttpApplication {
     if '/' notin shards {
       shards['/'] = directory
     }
-    ; Sort from longest to shortest.
-    shards.keys.inssort((x,y) -> y.len - x.len)
+    ; The longest shard key which the path starts with wins.
+    router = Router()
+    for (path, app) in shards {
+      router.add_prefix(path, app)
+    }
   }
   method process(req, sink) {
-    for (_,shard_key) in shards.keys {
-      if req.path.starts_with(shard_key) {
-        shards[shard_key].process(_rebase(shard_key, req), sink)
-        return
-      }
+    found = router.match(req.path)
+    if ~found {
+      sink([HEADER_GENERIC_500, 'No such shard.\n'])
+      return
     }
-    sink([HEADER_GENERIC_500, 'No such shard.\n'])
-  }
-  method _rebase(shard_key, req) {
-    req.path = req.path.substr(shard_key.len)
-    return req
+    (shard, _, rest) = found
+    req.path = rest
+    shard.process(req, sink)
   }
 }
\ No newline at end of file
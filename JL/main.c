@@ -43,6 +43,7 @@ int main(int argc, const char *argv[]) {
   ArgStore *store = commandline_parse_args(config, argc, argv);
 
   optimize_init();
+  optimize_skip(argstore_lookup_string(store, ArgKey__OPTIMIZE_SKIP));
 
   Set modules;
   set_init_default(&modules);
@@ -185,6 +185,8 @@ Element memory_graph_new_node(MemoryGraph *graph) {
   node->obj.is_external = false;
   map_init_default(&node->obj.fields);
   node->obj.parent_objs = expando(Object *, 4);
+  node->obj.slots = NULL;
+  node->obj.num_slots = 0;
   Element e = {
       .type = OBJECT,
       .obj = &node->obj,
@@ -420,6 +422,51 @@ void memory_graph_set_var(MemoryGraph *graph, const Element block,
   obj_set_field(relevant_block.obj, field_name, &field_val);
 }
 
+void memory_graph_init_slots(MemoryGraph *graph, Object *block,
+                             int num_slots) {
+  ASSERT_NOT_NULL(graph);
+  ASSERT_NOT_NULL(block);
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_await(block->node->access_mutex, INFINITE);
+#endif
+  int i;
+  for (i = 0; i < block->num_slots; ++i) {
+    if (OBJECT == block->slots[i].type) {
+      memory_graph_dec_edge(graph, block, block->slots[i].obj);
+    }
+  }
+  if (NULL != block->slots) {
+    DEALLOC(block->slots);
+  }
+  block->slots = ALLOC_ARRAY(Element, num_slots);
+  block->num_slots = num_slots;
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_release(block->node->access_mutex);
+#endif
+}
+
+void memory_graph_set_slot(MemoryGraph *graph, Object *block, int index,
+                           const Element *elt) {
+  ASSERT_NOT_NULL(graph);
+  ASSERT_NOT_NULL(block);
+  ASSERT(index >= 0, index < block->num_slots);
+  // Anonymous functions running on other threads may share the block.
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_await(block->node->access_mutex, INFINITE);
+#endif
+  Element *slot = block->slots + index;
+  if (OBJECT == slot->type) {
+    memory_graph_dec_edge(graph, block, slot->obj);
+  }
+  if (OBJECT == elt->type) {
+    memory_graph_inc_edge(graph, block, elt->obj);
+  }
+  *slot = *elt;
+#ifdef ENABLE_MEMORY_LOCK
+  mutex_release(block->node->access_mutex);
+#endif
+}
+
 void traverse_subtree(MemoryGraph *graph, Set *marked, Node *node) {
   ASSERT_NOT_NULL(graph);
   if (set_lookup(marked, node)) {
@@ -442,6 +489,11 @@ void traverse_subtree(MemoryGraph *graph, Set *marked, Node *node) {
   set_iterate(&node->children, traverse_subtree_helper);
 }
 
+int memory_graph_num_nodes(const MemoryGraph *graph) {
+  ASSERT_NOT_NULL(graph);
+  return set_size(&graph->nodes);
+}
+
 int memory_graph_free_space(MemoryGraph *graph) {
   ASSERT_NOT_NULL(graph);
 
@@ -59,6 +59,12 @@ DEB_FN(void, memory_graph_set_field_ptr, MemoryGraph *memory_graph,
 void memory_graph_set_var(MemoryGraph *graph, const Element block,
                           const char field_name[], const Element field_val);
 
+// Gives block num_slots slots which are all initially Nil.
+void memory_graph_init_slots(MemoryGraph *graph, Object *block,
+                             int num_slots);
+void memory_graph_set_slot(MemoryGraph *graph, Object *block, int index,
+                           const Element *elt);
+
 void memory_graph_array_push(MemoryGraph *graph, Object *parent,
                              const Element *element);
 
@@ -84,6 +90,8 @@ void memory_graph_tuple_add(MemoryGraph *graph, const Element tuple,
                             const Element elt);
 // Removes all unreachable nodes in the graph
 int memory_graph_free_space(MemoryGraph *memory_graph);
+// Objects currently in the graph, including garbage not yet freed.
+int memory_graph_num_nodes(const MemoryGraph *graph);
 
 void memory_graph_print(const MemoryGraph *graph, FILE *file);
 
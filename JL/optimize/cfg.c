@@ -0,0 +1,226 @@
+/*
+ * cfg.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "cfg.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../datastructure/expando.h"
+#include "../datastructure/map.h"
+#include "../error.h"
+#include "../memory/memory.h"
+
+bool cfg_is_jump(Op op) { return JMP == op || IF == op || IFN == op; }
+
+static bool ends_flow(Op op) { return RET == op || EXIT == op || RAIS == op; }
+
+int cfg_jump_target(const Tape *tape, int index) {
+  const InsContainer *c = tape_get(tape, index);
+  if (VAL_PARAM != c->ins.param || INT != c->ins.val.type) {
+    return -1;
+  }
+  int64_t target = index + c->ins.val.int_val + 1;
+  if (target < 0 || target >= tape_len(tape)) {
+    return -1;
+  }
+  return (int)target;
+}
+
+void cfg_init(CFG *cfg, const OptimizeHelper *oh, const Tape *tape) {
+  ASSERT(NOT_NULL(cfg), NOT_NULL(oh), NOT_NULL(tape));
+  cfg->tape = tape;
+  cfg->len = tape_len(tape);
+  cfg->blocks = expando(BasicBlock, DEFAULT_EXPANDO_SIZE);
+  cfg->block_of = ALLOC_ARRAY(int, cfg->len + 1);
+  if (0 == cfg->len) {
+    return;
+  }
+  bool *leaders = ALLOC_ARRAY(bool, cfg->len + 1);
+  bool *entries = ALLOC_ARRAY(bool, cfg->len + 1);
+  leaders[0] = entries[0] = true;
+  int i;
+  for (i = 0; i < cfg->len; i++) {
+    const InsContainer *c = tape_get(tape, i);
+    if (NULL != map_lookup(&oh->i_to_refs, (void *)(intptr_t)i) ||
+        NULL != map_lookup(&oh->i_to_class_starts, (void *)(intptr_t)i) ||
+        NULL != map_lookup(&oh->i_to_class_ends, (void *)(intptr_t)i)) {
+      leaders[i] = entries[i] = true;
+    }
+    if (cfg_is_jump(c->ins.op) || CTCH == c->ins.op) {
+      int target = cfg_jump_target(tape, i);
+      if (target >= 0) {
+        leaders[target] = true;
+        // Catches are reached from wherever the error was raised.
+        entries[target] |= (CTCH == c->ins.op);
+      }
+    }
+    if (cfg_is_jump(c->ins.op) || ends_flow(c->ins.op)) {
+      leaders[i + 1] = true;
+    }
+  }
+  BasicBlock block = {.start = 0};
+  for (i = 1; i <= cfg->len; i++) {
+    if (!leaders[i] && i != cfg->len) {
+      continue;
+    }
+    block.end = i;
+    block.is_entry = entries[block.start];
+    block.succ[0] = block.succ[1] = CFG_NO_BLOCK;
+    int id = expando_append(cfg->blocks, &block);
+    int j;
+    for (j = block.start; j < block.end; j++) {
+      cfg->block_of[j] = id;
+    }
+    block.start = i;
+  }
+  cfg->block_of[cfg->len] = CFG_NO_BLOCK;
+
+  int num_blocks = expando_len(cfg->blocks);
+  for (i = 0; i < num_blocks; i++) {
+    BasicBlock *b = (BasicBlock *)expando_get(cfg->blocks, i);
+    const InsContainer *last = tape_get(tape, b->end - 1);
+    if (JMP != last->ins.op && !ends_flow(last->ins.op)) {
+      b->succ[0] = cfg->block_of[b->end];
+    }
+    if (cfg_is_jump(last->ins.op)) {
+      int target = cfg_jump_target(tape, b->end - 1);
+      if (target >= 0) {
+        b->succ[1] = cfg->block_of[target];
+      } else {
+        // Nowhere sensible to go, so do not let anything reason across it.
+        b->is_entry = true;
+      }
+    }
+  }
+  DEALLOC(leaders);
+  DEALLOC(entries);
+}
+
+void cfg_finalize(CFG *cfg) {
+  ASSERT(NOT_NULL(cfg));
+  expando_delete(cfg->blocks);
+  DEALLOC(cfg->block_of);
+}
+
+int cfg_num_blocks(const CFG *cfg) { return expando_len(cfg->blocks); }
+
+const BasicBlock *cfg_block(const CFG *cfg, int block_id) {
+  return (const BasicBlock *)expando_get(cfg->blocks, block_id);
+}
+
+const BasicBlock *cfg_block_of(const CFG *cfg, int index) {
+  return cfg_block(cfg, cfg->block_of[index]);
+}
+
+bool cfg_is_leader(const CFG *cfg, int index) {
+  return cfg_block_of(cfg, index)->start == index;
+}
+
+bool resval_equals(const ResvalState *s1, const ResvalState *s2) {
+  if (s1->type != s2->type) {
+    return false;
+  }
+  switch (s1->type) {
+    case ResvalState_ID:
+      return s1->id == s2->id;  // same pointer because string interning
+    case ResvalState_VAL:
+      return value_equals(&s1->val, &s2->val);
+    default:
+      return true;
+  }
+}
+
+void resval_transfer(ResvalState *state, const Ins *ins) {
+  switch (ins->op) {
+    // Neither touch the resval nor rebind anything.
+    case NOP:
+    case PUSH:
+    case PNIL:
+    case DUP:
+    case JMP:
+    case IF:
+    case IFN:
+    case CTCH:
+    case SLTS:
+    case PSHL:
+    case SETL:
+      return;
+    case SET:
+    case LET:
+      if (ID_PARAM != ins->param) {
+        break;
+      }
+      // The resval and the variable now hold the same thing.
+      if (ResvalState_UNKNOWN == state->type ||
+          (ResvalState_ID == state->type && state->id != ins->id)) {
+        state->type = ResvalState_ID;
+        state->id = ins->id;
+      }
+      return;
+    case RES:
+    case PSRS:
+      if (ID_PARAM == ins->param) {
+        state->type = ResvalState_ID;
+        state->id = ins->id;
+        return;
+      }
+      if (VAL_PARAM == ins->param) {
+        state->type = ResvalState_VAL;
+        state->val = ins->val;
+        return;
+      }
+      break;
+    case RNIL:
+      state->type = ResvalState_NONE;
+      return;
+    default:
+      break;
+  }
+  state->type = ResvalState_UNKNOWN;
+}
+
+void resval_meet(ResvalState *into, const ResvalState *from) {
+  if (ResvalState_UNVISITED == into->type) {
+    *into = *from;
+  } else if (!resval_equals(into, from)) {
+    into->type = ResvalState_UNKNOWN;
+  }
+}
+
+ResvalState *cfg_resval_in(const CFG *cfg) {
+  int i, num_blocks = cfg_num_blocks(cfg);
+  ResvalState *in = ALLOC_ARRAY(ResvalState, num_blocks);
+  for (i = 0; i < num_blocks; i++) {
+    in[i].type = cfg_block(cfg, i)->is_entry ? ResvalState_UNKNOWN
+                                             : ResvalState_UNVISITED;
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (i = 0; i < num_blocks; i++) {
+      if (ResvalState_UNVISITED == in[i].type) {
+        continue;
+      }
+      const BasicBlock *b = cfg_block(cfg, i);
+      ResvalState out = in[i];
+      int j;
+      for (j = b->start; j < b->end; j++) {
+        resval_transfer(&out, &tape_get(cfg->tape, j)->ins);
+      }
+      for (j = 0; j < 2; j++) {
+        if (CFG_NO_BLOCK == b->succ[j]) {
+          continue;
+        }
+        ResvalState before = in[b->succ[j]];
+        resval_meet(in + b->succ[j], &out);
+        changed |= !resval_equals(&before, in + b->succ[j]);
+      }
+    }
+  }
+  return in;
+}
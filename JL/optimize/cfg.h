@@ -0,0 +1,74 @@
+/*
+ * cfg.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef OPTIMIZE_CFG_H_
+#define OPTIMIZE_CFG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../element.h"
+#include "../program/instruction.h"
+#include "../program/tape.h"
+#include "optimizer.h"
+
+#define CFG_NO_BLOCK -1
+
+// A straight-line run of instructions [start, end). Control only enters at
+// start and only leaves after end - 1.
+typedef struct {
+  int start, end;
+  // Successor block ids, CFG_NO_BLOCK if absent. succ[0] is the fallthrough.
+  int succ[2];
+  // True if control can arrive from somewhere the CFG cannot see, e.g. a
+  // function/method call, a class body or a catch.
+  bool is_entry;
+} BasicBlock;
+
+typedef struct {
+  const Tape *tape;
+  Expando *blocks;
+  int *block_of;
+  int len;
+} CFG;
+
+// What is known about the resval at a point in the program.
+typedef struct {
+  enum {
+    ResvalState_UNVISITED,
+    ResvalState_UNKNOWN,
+    ResvalState_NONE,
+    ResvalState_ID,
+    ResvalState_VAL
+  } type;
+  union {
+    const char *id;
+    Value val;
+  };
+} ResvalState;
+
+void cfg_init(CFG *cfg, const OptimizeHelper *oh, const Tape *tape);
+void cfg_finalize(CFG *cfg);
+
+int cfg_num_blocks(const CFG *cfg);
+const BasicBlock *cfg_block(const CFG *cfg, int block_id);
+const BasicBlock *cfg_block_of(const CFG *cfg, int index);
+// True if index is the first instruction of its block.
+bool cfg_is_leader(const CFG *cfg, int index);
+
+bool cfg_is_jump(Op op);
+// Returns the index of the instruction executed after the jump at index is
+// taken, or -1 if it lands outside of the tape.
+int cfg_jump_target(const Tape *tape, int index);
+
+// Computes the ResvalState at the start of each block. Returns an array of
+// length cfg_num_blocks() which must be DEALLOC'd by the caller.
+ResvalState *cfg_resval_in(const CFG *cfg);
+void resval_transfer(ResvalState *state, const Ins *ins);
+bool resval_equals(const ResvalState *s1, const ResvalState *s2);
+
+#endif /* OPTIMIZE_CFG_H_ */
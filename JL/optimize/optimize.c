@@ -7,8 +7,10 @@
 
 #include "optimize.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "../codegen/tokenizer.h"
 #include "../datastructure/expando.h"
@@ -23,13 +25,23 @@
 #define is_goto(op) \
   (((op) == JMP) || ((op) == IFN) || ((op) == IF) || ((op) == CTCH))
 
+typedef struct {
+  // What -opt_skip calls it.
+  const char *name;
+  Optimizer o;
+  int level;
+  bool skip;
+} RegisteredOptimizer;
+
 static Expando *optimizers = NULL;
 
 void optimize_init() {
-  optimizers = expando(Optimizer, DEFAULT_EXPANDO_SIZE);
+  optimizers = expando(RegisteredOptimizer, DEFAULT_EXPANDO_SIZE);
   register_optimizer("ResPush", optimizer_ResPush);
   register_optimizer("SetRes", optimizer_SetRes);
   register_optimizer("SetPush", optimizer_SetPush);
+  register_optimizer("SlotPush", optimizer_SlotPush);
+  register_optimizer("SetSlot", optimizer_SetSlot);
   register_optimizer("JmpRes", optimizer_JmpRes);
   register_optimizer("PushRes", optimizer_PushRes);
   register_optimizer("ResPush2", optimizer_ResPush2);
@@ -45,6 +57,26 @@ void optimize_init() {
   register_optimizer("Nil", optimizer_Nil);
   register_optimizer("GetSpecial", optimizer_GetSpecial);
   //  register_optimizer("Increment", optimizer_Increment);
+  register_optimizer_at_level("JumpThread", optimizer_JumpThread,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  register_optimizer_at_level("ConstantFold", optimizer_ConstantFold,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  register_optimizer_at_level("DeadRes", optimizer_DeadRes,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  register_optimizer_at_level("DeadStore", optimizer_DeadStore,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  register_optimizer_at_level("RedundantRes", optimizer_RedundantRes,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  // ConstantFold turns branches into jumps which can be threaded again.
+  register_optimizer_at_level("JumpThread-SecondPass", optimizer_JumpThread,
+                              OPTIMIZE_LEVEL_DATAFLOW);
+  // Superinstructions picked from -profile_ops. Run last.
+  register_optimizer("ResCall", optimizer_ResCall);
+  register_optimizer("PushCallNoArgs", optimizer_PushCallNoArgs);
+  register_optimizer("PushThenRes", optimizer_PushThenRes);
+  register_optimizer("MethodCallNoArgs", optimizer_MethodCallNoArgs);
+  // Adds ops the CFG does not know about, so nothing CFG-based may follow.
+  register_optimizer("CompareBranch", optimizer_CompareBranch);
 }
 
 void optimize_finalize() { expando_delete(optimizers); }
@@ -173,13 +205,17 @@ void oh_resolve(OptimizeHelper *oh, Tape *new_tape) {
   expando_delete(oh->adjustments);
 }
 
-Tape *optimize(Tape *const t) {
+Tape *optimize(Tape *const t, int level) {
   Tape *tape = t;
   int i, opts_len = expando_len(optimizers);
   for (i = 0; i < opts_len; i++) {
+    RegisteredOptimizer *ro = (RegisteredOptimizer *)expando_get(optimizers, i);
+    if (ro->level > level || ro->skip) {
+      continue;
+    }
     OptimizeHelper oh;
     oh_init(&oh, tape);
-    (*((Optimizer *)expando_get(optimizers, i)))(&oh, tape, 0, tape_len(tape));
+    ro->o(&oh, tape, 0, tape_len(tape));
     Tape *new_tape = tape_create();
     oh_resolve(&oh, new_tape);
     tape_delete(tape);
@@ -189,7 +225,36 @@ Tape *optimize(Tape *const t) {
 }
 
 void register_optimizer(const char name[], const Optimizer o) {
-  expando_append(optimizers, &o);
+  register_optimizer_at_level(name, o, OPTIMIZE_LEVEL_PEEPHOLE);
+}
+
+void register_optimizer_at_level(const char name[], const Optimizer o,
+                                 int level) {
+  RegisteredOptimizer ro = {.name = name, .o = o, .level = level,
+                            .skip = false};
+  expando_append(optimizers, &ro);
+}
+
+void optimize_skip(const char skip[]) {
+  const char *start = skip;
+  while ('\0' != *start) {
+    const char *end = strchr(start, ',');
+    size_t len = (NULL == end) ? strlen(start) : (size_t)(end - start);
+    bool found = false;
+    int i, opts_len = expando_len(optimizers);
+    for (i = 0; i < opts_len; i++) {
+      RegisteredOptimizer *ro =
+          (RegisteredOptimizer *)expando_get(optimizers, i);
+      if (len == strlen(ro->name) && 0 == strncmp(ro->name, start, len)) {
+        ro->skip = true;
+        found = true;
+      }
+    }
+    if (!found) {
+      ERROR("No optimizer named '%.*s'.", (int)len, start);
+    }
+    start = (NULL == end) ? start + len : end + 1;
+  }
 }
 
 // void InsContainer_swap(Expando * const e, void *x, void *y) {
@@ -11,11 +11,21 @@
 #include "../program/tape.h"
 #include "optimizer.h"
 
+// Only the local peephole optimizers.
+#define OPTIMIZE_LEVEL_PEEPHOLE 1
+// Also runs the CFG/dataflow optimizers.
+#define OPTIMIZE_LEVEL_DATAFLOW 2
+
 void optimize_init();
 void optimize_finalize();
-Tape *optimize(Tape * const t);
+Tape *optimize(Tape * const t, int level);
+// Leaves out the optimizers named in skip, a comma-separated list of the names
+// they were registered with. Helps find which one broke a program.
+void optimize_skip(const char skip[]);
 
 void register_optimizer(const char name[], const Optimizer o);
+void register_optimizer_at_level(const char name[], const Optimizer o,
+                                 int level);
 
 void Int32_swap(void *x, void *y);
 int Int32_compare(void *x, void *y);
@@ -13,8 +13,11 @@
 #include "../datastructure/map.h"
 #include "../element.h"
 #include "../ltable/ltable.h"
+#include "../memory/memory.h"
 #include "../program/instruction.h"
+#include "../program/ops.h"
 #include "../program/tape.h"
+#include "cfg.h"
 #include "optimizer.h"
 
 void optimizer_ResPush(OptimizeHelper *oh, const Tape *const tape, int start,
@@ -66,6 +69,41 @@ void optimizer_SetPush(OptimizeHelper *oh, const Tape *const tape, int start,
   }
 }
 
+void optimizer_SlotPush(OptimizeHelper *oh, const Tape *const tape, int start,
+                        int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (RESL == first->ins.op && PUSH == second->ins.op &&
+        NO_PARAM == second->ins.param &&
+        NULL == map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      o_Remove(oh, i);
+      o_SetOp(oh, i - 1, PSHL);
+    }
+  }
+}
+
+void optimizer_SetSlot(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (SETL != first->ins.op ||
+        (RESL != second->ins.op && PSHL != second->ins.op) ||
+        first->ins.val.int_val != second->ins.val.int_val ||
+        NULL != map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      continue;
+    }
+    if (RESL == second->ins.op) {
+      o_Remove(oh, i);
+    } else {
+      o_Replace(oh, i, instruction(PUSH));
+    }
+  }
+}
+
 void optimizer_GetPush(OptimizeHelper *oh, const Tape *const tape, int start,
                        int end) {
   int i;
@@ -371,3 +409,526 @@ void optimizer_GetSpecial(OptimizeHelper *oh, const Tape *const tape, int start,
     o_SetVal(oh, i, SGET, v);
   }
 }
+
+// Superinstructions. These hide the RES/PUSH from the other optimizers so they
+// run after all of them.
+
+void optimizer_ResCall(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (RES == first->ins.op && NO_PARAM != first->ins.param &&
+        CALL == second->ins.op && NO_PARAM == second->ins.param &&
+        NULL == map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      o_Remove(oh, i);
+      o_SetOp(oh, i - 1, RCLL);
+    }
+  }
+}
+
+void optimizer_PushCallNoArgs(OptimizeHelper *oh, const Tape *const tape,
+                              int start, int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (PUSH == first->ins.op && ID_PARAM == first->ins.param &&
+        CLLN == second->ins.op && NO_PARAM == second->ins.param &&
+        NULL == map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      o_Remove(oh, i);
+      o_SetOp(oh, i - 1, PCLN);
+    }
+  }
+}
+
+// PUSH then RES x, which sets up the argument of a method call, an array
+// index or the rhs of an op on the stack. Runs after ResCall so RES+CALL keeps
+// becoming RCLL.
+void optimizer_PushThenRes(OptimizeHelper *oh, const Tape *const tape,
+                           int start, int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (PUSH == first->ins.op && NO_PARAM == first->ins.param &&
+        RES == second->ins.op && ID_PARAM == second->ins.param &&
+        NULL == map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      Ins fused = second->ins;
+      fused.op = PRES;
+      o_Remove(oh, i);
+      o_Replace(oh, i - 1, fused);
+    }
+  }
+}
+
+// PUSH then CLLN m, which is how x.m() calls a method without arguments.
+void optimizer_MethodCallNoArgs(OptimizeHelper *oh, const Tape *const tape,
+                                int start, int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    if (PUSH == first->ins.op && NO_PARAM == first->ins.param &&
+        CLLN == second->ins.op && ID_PARAM == second->ins.param &&
+        NULL == map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      Ins fused = second->ins;
+      fused.op = MCLN;
+      o_Remove(oh, i);
+      o_Replace(oh, i - 1, fused);
+    }
+  }
+}
+
+// Everything below is only run at OPTIMIZE_LEVEL_DATAFLOW and uses the CFG
+// instead of only looking at adjacent instructions.
+
+#define MAX_JUMP_THREAD_HOPS 16
+
+static bool is_cond_jump(Op op) { return IF == op || IFN == op; }
+
+// Retargets jumps which land on other jumps.
+void optimizer_JumpThread(OptimizeHelper *oh, const Tape *const tape,
+                          int start, int end) {
+  int i;
+  for (i = start; i < end; i++) {
+    const InsContainer *c = tape_get(tape, i);
+    if (!cfg_is_jump(c->ins.op)) {
+      continue;
+    }
+    int target = cfg_jump_target(tape, i);
+    if (target < 0) {
+      continue;
+    }
+    if (target == i + 1) {
+      o_Remove(oh, i);
+      continue;
+    }
+    int final_target = target, hops;
+    for (hops = 0; hops < MAX_JUMP_THREAD_HOPS; hops++) {
+      const InsContainer *next = tape_get(tape, final_target);
+      int next_target;
+      if (JMP == next->ins.op || (is_cond_jump(c->ins.op) &&
+                                  c->ins.op == next->ins.op)) {
+        // The resval is unchanged so the same branch is taken again.
+        next_target = cfg_jump_target(tape, final_target);
+      } else if (is_cond_jump(c->ins.op) && is_cond_jump(next->ins.op)) {
+        // The opposite branch is never taken.
+        next_target = final_target + 1;
+      } else {
+        break;
+      }
+      if (next_target < 0 || next_target == final_target ||
+          next_target >= tape_len(tape)) {
+        break;
+      }
+      final_target = next_target;
+    }
+    if (final_target != target) {
+      o_SetVal(oh, i, c->ins.op, create_int(final_target - i - 1).val);
+      continue;
+    }
+    const InsContainer *landing = tape_get(tape, target);
+    if (JMP == c->ins.op && RET == landing->ins.op &&
+        NO_PARAM == landing->ins.param) {
+      o_Replace(oh, i, instruction(RET));
+    }
+  }
+}
+
+static bool is_foldable_value(const Value *v) {
+  return INT == v->type || FLOAT == v->type;
+}
+
+// Mirrors program/ops.h so folded results are identical to the runtime ones.
+static bool fold_constants(Op op, Value lhs, Value rhs, ResvalState *result) {
+  if (!is_foldable_value(&lhs) || !is_foldable_value(&rhs)) {
+    return false;
+  }
+  bool is_float = FLOAT == lhs.type || FLOAT == rhs.type;
+  bool cond;
+  double res;
+  switch (op) {
+    case ADD:
+      res = APPLY(lhs, rhs, +);
+      break;
+    case SUB:
+      res = APPLY(lhs, rhs, -);
+      break;
+    case MULT:
+      res = APPLY(lhs, rhs, *);
+      break;
+    case DIV:
+      if (0 == VAL_OF(rhs)) {
+        return false;
+      }
+      res = APPLY(lhs, rhs, /);
+      break;
+    case MOD:
+      if (is_float || 0 == rhs.int_val || -1 == rhs.int_val) {
+        return false;
+      }
+      result->type = ResvalState_VAL;
+      result->val.type = INT;
+      result->val.int_val = APPLY_INT(lhs, rhs, %);
+      return true;
+    case LT:
+      cond = APPLY(lhs, rhs, <);
+      goto fold_cond;
+    case LTE:
+      cond = APPLY(lhs, rhs, <=);
+      goto fold_cond;
+    case GT:
+      cond = APPLY(lhs, rhs, >);
+      goto fold_cond;
+    case GTE:
+      cond = APPLY(lhs, rhs, >=);
+      goto fold_cond;
+    case EQ:
+      cond = APPLY(lhs, rhs, ==);
+      goto fold_cond;
+    default:
+      return false;
+  }
+  result->type = ResvalState_VAL;
+  if (is_float) {
+    result->val = create_float(res).val;
+    return true;
+  }
+  if (res < (double)INT64_MIN || res >= (double)INT64_MAX) {
+    return false;
+  }
+  result->val = create_int((int64_t)res).val;
+  return true;
+fold_cond:
+  // True is 1 and False is None.
+  if (cond) {
+    result->type = ResvalState_VAL;
+    result->val = create_int(1).val;
+  } else {
+    result->type = ResvalState_NONE;
+  }
+  return true;
+}
+
+// Ops which can neither rebind a variable nor call back into user code. Math
+// and comparisons dispatch to methods on objects, so they only qualify when
+// state holds a primitive resval and rhs_known says the other operand is one.
+static bool keeps_vars(const Ins *ins, const ResvalState *state,
+                       bool rhs_known) {
+  switch (ins->op) {
+    case ADD:
+    case SUB:
+    case MULT:
+    case DIV:
+    case MOD:
+    case LT:
+    case LTE:
+    case GT:
+    case GTE:
+      return ResvalState_VAL == state->type &&
+             (VAL_PARAM == ins->param || rhs_known);
+    case NOP:
+    case RES:
+    case PUSH:
+    case PSRS:
+    case RNIL:
+    case PNIL:
+    case PEEK:
+    case DUP:
+    case TUPL:
+    case TGET:
+    case TLEN:
+    case TLTE:
+    case TGTE:
+    case TEQ:
+    case ANEW:
+    case SLTS:
+    case RESL:
+    case PSHL:
+    case SETL:
+      return true;
+    case EQ:
+    case NEQ:
+      // Without a param these dispatch to builtin.eq for objects.
+      return NO_PARAM != ins->param;
+    default:
+      return false;
+  }
+}
+
+// Propagates constants through resval and variables and folds math and
+// branches on them.
+void optimizer_ConstantFold(OptimizeHelper *oh, const Tape *const tape,
+                            int start, int end) {
+  CFG cfg;
+  cfg_init(&cfg, oh, tape);
+  ResvalState *resval_in = cfg_resval_in(&cfg);
+  Value *values = ALLOC_ARRAY(Value, tape_len(tape));
+  Map consts;
+  int b, num_blocks = cfg_num_blocks(&cfg);
+  for (b = 0; b < num_blocks; b++) {
+    const BasicBlock *block = cfg_block(&cfg, b);
+    if (block->start < start || block->end > end) {
+      continue;
+    }
+    ResvalState state = resval_in[b];
+    // Variable name -> Value in values.
+    map_init_default(&consts);
+    int i;
+    for (i = block->start; i < block->end; i++) {
+      const InsContainer *c = tape_get(tape, i);
+      const Value *known = (ID_PARAM == c->ins.param)
+                               ? map_lookup(&consts, c->ins.id)
+                               : NULL;
+      ResvalState folded;
+      if (ResvalState_VAL == state.type &&
+          (VAL_PARAM == c->ins.param || NULL != known) &&
+          fold_constants(c->ins.op, state.val,
+                         NULL != known ? *known : c->ins.val, &folded)) {
+        if (ResvalState_VAL == folded.type) {
+          o_SetVal(oh, i, RES, folded.val);
+        } else {
+          o_Replace(oh, i, instruction(RNIL));
+        }
+        state = folded;
+        continue;
+      }
+      if (NULL != known && (RES == c->ins.op || PUSH == c->ins.op)) {
+        o_SetVal(oh, i, c->ins.op, *known);
+        if (RES == c->ins.op) {
+          state.type = ResvalState_VAL;
+          state.val = *known;
+        }
+        continue;
+      }
+      if (is_cond_jump(c->ins.op) && (ResvalState_VAL == state.type ||
+                                      ResvalState_NONE == state.type)) {
+        bool taken = (ResvalState_VAL == state.type) == (IF == c->ins.op);
+        if (taken) {
+          o_SetOp(oh, i, JMP);
+        } else {
+          o_Remove(oh, i);
+        }
+        continue;
+      }
+      if ((SET == c->ins.op || LET == c->ins.op) &&
+          ID_PARAM == c->ins.param) {
+        map_remove(&consts, c->ins.id);
+        if (ResvalState_VAL == state.type) {
+          values[i] = state.val;
+          map_insert(&consts, c->ins.id, values + i);
+        }
+      } else if (!keeps_vars(&c->ins, &state, NULL != known)) {
+        map_finalize(&consts);
+        map_init_default(&consts);
+      }
+      resval_transfer(&state, &c->ins);
+    }
+    map_finalize(&consts);
+  }
+  DEALLOC(values);
+  DEALLOC(resval_in);
+  cfg_finalize(&cfg);
+}
+
+// Ops which set the resval without looking at the previous one.
+static bool overwrites_resval(const Ins *ins) {
+  switch (ins->op) {
+    case RES:
+    case RNIL:
+    case PSRS:
+    case PEEK:
+    case TUPL:
+    case ANEW:
+    case RESL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Removes resvals which are overwritten before anything reads them.
+void optimizer_DeadRes(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end) {
+  CFG cfg;
+  cfg_init(&cfg, oh, tape);
+  int i;
+  for (i = start; i < end - 1; i++) {
+    const InsContainer *first = tape_get(tape, i);
+    const InsContainer *second = tape_get(tape, i + 1);
+    // RES of a variable is kept since it raises if the variable is missing.
+    if (((RES == first->ins.op && (VAL_PARAM == first->ins.param ||
+                                   STR_PARAM == first->ins.param)) ||
+         RNIL == first->ins.op || RESL == first->ins.op) &&
+        overwrites_resval(&second->ins) && !cfg_is_leader(&cfg, i + 1)) {
+      o_Remove(oh, i);
+    }
+  }
+  cfg_finalize(&cfg);
+}
+
+// Whether an instruction between two stores to id could observe the first,
+// including through a catch if it raises.
+static bool may_read_var(const Ins *ins, const char *id) {
+  switch (ins->op) {
+    case NOP:
+    case RNIL:
+    case PNIL:
+    case PEEK:
+    case DUP:
+    case SLTS:
+    case RESL:
+    case PSHL:
+    case SETL:
+      return false;
+    case RES:
+    case PUSH:
+    case PSRS:
+      // Looking up a missing variable raises.
+      return ID_PARAM == ins->param;
+    case LET:
+      // Cannot fail, unlike SET which may throw for a const.
+      return ins->id == id;
+    default:
+      return true;
+  }
+}
+
+// Removes a LET which is followed in the same block by another LET of the
+// same variable without anything able to see the first one. SET is kept since
+// it raises for a const.
+void optimizer_DeadStore(OptimizeHelper *oh, const Tape *const tape,
+                         int start, int end) {
+  CFG cfg;
+  cfg_init(&cfg, oh, tape);
+  int i;
+  for (i = start; i < end; i++) {
+    const InsContainer *store = tape_get(tape, i);
+    if (LET != store->ins.op || ID_PARAM != store->ins.param) {
+      continue;
+    }
+    int j, block_end = min(cfg_block_of(&cfg, i)->end, end);
+    for (j = i + 1; j < block_end; j++) {
+      const InsContainer *next = tape_get(tape, j);
+      // LET and SET may resolve to different blocks so only match the same op.
+      if (LET == next->ins.op && ID_PARAM == next->ins.param &&
+          store->ins.id == next->ins.id) {
+        o_Remove(oh, i);
+        break;
+      }
+      if (may_read_var(&next->ins, store->ins.id)) {
+        break;
+      }
+    }
+  }
+  cfg_finalize(&cfg);
+}
+
+// Uses what is known about the resval across blocks to drop RES which would
+// not change it and to PUSH the resval instead of looking a variable up again.
+void optimizer_RedundantRes(OptimizeHelper *oh, const Tape *const tape,
+                            int start, int end) {
+  CFG cfg;
+  cfg_init(&cfg, oh, tape);
+  ResvalState *resval_in = cfg_resval_in(&cfg);
+  int b, num_blocks = cfg_num_blocks(&cfg);
+  for (b = 0; b < num_blocks; b++) {
+    const BasicBlock *block = cfg_block(&cfg, b);
+    if (block->start < start || block->end > end) {
+      continue;
+    }
+    ResvalState state = resval_in[b];
+    int i;
+    for (i = block->start; i < block->end; i++) {
+      const InsContainer *c = tape_get(tape, i);
+      ResvalState after = state;
+      resval_transfer(&after, &c->ins);
+      if ((RES == c->ins.op || RNIL == c->ins.op) &&
+          ResvalState_UNKNOWN != state.type &&
+          ResvalState_UNVISITED != state.type &&
+          resval_equals(&state, &after)) {
+        o_Remove(oh, i);
+      } else if ((PUSH == c->ins.op || PSRS == c->ins.op) &&
+                 ID_PARAM == c->ins.param &&
+                 ResvalState_ID == state.type && state.id == c->ins.id) {
+        o_Replace(oh, i, instruction(PUSH));
+      }
+      state = after;
+    }
+  }
+  DEALLOC(resval_in);
+  cfg_finalize(&cfg);
+}
+
+// Run at every level, but after everything CFG-based since the CFG does not
+// know about the ops added here.
+
+#define MAX_RESVAL_SCAN 16
+
+// Whether the resval at index is overwritten before anything can read it.
+// Follows JMPs and steps over ops which do not touch the resval.
+static bool resval_dead_at(const Tape *tape, int index) {
+  int scanned;
+  for (scanned = 0; scanned < MAX_RESVAL_SCAN; scanned++) {
+    if (index < 0 || index >= tape_len(tape)) {
+      return false;
+    }
+    const Ins *ins = &tape_get(tape, index)->ins;
+    if (overwrites_resval(ins)) {
+      return true;
+    }
+    switch (ins->op) {
+      case JMP:
+        index = cfg_jump_target(tape, index);
+        continue;
+      case PUSH:
+        if (NO_PARAM == ins->param) {
+          return false;
+        }
+        break;
+      case NOP:
+      case NBLK:
+      case BBLK:
+      case PNIL:
+      case PSHL:
+      case SLTS:
+        break;
+      default:
+        return false;
+    }
+    index++;
+  }
+  return false;
+}
+
+// Turns <cmp>+IFN into J<cmp>+JMP so loop and if conditions branch on the
+// comparison directly instead of going through a True/False resval.
+//
+// This is a peephole pass rather than something codegen emits because it is
+// only safe where nothing reads that resval afterward, on either edge, and
+// that takes the CFG built here. Codegen cannot see past the condition it is
+// producing. EQ and NEQ on the stack may call builtin.eq(), which the VM waits
+// for when they are fused.
+void optimizer_CompareBranch(OptimizeHelper *oh, const Tape *const tape,
+                             int start, int end) {
+  int i;
+  for (i = start + 1; i < end; i++) {
+    const InsContainer *first = tape_get(tape, i - 1);
+    const InsContainer *second = tape_get(tape, i);
+    Op branch = op_compare_branch(first->ins.op);
+    if (NOP == branch || IFN != second->ins.op ||
+        VAL_PARAM != second->ins.param || STR_PARAM == first->ins.param ||
+        NULL != map_lookup(&oh->i_gotos, (void *)(intptr_t)(i - 1))) {
+      continue;
+    }
+    int target = cfg_jump_target(tape, i);
+    if (target < 0 || !resval_dead_at(tape, i + 1) ||
+        !resval_dead_at(tape, target)) {
+      continue;
+    }
+    o_SetOp(oh, i - 1, branch);
+    o_SetOp(oh, i, JMP);
+  }
+}
@@ -17,6 +17,10 @@ void optimizer_SetRes(OptimizeHelper *oh, const Tape *const tape, int start,
                       int end);
 void optimizer_SetPush(OptimizeHelper *oh, const Tape *const tape, int start,
                        int end);
+void optimizer_SlotPush(OptimizeHelper *oh, const Tape *const tape, int start,
+                        int end);
+void optimizer_SetSlot(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end);
 void optimizer_GetPush(OptimizeHelper *oh, const Tape *const tape, int start,
                        int end);
 void optimizer_JmpRes(OptimizeHelper *oh, const Tape *const tape, int start,
@@ -47,4 +51,28 @@ void optimizer_GetSpecial(OptimizeHelper *oh, const Tape *const tape, int start,
                           int end);
 void optimizer_Nil(OptimizeHelper *oh, const Tape *const tape, int start,
                    int end);
+
+// Superinstructions.
+void optimizer_ResCall(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end);
+void optimizer_PushCallNoArgs(OptimizeHelper *oh, const Tape *const tape,
+                              int start, int end);
+void optimizer_PushThenRes(OptimizeHelper *oh, const Tape *const tape,
+                           int start, int end);
+void optimizer_MethodCallNoArgs(OptimizeHelper *oh, const Tape *const tape,
+                                int start, int end);
+void optimizer_CompareBranch(OptimizeHelper *oh, const Tape *const tape,
+                             int start, int end);
+
+// CFG-based.
+void optimizer_JumpThread(OptimizeHelper *oh, const Tape *const tape,
+                          int start, int end);
+void optimizer_ConstantFold(OptimizeHelper *oh, const Tape *const tape,
+                            int start, int end);
+void optimizer_DeadRes(OptimizeHelper *oh, const Tape *const tape, int start,
+                       int end);
+void optimizer_DeadStore(OptimizeHelper *oh, const Tape *const tape,
+                         int start, int end);
+void optimizer_RedundantRes(OptimizeHelper *oh, const Tape *const tape,
+                            int start, int end);
 #endif /* OPTIMIZERS_H_ */
@@ -23,7 +23,12 @@ const char *instructions[] = {
     "inc",  "dec",  "finc", "fdec", "sinc", "call", "clln", "tupl",
     "tgte", "tlte", "teq",  "dup",  "goto", "prnt", "lmdl", "get",
     "gtsh", "rnil", "pnil", "fld",  "fldc", "is",   "adr",  "rais",
-    "ctch", "anew", "aidx", "aset", "cnst", "setc", "letc", "sget"};
+    "ctch", "anew", "aidx", "aset", "cnst", "setc", "letc", "sget",
+    "rcll", "pcln", "pres", "mcln", "slts", "resl", "pshl", "setl",
+    "jlt",  "jlte", "jgt",  "jgte", "jeq",  "jneq", "addi", "addf",
+    "subi", "subf", "muli", "mulf", "divi", "divf", "modi", "gti",
+    "gtf",  "lti",  "ltf",  "eqi",  "eqf",  "neqi", "neqf", "gtei",
+    "gtef", "ltei", "ltef"};
 
 Op op_type(const char word[]) {
   int i;
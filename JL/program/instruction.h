@@ -81,6 +81,48 @@ typedef enum {
   SETC,
   LETC,
   SGET,
+  // SUPERINSTRUCTIONS
+  RCLL,  // RES+CALL
+  PCLN,  // PUSH+CLLN
+  PRES,  // PUSH+RES
+  MCLN,  // PUSH+CLLN <method>
+  // SLOTS
+  SLTS,  // Allocates slots in the current block.
+  RESL,  // RES slot
+  PSHL,  // PUSH slot
+  SETL,  // SET slot
+  // COMPARE-AND-BRANCH: Always followed by a JMP, which is skipped if the
+  // comparison holds. Together they replace <cmp>+IFN without setting the
+  // resval.
+  JLT,
+  JLTE,
+  JGT,
+  JGTE,
+  JEQ,
+  JNEQ,
+  // QUICKENED: Int-Int and Float-Float forms of binary ops, which the VM
+  // swaps in at runtime. Never emitted by the compiler.
+  ADDI,
+  ADDF,
+  SUBI,
+  SUBF,
+  MULI,
+  MULF,
+  DIVI,
+  DIVF,
+  MODI,
+  GTI,
+  GTF,
+  LTI,
+  LTF,
+  EQI,
+  EQF,
+  NEQI,
+  NEQF,
+  GTEI,
+  GTEF,
+  LTEI,
+  LTEF,
   // NOT A REAL OP
   OP_BOUND,
 } Op;
@@ -104,6 +146,12 @@ typedef struct {
   uint16_t row, col;
 } Ins;
 
+// Slot ops take a single int naming how many blocks up the slot lives and its
+// index within that block.
+#define SLOT_REF(depth, index) (((depth) << 16) | (index))
+#define SLOT_DEPTH(ref) ((ref) >> 16)
+#define SLOT_INDEX(ref) ((ref)&0xFFFF)
+
 Op op_type(const char word[]);
 Ins instruction(Op);
 Ins instruction_val(Op, Value);
@@ -31,6 +31,9 @@ FileInfo *module_fileinfo(const Module const *m);
 // void module_load(Module *m);
 Ins module_ins(const Module *m, uint32_t index);
 const InsContainer *module_insc(const Module *m, uint32_t index);
+// Rewrites the op at index in place. Used to quicken running code, so it only
+// touches the op and threads racing on it just see either version.
+void module_set_op(const Module *m, uint32_t index, Op op);
 const Map *module_refs(const Module *m);
 // Set *module_literals(const Module *m);
 // Set *module_vars(const Module *m);
@@ -82,6 +82,11 @@ const InsContainer *module_insc(const Module *m, uint32_t index) {
   return tape_get(m->tape, (int)index);
 }
 
+void module_set_op(const Module *m, uint32_t index, Op op) {
+  ASSERT(NOT_NULL(m), tape_len(m->tape) > index);
+  tape_get_mutable(m->tape, (int)index)->ins.op = op;
+}
+
 int32_t module_ref(const Module *m, const char ref_name[]) {
   ASSERT(NOT_NULL(m), NOT_NULL(ref_name));
   void *ptr = map_lookup(module_refs(m), ref_name);
@@ -7,6 +7,8 @@
 
 #include "ops.h"
 
+#include <stdint.h>
+
 #include "../element.h"
 #include "../vm/vm.h"
 
@@ -25,3 +27,131 @@ OPFUNC_BOOLTYPE_NULLABLE(&&, and);
 OPFUNC_BOOLTYPE_NULLABLE(||, or);
 // OPFUNC_BOOLTYPE_SINGLE_NIL(element_not, not);
 OPFUNC_BOOLTYPE_SINGLE(!, notc);
+
+#define BOTH_OF_TYPE(lhe, rhe, val_type)         \
+  (VALUE == (lhe).type && VALUE == (rhe).type && \
+   (val_type) == (lhe).val.type && (val_type) == (rhe).val.type)
+
+#define QUICK_GENERIC(generic, int_op, float_op, op, kind, name) \
+  QUICK_CASES(generic, int_op, float_op, op, kind, name)       \
+    return generic;
+
+Op op_generic(Op op) {
+  switch (op) {
+    QUICK_OPS(QUICK_GENERIC)
+    case MOD:
+    case MODI:
+      return MOD;
+    default:
+      return NOP;
+  }
+}
+
+#define QUICK_SPECIALIZE(generic, int_op, float_op, op, kind, name) \
+  case generic:                                               \
+    return (INT == lhe.val.type) ? int_op : float_op;
+
+Op op_specialize(Op op, Element lhe, Element rhe) {
+  if (!BOTH_OF_TYPE(lhe, rhe, INT) && !BOTH_OF_TYPE(lhe, rhe, FLOAT)) {
+    return op;
+  }
+  switch (op) {
+    QUICK_OPS(QUICK_SPECIALIZE)
+    case MOD:
+      return (INT == lhe.val.type) ? MODI : op;
+    default:
+      return op;
+  }
+}
+
+#define QUICK_RESULT_ARITH(vm, val, create) create(val)
+#define QUICK_RESULT_DIV QUICK_RESULT_ARITH
+#define QUICK_RESULT_BOOL(vm, val, create) \
+  ((val) ? element_true(vm) : element_false(vm))
+
+// The generic ops compute through double, which is exact as long as operands
+// and results stay within 2^53. Past that the Int ops do the same as them.
+#define EXACT_INT_MAX (INT64_C(1) << 53)
+#define IS_EXACT_INT(val) ((val) >= -EXACT_INT_MAX && (val) <= EXACT_INT_MAX)
+
+#define QUICK_INT_ARITH(vm, lhv, rhv, op, name)                             \
+  {                                                                         \
+    int64_t int_res;                                                        \
+    if (IS_EXACT_INT(lhv.int_val) && IS_EXACT_INT(rhv.int_val) &&           \
+        !__builtin_##name##_overflow(lhv.int_val, rhv.int_val, &int_res) && \
+        IS_EXACT_INT(int_res)) {                                            \
+      *res = create_int(int_res);                                           \
+    } else {                                                                \
+      *res = create_int(APPLY(lhv, rhv, op));                               \
+    }                                                                       \
+  }
+// Division already goes through double in the generic op, so the result is
+// the same. Dividing by zero is left to the generic op.
+#define QUICK_INT_DIV(vm, lhv, rhv, op, name) \
+  if (0 == rhv.int_val) {                     \
+    return false;                             \
+  }                                           \
+  *res = create_int(APPLY(lhv, rhv, op))
+#define QUICK_INT_BOOL(vm, lhv, rhv, op, name)                 \
+  *res = QUICK_RESULT_BOOL(                                    \
+      vm,                                                      \
+      (IS_EXACT_INT(lhv.int_val) && IS_EXACT_INT(rhv.int_val)) \
+          ? lhv.int_val op rhv.int_val                         \
+          : APPLY(lhv, rhv, op),                               \
+      create_int)
+
+#define QUICK_RUN(generic, int_op, float_op, op, kind, name)               \
+  case int_op:                                                             \
+    if (!BOTH_OF_TYPE(lhe, rhe, INT)) {                                    \
+      return false;                                                        \
+    }                                                                      \
+    QUICK_INT_##kind(vm, lhe.val, rhe.val, op, name);                      \
+    return true;                                                           \
+  case float_op:                                                           \
+    if (!BOTH_OF_TYPE(lhe, rhe, FLOAT)) {                                  \
+      return false;                                                        \
+    }                                                                      \
+    *res = QUICK_RESULT_##kind(vm, lhe.val.float_val op rhe.val.float_val, \
+                               create_float);                              \
+    return true;
+
+bool operator_quick(VM *vm, Op op, Element lhe, Element rhe, Element *res) {
+  switch (op) {
+    QUICK_OPS(QUICK_RUN)
+    // There is no Float form since % only takes Ints. x % -1 is always 0 but
+    // traps for INT64_MIN, so it is answered here.
+    case MODI:
+      if (!BOTH_OF_TYPE(lhe, rhe, INT) || 0 == rhe.val.int_val) {
+        return false;
+      }
+      *res = create_int((-1 == rhe.val.int_val)
+                            ? 0
+                            : lhe.val.int_val % rhe.val.int_val);
+      return true;
+    default:
+      return false;
+  }
+}
+
+#define TO_BRANCH(compare, branch) \
+  case compare:                    \
+    return branch;
+#define TO_COMPARE(compare, branch) \
+  case branch:                      \
+    return compare;
+
+Op op_compare_branch(Op op) {
+  switch (op) {
+    BRANCH_OPS(TO_BRANCH)
+    default:
+      return NOP;
+  }
+}
+
+Op op_branch_compare(Op op) {
+  switch (op) {
+    BRANCH_OPS(TO_COMPARE)
+    default:
+      return NOP;
+  }
+}
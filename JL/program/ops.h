@@ -114,4 +114,52 @@ OPDEF_BOOLTYPE(and);
 OPDEF_BOOLTYPE(or);
 OPDEF_SINGLE(notc);
 
+// Quickening: a binary op that sees two Ints or two Floats is rewritten in
+// place to a form specialized for them, which skips the generic type checks.
+// When its operands stop matching it is rewritten back. MOD only has MODI.
+
+// X(generic, int_op, float_op, C operator, kind, __builtin_*_overflow name)
+#define QUICK_OPS(X)                 \
+  X(ADD, ADDI, ADDF, +, ARITH, add)  \
+  X(SUB, SUBI, SUBF, -, ARITH, sub)  \
+  X(MULT, MULI, MULF, *, ARITH, mul) \
+  X(DIV, DIVI, DIVF, /, DIV, div)    \
+  X(GT, GTI, GTF, >, BOOL, gt)       \
+  X(LT, LTI, LTF, <, BOOL, lt)       \
+  X(EQ, EQI, EQF, ==, BOOL, eq)      \
+  X(NEQ, NEQI, NEQF, !=, BOOL, neq)  \
+  X(GTE, GTEI, GTEF, >=, BOOL, gte)  \
+  X(LTE, LTEI, LTEF, <=, BOOL, lte)
+
+// Expands to the case labels of every form of a quickenable op, so a switch on
+// the op can route them all in one jump.
+#define QUICK_CASES(generic, int_op, float_op, op, kind, name) \
+  case generic:                                                \
+  case int_op:                                                 \
+  case float_op:
+
+// The generic op behind a quickened one, op itself if it can be quickened, or
+// NOP if it cannot.
+Op op_generic(Op op);
+// The form of generic op specialized for lhe and rhe, or op if there is none.
+Op op_specialize(Op op, Element lhe, Element rhe);
+// Runs a quickened op. Returns false if op is not one or the operands do not
+// match it.
+bool operator_quick(VM *vm, Op op, Element lhe, Element rhe, Element *res);
+
+// X(comparison, compare-and-branch op)
+#define BRANCH_OPS(X) \
+  X(LT, JLT)          \
+  X(LTE, JLTE)        \
+  X(GT, JGT)          \
+  X(GTE, JGTE)        \
+  X(EQ, JEQ)          \
+  X(NEQ, JNEQ)
+
+#define BRANCH_CASES(compare, branch) case branch:
+
+// The compare-and-branch op for a comparison and back, or NOP if there is none.
+Op op_compare_branch(Op op);
+Op op_branch_compare(Op op);
+
 #endif /* PROGRAM_OPS_H_ */
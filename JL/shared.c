@@ -5,12 +5,23 @@
  *      Author: Jeff
  */
 
+// For flockfile() and getc_unlocked(), which strict C modes hide. Not 2008,
+// whose getline() would clash with the one below.
+#define _POSIX_C_SOURCE 200112L
+
 #include "shared.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "arena/strings.h"
 #include "codegen/tokenizer.h"
 #include "error.h"
@@ -18,6 +29,9 @@
 
 #ifdef _WIN32
 #define SLASH_CHAR '\\';
+#define flockfile _lock_file
+#define funlockfile _unlock_file
+#define getc_unlocked _getc_nolock
 #else
 #define SLASH_CHAR '/';
 #endif
@@ -85,21 +99,195 @@ void strcrepl(char *src, char from, char to) {
   }
 }
 
-char *find_str(char *haystack, size_t haystack_len, const char *needle,
-               size_t needle_len) {
-  int i, j;
-  for (i = 0; i <= (haystack_len - needle_len); ++i) {
-    for (j = 0; j < needle_len; ++j) {
-      if (haystack[i + j] != needle[j]) {
-        break;
-      } else if (j == (needle_len - 1)) {
-        return haystack + i;
+// Needles longer than this use Two-Way so the worst case stays linear.
+#define TWO_WAY_MIN_NEEDLE_LEN 64
+
+// Checks a candidate whose first and last bytes are already known to match.
+#define FIND_STR_CHECK(pos)                                               \
+  if (0 == memcmp(haystack + (pos) + 1, needle + 1, needle_len - 2)) { \
+    return haystack + (pos);                                          \
+  }
+
+// Filters candidate positions by comparing the first and last bytes of the
+// needle against a block of the haystack at a time, then memcmps the rest.
+char *find_str_filtered(char *haystack, size_t haystack_len,
+                        const char *needle, size_t needle_len) {
+  size_t i = 0, num_positions = haystack_len - needle_len + 1;
+#if defined(__AVX2__)
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+  for (; i + 32 <= num_positions; i += 32) {
+    __m256i block_first = _mm256_loadu_si256((const __m256i *)(haystack + i));
+    __m256i block_last =
+        _mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                         _mm256_cmpeq_epi8(last, block_last)));
+    while (0 != mask) {
+      FIND_STR_CHECK(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+  for (; i + 16 <= num_positions; i += 16) {
+    __m128i block_first = _mm_loadu_si128((const __m128i *)(haystack + i));
+    __m128i block_last =
+        _mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                      _mm_cmpeq_epi8(last, block_last)));
+    while (0 != mask) {
+      FIND_STR_CHECK(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  // Whatever is left over, or everything without SIMD.
+  while (i < num_positions) {
+    char *first_match = memchr(haystack + i, needle[0], num_positions - i);
+    if (NULL == first_match) {
+      return NULL;
+    }
+    i = first_match - haystack;
+    if (haystack[i + needle_len - 1] == needle[needle_len - 1]) {
+      FIND_STR_CHECK(i);
+    }
+    i++;
+  }
+  return NULL;
+}
+
+#undef FIND_STR_CHECK
+
+// Splits the needle into two parts such that the right part is its maximal
+// suffix, and sets period to the period of the right part.
+size_t two_way_critical_factorization(const unsigned char needle[],
+                                      size_t needle_len, size_t *period) {
+  size_t max_suffix = SIZE_MAX, max_suffix_rev = SIZE_MAX;
+  size_t j = 0, k = 1, p = 1;
+  unsigned char a, b;
+  // Max suffix under <.
+  while (j + k < needle_len) {
+    a = needle[j + k];
+    b = needle[max_suffix + k];
+    if (a < b) {
+      j += k;
+      k = 1;
+      p = j - max_suffix;
+    } else if (a == b) {
+      if (k != p) {
+        ++k;
+      } else {
+        j += p;
+        k = 1;
+      }
+    } else {
+      max_suffix = j++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  // Max suffix under >.
+  j = 0;
+  k = p = 1;
+  while (j + k < needle_len) {
+    a = needle[j + k];
+    b = needle[max_suffix_rev + k];
+    if (b < a) {
+      j += k;
+      k = 1;
+      p = j - max_suffix_rev;
+    } else if (a == b) {
+      if (k != p) {
+        ++k;
+      } else {
+        j += p;
+        k = 1;
+      }
+    } else {
+      max_suffix_rev = j++;
+      k = p = 1;
+    }
+  }
+  // The longer of the two is the critical factorization.
+  if (max_suffix_rev + 1 < max_suffix + 1) {
+    return max_suffix + 1;
+  }
+  *period = p;
+  return max_suffix_rev + 1;
+}
+
+// Crochemore-Perrin Two-Way. O(n + m) time and O(1) space.
+char *find_str_two_way(char *haystack, size_t haystack_len,
+                       const char *needle, size_t needle_len) {
+  const unsigned char *h = (const unsigned char *)haystack;
+  const unsigned char *n = (const unsigned char *)needle;
+  size_t period, i, j = 0;
+  size_t suffix = two_way_critical_factorization(n, needle_len, &period);
+  if (0 == memcmp(n, n + period, suffix)) {
+    // The needle is periodic, so remember how much of the period already
+    // matched when shifting by it.
+    size_t memory = 0;
+    while (j <= haystack_len - needle_len) {
+      i = max(suffix, memory);
+      while (i < needle_len && n[i] == h[i + j]) {
+        ++i;
       }
+      if (i < needle_len) {
+        j += i - suffix + 1;
+        memory = 0;
+        continue;
+      }
+      i = suffix - 1;
+      while (memory < i + 1 && n[i] == h[i + j]) {
+        --i;
+      }
+      if (i + 1 < memory + 1) {
+        return haystack + j;
+      }
+      j += period;
+      memory = needle_len - period;
+    }
+    return NULL;
+  }
+  period = max(suffix, needle_len - suffix) + 1;
+  while (j <= haystack_len - needle_len) {
+    i = suffix;
+    while (i < needle_len && n[i] == h[i + j]) {
+      ++i;
+    }
+    if (i < needle_len) {
+      j += i - suffix + 1;
+      continue;
+    }
+    i = suffix - 1;
+    while (i != SIZE_MAX && n[i] == h[i + j]) {
+      --i;
+    }
+    if (SIZE_MAX == i) {
+      return haystack + j;
     }
+    j += period;
   }
   return NULL;
 }
 
+char *find_str(char *haystack, size_t haystack_len, const char *needle,
+               size_t needle_len) {
+  if (0 == needle_len || needle_len > haystack_len) {
+    return NULL;
+  }
+  if (1 == needle_len) {
+    return memchr(haystack, needle[0], haystack_len);
+  }
+  if (needle_len < TWO_WAY_MIN_NEEDLE_LEN) {
+    return find_str_filtered(haystack, haystack_len, needle, needle_len);
+  }
+  return find_str_two_way(haystack, haystack_len, needle, needle_len);
+}
+
 bool contains_char(const char str[], char c) {
   int i;
   for (i = 0; i < strlen(str); i++) {
@@ -160,59 +348,38 @@ int32_t string_comparator(const void *ptr1, const void *ptr2) {
   return strncmp((char *)lhs, (char *)rhs, sizeof(uint32_t));
 }
 
+// Reads a line, newline included, into *lineptr. The stream is locked once
+// for the whole line so each char is a plain buffer read instead of a locked
+// call. fgets() would be no faster and cannot say how much it read past a NUL.
+// The buffer doubles as it grows so long lines take few copies, and callers
+// may keep it for the next line.
 ssize_t getline(char **lineptr, size_t *n, FILE *stream) {
-  char *bufptr = NULL;
-  char *p = bufptr;
-  size_t size;
-  int c;
-
-  if (lineptr == NULL) {
-    return -1;
-  }
-  if (stream == NULL) {
-    return -1;
-  }
-  if (n == NULL) {
-    return -1;
-  }
-  bufptr = *lineptr;
-  size = *n;
-
-  c = fgetc(stream);
-  if (c == EOF) {
+  if (lineptr == NULL || stream == NULL || n == NULL) {
     return -1;
   }
-  if (bufptr == NULL) {
-    bufptr = ALLOC_ARRAY2(char, 128);
-    if (bufptr == NULL) {
-      return -1;
+  if (*lineptr == NULL || *n < 2) {
+    if (*lineptr != NULL) {
+      DEALLOC(*lineptr);
     }
-    size = 128;
-  }
-  p = bufptr;
-  while (c != EOF) {
-    if ((p - bufptr) > (size - 1)) {
-      size = size + 128;
-      // Handle realloc
-      int offset = p - bufptr;
-      bufptr = REALLOC(bufptr, char, size);
-      if (bufptr == NULL) {
-        return -1;
-      }
-      p = bufptr + offset;
+    *n = 128;
+    *lineptr = ALLOC_ARRAY2(char, *n);
+  }
+  size_t len = 0;
+  int c;
+  flockfile(stream);
+  while (EOF != (c = getc_unlocked(stream))) {
+    if (len + 1 == *n) {
+      *n *= 2;
+      *lineptr = REALLOC(*lineptr, char, *n);
     }
-    *(p++) = c;
-    if (c == '\n') {
+    (*lineptr)[len++] = (char)c;
+    if ('\n' == c) {
       break;
     }
-    c = fgetc(stream);
   }
-
-  *(p++) = '\0';
-  *lineptr = bufptr;
-  *n = size;
-
-  return p - bufptr - 1;
+  funlockfile(stream);
+  (*lineptr)[len] = '\0';
+  return len == 0 ? -1 : (ssize_t)len;
 }
 
 void split_path_file(const char path_file[], char **path, char **file_name,
@@ -42,6 +42,12 @@ void thread_init(Thread *t, Element self, MemoryGraph *graph, Element root) {
   t->graph = graph;
   t->id = THREAD_COUNT++;
   t->access_mutex = mutex_create(NULL);
+  t->green = false;
+  t->sync_depth = 0;
+  t->park.fd = -1;
+  t->park.events = 0;
+  t->park.fn = NULL;
+  op_history_init(t->op_history);
   ASSERT(NOT_NULL(t), NOT_NULL(graph));
   memory_graph_set_field(graph, self, strings_intern("id"), create_int(t->id));
   memory_graph_set_field(graph, self, CURRENT_BLOCK, (t->current_block = self));
@@ -56,14 +62,12 @@ void thread_init(Thread *t, Element self, MemoryGraph *graph, Element root) {
                          (t->saved_blocks = create_array(graph)));
 }
 
-void thread_start(Thread *t, VM *vm) {
+void thread_begin(Thread *t, VM *vm) {
   ASSERT(NOT_NULL(t));
   Element fn = obj_get_field(t->self, strings_intern("fn"));
   Element arg = obj_get_field(t->self, strings_intern("arg"));
   t_set_resval(t, arg);
 
-  Element current_block = t_current_block(t);
-
   if (inherits_from(obj_get_field_obj(fn.obj, CLASS_KEY).obj,
                     class_function.obj) ||
       ISTYPE(fn, class_anon_function)) {
@@ -80,14 +84,29 @@ void thread_start(Thread *t, VM *vm) {
   } else {
     ERROR("NOOOOOOOOOO");
   }
+}
 
-  while (execute(vm, t)) {
-    if (current_block.obj == t_current_block(t).obj) {
-      break;
+bool thread_continue(Thread *t, VM *vm) {
+  ASSERT(NOT_NULL(t));
+  // The Thread object is its own first block.
+  if (t->self.obj != t_current_block(t).obj) {
+    while (execute(vm, t)) {
+      if (t->self.obj == t_current_block(t).obj) {
+        break;
+      }
+      if (t->park.fd >= 0) {
+        return false;
+      }
     }
   }
   Element result = t_get_resval(t);
   memory_graph_set_field(vm->graph, t->self, strings_intern("result"), result);
+  return true;
+}
+
+void thread_start(Thread *t, VM *vm) {
+  thread_begin(t, vm);
+  thread_continue(t, vm);
 }
 
 unsigned __stdcall thread_start_wrapper(void *ptr) {
@@ -275,6 +294,24 @@ Element t_peekstack(Thread *t, int distance) {
   return Array_get(array, Array_size(array) - 1 - distance);
 }
 
+bool t_can_park(const Thread *t) {
+  return NULL != t && t->green && 0 == t->sync_depth;
+}
+
+bool t_park(Thread *t, int fd, int events, ExternalFunction fn,
+            ExternalData *data, const Element *arg) {
+  if (!t_can_park(t) || fd < 0) {
+    return false;
+  }
+  t->park.fd = fd;
+  t->park.events = events;
+  t->park.fn = fn;
+  memory_graph_set_field(t->graph, t->self, strings_intern("$park_obj"),
+                         data->object);
+  memory_graph_set_field(t->graph, t->self, strings_intern("$park_arg"), *arg);
+  return true;
+}
+
 bool is_block(Element elt) {
   return ISTYPE(elt, class_object) &&
          NONE != obj_lookup(elt.obj, CKey_$ip).type;
@@ -7,15 +7,32 @@
 #include "../element.h"
 #include "../error.h"
 #include "../program/instruction.h"
+#include "../vm/op_profile.h"
 #include "thread_interface.h"
 
 typedef struct VM_ VM;
 
+// An external call which would have blocked, waiting for events on fd. The
+// object and argument it was called with are kept on the Thread object.
+typedef struct {
+  // -1 when not parked.
+  int fd;
+  int events;
+  ExternalFunction fn;
+} ThreadPark;
+
 typedef struct Thread_ {
   int64_t id;
   MemoryGraph *graph;
   Element self, stack, saved_blocks, current_block;
   ThreadHandle access_mutex;
+  // Run by a scheduler rather than on an OS thread of its own.
+  bool green;
+  // Native frames, like vm_call_fn_sync(), which a park cannot unwind.
+  uint32_t sync_depth;
+  ThreadPark park;
+  // Ops just executed, for -profile_ops.
+  Op op_history[OP_HISTORY_LEN];
 } Thread;
 
 // Merges Thread class into external C type.
@@ -23,6 +40,12 @@ Element add_thread_class(VM *vm, Element module);
 
 Thread *thread_create(Element self, MemoryGraph *graph, Element root);
 void thread_start(Thread *t, VM *vm);
+// Calls the Thread's fn without executing it, so thread_continue() can run it
+// in steps.
+void thread_begin(Thread *t, VM *vm);
+// Executes until fn returns, then sets the result. Returns false instead if a
+// green Thread parked first.
+bool thread_continue(Thread *t, VM *vm);
 Element create_thread_object(VM *vm, Element fn, Element arg);
 Thread *Thread_extract(Element e);
 
@@ -57,4 +80,12 @@ void t_set_module(Thread *t, Element module_element, uint32_t ip);
 
 bool is_block(Element elt);
 
+// Whether an external call made now could park t instead of blocking.
+bool t_can_park(const Thread *t);
+// Parks t if it can, so that its scheduler calls fn with data and arg again
+// once fd has any of events, the result of which is the result of the call.
+// Returns false if t cannot park and the caller should block instead.
+bool t_park(Thread *t, int fd, int events, ExternalFunction fn,
+            ExternalData *data, const Element *arg);
+
 #endif /* THREADS_THREAD_H_ */
@@ -0,0 +1,163 @@
+/*
+ * op_profile.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#include "op_profile.h"
+
+#include <stdlib.h>
+
+#include "../error.h"
+#include "../memory/memory.h"
+
+#define PAIR_INDEX(op1, op2) ((op1)*OP_BOUND + (op2))
+#define TRIPLE_INDEX(op1, op2, op3) (PAIR_INDEX(op1, op2) * OP_BOUND + (op3))
+
+// Only the triples which actually run are kept, so this is far smaller than
+// OP_BOUND^3 counters. Must be a power of 2.
+#define TRIPLE_TABLE_SIZE 8192
+
+typedef struct {
+  // TRIPLE_INDEX() + 1, or 0 when the entry is free.
+  uint32_t key;
+  uint64_t count;
+} TripleCount;
+
+struct OpProfile_ {
+  uint64_t ops[OP_BOUND];
+  uint64_t pairs[OP_BOUND * OP_BOUND];
+  TripleCount triples[TRIPLE_TABLE_SIZE];
+  // Triples which did not fit in the table.
+  uint64_t dropped_triples;
+};
+
+typedef struct {
+  uint64_t count;
+  Op ops[3];
+} OpSequence;
+
+OpProfile *op_profile_create() { return ALLOC(OpProfile); }
+
+void op_profile_delete(OpProfile *profile) {
+  ASSERT(NOT_NULL(profile));
+  DEALLOC(profile);
+}
+
+void op_history_init(Op history[OP_HISTORY_LEN]) {
+  int i;
+  for (i = 0; i < OP_HISTORY_LEN; i++) {
+    history[i] = OP_BOUND;
+  }
+}
+
+void op_profile_count_triple(OpProfile *profile, uint32_t index) {
+  uint32_t key = index + 1;
+  // Fibonacci hashing spreads the neighboring indices of one pair apart.
+  uint32_t slot = (key * 2654435769u) & (TRIPLE_TABLE_SIZE - 1);
+  int probes;
+  for (probes = 0; probes < TRIPLE_TABLE_SIZE; probes++) {
+    TripleCount *entry = profile->triples + slot;
+    if (key == entry->key ||
+        (0 == entry->key &&
+         (__sync_bool_compare_and_swap(&entry->key, 0, key) ||
+          key == entry->key))) {
+      __sync_fetch_and_add(&entry->count, 1);
+      return;
+    }
+    slot = (slot + 1) & (TRIPLE_TABLE_SIZE - 1);
+  }
+  __sync_fetch_and_add(&profile->dropped_triples, 1);
+}
+
+void op_profile_record(OpProfile *profile, Op history[OP_HISTORY_LEN],
+                       Op op) {
+  // Several threads may be executing at once.
+  __sync_fetch_and_add(profile->ops + op, 1);
+  if (OP_BOUND != history[0]) {
+    __sync_fetch_and_add(profile->pairs + PAIR_INDEX(history[0], op), 1);
+  }
+  if (OP_BOUND != history[1]) {
+    op_profile_count_triple(profile,
+                            TRIPLE_INDEX(history[1], history[0], op));
+  }
+  history[1] = history[0];
+  history[0] = op;
+}
+
+int op_sequence_compare(const void *x, const void *y) {
+  uint64_t count_x = ((const OpSequence *)x)->count;
+  uint64_t count_y = ((const OpSequence *)y)->count;
+  return (count_x < count_y) - (count_x > count_y);
+}
+
+void op_sequence_set(OpSequence *seq, uint64_t count, uint32_t index,
+                     int seq_len) {
+  seq->count = count;
+  int j;
+  for (j = seq_len - 1; j >= 0; j--) {
+    seq->ops[j] = index % OP_BOUND;
+    index /= OP_BOUND;
+  }
+}
+
+void print_top(OpSequence *seqs, int num_seqs, int seq_len, uint64_t total,
+               FILE *file, int top_n) {
+  qsort(seqs, num_seqs, sizeof(OpSequence), op_sequence_compare);
+  int i;
+  for (i = 0; i < num_seqs && i < top_n; i++) {
+    fprintf(file, "  %12llu %6.2f%%  ", (unsigned long long)seqs[i].count,
+            total == 0 ? 0.0 : 100.0 * seqs[i].count / total);
+    int j;
+    for (j = 0; j < seq_len; j++) {
+      fprintf(file, "%-6s", instructions[seqs[i].ops[j]]);
+    }
+    fprintf(file, "\n");
+  }
+}
+
+void print_top_counts(const uint64_t counts[], int num_counts, int seq_len,
+                      uint64_t total, FILE *file, int top_n) {
+  OpSequence *seqs = ALLOC_ARRAY2(OpSequence, num_counts);
+  int i, num_seqs = 0;
+  for (i = 0; i < num_counts; i++) {
+    if (0 != counts[i]) {
+      op_sequence_set(seqs + num_seqs++, counts[i], i, seq_len);
+    }
+  }
+  print_top(seqs, num_seqs, seq_len, total, file, top_n);
+  DEALLOC(seqs);
+}
+
+void op_profile_print(const OpProfile *profile, FILE *file, int top_n) {
+  ASSERT(NOT_NULL(profile), NOT_NULL(file));
+  uint64_t total = 0;
+  int i;
+  for (i = 0; i < OP_BOUND; i++) {
+    total += profile->ops[i];
+  }
+  fprintf(file, "Op profile: %llu instructions executed.\n",
+          (unsigned long long)total);
+  fprintf(file, "Ops:\n");
+  print_top_counts(profile->ops, OP_BOUND, 1, total, file, top_n);
+  fprintf(file, "Pairs:\n");
+  print_top_counts(profile->pairs, OP_BOUND * OP_BOUND, 2, total, file,
+                   top_n);
+  fprintf(file, "Triples:\n");
+  OpSequence *seqs = ALLOC_ARRAY2(OpSequence, TRIPLE_TABLE_SIZE);
+  int num_seqs = 0;
+  for (i = 0; i < TRIPLE_TABLE_SIZE; i++) {
+    const TripleCount *entry = profile->triples + i;
+    if (0 != entry->key) {
+      op_sequence_set(seqs + num_seqs++, entry->count, entry->key - 1, 3);
+    }
+  }
+  print_top(seqs, num_seqs, 3, total, file, top_n);
+  DEALLOC(seqs);
+  if (profile->dropped_triples > 0) {
+    fprintf(file, "  %12llu triples not counted.\n",
+            (unsigned long long)profile->dropped_triples);
+  }
+  fflush(file);
+}
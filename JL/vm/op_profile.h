@@ -0,0 +1,34 @@
+/*
+ * op_profile.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jeff
+ */
+
+#ifndef VM_OP_PROFILE_H_
+#define VM_OP_PROFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../program/instruction.h"
+
+// Ops a Thread remembers having executed, for the triples.
+#define OP_HISTORY_LEN 2
+
+// Counts how often each pair and triple of ops is executed one after another
+// so the hottest ones can be turned into superinstructions.
+typedef struct OpProfile_ OpProfile;
+
+OpProfile *op_profile_create();
+void op_profile_delete(OpProfile *profile);
+
+// Empties a Thread's history, newest op first. OP_BOUND marks no op.
+void op_history_init(Op history[OP_HISTORY_LEN]);
+// Counts op along with the ops the same Thread executed just before it, then
+// adds op to history. Follows jumps and calls since history is what ran.
+void op_profile_record(OpProfile *profile, Op history[OP_HISTORY_LEN],
+                       Op op);
+void op_profile_print(const OpProfile *profile, FILE *file, int top_n);
+
+#endif /* VM_OP_PROFILE_H_ */
@@ -9,6 +9,7 @@
 #include "../element.h"
 #include "../external/external.h"
 #include "../external/net/net.h"
+#include "../external/struct.h"
 #include "../external/time/time.h"
 #include "../shared.h"
 #include "../threads/sync.h"
@@ -31,9 +32,35 @@ void maybe_merge_existing_source(VM *vm, Element module_element,
     add_io_external(vm, module_element);
   } else if (ENDS_WITH_ANY(fn, sync)) {
     add_sync_external(vm, module_element);
+  } else if (ENDS_WITH_ANY(fn, struct)) {
+    add_struct_external(vm, module_element);
   } else if (ENDS_WITH_ANY(fn, net)) {
     add_net_external(vm, module_element);
   } else if (ENDS_WITH_ANY(fn, time)) {
     add_time_external(vm, module_element);
   }
 }
+
+const char **builtin_external_classes(const char fn[]) {
+  // Keep in step with the add_*_external() functions called above.
+  static const char *io_classes[] = {"File__", "FileFuture", NULL};
+  static const char *sync_classes[] = {"Thread", "Mutex", "Semaphore",
+                                       "RWLock", NULL};
+  static const char *struct_classes[] = {
+      "Map", "Set", "LruCache", "SyncLruCache", "MapIterator__", NULL};
+  static const char *net_classes[] = {
+      "SocketHandle", "Socket", "SSLSocketHandle", "SSLSocket",
+      "EventLoop", "HttpFields", "HttpFieldsIterator__", "HttpParser",
+      "Template", "Router", "Scheduler", NULL};
+  static const char *no_classes[] = {NULL};
+  if (ENDS_WITH_ANY(fn, io)) {
+    return io_classes;
+  } else if (ENDS_WITH_ANY(fn, sync)) {
+    return sync_classes;
+  } else if (ENDS_WITH_ANY(fn, struct)) {
+    return struct_classes;
+  } else if (ENDS_WITH_ANY(fn, net)) {
+    return net_classes;
+  }
+  return no_classes;
+}
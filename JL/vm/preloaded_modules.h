@@ -13,4 +13,8 @@
 void maybe_merge_existing_source(VM *vm, Element module_element,
                                  const char fn[]);
 
+// NULL-terminated names of the classes maybe_merge_existing_source() adds to
+// the builtin module loaded from fn.
+const char **builtin_external_classes(const char fn[]);
+
 #endif /* VM_PRELOADED_MODULES_H_ */
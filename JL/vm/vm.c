@@ -23,6 +23,8 @@
 #include "../error.h"
 #include "../external/external.h"
 #include "../external/strings.h"
+#include "../external/time/impl/time.h"
+#include "../external/typed_array.h"
 #include "../file_load.h"
 #include "../memory/memory.h"
 #include "../memory/memory_graph.h"
@@ -34,6 +36,9 @@
 #include "../threads/sync.h"
 #include "../threads/thread.h"
 #include "../vm/preloaded_modules.h"
+#include "op_profile.h"
+
+#define OP_PROFILE_TOP_N 25
 
 void vm_to_string(const VM *vm, Element elt, FILE *target);
 void execute_tget(VM *vm, Thread *t, Ins ins, Element tuple, int64_t index);
@@ -103,9 +108,76 @@ void catch_error(VM *vm, Thread *t) {
   fflush(stderr);
 }
 
-DEB_FN(Element, vm_lookup_module, const VM *vm, const char module_name[]) {
+Element vm_merge_module(VM *vm, const char fn[]);
+
+// Loads the pending builtin module named module_name if there is one.
+Element vm_load_pending_module(VM *vm, const char module_name[]) {
+  mutex_await(vm->module_load_mutex, INFINITE);
+  // Another thread may have loaded it while this one was waiting.
+  Element module = obj_get_field(vm->modules, module_name);
+  const char *fn;
+  if (NONE == module.type &&
+      NULL != (fn = map_lookup(&vm->pending_modules, module_name))) {
+    map_remove(&vm->pending_modules, module_name);
+    vm->num_pending_modules--;
+    module = vm_merge_module(vm, fn);
+  }
+  mutex_release(vm->module_load_mutex);
+  return module;
+}
+
+// Records each class the builtin module in fn declares as owned by
+// module_name. Only compiled modules are indexed, so a .jb file is loaded
+// right away instead.
+void vm_index_builtin_classes(VM *vm, const char fn[],
+                              const char module_name[]) {
+  const char **external = builtin_external_classes(fn);
+  for (; NULL != *external; ++external) {
+    map_insert(&vm->builtin_classes, strings_intern(*external),
+               (void *)module_name);
+  }
+  FILE *file = fopen(fn, "r");
+  if (NULL == file) {
+    return;
+  }
+  char line[256];
+  bool line_start = true;
+  while (NULL != fgets(line, sizeof(line), file)) {
+    bool at_start = line_start;
+    line_start = NULL != strchr(line, '\n');
+    if (!at_start) {
+      continue;
+    }
+    char *pos = line;
+    while (is_whitespace(*pos)) {
+      pos++;
+    }
+    if (0 != strncmp(pos, "class", 5) || !is_whitespace(pos[5])) {
+      continue;
+    }
+    pos += 6;
+    while (is_whitespace(*pos)) {
+      pos++;
+    }
+    int len = 0;
+    while (is_alphanumeric(pos[len])) {
+      len++;
+    }
+    if (len > 0) {
+      map_insert(&vm->builtin_classes, strings_intern_range(pos, 0, len),
+                 (void *)module_name);
+    }
+  }
+  fclose(file);
+}
+
+DEB_FN(Element, vm_lookup_module, VM *vm, const char module_name[]) {
   ASSERT(NOT_NULL(vm), NOT_NULL(module_name));
-  return obj_get_field(vm->modules, module_name);
+  Element module = obj_get_field(vm->modules, module_name);
+  if (NONE == module.type && vm->num_pending_modules > 0) {
+    module = vm_load_pending_module(vm, module_name);
+  }
+  return module;
 }
 
 void vm_add_string_class(VM *vm) { merge_string_class(vm, class_string); }
@@ -241,7 +313,7 @@ Element vm_add_module(VM *vm, const Module *module) {
   module_iterate_classes(module, add_class);
   return module_element;
 }
-void vm_merge_module(VM *vm, const char fn[]) {
+Element vm_merge_module(VM *vm, const char fn[]) {
   Module *module = load_fn(strings_intern(fn), vm->store);
   ASSERT(NOT_NULL(vm), NOT_NULL(module));
   Element module_element = create_module(vm, module);
@@ -297,13 +369,22 @@ void vm_merge_module(VM *vm, const char fn[]) {
     map_iterate(methods, add_method);
   }
   module_iterate_classes(module, add_class);
+  return module_element;
 }
 
 VM *vm_create(ArgStore *store) {
+  int64_t start_usec = current_usec_since_epoch();
   VM *vm = ALLOC(VM);
   vm->debug_mutex = mutex_create(NULL);
   vm->module_init_mutex = mutex_create(NULL);
+  vm->module_load_mutex = mutex_create(NULL);
+  map_init_default(&vm->pending_modules);
+  vm->num_pending_modules = 0;
+  map_init_default(&vm->builtin_classes);
   vm->store = store;
+  vm->op_profile = argstore_lookup_bool(store, ArgKey__PROFILE_OPS)
+                       ? op_profile_create()
+                       : NULL;
   vm->graph = memory_graph_create();
   vm->root = memory_graph_create_root_element(vm->graph);
   memory_graph_set_field(vm->graph, vm->root, THREADS_KEY,
@@ -330,11 +411,37 @@ VM *vm_create(ArgStore *store) {
   memory_graph_set_field(vm->graph, vm->root, FALSE_KEYWORD, create_none());
   memory_graph_set_field(vm->graph, vm->root, TRUE_KEYWORD, create_int(1));
 
+  int64_t builtins_usec = current_usec_since_epoch();
+  int core_nodes = memory_graph_num_nodes(vm->graph);
+
+  // The rest are only compiled once something imports them or looks up one of
+  // their classes, unless -eager_builtins asks for the old behavior.
+  bool eager = argstore_lookup_bool(store, ArgKey__EAGER_BUILTINS);
   int i;
   for (i = 0; i < builtin_files->count; ++i) {
+    const char *module_name = strings_intern(builtin_files->stringlist_val[i]);
     const char *fn =
         guess_file_extension(builtin_dir, builtin_files->stringlist_val[i]);
-    vm_merge_module(vm, fn);
+    map_insert(&vm->pending_modules, module_name, (void *)fn);
+    vm->num_pending_modules++;
+    if (eager || ends_with(fn, ".jb")) {
+      vm_load_pending_module(vm, module_name);
+    } else {
+      vm_index_builtin_classes(vm, fn, module_name);
+    }
+  }
+  if (argstore_lookup_bool(store, ArgKey__STARTUP_STATS)) {
+    int64_t end_usec = current_usec_since_epoch();
+    int nodes = memory_graph_num_nodes(vm->graph);
+    fprintf(stderr,
+            "Before builtin modules: %lld usec, %d objects (%zu KB).\n"
+            "After builtin modules: %lld usec, %d objects (%zu KB). %d of %d "
+            "builtin modules left to load, %d classes indexed.\n",
+            (long long)(builtins_usec - start_usec), core_nodes,
+            core_nodes * sizeof(Object) / 1024,
+            (long long)(end_usec - start_usec), nodes,
+            nodes * sizeof(Object) / 1024, vm->num_pending_modules,
+            builtin_files->count, (int)map_size(&vm->builtin_classes));
   }
   return vm;
 }
@@ -355,6 +462,18 @@ void vm_delete(VM *vm) {
   vm->graph = NULL;
   mutex_close(vm->debug_mutex);
   mutex_close(vm->module_init_mutex);
+  mutex_close(vm->module_load_mutex);
+  if (argstore_lookup_bool(vm->store, ArgKey__STARTUP_STATS)) {
+    fprintf(stderr, "%d of %d builtin modules were never loaded.\n",
+            vm->num_pending_modules,
+            argstore_get(vm->store, ArgKey__BUILTIN_FILES)->count);
+  }
+  map_finalize(&vm->pending_modules);
+  map_finalize(&vm->builtin_classes);
+  if (NULL != vm->op_profile) {
+    op_profile_print(vm->op_profile, stderr, OP_PROFILE_TOP_N);
+    op_profile_delete(vm->op_profile);
+  }
   DEALLOC(vm);
 }
 
@@ -466,6 +585,15 @@ Element vm_lookup(VM *vm, Thread *t, const char name[]) {
     if (NONE != (lookup = obj_get_field(t->self, name)).type) {
       return maybe_wrap_in_instance(vm, t, block, lookup, name);
     }
+    // Classes of a builtin module only become global once it is loaded, so
+    // load the one which owns the name and look again.
+    const char *module_name;
+    if (vm->num_pending_modules > 0 &&
+        NULL != (module_name = map_lookup(&vm->builtin_classes, name)) &&
+        NONE != vm_lookup_module(vm, module_name).type &&
+        NONE != (lookup = obj_get_field(vm->root, name)).type) {
+      return maybe_wrap_in_instance(vm, t, block, lookup, name);
+    }
     return create_none();
   }
   return maybe_wrap_in_instance(vm, t, block, lookup, name);
@@ -595,6 +723,33 @@ void vm_call_fn(VM *vm, Thread *t, Element obj, Element func) {
                  "Attempted to call something not a function or Class.");
 }
 
+bool vm_call_fn_sync(VM *vm, Thread *t, Element obj, Element func,
+                     Element args, Element *result) {
+  Element block = t_current_block(t);
+  uint32_t ip = t_get_ip(t);
+  uint32_t depth = Array_size(t->saved_blocks.obj->array);
+  t_set_resval(t, args);
+  // Returning early to park would lose this frame.
+  t->sync_depth++;
+  vm_call_fn(vm, t, obj, func);
+  if (Array_size(t->saved_blocks.obj->array) > depth) {
+    t_shift_ip(t, 1);
+    while (Array_size(t->saved_blocks.obj->array) > depth && execute(vm, t))
+      ;
+  }
+  t->sync_depth--;
+  if (block.obj != t_current_block(t).obj ||
+      (t_get_ip(t) != ip && t_get_ip(t) != ip + 1)) {
+    // An error unwound to a catch or started raise_error. Execution continues
+    // from there, so undo the shift execute() makes after the caller returns.
+    t_shift_ip(t, -1);
+    return false;
+  }
+  t_set_ip(t, ip);
+  *result = t_get_resval(t);
+  return true;
+}
+
 void vm_to_string(const VM *vm, Element elt, FILE *target) {
   elt_to_str(elt, target);
 }
@@ -612,8 +767,27 @@ void execute_object_operation(VM *vm, Thread *t, Element lhs, Element rhs,
   vm_call_fn(vm, t, builtin, fn);
 }
 
+// Calls fn with the resval as its arguments.
+void execute_call(VM *vm, Thread *t, Ins ins, Element fn) {
+  if (!ISOBJECT(fn)) {
+    vm_throw_error(vm, t, ins,
+                   "Cannot execute call something not a Function or Class.");
+    return;
+  }
+  Element class = obj_lookup(fn.obj, CKey_class);
+  if (inherits_from(class.obj, class_function.obj) ||
+      ISTYPE(fn, class_methodinstance) ||
+      ISTYPE(fn, class_external_methodinstance) ||
+      ISTYPE(fn, class_anon_function)) {
+    vm_call_fn(vm, t, *obj_deep_lookup_ckey(fn.obj, CKey_module), fn);
+  } else if (ISTYPE(fn, class_class)) {
+    vm_call_new(vm, t, fn);
+  }
+}
+
 bool execute_no_param(VM *vm, Thread *t, Ins ins) {
   Element elt, index, new_val, class, block;
+  TypedArray *typed;
   bool has_error = false;
   switch (ins.op) {
     case NOP:
@@ -637,22 +811,7 @@ bool execute_no_param(VM *vm, Thread *t, Ins ins) {
       if (has_error) {
         return true;
       }
-      if (ISOBJECT(elt)) {
-        class = obj_lookup(elt.obj, CKey_class);
-        if (inherits_from(class.obj, class_function.obj) ||
-            ISTYPE(elt, class_methodinstance) ||
-            ISTYPE(elt, class_external_methodinstance) ||
-            ISTYPE(elt, class_anon_function)) {
-          vm_call_fn(vm, t, *obj_deep_lookup_ckey(elt.obj, CKey_module), elt);
-        } else if (ISTYPE(elt, class_class)) {
-          vm_call_new(vm, t, elt);
-        }
-      } else {
-        vm_throw_error(
-            vm, t, ins,
-            "Cannot execute call something not a Function or Class.");
-        return true;
-      }
+      execute_call(vm, t, ins, elt);
       return true;
     case ASET:
       elt = t_popstack(t, &has_error);
@@ -681,6 +840,17 @@ bool execute_no_param(VM *vm, Thread *t, Ins ins) {
           return true;
         }
         memory_graph_array_set(vm->graph, elt.obj, index.val.int_val, &new_val);
+      } else if (NULL != (typed = typed_array_of(elt.obj))) {
+        if (index.type != VALUE || index.val.type != INT) {
+          vm_throw_error(vm, t, ins,
+                         "Cannot index an array with something not an int.");
+          return true;
+        }
+        const char *error =
+            typed_array_set(vm, elt, typed, index.val.int_val, new_val);
+        if (NULL != error) {
+          vm_throw_error(vm, t, ins, error);
+        }
       } else {
         Element set_fn = vm_object_lookup(vm, t, elt, ARRAYLIKE_SET_KEY);
         if (NONE == set_fn.type) {
@@ -725,6 +895,22 @@ bool execute_no_param(VM *vm, Thread *t, Ins ins) {
           t_set_resval(t, Array_get(elt.obj->array, index.val.int_val));
         }
         return true;
+      } else if (NULL != (typed = typed_array_of(elt.obj))) {
+        if (index.type != VALUE || index.val.type != INT) {
+          vm_throw_error(vm, t, ins,
+                         "Array indexing with something not an int.");
+          return true;
+        }
+        // elt is about to hold the value instead.
+        Object *typed_obj = elt.obj;
+        typed_array_lock(typed_obj);
+        const char *error = typed_array_get(typed, index.val.int_val, &elt);
+        typed_array_unlock(typed_obj);
+        if (NULL != error) {
+          vm_throw_error(vm, t, ins, error);
+          return true;
+        }
+        t_set_resval(t, elt);
       } else {
         Element index_fn = vm_object_lookup(vm, t, elt, ARRAYLIKE_INDEX_KEY);
         if (NONE == index_fn.type) {
@@ -835,51 +1021,6 @@ bool execute_no_param(VM *vm, Thread *t, Ins ins) {
     return true;
   }
   switch (ins.op) {
-    case ADD:
-      if (ISTYPE(lhs, class_string) && ISTYPE(rhs, class_string)) {
-        res = string_add(vm, lhs, rhs);
-        break;
-      }
-      res = operator_add(vm, t, ins, lhs, rhs);
-      break;
-    case SUB:
-      res = operator_sub(vm, t, ins, lhs, rhs);
-      break;
-    case MULT:
-      res = operator_mult(vm, t, ins, lhs, rhs);
-      break;
-    case DIV:
-      res = operator_div(vm, t, ins, lhs, rhs);
-      break;
-    case MOD:
-      res = operator_mod(vm, t, ins, lhs, rhs);
-      break;
-    case EQ:
-      if (lhs.type == VALUE && rhs.type == VALUE) {
-        res = operator_eq(vm, t, ins, lhs, rhs);
-        break;
-      }
-      execute_object_operation(vm, t, lhs, rhs, EQ_FN_NAME);
-      return true;
-    case NEQ:
-      if (lhs.type == VALUE && rhs.type == VALUE) {
-        res = operator_neq(vm, t, ins, lhs, rhs);
-        break;
-      }
-      execute_object_operation(vm, t, lhs, rhs, NEQ_FN_NAME);
-      return true;
-    case GT:
-      res = operator_gt(vm, t, ins, lhs, rhs);
-      break;
-    case LT:
-      res = operator_lt(vm, t, ins, lhs, rhs);
-      break;
-    case GTE:
-      res = operator_gte(vm, t, ins, lhs, rhs);
-      break;
-    case LTE:
-      res = operator_lte(vm, t, ins, lhs, rhs);
-      break;
     case AND:
       res = operator_and(vm, t, ins, lhs, rhs);
       break;
@@ -938,6 +1079,35 @@ void inc(VM *vm, Thread *t, Ins ins, Element *elt, int inc_val) {
   }
 }
 
+// Calls method ins.str of obj with the resval as its arguments.
+void execute_method_call(VM *vm, Thread *t, Ins ins, Element obj) {
+  if (obj.type == NONE) {
+    vm_throw_error(vm, t, ins, "Cannot deference Nil.");
+    return;
+  }
+  if (!ISOBJECT(obj)) {
+    vm_throw_error(vm, t, ins, "Cannot call a non-object.");
+    return;
+  }
+  Element target = vm_object_lookup(vm, t, obj, ins.str);
+  if (OBJECT != target.type) {
+    vm_throw_error(vm, t, ins, "Object has no such function '%s'.", ins.str);
+    return;
+  }
+  if (inherits_from(obj_lookup_ptr(target.obj, CKey_class)->obj,
+                    class_function.obj) ||
+      ISTYPE(target, class_methodinstance) ||
+      ISTYPE(target, class_external_methodinstance) ||
+      ISTYPE(target, class_anon_function)) {
+    vm_call_fn(vm, t, obj, target);
+  } else if (ISTYPE(target, class_class)) {
+    vm_call_new(vm, t, target);
+  } else {
+    vm_throw_error(vm, t, ins,
+                   "Cannot execute call something not a Function or Class.");
+  }
+}
+
 bool execute_id_param(VM *vm, Thread *t, Ins ins) {
   ASSERT_NOT_NULL(ins.str);
   Element block = t_current_block(t);
@@ -1027,6 +1197,19 @@ bool execute_id_param(VM *vm, Thread *t, Ins ins) {
     case RES:
       t_set_resval(t, vm_lookup(vm, t, ins.str));
       break;
+    case RCLL:
+      t_set_resval(t, vm_lookup(vm, t, ins.str));
+      obj = t_popstack(t, &has_error);
+      if (has_error) {
+        return true;
+      }
+      execute_call(vm, t, ins, obj);
+      break;
+    case PCLN:
+      obj = vm_lookup(vm, t, ins.str);
+      t_set_resval(t, vm->empty_tuple);
+      execute_call(vm, t, ins, obj);
+      break;
     case GET:
       new_res_val = vm_object_get(vm, t, ins.str, &has_error);
       if (!has_error) {
@@ -1103,6 +1286,16 @@ bool execute_id_param(VM *vm, Thread *t, Ins ins) {
       inc(vm, t, ins, (Element *)val, -1);
       t_set_resval(t, *val);
       break;
+    case PRES:
+      t_pushstack(t, t_get_resval(t));
+      t_set_resval(t, vm_lookup(vm, t, ins.str));
+      break;
+    case MCLN:
+      // PUSH+CLLN, so the object is the resval rather than popped.
+      obj = t_get_resval(t);
+      t_set_resval(t, vm->empty_tuple);
+      execute_method_call(vm, t, ins, obj);
+      break;
     case CLLN:
       t_set_resval(t, vm->empty_tuple);  // @suppress("No break at end of case")
     case CALL:
@@ -1110,34 +1303,7 @@ bool execute_id_param(VM *vm, Thread *t, Ins ins) {
       if (has_error) {
         return true;
       }
-      if (obj.type == NONE) {
-        vm_throw_error(vm, t, ins, "Cannot deference Nil.");
-        return true;
-      }
-      if (!ISOBJECT(obj)) {
-        vm_throw_error(vm, t, ins, "Cannot call a non-object.");
-        return true;
-      }
-      Element target = vm_object_lookup(vm, t, obj, ins.str);
-      if (OBJECT != target.type) {
-        vm_throw_error(vm, t, ins, "Object has no such function '%s'.",
-                       ins.str);
-        return true;
-      }
-      if (inherits_from(obj_lookup_ptr(target.obj, CKey_class)->obj,
-                        class_function.obj) ||
-          ISTYPE(target, class_methodinstance) ||
-          ISTYPE(target, class_external_methodinstance) ||
-          ISTYPE(target, class_anon_function)) {
-        vm_call_fn(vm, t, obj, target);
-      } else if (ISTYPE(target, class_class)) {
-        vm_call_new(vm, t, target);
-      } else {
-        vm_throw_error(
-            vm, t, ins,
-            "Cannot execute call something not a Function or Class.");
-        return true;
-      }
+      execute_method_call(vm, t, ins, obj);
       break;
     case PRNT:
       elt_to_str(vm_lookup(vm, t, ins.str), stdout);
@@ -1145,51 +1311,6 @@ bool execute_id_param(VM *vm, Thread *t, Ins ins) {
         fflush(stdout);
       }
       break;
-    case ADD:
-      resval = t_get_resval(t);
-      obj = vm_lookup(vm, t, ins.str);
-      if (ISTYPE(resval, class_string) && ISTYPE(obj, class_string)) {
-        t_set_resval(t, string_add(vm, resval, obj));
-        break;
-      }
-      t_set_resval(t, operator_add(vm, t, ins, t_get_resval(t), obj));
-      break;
-    case SUB:
-      t_set_resval(t, operator_sub(vm, t, ins, t_get_resval(t),
-                                   vm_lookup(vm, t, ins.str)));
-      break;
-    case DIV:
-      t_set_resval(t, operator_div(vm, t, ins, t_get_resval(t),
-                                   vm_lookup(vm, t, ins.str)));
-      break;
-    case MULT:
-      t_set_resval(t, operator_mult(vm, t, ins, t_get_resval(t),
-                                    vm_lookup(vm, t, ins.str)));
-      break;
-    case MOD:
-      t_set_resval(t, operator_mod(vm, t, ins, t_get_resval(t),
-                                   vm_lookup(vm, t, ins.str)));
-      break;
-    case LT:
-      t_set_resval(t, operator_lt(vm, t, ins, t_get_resval(t),
-                                  vm_lookup(vm, t, ins.str)));
-      break;
-    case LTE:
-      t_set_resval(t, operator_lte(vm, t, ins, t_get_resval(t),
-                                   vm_lookup(vm, t, ins.str)));
-      break;
-    case EQ:
-      t_set_resval(t, operator_eq(vm, t, ins, t_get_resval(t),
-                                  vm_lookup(vm, t, ins.str)));
-      break;
-    case GT:
-      t_set_resval(t, operator_gt(vm, t, ins, t_get_resval(t),
-                                  vm_lookup(vm, t, ins.str)));
-      break;
-    case GTE:
-      t_set_resval(t, operator_gte(vm, t, ins, t_get_resval(t),
-                                   vm_lookup(vm, t, ins.str)));
-      break;
     default:
       ERROR("Instruction op was not a id_param");
   }
@@ -1215,6 +1336,17 @@ void vm_set_catch_goto(VM *vm, Thread *t, uint32_t index) {
                          strings_intern("$try_goto"), create_int(index));
 }
 
+// Finds the block holding the slot referred to by a slot op.
+Object *slot_block(Thread *t, int64_t ref) {
+  Element block = t_current_block(t);
+  int depth;
+  for (depth = SLOT_DEPTH(ref); depth > 0; --depth) {
+    block = obj_lookup(block.obj, CKey_$parent);
+  }
+  ASSERT(OBJECT == block.type, SLOT_INDEX(ref) < block.obj->num_slots);
+  return block.obj;
+}
+
 bool execute_val_param(VM *vm, Thread *t, Ins ins) {
   Element elt = val_to_elt(ins.val), popped;
   Element tuple, array, new_res_val;
@@ -1222,42 +1354,20 @@ bool execute_val_param(VM *vm, Thread *t, Ins ins) {
   int tuple_len;
   int i;
   switch (ins.op) {
-    case ADD:
-      t_set_resval(t, operator_add(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case SUB:
-      t_set_resval(t, operator_sub(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case DIV:
-      t_set_resval(t, operator_div(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case MULT:
-      t_set_resval(t, operator_mult(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case MOD:
-      t_set_resval(t, operator_mod(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case LT:
-      t_set_resval(t, operator_lt(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case LTE:
-      t_set_resval(t, operator_lte(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case EQ:
-      t_set_resval(t, operator_eq(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case GT:
-      t_set_resval(t, operator_gt(vm, t, ins, t_get_resval(t), elt));
-      break;
-    case GTE:
-      t_set_resval(t, operator_gte(vm, t, ins, t_get_resval(t), elt));
-      break;
     case EXIT:
       t_set_resval(t, elt);
       return false;
     case RES:
       t_set_resval(t, elt);
       break;
+    case RCLL:
+      t_set_resval(t, elt);
+      popped = t_popstack(t, &has_error);
+      if (has_error) {
+        return true;
+      }
+      execute_call(vm, t, ins, popped);
+      break;
     case PUSH:
       t_pushstack(t, elt);
       break;
@@ -1397,6 +1507,24 @@ bool execute_val_param(VM *vm, Thread *t, Ins ins) {
         t_set_resval(t, new_res_val);
       }
       break;
+    case SLTS:
+      ASSERT(elt.type == VALUE, elt.val.type == INT);
+      memory_graph_init_slots(vm->graph, t_current_block(t).obj,
+                              elt.val.int_val);
+      break;
+    case RESL:
+      t_set_resval(t, slot_block(t, elt.val.int_val)
+                          ->slots[SLOT_INDEX(elt.val.int_val)]);
+      break;
+    case PSHL:
+      t_pushstack(t, slot_block(t, elt.val.int_val)
+                         ->slots[SLOT_INDEX(elt.val.int_val)]);
+      break;
+    case SETL:
+      new_res_val = t_get_resval(t);
+      memory_graph_set_slot(vm->graph, slot_block(t, elt.val.int_val),
+                            SLOT_INDEX(elt.val.int_val), &new_res_val);
+      break;
     default:
       ERROR("Instruction op was not a val_param. op=%s",
             instructions[(int)ins.op]);
@@ -1405,7 +1533,8 @@ bool execute_val_param(VM *vm, Thread *t, Ins ins) {
 }
 
 bool execute_str_param(VM *vm, Thread *t, Ins ins) {
-  Element str_array = string_create(vm, ins.str);
+  Element str_array = string_create(vm, ins.str), fn;
+  bool has_error = false;
   switch (ins.op) {
     case PUSH:
       t_pushstack(t, str_array);
@@ -1413,6 +1542,14 @@ bool execute_str_param(VM *vm, Thread *t, Ins ins) {
     case RES:
       t_set_resval(t, str_array);
       break;
+    case RCLL:
+      t_set_resval(t, str_array);
+      fn = t_popstack(t, &has_error);
+      if (has_error) {
+        return true;
+      }
+      execute_call(vm, t, ins, fn);
+      break;
     case PRNT:
       elt_to_str(str_array, stdout);
       if (DBG) {
@@ -1430,6 +1567,175 @@ bool execute_str_param(VM *vm, Thread *t, Ins ins) {
   return true;
 }
 
+// The generic form of the ops which can be quickened, once their operands have
+// been fetched.
+void execute_binary_generic(VM *vm, Thread *t, Ins ins, Element lhs,
+                            Element rhs) {
+  Element res;
+  switch (ins.op) {
+    case ADD:
+      if (ISTYPE(lhs, class_string) && ISTYPE(rhs, class_string)) {
+        res = string_add(vm, lhs, rhs);
+        break;
+      }
+      res = operator_add(vm, t, ins, lhs, rhs);
+      break;
+    case SUB:
+      res = operator_sub(vm, t, ins, lhs, rhs);
+      break;
+    case MULT:
+      res = operator_mult(vm, t, ins, lhs, rhs);
+      break;
+    case DIV:
+      res = operator_div(vm, t, ins, lhs, rhs);
+      break;
+    case MOD:
+      res = operator_mod(vm, t, ins, lhs, rhs);
+      break;
+    case EQ:
+      if (NO_PARAM == ins.param &&
+          (lhs.type != VALUE || rhs.type != VALUE)) {
+        execute_object_operation(vm, t, lhs, rhs, EQ_FN_NAME);
+        return;
+      }
+      res = operator_eq(vm, t, ins, lhs, rhs);
+      break;
+    case NEQ:
+      if (NO_PARAM == ins.param &&
+          (lhs.type != VALUE || rhs.type != VALUE)) {
+        execute_object_operation(vm, t, lhs, rhs, NEQ_FN_NAME);
+        return;
+      }
+      res = operator_neq(vm, t, ins, lhs, rhs);
+      break;
+    case GT:
+      res = operator_gt(vm, t, ins, lhs, rhs);
+      break;
+    case LT:
+      res = operator_lt(vm, t, ins, lhs, rhs);
+      break;
+    case GTE:
+      res = operator_gte(vm, t, ins, lhs, rhs);
+      break;
+    case LTE:
+      res = operator_lte(vm, t, ins, lhs, rhs);
+      break;
+    default:
+      vm_throw_error(vm, t, ins, "Instruction op was not a binary op.");
+      return;
+  }
+  t_set_resval(t, res);
+}
+
+// The operands of a binary op are either the top two on the stack or the
+// resval and the instruction's parameter. Returns false if the stack ran out.
+bool binary_operands(VM *vm, Thread *t, Ins ins, Element *lhs, Element *rhs) {
+  bool has_error = false;
+  switch (ins.param) {
+    case NO_PARAM:
+      *rhs = t_popstack(t, &has_error);
+      if (has_error) {
+        return false;
+      }
+      *lhs = t_popstack(t, &has_error);
+      return !has_error;
+    case VAL_PARAM:
+      *lhs = t_get_resval(t);
+      *rhs = val_to_elt(ins.val);
+      return true;
+    default /*ID_PARAM*/:
+      *lhs = t_get_resval(t);
+      *rhs = vm_lookup(vm, t, ins.id);
+      return true;
+  }
+}
+
+// Runs an op which can be quickened. If both operands are Ints or both are
+// Floats the instruction is rewritten to the op specialized for them, and if a
+// specialized op sees anything else it is rewritten back.
+bool execute_binary(VM *vm, Thread *t, Ins ins) {
+  Element lhs, rhs, res;
+  if (!binary_operands(vm, t, ins, &lhs, &rhs)) {
+    return true;
+  }
+  if (operator_quick(vm, ins.op, lhs, rhs, &res)) {
+    t_set_resval(t, res);
+    return true;
+  }
+  Op generic = op_generic(ins.op);
+  Op specialized = op_specialize(generic, lhs, rhs);
+  if (specialized != ins.op) {
+    module_set_op(t_get_module(t).obj->module, t_get_ip(t), specialized);
+  }
+  if (specialized == generic) {
+    ins.op = generic;
+    execute_binary_generic(vm, t, ins, lhs, rhs);
+    return true;
+  }
+  operator_quick(vm, specialized, lhs, rhs, &res);
+  t_set_resval(t, res);
+  return true;
+}
+
+// Compares two objects with builtin.eq() or builtin.neq() and waits for the
+// answer, since a compare-and-branch op needs it before moving on. Returns
+// false if the call raised an error.
+bool execute_object_compare(VM *vm, Thread *t, Element lhs, Element rhs,
+                            const char func_name[], Element *res) {
+  Element args = create_tuple(vm->graph);
+  memory_graph_tuple_add(vm->graph, args, lhs);
+  memory_graph_tuple_add(vm->graph, args, rhs);
+  Element builtin = vm_lookup_module(vm, BUILTIN_MODULE_NAME);
+  ASSERT(NONE != builtin.type);
+  Element fn = vm_object_lookup(vm, t, builtin, func_name);
+  ASSERT(NONE != fn.type);
+  return vm_call_fn_sync(vm, t, builtin, fn, args, res);
+}
+
+// Runs the comparison of a compare-and-branch op and skips the JMP after it if
+// the comparison holds. The resval is only changed by builtin.eq() or
+// builtin.neq(), and the optimizer only fuses where it is not read afterward.
+bool execute_compare_branch(VM *vm, Thread *t, Ins ins) {
+  Element lhs, rhs, res;
+  if (!binary_operands(vm, t, ins, &lhs, &rhs)) {
+    return true;
+  }
+  ins.op = op_branch_compare(ins.op);
+  if (!operator_quick(vm, op_specialize(ins.op, lhs, rhs), lhs, rhs, &res)) {
+    switch (ins.op) {
+      case LT:
+        res = operator_lt(vm, t, ins, lhs, rhs);
+        break;
+      case LTE:
+        res = operator_lte(vm, t, ins, lhs, rhs);
+        break;
+      case GT:
+        res = operator_gt(vm, t, ins, lhs, rhs);
+        break;
+      case GTE:
+        res = operator_gte(vm, t, ins, lhs, rhs);
+        break;
+      default /*EQ, NEQ*/:
+        if (NO_PARAM == ins.param &&
+            (lhs.type != VALUE || rhs.type != VALUE)) {
+          if (!execute_object_compare(vm, t, lhs, rhs,
+                                      EQ == ins.op ? EQ_FN_NAME : NEQ_FN_NAME,
+                                      &res)) {
+            return true;
+          }
+          break;
+        }
+        res = (EQ == ins.op) ? operator_eq(vm, t, ins, lhs, rhs)
+                             : operator_neq(vm, t, ins, lhs, rhs);
+        break;
+    }
+  }
+  if (is_true(res)) {
+    t_shift_ip(t, 1);
+  }
+  return true;
+}
+
 // returns whether or not the program should continue
 bool execute(VM *vm, Thread *t) {
   ASSERT_NOT_NULL(vm);
@@ -1450,19 +1756,34 @@ bool execute(VM *vm, Thread *t) {
   mutex_release(vm->debug_mutex);
 #endif
 
+  if (NULL != vm->op_profile) {
+    op_profile_record(vm->op_profile, t->op_history, ins.op);
+  }
+
   bool status;
-  switch (ins.param) {
-    case ID_PARAM:
-      status = execute_id_param(vm, t, ins);
-      break;
-    case VAL_PARAM:
-      status = execute_val_param(vm, t, ins);
+  switch (ins.op) {
+    QUICK_OPS(QUICK_CASES)
+    case MOD:
+    case MODI:
+      status = execute_binary(vm, t, ins);
       break;
-    case STR_PARAM:
-      status = execute_str_param(vm, t, ins);
+    BRANCH_OPS(BRANCH_CASES)
+      status = execute_compare_branch(vm, t, ins);
       break;
     default:
-      status = execute_no_param(vm, t, ins);
+      switch (ins.param) {
+        case ID_PARAM:
+          status = execute_id_param(vm, t, ins);
+          break;
+        case VAL_PARAM:
+          status = execute_val_param(vm, t, ins);
+          break;
+        case STR_PARAM:
+          status = execute_str_param(vm, t, ins);
+          break;
+        default:
+          status = execute_no_param(vm, t, ins);
+      }
   }
   if (NONE != obj_get_field(t_current_block(t), ERROR_KEY).type) {
     catch_error(vm, t);
@@ -1474,6 +1795,31 @@ bool execute(VM *vm, Thread *t) {
   return status;
 }
 
+void vm_resume_parked(VM *vm, Thread *t) {
+  ASSERT(t->park.fd >= 0);
+  ExternalFunction fn = t->park.fn;
+  Element obj = obj_get_field(t->self, strings_intern("$park_obj"));
+  Element arg = obj_get_field(t->self, strings_intern("$park_arg"));
+  t->park.fd = -1;
+  Element block = t_current_block(t);
+  Element returned = fn(vm, t, obj.obj->external_data, &arg);
+  if (t->park.fd >= 0) {
+    return;
+  }
+  memory_graph_set_field(vm->graph, t->self, strings_intern("$park_obj"),
+                         create_none());
+  memory_graph_set_field(vm->graph, t->self, strings_intern("$park_arg"),
+                         create_none());
+  // The rest of what execute() does after a call. The ip already moved past
+  // the call when the Thread parked.
+  t_set_resval(t, returned);
+  if (NONE != obj_get_field(t_current_block(t), ERROR_KEY).type) {
+    catch_error(vm, t);
+  } else if (block.obj != t_current_block(t).obj) {
+    t_shift_ip(t, 1);
+  }
+}
+
 void vm_maybe_initialize_and_execute(VM *vm, Thread *t,
                                      Element module_element) {
   mutex_await(vm->module_init_mutex, INFINITE);
@@ -1490,8 +1836,10 @@ void vm_maybe_initialize_and_execute(VM *vm, Thread *t,
   ASSERT(NONE != module_element.type);
   t_new_block(t, module_element, module_element);
   t_set_module(t, module_element, 0);
+  t->sync_depth++;
   while (execute(vm, t))
     ;
+  t->sync_depth--;
   t_back(t);
 
   t_set_resval(t, memory_graph_array_pop(vm->graph, get_old_resvals(t).obj));
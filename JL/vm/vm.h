@@ -12,6 +12,7 @@
 #include <stdint.h>
 
 #include "../command/commandline.h"
+#include "../datastructure/map.h"
 #include "../element.h"
 #include "../program/instruction.h"
 #include "../threads/thread_interface.h"
@@ -20,12 +21,23 @@
 
 typedef struct MemoryGraph_ MemoryGraph;
 typedef struct Module_ Module;
+typedef struct OpProfile_ OpProfile;
 
 struct VM_ {
   ArgStore *store;
   MemoryGraph *graph;
   Element root, modules, empty_tuple;
-  ThreadHandle debug_mutex, module_init_mutex;
+  ThreadHandle debug_mutex, module_init_mutex, module_load_mutex;
+  // Builtin files which have not been compiled yet, by module name. Each is
+  // loaded the first time it is looked up.
+  Map pending_modules;
+  int num_pending_modules;
+  // Module name of each class a pending module would make global, so a lookup
+  // which misses can load just the module that owns the name. Only written
+  // during vm_create().
+  Map builtin_classes;
+  // NULL unless -profile_ops is set.
+  OpProfile *op_profile;
 };
 
 VM *vm_create(ArgStore *store);
@@ -40,12 +52,17 @@ void vm_throw_error(VM *vm, Thread *t, Ins ins, const char fmt[], ...);
 
 Element vm_lookup(VM *vm, Thread *t, const char name[]);
 
-DEB_FN(Element, vm_lookup_module, const VM *vm, const char module_name[]);
+DEB_FN(Element, vm_lookup_module, VM *vm, const char module_name[]);
 
 void vm_maybe_initialize_and_execute(VM *vm, Thread *t, Element module_element);
 
 void vm_call_fn(VM *vm, Thread *t, Element obj, Element func);
 void vm_call_new(VM *vm, Thread *t, Element class);
+// Calls func with args and executes it until it returns. For external functions
+// which need to call back into JL code. Returns false if func raised an error
+// which it did not catch, in which case the caller should return right away.
+bool vm_call_fn_sync(VM *vm, Thread *t, Element obj, Element func,
+                     Element args, Element *result);
 
 void vm_start_execution(VM *vm, Element module);
 
@@ -53,4 +70,8 @@ void vm_set_catch_goto(VM *vm, Thread *t, uint32_t index);
 
 bool execute(VM *vm, Thread *t);
 
+// Calls the external a green Thread parked in again, once its fd is ready,
+// and finishes the call like execute() would. The Thread may park again.
+void vm_resume_parked(VM *vm, Thread *t);
+
 #endif /* VM_VM_H_ */